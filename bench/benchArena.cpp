@@ -0,0 +1,205 @@
+/**
+ * DeviceArena planning check on the host allocator : buffer offsets and reserved bytes of hand-computed plans
+ * (chain of overlapping lifetimes, disjoint lifetimes, all alive, the px2Cam buffers), no overlap between buffers alive
+ * at the same step and alignment on random plans, block per Commit(), allocation failure and Release().
+ * Then the time of Commit() for growing random plans. Returns the number of failed checks.
+ */
+
+#include "px2arena.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+static int numFailed = 0;
+
+static void Check(const char* name, bool passed)
+{
+    printf("%-56s %s\n", name, passed ? "ok" : "FAIL");
+    numFailed += passed ? 0 : 1;
+}
+
+static void CheckSize(const char* name, size_t value, size_t expected)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "%s : %zu (expected %zu)", name, value, expected);
+    Check(line, value == expected);
+}
+
+// A 0-1, B 1-2, C 2-3 : A and C share offset 0, B goes after the larger of the two
+static void CheckChain()
+{
+    HostArenaAllocator host;
+    DeviceArena arena(&host);
+    arenaBufferId a = arena.Request("chain", "A", 4096, 256, 0, 1);
+    arenaBufferId b = arena.Request("chain", "B", 1000, 256, 1, 2);
+    arenaBufferId c = arena.Request("chain", "C", 3000, 256, 2, 3);
+
+    Check("chain : no pointer before Commit()", arena.GetPtr(a) == nullptr);
+    Check("chain : Commit()", arena.Commit());
+    CheckSize("chain : offset A", arena.GetOffset(a), 0);
+    CheckSize("chain : offset C (aliases A)", arena.GetOffset(c), 0);
+    CheckSize("chain : offset B", arena.GetOffset(b), 4096);
+    CheckSize("chain : reserved bytes", arena.GetReport().reservedBytes, 5096);
+}
+
+static void CheckDisjoint()
+{
+    HostArenaAllocator host;
+    DeviceArena arena(&host);
+    arenaBufferId a = arena.Request("disjoint", "A", 4096, 256, 0, 0);
+    arenaBufferId b = arena.Request("disjoint", "B", 1000, 256, 1, 1);
+    arenaBufferId c = arena.Request("disjoint", "C", 3000, 256, 2, 2);
+
+    Check("disjoint : Commit()", arena.Commit());
+    Check("disjoint : every offset is 0", (arena.GetOffset(a) == 0) && (arena.GetOffset(b) == 0) && (arena.GetOffset(c) == 0));
+    CheckSize("disjoint : reserved bytes", arena.GetReport().reservedBytes, 4096);
+}
+
+// Same buffers, all alive : packed by size, each offset aligned
+static void CheckAllAlive()
+{
+    HostArenaAllocator host;
+    DeviceArena arena(&host);
+    arenaBufferId a = arena.Request("alive", "A", 4096);
+    arenaBufferId b = arena.Request("alive", "B", 1000);
+    arenaBufferId c = arena.Request("alive", "C", 3000);
+
+    Check("all alive : Commit()", arena.Commit());
+    CheckSize("all alive : offset A", arena.GetOffset(a), 0);
+    CheckSize("all alive : offset C", arena.GetOffset(c), 4096);
+    CheckSize("all alive : offset B", arena.GetOffset(b), 7168);
+    CheckSize("all alive : reserved bytes", arena.GetReport().reservedBytes, 8168);
+}
+
+// px2Cam with resizeRatio 0.54 and a 1024x512 ROI : the resized image reuses the pitched RGBA copy
+static void CheckCamPlan()
+{
+    const size_t pitchedBytes = 7680*1208;
+    const size_t bgrBytes = 1920*1208*3;
+    const size_t resizedBytes = 1036*652*3;
+    const size_t trtBytes = 1024*512*3*sizeof(float);
+    const size_t croppedBytes = 1024*512*3;
+
+    HostArenaAllocator host;
+    DeviceArena arena(&host);
+    arenaBufferId pitchedId = arena.Request("cam", "pitchedRGBA", pitchedBytes, 256, 0, 1);
+    arena.Request("cam", "gpuMatBGR", bgrBytes);
+    arenaBufferId resizedId = arena.Request("cam", "gpuMatResized", resizedBytes, 256, 2, 3);
+    arena.Request("cam", "trtImg", trtBytes);
+    arena.Request("cam", "cropped", croppedBytes);
+
+    Check("cam : Commit()", arena.Commit());
+    Check("cam : gpuMatResized aliases pitchedRGBA", arena.GetOffset(resizedId) == arena.GetOffset(pitchedId));
+    CheckSize("cam : reserved bytes", arena.GetReport().reservedBytes, pitchedBytes + bgrBytes + trtBytes + croppedBytes);
+
+    // A later module gets its own block
+    arenaBufferId laneMapId = arena.Request("ld", "laneMap", 2*256*512*4, 1024);
+    Check("cam + ld : second Commit()", arena.Commit());
+    Check("cam + ld : laneMap 1024 aligned", ((uintptr_t)arena.GetPtr(laneMapId) & 1023) == 0);
+    CheckSize("cam + ld : blocks", arena.GetReport().numBlocks, 2);
+    CheckSize("cam + ld : host allocations", host.GetNumAllocations(), 2);
+    CheckSize("cam + ld : reserved bytes", arena.GetReport().reservedBytes,
+              pitchedBytes + bgrBytes + trtBytes + croppedBytes + 2*256*512*4);
+
+    arena.Release();
+    CheckSize("cam + ld : host bytes after Release()", host.GetAllocatedBytes(), 0);
+}
+
+// Random buffers on 6 steps : buffers alive at the same step never overlap, offsets are aligned
+static void CheckRandomPlans()
+{
+    mt19937 rng(1);
+    HostArenaAllocator host;
+    int numCommitFailures = 0;
+    int numOverlaps = 0;
+    int numMisaligned = 0;
+
+    for(int planIdx = 0; planIdx < 500; planIdx++)
+    {
+        DeviceArena arena(&host);
+        int numBuffers = 1 + rng()%16;
+
+        vector<arenaBufferId> ids;
+        vector<uint32_t> firstSteps, lastSteps;
+        vector<size_t> sizes, alignments;
+        for(int bufferIdx = 0; bufferIdx < numBuffers; bufferIdx++)
+        {
+            firstSteps.push_back(rng()%6);
+            lastSteps.push_back(firstSteps.back() + rng()%4);
+            sizes.push_back(1 + rng()%5000);
+            alignments.push_back((size_t)1 << (rng()%11));
+            ids.push_back(arena.Request("random", "buffer", sizes.back(), alignments.back(), firstSteps.back(), lastSteps.back()));
+        }
+
+        if(!arena.Commit())
+        {
+            numCommitFailures++;
+            continue;
+        }
+
+        for(int i = 0; i < numBuffers; i++)
+        {
+            numMisaligned += ((uintptr_t)arena.GetPtr(ids[i]) % alignments[i] != 0) ? 1 : 0;
+
+            for(int j = i + 1; j < numBuffers; j++)
+            {
+                bool alive = (firstSteps[i] <= lastSteps[j]) && (firstSteps[j] <= lastSteps[i]);
+                size_t offsetI = arena.GetOffset(ids[i]);
+                size_t offsetJ = arena.GetOffset(ids[j]);
+                bool disjoint = (offsetI + sizes[i] <= offsetJ) || (offsetJ + sizes[j] <= offsetI);
+                numOverlaps += (alive && !disjoint) ? 1 : 0;
+            }
+        }
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line), "random plans : %d failed, %d overlaps, %d misaligned", numCommitFailures, numOverlaps, numMisaligned);
+    Check(line, (numCommitFailures == 0) && (numOverlaps == 0) && (numMisaligned == 0));
+}
+
+static void CheckAllocationFailure()
+{
+    HostArenaAllocator host;
+    host.SetLimit(1000);
+    DeviceArena arena(&host);
+    arenaBufferId bigId = arena.Request("limit", "big", 1 << 20);
+
+    Check("limit : Commit() fails over the allocator limit", !arena.Commit());
+    Check("limit : nothing allocated, no pointer", (host.GetNumAllocations() == 0) && (arena.GetPtr(bigId) == nullptr));
+}
+
+int main()
+{
+    CheckChain();
+    CheckDisjoint();
+    CheckAllAlive();
+    CheckCamPlan();
+    CheckRandomPlans();
+    CheckAllocationFailure();
+
+    printf("\nbuffers   Commit()(us)  requested(KB)  reserved(KB)\n");
+
+    mt19937 rng(2);
+    for(int numBuffers : {8, 32, 128, 512})
+    {
+        HostArenaAllocator host;
+        DeviceArena arena(&host);
+        for(int bufferIdx = 0; bufferIdx < numBuffers; bufferIdx++)
+        {
+            uint32_t firstStep = rng()%16;
+            arena.Request("timing", "buffer", 1024 + rng()%(1 << 20), 256, firstStep, firstStep + rng()%4);
+        }
+
+        auto begin = chrono::steady_clock::now();
+        arena.Commit();
+        double commitUs = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count();
+
+        arenaReport report = arena.GetReport();
+        printf("%7d   %12.1f  %13zu  %12zu\n", numBuffers, commitUs, report.requestedBytes/1024, report.reservedBytes/1024);
+    }
+
+    return numFailed;
+}
@@ -0,0 +1,160 @@
+/**
+ * OverlayCompositor span blend check : FillRect() (SSE2 / NEON span blend, scalar tail) against a scalar reference,
+ * round((src*a + dst*(255 - a))/255) per channel, for every alpha, span offsets 0-7 and widths 0-40 on random pixels,
+ * pixels outside the span unchanged. Then the time of a 1920x1208 fill for both and of Compose() with a typical overlay
+ * (labeled boxes, lane poly lines, texts, top-view inset). Returns the number of failed checks.
+ */
+
+#include "px2compositor.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace std;
+
+static const int frameWidth = 1920;
+static const int frameHeight = 1208;
+
+static const char* GetSpanISA()
+{
+#if defined(__SSE2__)
+    return "SSE2";
+#elif defined(__aarch64__)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+// 255 is odd, so t/255 is never halfway between two integers
+static void FillRectReference(cv::Mat& rgba, int x0, int y0, int x1, int y1, const uint8_t* color)
+{
+    const uint32_t alpha = color[3];
+    const uint8_t src[4] = {color[0], color[1], color[2], 255};
+
+    for(int y = max(y0, 0); y < min(y1, rgba.rows); y++)
+    {
+        uint8_t* row = rgba.ptr<uint8_t>(y);
+        for(int x = max(x0, 0); x < min(x1, rgba.cols); x++)
+        {
+            for(int c = 0; c < 4; c++)
+            {
+                uint32_t t = src[c]*alpha + row[4*x + c]*(255 - alpha);
+                row[4*x + c] = (uint8_t)((2*t + 255)/510);
+            }
+        }
+    }
+}
+
+static void RandomFill(cv::Mat& rgba, mt19937& rng)
+{
+    for(int y = 0; y < rgba.rows; y++)
+    {
+        uint8_t* row = rgba.ptr<uint8_t>(y);
+        for(int x = 0; x < rgba.cols*4; x++)
+            row[x] = rng() & 0xFF;
+    }
+}
+
+static long CountDiffs(const cv::Mat& a, const cv::Mat& b)
+{
+    long numDiffs = 0;
+    for(int y = 0; y < a.rows; y++)
+        numDiffs += (memcmp(a.ptr<uint8_t>(y), b.ptr<uint8_t>(y), a.cols*4) != 0) ? 1 : 0;
+    return numDiffs;
+}
+
+static double FillMs(void (*fill)(cv::Mat&, int, int, int, int, const uint8_t*), cv::Mat& rgba, const uint8_t* color)
+{
+    const int numIters = 20;
+    auto begin = chrono::steady_clock::now();
+    for(int iter = 0; iter < numIters; iter++)
+        fill(rgba, 0, 0, rgba.cols, rgba.rows, color);
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count()/numIters;
+}
+
+int main()
+{
+    int numFailed = 0;
+    mt19937 rng(1);
+
+    // Every alpha, every span start in a 16 byte vector and every tail length
+    long numSpans = 0;
+    long numBadSpans = 0;
+    cv::Mat row(1, 64, CV_8UC4);
+    cv::Mat rowReference;
+    for(int alpha = 0; alpha < 256; alpha++)
+    {
+        for(int x0 = 0; x0 < 8; x0++)
+        {
+            for(int width = 0; width <= 40; width++)
+            {
+                const uint8_t color[4] = {(uint8_t)(rng() & 0xFF), (uint8_t)(rng() & 0xFF), (uint8_t)(rng() & 0xFF), (uint8_t)alpha};
+
+                RandomFill(row, rng);
+                row.copyTo(rowReference);
+
+                OverlayCompositor::FillRect(row, x0, 0, x0 + width, 1, color);
+                FillRectReference(rowReference, x0, 0, x0 + width, 1, color);
+
+                numBadSpans += CountDiffs(row, rowReference);
+                numSpans++;
+            }
+        }
+    }
+
+    printf("span blend (%s) : %ld spans, %ld differ from the scalar reference  %s\n",
+           GetSpanISA(), numSpans, numBadSpans, (numBadSpans == 0) ? "ok" : "FAIL");
+    numFailed += (numBadSpans == 0) ? 0 : 1;
+
+    // Full frame
+    cv::Mat frame(frameHeight, frameWidth, CV_8UC4);
+    cv::Mat frameReference;
+    RandomFill(frame, rng);
+    frame.copyTo(frameReference);
+
+    const uint8_t translucent[4] = {255, 64, 0, 96};
+    double fillMs = FillMs(OverlayCompositor::FillRect, frame, translucent);
+    double referenceMs = FillMs(FillRectReference, frameReference, translucent);
+    long numBadRows = CountDiffs(frame, frameReference);
+
+    printf("%dx%d fill, alpha %d : FillRect %.2fms, scalar reference %.2fms, %ld rows differ  %s\n",
+           frameWidth, frameHeight, translucent[3], fillMs, referenceMs, numBadRows, (numBadRows == 0) ? "ok" : "FAIL");
+    numFailed += (numBadRows == 0) ? 0 : 1;
+
+    // Compose() of a display frame : 20 labeled boxes, 4 lanes, 2 texts, 500x500 top view
+    OverlayBatch overlay;
+    const dwVector4f red{1.f, 0.f, 0.f, 1.f};
+    const dwVector4f green{0.f, 1.f, 0.f, 0.5f};
+    for(int boxIdx = 0; boxIdx < 20; boxIdx++)
+    {
+        dwRectf box{(float32_t)(80*boxIdx), (float32_t)(400 + 10*boxIdx), 120.f, 90.f};
+        overlay.AddBox(box, red, 2.f, "car");
+    }
+    for(int laneIdx = 0; laneIdx < 4; laneIdx++)
+    {
+        dwVector2f lanePts[20];
+        for(int ptIdx = 0; ptIdx < 20; ptIdx++)
+            lanePts[ptIdx] = dwVector2f{(float32_t)(400 + 300*laneIdx + 10*ptIdx), (float32_t)(1200 - 30*ptIdx)};
+        overlay.AddPolyLine(lanePts, 20, green, 6.f);
+    }
+    overlay.AddText("fps 30.0", dwVector2f{20.f, 40.f}, red);
+    overlay.AddText("level 0", dwVector2f{20.f, 70.f}, red);
+
+    cv::Mat topView(500, 500, CV_8UC3, cv::Scalar(40, 80, 40));
+
+    OverlayCompositor compositor;
+    compositor.Compose(frame, overlay, topView);
+
+    const int numIters = 20;
+    auto begin = chrono::steady_clock::now();
+    for(int iter = 0; iter < numIters; iter++)
+        compositor.Compose(frame, overlay, topView);
+    double composeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count()/numIters;
+
+    printf("Compose() %dx%d, %u primitives + inset : %.2fms\n", frameWidth, frameHeight, overlay.GetNumPrimitives(), composeMs);
+
+    return numFailed;
+}
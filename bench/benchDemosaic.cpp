@@ -0,0 +1,235 @@
+/**
+ * Fused RCCB demosaic check : DemosaicRCCBHost() against an independent path on synthetic 1920x1208 RCCB frames,
+ * full-res bilinear demosaic -> linear RCB image -> bilinear resize (cv::resize INTER_LINEAR pixel centers) -> crop
+ * -> black / white level, gains, G = C - R - B, gamma. Then DemosaicRCCB() on the GPU against the host reference, and its time.
+ */
+
+#include "px2demosaic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+static const int rawWidth = 1920;
+static const int rawHeight = 1208;
+
+// 0 : R, 1 : C, 2 : B
+static int CfaColor(const rccbDemosaicParameters& params, int x, int y)
+{
+    int qx = x & 1;
+    int qy = y & 1;
+    if((qx == params.redX) && (qy == params.redY))
+        return 0;
+    if((qx != params.redX) && (qy != params.redY))
+        return 2;
+    return 1;
+}
+
+// Flat : R 1000, C 3000, B 800. Otherwise a smooth scene, C ~ 1.6 x R + G + B
+static void MakeRaw(cv::Mat& raw, const rccbDemosaicParameters& params, bool flat)
+{
+    raw.create(rawHeight, rawWidth, CV_16UC1);
+    for(int y = 0; y < rawHeight; y++)
+    {
+        uint16_t* row = (uint16_t*)(raw.data + y*raw.step);
+        for(int x = 0; x < rawWidth; x++)
+        {
+            const float flatValues[3] = {1000.f, 3000.f, 800.f};
+            const float sceneGains[3] = {0.6f, 1.6f, 0.5f};
+
+            int color = CfaColor(params, x, y);
+            float base = 1200.f + 800.f*sinf(x*0.01f)*cosf(y*0.013f);
+            row[x] = (uint16_t)(flat ? flatValues[color] : base*sceneGains[color]);
+        }
+    }
+}
+
+// Bilinear demosaic : the sample on its own site, otherwise the mean of the same color sites around it
+static void DemosaicFullRes(const cv::Mat& raw, const rccbDemosaicParameters& params, vector<float>& rcb)
+{
+    rcb.assign((size_t)rawWidth*rawHeight*3, 0.f);
+    for(int y = 0; y < rawHeight; y++)
+    {
+        for(int x = 0; x < rawWidth; x++)
+        {
+            float sum[3] = {0.f, 0.f, 0.f};
+            int count[3] = {0, 0, 0};
+            int color = CfaColor(params, x, y);
+
+            for(int dy = -1; dy <= 1; dy++)
+            {
+                for(int dx = -1; dx <= 1; dx++)
+                {
+                    int xx = x + dx;
+                    int yy = y + dy;
+                    if((xx < 0) || (yy < 0) || (xx >= rawWidth) || (yy >= rawHeight))
+                        continue;
+
+                    int neighborColor = CfaColor(params, xx, yy);
+                    if(neighborColor == color)
+                        continue;
+                    sum[neighborColor] += ((const uint16_t*)(raw.data + yy*raw.step))[xx];
+                    count[neighborColor]++;
+                }
+            }
+
+            float* px = &rcb[((size_t)y*rawWidth + x)*3];
+            for(int c = 0; c < 3; c++)
+                px[c] = (c == color) ? ((const uint16_t*)(raw.data + y*raw.step))[x] : sum[c]/count[c];
+        }
+    }
+}
+
+// Resized pixel (x, y) : source (x + 0.5)/scale - 0.5, border replicated
+static void ResizeBilinear(const vector<float>& src, int srcW, int srcH, vector<float>& dst, int dstW, int dstH)
+{
+    dst.resize((size_t)dstW*dstH*3);
+    float scaleX = (float)dstW/srcW;
+    float scaleY = (float)dstH/srcH;
+
+    for(int y = 0; y < dstH; y++)
+    {
+        float sy = max(0.f, (y + 0.5f)/scaleY - 0.5f);
+        int y0 = min((int)sy, srcH - 1);
+        int y1 = min(y0 + 1, srcH - 1);
+        float fy = min(sy - y0, 1.f);
+
+        for(int x = 0; x < dstW; x++)
+        {
+            float sx = max(0.f, (x + 0.5f)/scaleX - 0.5f);
+            int x0 = min((int)sx, srcW - 1);
+            int x1 = min(x0 + 1, srcW - 1);
+            float fx = min(sx - x0, 1.f);
+
+            for(int c = 0; c < 3; c++)
+            {
+                float top = (1.f - fx)*src[((size_t)y0*srcW + x0)*3 + c] + fx*src[((size_t)y0*srcW + x1)*3 + c];
+                float bottom = (1.f - fx)*src[((size_t)y1*srcW + x0)*3 + c] + fx*src[((size_t)y1*srcW + x1)*3 + c];
+                dst[((size_t)y*dstW + x)*3 + c] = (1.f - fy)*top + fy*bottom;
+            }
+        }
+    }
+}
+
+static float ToneCurveReference(float value, float gamma)
+{
+    return powf(min(max(value, 0.f), 1.f), gamma);
+}
+
+// Same tensor layout as DemosaicRCCBHost() (CHW, RGB 0-1)
+static void IndependentPath(const cv::Mat& raw, const rccbDemosaicParameters& params, int resizedW, int resizedH,
+                            const tensorCropGeometry& geometry, vector<float>& tensor)
+{
+    vector<float> rcb, resized;
+    DemosaicFullRes(raw, params, rcb);
+    ResizeBilinear(rcb, rawWidth, rawHeight, resized, resizedW, resizedH);
+
+    int numPx = geometry.roiW*geometry.roiH;
+    tensor.resize(3*numPx);
+
+    float scale = 1.f/(params.whiteLevel - params.blackLevel);
+    for(int y = 0; y < geometry.roiH; y++)
+    {
+        for(int x = 0; x < geometry.roiW; x++)
+        {
+            const float* px = &resized[((size_t)(geometry.roiY + y)*resizedW + geometry.roiX + x)*3];
+            float r = (px[0] - params.blackLevel)*scale*params.gainR;
+            float c = (px[1] - params.blackLevel)*scale*params.gainC;
+            float b = (px[2] - params.blackLevel)*scale*params.gainB;
+
+            int j = y*geometry.roiW + x;
+            tensor[j] = ToneCurveReference(r, params.gamma);
+            tensor[numPx + j] = ToneCurveReference(c - r - b, params.gamma);
+            tensor[2*numPx + j] = ToneCurveReference(b, params.gamma);
+        }
+    }
+}
+
+int main()
+{
+    rccbDemosaicParameters params;
+    params.blackLevel = 64.f;
+    params.gainR = 1.1f;
+    params.gainB = 1.2f;
+
+    // px2Cam geometries : resizeRatio 0.54 (full res demosaic) and 0.5 (half res), centered crop
+    struct { float resizeRatio; int roiW, roiH; } cases[2] = {{0.54f, 1024, 512}, {0.5f, 900, 400}};
+
+    printf("scene   res    fused vs independent x255 : mean    max     kernel vs host    kernel(us)\n");
+
+    for(bool flat : {true, false})
+    {
+        cv::Mat raw;
+        MakeRaw(raw, params, flat);
+
+        for(const auto& testCase : cases)
+        {
+            int resizedW = (int)(rawWidth*testCase.resizeRatio);
+            int resizedH = (int)(rawHeight*testCase.resizeRatio);
+
+            tensorCropGeometry geometry;
+            geometry.scaleX = (float)resizedW/rawWidth;
+            geometry.scaleY = (float)resizedH/rawHeight;
+            geometry.roiW = testCase.roiW;
+            geometry.roiH = testCase.roiH;
+            geometry.roiX = (resizedW - geometry.roiW)/2;
+            geometry.roiY = (resizedH - geometry.roiH)/2;
+            geometry.halfRes = (geometry.scaleX <= 0.5f) && (geometry.scaleY <= 0.5f);
+
+            vector<float> fused, independent;
+            cv::Mat bgr;
+            DemosaicRCCBHost(raw, params, geometry, fused, bgr);
+            IndependentPath(raw, params, resizedW, resizedH, geometry, independent);
+
+            double sumErr = 0.0;
+            float maxErr = 0.f;
+            for(size_t i = 0; i < fused.size(); i++)
+            {
+                float err = fabsf(fused[i] - independent[i]);
+                sumErr += err;
+                maxErr = max(maxErr, err);
+            }
+
+            // Kernel on the same frame
+            char kernelResult[64] = "no device";
+            double kernelUs = 0.0;
+
+            uint16_t* rawDev = nullptr;
+            float* tensorDev = nullptr;
+            size_t rawPitch = 0;
+            if((cudaMallocPitch((void**)&rawDev, &rawPitch, rawWidth*sizeof(uint16_t), rawHeight) == cudaSuccess) &&
+               (cudaMalloc((void**)&tensorDev, fused.size()*sizeof(float)) == cudaSuccess))
+            {
+                cudaMemcpy2D(rawDev, rawPitch, raw.data, raw.step, rawWidth*sizeof(uint16_t), rawHeight, cudaMemcpyHostToDevice);
+
+                DemosaicRCCB(rawDev, rawPitch, rawWidth, rawHeight, params, geometry, tensorDev, nullptr);
+                cudaDeviceSynchronize();
+
+                const int numIters = 100;
+                auto begin = chrono::steady_clock::now();
+                for(int iter = 0; iter < numIters; iter++)
+                    DemosaicRCCB(rawDev, rawPitch, rawWidth, rawHeight, params, geometry, tensorDev, nullptr);
+                cudaDeviceSynchronize();
+                kernelUs = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count()/numIters;
+
+                vector<float> kernelTensor(fused.size());
+                cudaMemcpy(kernelTensor.data(), tensorDev, fused.size()*sizeof(float), cudaMemcpyDeviceToHost);
+
+                float kernelMaxDiff = 0.f;
+                for(size_t i = 0; i < fused.size(); i++)
+                    kernelMaxDiff = max(kernelMaxDiff, fabsf(kernelTensor[i] - fused[i]));
+                snprintf(kernelResult, sizeof(kernelResult), "max %.2e", kernelMaxDiff);
+            }
+            cudaFree(rawDev);
+            cudaFree(tensorDev);
+
+            printf("%-6s  %-4s   %36.2f  %6.2f     %-16s  %9.1f\n", flat ? "flat" : "smooth", geometry.halfRes ? "half" : "full",
+                   255.0*sumErr/fused.size(), 255.f*maxErr, kernelResult, kernelUs);
+        }
+    }
+
+    return 0;
+}
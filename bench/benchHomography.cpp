@@ -0,0 +1,114 @@
+/**
+ * BatchHomography micro-benchmark : rectified image -> top-view of lane points with a ground plane homography.
+ * Batched float kernels (SoA, interleaved) against the former per-point double precision projection
+ * (px2LD::Rect2Topview), throughput and largest difference.
+ */
+
+#include "homography.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Former px2LD::Rect2Topview, one point per call
+static void Rect2TopviewReference(const double* H, float xIn, float yIn, float& xOut, float& yOut)
+{
+    double w = H[6]*xIn + H[7]*yIn + H[8];
+
+    xOut = (H[0]*xIn + H[1]*yIn + H[2])/w;
+    yOut = (H[3]*xIn + H[4]*yIn + H[5])/w;
+}
+
+static void Invert3x3(const double* M, double* Minv)
+{
+    double adj[9];
+    adj[0] = M[4]*M[8] - M[5]*M[7];
+    adj[1] = M[2]*M[7] - M[1]*M[8];
+    adj[2] = M[1]*M[5] - M[2]*M[4];
+    adj[3] = M[5]*M[6] - M[3]*M[8];
+    adj[4] = M[0]*M[8] - M[2]*M[6];
+    adj[5] = M[2]*M[3] - M[0]*M[5];
+    adj[6] = M[3]*M[7] - M[4]*M[6];
+    adj[7] = M[1]*M[6] - M[0]*M[7];
+    adj[8] = M[0]*M[4] - M[1]*M[3];
+
+    double det = M[0]*adj[0] + M[1]*adj[3] + M[2]*adj[6];
+    for(int i = 0; i < 9; i++)
+        Minv[i] = adj[i]/det;
+}
+
+static double ElapsedNs(chrono::steady_clock::time_point begin)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+}
+
+int main()
+{
+    // Ground (lateral x, forward y, meters) -> rectified pixel : f = 1000 px, 1920x1208 principal point, 1.5 m high
+    const double ground2Rect[9] = {1000.0,  960.0,    0.0,
+                                      0.0,  604.0, 1500.0,
+                                      0.0,    1.0,    0.0};
+    double rect2Topview[9];
+    Invert3x3(ground2Rect, rect2Topview);
+
+    BatchHomography homography;
+    homography.SetMatrix(rect2Topview);
+
+    // Lane points below the horizon, 2 m to 100 m ahead
+    mt19937 rng(7);
+    uniform_real_distribution<float> colDist(0.f, 1919.f);
+    uniform_real_distribution<float> rowDist(619.f, 1207.f);
+
+    printf("points   reference(ns/pt)  soa(ns/pt)  interleaved(ns/pt)  max diff(m)\n");
+
+    const uint32_t pointCounts[3] = {64, 1024, 16384};
+    for(int countIdx = 0; countIdx < 3; countIdx++)
+    {
+        uint32_t numPts = pointCounts[countIdx];
+
+        vector<float> xIn(numPts), yIn(numPts), ptsIn(2*numPts);
+        for(uint32_t ptIdx = 0; ptIdx < numPts; ptIdx++)
+        {
+            xIn[ptIdx] = colDist(rng);
+            yIn[ptIdx] = rowDist(rng);
+            ptsIn[2*ptIdx] = xIn[ptIdx];
+            ptsIn[2*ptIdx + 1] = yIn[ptIdx];
+        }
+
+        vector<float> xRef(numPts), yRef(numPts), xOut(numPts), yOut(numPts), ptsOut(2*numPts);
+
+        const int numIters = max(20, (int)(4e6/numPts));
+
+        auto begin = chrono::steady_clock::now();
+        for(int iter = 0; iter < numIters; iter++)
+            for(uint32_t ptIdx = 0; ptIdx < numPts; ptIdx++)
+                Rect2TopviewReference(rect2Topview, xIn[ptIdx], yIn[ptIdx], xRef[ptIdx], yRef[ptIdx]);
+        double referenceNs = ElapsedNs(begin)/((double)numIters*numPts);
+
+        begin = chrono::steady_clock::now();
+        for(int iter = 0; iter < numIters; iter++)
+            homography.Transform(xIn.data(), yIn.data(), xOut.data(), yOut.data(), numPts);
+        double soaNs = ElapsedNs(begin)/((double)numIters*numPts);
+
+        begin = chrono::steady_clock::now();
+        for(int iter = 0; iter < numIters; iter++)
+            homography.TransformInterleaved(ptsIn.data(), ptsOut.data(), numPts);
+        double interleavedNs = ElapsedNs(begin)/((double)numIters*numPts);
+
+        float maxDiff = 0.f;
+        for(uint32_t ptIdx = 0; ptIdx < numPts; ptIdx++)
+        {
+            maxDiff = max(maxDiff, max(fabsf(xOut[ptIdx] - xRef[ptIdx]), fabsf(yOut[ptIdx] - yRef[ptIdx])));
+            maxDiff = max(maxDiff, max(fabsf(ptsOut[2*ptIdx] - xRef[ptIdx]), fabsf(ptsOut[2*ptIdx + 1] - yRef[ptIdx])));
+        }
+
+        printf("%6u   %16.2f  %10.2f  %18.2f  %11.2e\n", numPts, referenceNs, soaNs, interleavedNs, maxDiff);
+    }
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * LaneSegDecoder micro-benchmark : synthetic lane probability maps at the lane network output sizes.
+ * Full decode time per map, and the row peak extraction against a plain scalar scan (same peaks expected).
+ */
+
+#include "laneDecoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+// 4 lanes converging to a vanishing point, gaussian cross profile, background noise
+static void MakeLaneMap(int mapWidth, int mapHeight, vector<float>& probMap)
+{
+    mt19937 rng(7);
+    uniform_real_distribution<float> noise(0.f, 0.2f);
+
+    probMap.resize((size_t)mapWidth*mapHeight);
+
+    const float bottomX[4] = {-0.1f, 0.3f, 0.7f, 1.1f};
+    float vanishX = 0.5f*mapWidth;
+    float vanishY = 0.35f*mapHeight;
+    float sigma = max(1.f, mapWidth/256.f);
+
+    for(int y = 0; y < mapHeight; y++)
+    {
+        float t = (y - vanishY)/(mapHeight - 1 - vanishY);
+        for(int x = 0; x < mapWidth; x++)
+        {
+            float prob = noise(rng);
+            if(t > 0.f)
+            {
+                for(int laneIdx = 0; laneIdx < 4; laneIdx++)
+                {
+                    float laneX = vanishX + t*(bottomX[laneIdx]*mapWidth - vanishX);
+                    float d = (x - laneX)/(sigma*(0.5f + t));
+                    prob = max(prob, expf(-0.5f*d*d));
+                }
+            }
+            probMap[(size_t)y*mapWidth + x] = prob;
+        }
+    }
+}
+
+// Reference : every pixel compared, same run rules as LaneSegDecoder::ExtractRowPeaks
+static int ExtractRowPeaksScalar(const float* rowData, int mapWidth, const laneDecoderParameters& params,
+                                 float* peakX, float* peakProb, int maxPeaks)
+{
+    int numPeaks = 0;
+    int x = 0;
+    while((x < mapWidth) && (numPeaks < maxPeaks))
+    {
+        if(rowData[x] <= params.probThres)
+        {
+            x++;
+            continue;
+        }
+
+        float probSum = 0.f;
+        float weightedXSum = 0.f;
+        float probMax = 0.f;
+        int runStart = x;
+        for(; (x < mapWidth) && (rowData[x] > params.probThres); x++)
+        {
+            probSum += rowData[x];
+            weightedXSum += rowData[x]*(float)x;
+            probMax = max(probMax, rowData[x]);
+        }
+
+        int runWidth = x - runStart;
+        if((runWidth >= params.minPeakWidth) && (runWidth <= params.maxPeakWidth))
+        {
+            peakX[numPeaks] = weightedXSum/probSum;
+            peakProb[numPeaks] = probMax;
+            numPeaks++;
+        }
+    }
+
+    return numPeaks;
+}
+
+static double ElapsedUs(chrono::steady_clock::time_point begin)
+{
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count();
+}
+
+int main()
+{
+    const int mapSizes[3][2] = {{256, 128}, {512, 256}, {1024, 512}};
+
+    printf("map size    decode(us)  lanes  peaks simd(us)  peaks scalar(us)  peaks equal\n");
+
+    for(int sizeIdx = 0; sizeIdx < 3; sizeIdx++)
+    {
+        int mapWidth = mapSizes[sizeIdx][0];
+        int mapHeight = mapSizes[sizeIdx][1];
+
+        vector<float> probMap;
+        MakeLaneMap(mapWidth, mapHeight, probMap);
+
+        LaneSegDecoder decoder;
+        laneDecoderParameters params;
+        params.maxLinkDx = 12.f*mapWidth/256.f;
+        params.maxPeakWidth = 40*mapWidth/256;
+        decoder.SetParameters(params);
+
+        const int numIters = max(20, (int)(2e7/((double)mapWidth*mapHeight)));
+
+        vector<laneInstance> lanes;
+        decoder.Decode(probMap.data(), mapWidth, mapHeight, lanes);
+
+        auto begin = chrono::steady_clock::now();
+        for(int iter = 0; iter < numIters; iter++)
+            decoder.Decode(probMap.data(), mapWidth, mapHeight, lanes);
+        double decodeUs = ElapsedUs(begin)/numIters;
+
+        // Every row, as with rowStep = 1
+        int maxPeaks = mapWidth/params.minPeakWidth + 1;
+        vector<float> peakX(maxPeaks), peakProb(maxPeaks), refX(maxPeaks), refProb(maxPeaks);
+
+        bool peaksEqual = true;
+        for(int y = 0; y < mapHeight; y++)
+        {
+            const float* rowData = probMap.data() + (size_t)y*mapWidth;
+            int numPeaks = decoder.ExtractRowPeaks(rowData, mapWidth, peakX.data(), peakProb.data(), maxPeaks);
+            int numRef = ExtractRowPeaksScalar(rowData, mapWidth, params, refX.data(), refProb.data(), maxPeaks);
+            peaksEqual = peaksEqual && (numPeaks == numRef) && equal(refX.begin(), refX.begin() + numRef, peakX.begin());
+        }
+
+        volatile int sink = 0;
+        begin = chrono::steady_clock::now();
+        for(int iter = 0; iter < numIters; iter++)
+            for(int y = 0; y < mapHeight; y++)
+                sink += decoder.ExtractRowPeaks(probMap.data() + (size_t)y*mapWidth, mapWidth, peakX.data(), peakProb.data(), maxPeaks);
+        double simdUs = ElapsedUs(begin)/numIters;
+
+        begin = chrono::steady_clock::now();
+        for(int iter = 0; iter < numIters; iter++)
+            for(int y = 0; y < mapHeight; y++)
+                sink += ExtractRowPeaksScalar(probMap.data() + (size_t)y*mapWidth, mapWidth, params, refX.data(), refProb.data(), maxPeaks);
+        double scalarUs = ElapsedUs(begin)/numIters;
+
+        printf("%4dx%-4d   %10.1f  %5d  %15.1f  %16.1f  %s\n", mapWidth, mapHeight, decodeUs, (int)lanes.size(),
+               simdUs, scalarUs, peaksEqual ? "yes" : "NO");
+    }
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * Fused NV12 -> tensor check : NV12ToTensorHost() against an independent path on synthetic 1920x1208 NV12 frames,
+ * chroma upsampled to full res (bilinear, MPEG-2 siting) -> YUV to RGB from the Kr / Kb definition of BT.601 / BT.709
+ * -> bilinear resize (cv::resize INTER_LINEAR pixel centers) -> crop -> clamp. Then NV12ToTensor() on the GPU against
+ * the host reference, and its time.
+ */
+
+#include "px2yuv.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+static const int frameWidth = 1920;
+static const int frameHeight = 1208;
+
+// Flat : Y 100, U 90, V 170. Otherwise smooth luma and chroma planes
+static void MakeNV12(cv::Mat& luma, cv::Mat& chroma, bool flat)
+{
+    luma.create(frameHeight, frameWidth, CV_8UC1);
+    chroma.create(frameHeight/2, frameWidth/2, CV_8UC2);
+
+    for(int y = 0; y < frameHeight; y++)
+    {
+        uint8_t* row = luma.ptr<uint8_t>(y);
+        for(int x = 0; x < frameWidth; x++)
+            row[x] = flat ? 100 : (uint8_t)(120.f + 80.f*sinf(x*0.011f)*cosf(y*0.009f));
+    }
+
+    for(int y = 0; y < frameHeight/2; y++)
+    {
+        uint8_t* row = chroma.ptr<uint8_t>(y);
+        for(int x = 0; x < frameWidth/2; x++)
+        {
+            row[2*x] = flat ? 90 : (uint8_t)(128.f + 40.f*sinf(x*0.02f));
+            row[2*x + 1] = flat ? 170 : (uint8_t)(128.f + 40.f*cosf(y*0.017f));
+        }
+    }
+}
+
+// Chroma (i, j) sits on luma (2*i, 2*j + 0.5), border replicated
+static float UpsampleChroma(const cv::Mat& chroma, int channel, int x, int y)
+{
+    float cx = min(max(x*0.5f, 0.f), (float)(chroma.cols - 1));
+    float cy = min(max((y - 0.5f)*0.5f, 0.f), (float)(chroma.rows - 1));
+    int x0 = (int)cx;
+    int y0 = (int)cy;
+    int x1 = min(x0 + 1, chroma.cols - 1);
+    int y1 = min(y0 + 1, chroma.rows - 1);
+    float fx = cx - x0;
+    float fy = cy - y0;
+
+    float top = (1.f - fx)*chroma.ptr<uint8_t>(y0)[2*x0 + channel] + fx*chroma.ptr<uint8_t>(y0)[2*x1 + channel];
+    float bottom = (1.f - fx)*chroma.ptr<uint8_t>(y1)[2*x0 + channel] + fx*chroma.ptr<uint8_t>(y1)[2*x1 + channel];
+    return (1.f - fy)*top + fy*bottom;
+}
+
+// Full res RGB, not clamped : R = Y + 2(1 - Kr)V, B = Y + 2(1 - Kb)U, G = (Y - Kr R - Kb B)/Kg
+static void ConvertFullRes(const cv::Mat& luma, const cv::Mat& chroma, const yuvColorParameters& params, vector<float>& rgb)
+{
+    const float kr = params.bt709 ? 0.2126f : 0.299f;
+    const float kb = params.bt709 ? 0.0722f : 0.114f;
+    const float kg = 1.f - kr - kb;
+
+    rgb.resize((size_t)frameWidth*frameHeight*3);
+    for(int y = 0; y < frameHeight; y++)
+    {
+        for(int x = 0; x < frameWidth; x++)
+        {
+            float yValue = luma.ptr<uint8_t>(y)[x];
+            float uValue = UpsampleChroma(chroma, 0, x, y) - 128.f;
+            float vValue = UpsampleChroma(chroma, 1, x, y) - 128.f;
+
+            float yn = params.fullRange ? yValue/255.f : (yValue - 16.f)/219.f;
+            float un = params.fullRange ? uValue/255.f : uValue/224.f;
+            float vn = params.fullRange ? vValue/255.f : vValue/224.f;
+
+            float* px = &rgb[((size_t)y*frameWidth + x)*3];
+            px[0] = yn + 2.f*(1.f - kr)*vn;
+            px[2] = yn + 2.f*(1.f - kb)*un;
+            px[1] = (yn - kr*px[0] - kb*px[2])/kg;
+        }
+    }
+}
+
+// Resized pixel (x, y) : source (x + 0.5)/scale - 0.5, border replicated
+static void ResizeBilinear(const vector<float>& src, int srcW, int srcH, vector<float>& dst, int dstW, int dstH)
+{
+    dst.resize((size_t)dstW*dstH*3);
+    float scaleX = (float)dstW/srcW;
+    float scaleY = (float)dstH/srcH;
+
+    for(int y = 0; y < dstH; y++)
+    {
+        float sy = max(0.f, (y + 0.5f)/scaleY - 0.5f);
+        int y0 = min((int)sy, srcH - 1);
+        int y1 = min(y0 + 1, srcH - 1);
+        float fy = min(sy - y0, 1.f);
+
+        for(int x = 0; x < dstW; x++)
+        {
+            float sx = max(0.f, (x + 0.5f)/scaleX - 0.5f);
+            int x0 = min((int)sx, srcW - 1);
+            int x1 = min(x0 + 1, srcW - 1);
+            float fx = min(sx - x0, 1.f);
+
+            for(int c = 0; c < 3; c++)
+            {
+                float top = (1.f - fx)*src[((size_t)y0*srcW + x0)*3 + c] + fx*src[((size_t)y0*srcW + x1)*3 + c];
+                float bottom = (1.f - fx)*src[((size_t)y1*srcW + x0)*3 + c] + fx*src[((size_t)y1*srcW + x1)*3 + c];
+                dst[((size_t)y*dstW + x)*3 + c] = (1.f - fy)*top + fy*bottom;
+            }
+        }
+    }
+}
+
+// Same tensor layout as NV12ToTensorHost() (CHW, RGB 0-1)
+static void IndependentPath(const cv::Mat& luma, const cv::Mat& chroma, const yuvColorParameters& params,
+                            int resizedW, int resizedH, const tensorCropGeometry& geometry, vector<float>& tensor)
+{
+    vector<float> rgb, resized;
+    ConvertFullRes(luma, chroma, params, rgb);
+    ResizeBilinear(rgb, frameWidth, frameHeight, resized, resizedW, resizedH);
+
+    int numPx = geometry.roiW*geometry.roiH;
+    tensor.resize(3*numPx);
+
+    for(int y = 0; y < geometry.roiH; y++)
+    {
+        for(int x = 0; x < geometry.roiW; x++)
+        {
+            const float* px = &resized[((size_t)(geometry.roiY + y)*resizedW + geometry.roiX + x)*3];
+            for(int c = 0; c < 3; c++)
+                tensor[c*numPx + y*geometry.roiW + x] = min(max(px[c], 0.f), 1.f);
+        }
+    }
+}
+
+int main()
+{
+    // px2Cam geometries : resizeRatio 0.54 (full res luma) and 0.5 (half res, quad means), centered crop
+    struct { float resizeRatio; int roiW, roiH; } cases[2] = {{0.54f, 1024, 512}, {0.5f, 900, 400}};
+
+    // Camera default (BT.601 limited range) and BT.709 full range
+    yuvColorParameters colorParamsList[2];
+    colorParamsList[1].bt709 = true;
+    colorParamsList[1].fullRange = true;
+
+    printf("scene   color        res    fused vs independent x255 : mean    max     kernel vs host    kernel(us)\n");
+
+    for(bool flat : {true, false})
+    {
+        cv::Mat luma, chroma;
+        MakeNV12(luma, chroma, flat);
+
+        for(const yuvColorParameters& params : colorParamsList)
+        {
+            for(const auto& testCase : cases)
+            {
+                int resizedW = (int)(frameWidth*testCase.resizeRatio);
+                int resizedH = (int)(frameHeight*testCase.resizeRatio);
+
+                tensorCropGeometry geometry;
+                geometry.scaleX = (float)resizedW/frameWidth;
+                geometry.scaleY = (float)resizedH/frameHeight;
+                geometry.roiW = testCase.roiW;
+                geometry.roiH = testCase.roiH;
+                geometry.roiX = (resizedW - geometry.roiW)/2;
+                geometry.roiY = (resizedH - geometry.roiH)/2;
+                geometry.halfRes = (geometry.scaleX <= 0.5f) && (geometry.scaleY <= 0.5f);
+
+                vector<float> fused, independent;
+                cv::Mat bgr;
+                NV12ToTensorHost(luma, chroma, params, geometry, fused, bgr);
+                IndependentPath(luma, chroma, params, resizedW, resizedH, geometry, independent);
+
+                double sumErr = 0.0;
+                float maxErr = 0.f;
+                for(size_t i = 0; i < fused.size(); i++)
+                {
+                    float err = fabsf(fused[i] - independent[i]);
+                    sumErr += err;
+                    maxErr = max(maxErr, err);
+                }
+
+                // Kernel on the same frame
+                char kernelResult[64] = "no device";
+                double kernelUs = 0.0;
+
+                uint8_t* lumaDev = nullptr;
+                uint8_t* chromaDev = nullptr;
+                float* tensorDev = nullptr;
+                size_t lumaPitch = 0;
+                size_t chromaPitch = 0;
+                if((cudaMallocPitch((void**)&lumaDev, &lumaPitch, frameWidth, frameHeight) == cudaSuccess) &&
+                   (cudaMallocPitch((void**)&chromaDev, &chromaPitch, frameWidth, frameHeight/2) == cudaSuccess) &&
+                   (cudaMalloc((void**)&tensorDev, fused.size()*sizeof(float)) == cudaSuccess))
+                {
+                    cudaMemcpy2D(lumaDev, lumaPitch, luma.data, luma.step, frameWidth, frameHeight, cudaMemcpyHostToDevice);
+                    cudaMemcpy2D(chromaDev, chromaPitch, chroma.data, chroma.step, frameWidth, frameHeight/2, cudaMemcpyHostToDevice);
+
+                    NV12ToTensor(lumaDev, lumaPitch, chromaDev, chromaPitch, frameWidth, frameHeight, params, geometry, tensorDev, nullptr);
+                    cudaDeviceSynchronize();
+
+                    const int numIters = 100;
+                    auto begin = chrono::steady_clock::now();
+                    for(int iter = 0; iter < numIters; iter++)
+                        NV12ToTensor(lumaDev, lumaPitch, chromaDev, chromaPitch, frameWidth, frameHeight, params, geometry, tensorDev, nullptr);
+                    cudaDeviceSynchronize();
+                    kernelUs = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count()/numIters;
+
+                    vector<float> kernelTensor(fused.size());
+                    cudaMemcpy(kernelTensor.data(), tensorDev, fused.size()*sizeof(float), cudaMemcpyDeviceToHost);
+
+                    float kernelMaxDiff = 0.f;
+                    for(size_t i = 0; i < fused.size(); i++)
+                        kernelMaxDiff = max(kernelMaxDiff, fabsf(kernelTensor[i] - fused[i]));
+                    snprintf(kernelResult, sizeof(kernelResult), "max %.2e", kernelMaxDiff);
+                }
+                cudaFree(lumaDev);
+                cudaFree(chromaDev);
+                cudaFree(tensorDev);
+
+                printf("%-6s  %-11s  %-4s   %36.2f  %6.2f     %-16s  %9.1f\n", flat ? "flat" : "smooth",
+                       params.bt709 ? "709 full" : "601 limited", geometry.halfRes ? "half" : "full",
+                       255.0*sumErr/fused.size(), 255.f*maxErr, kernelResult, kernelUs);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * PngEncoder benchmark : 1920x1208 RGBA camera-like and synthetic frames.
+ * Round trip through lodepng_decode on several formats / odd sizes, then the encode time per mode and level
+ * against a single-threaded lodepng encode, for 1 / 2 / 4 / 8 threads (speedup against 1 thread of the same mode).
+ */
+
+#include "px2pngencoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static double NowMs()
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Camera-like : smooth gradients, sensor noise and a flat overlay area. Synthetic : 64 pixel checkerboard
+static void MakeImage(vector<uint8_t>& image, uint32_t width, uint32_t height, uint32_t numChannels, bool cameraLike)
+{
+    mt19937 rng(7);
+    normal_distribution<float> noise(0.f, 2.5f);
+
+    image.resize((size_t)width*height*numChannels);
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            for(uint32_t c = 0; c < numChannels; c++)
+            {
+                float value;
+                if(cameraLike)
+                {
+                    value = 110 + 60*sinf(x*0.004f + c)*cosf(y*0.006f) + ((y > height*0.6f) ? 40.f : 0.f) + noise(rng);
+                    if((x > width/3) && (x < width/2) && (y > height/4) && (y < height/2))
+                        value = 30.f*c;
+                }
+                else
+                {
+                    value = ((x/64 + y/64) & 1) ? 200.f : 40.f;
+                }
+
+                if((numChannels == 4) && (c == 3))
+                    value = 255.f;
+
+                image[((size_t)y*width + x)*numChannels + c] = (uint8_t)max(0.f, min(255.f, value));
+            }
+        }
+    }
+}
+
+static bool Decodes(const vector<uint8_t>& png, const vector<uint8_t>& image, uint32_t width, uint32_t height,
+                    LodePNGColorType colorType, unsigned bitDepth)
+{
+    unsigned char* decoded = nullptr;
+    unsigned decodedWidth, decodedHeight;
+    unsigned error = lodepng_decode_memory(&decoded, &decodedWidth, &decodedHeight, png.data(), png.size(), colorType, bitDepth);
+
+    bool equal = !error && (decodedWidth == width) && (decodedHeight == height) && (memcmp(decoded, image.data(), image.size()) == 0);
+    free(decoded);
+    return equal;
+}
+
+int main()
+{
+    const uint32_t width = 1920;
+    const uint32_t height = 1208;
+
+    printf("hardware threads : %u\n", thread::hardware_concurrency());
+
+    // Round trip
+    {
+        struct { uint32_t width, height, numChannels; LodePNGColorType colorType; unsigned bitDepth; } formats[] = {
+            {1920, 1208, 4, LCT_RGBA, 8}, {641, 97, 3, LCT_RGB, 8}, {333, 200, 1, LCT_GREY, 8},
+            {320, 130, 2, LCT_GREY, 16}, {5, 1, 4, LCT_RGBA, 8}, {1, 300, 2, LCT_GREY_ALPHA, 8}};
+
+        int numFails = 0;
+        for(const auto& format : formats)
+        {
+            for(bool cameraLike : {true, false})
+            {
+                vector<uint8_t> image;
+                MakeImage(image, format.width, format.height, format.numChannels, cameraLike);
+
+                for(int mode = PNG_ENCODE_STORE; mode <= PNG_ENCODE_DEFLATE; mode++)
+                {
+                    for(int level : {0, 1, 6})
+                    {
+                        for(uint32_t numThreads : {1u, 3u})
+                        {
+                            pngEncoderParameters params;
+                            params.mode = (pngEncodeMode)mode;
+                            params.compressionLevel = level;
+                            params.numThreads = numThreads;
+                            params.bandRows = 37;
+
+                            PngEncoder encoder;
+                            encoder.Init(params);
+
+                            vector<uint8_t> png;
+                            unsigned error = encoder.Encode(png, image.data(), format.width, format.height,
+                                                            (size_t)format.width*format.numChannels, format.colorType, format.bitDepth);
+                            if(error || !Decodes(png, image, format.width, format.height, format.colorType, format.bitDepth))
+                            {
+                                printf("FAIL %ux%u, %u channels, mode %d, level %d, %u threads\n",
+                                       format.width, format.height, format.numChannels, mode, level, numThreads);
+                                numFails++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        printf("round trip failures : %d\n", numFails);
+    }
+
+    const char* modeNames[3] = {"STORE", "RLE", "DEFLATE"};
+
+    for(bool cameraLike : {true, false})
+    {
+        vector<uint8_t> image;
+        MakeImage(image, width, height, 4, cameraLike);
+        printf("== %s %ux%u RGBA ==\n", cameraLike ? "camera-like" : "synthetic", width, height);
+
+        for(int level : {0, 1, 6})
+        {
+            LodePNGState state;
+            lodepng_state_init(&state);
+            state.encoder.auto_convert = 0;
+            SetPngCompressionLevel(state, level);
+
+            unsigned char* png = nullptr;
+            size_t pngSize = 0;
+            double begin = NowMs();
+            for(int repeat = 0; repeat < 3; repeat++)
+            {
+                free(png);
+                png = nullptr;
+                lodepng_encode(&png, &pngSize, image.data(), width, height, &state);
+            }
+            printf("lodepng            level %d           : %8.1f ms %6.2f MB\n", level, (NowMs() - begin)/3, pngSize/1048576.0);
+            free(png);
+            lodepng_state_cleanup(&state);
+        }
+
+        for(int mode = PNG_ENCODE_STORE; mode <= PNG_ENCODE_DEFLATE; mode++)
+        {
+            for(int level : (mode == PNG_ENCODE_DEFLATE) ? vector<int>{1, 6} : vector<int>{0})
+            {
+                double singleThreadMs = 0.0;
+                for(uint32_t numThreads : {1u, 2u, 4u, 8u})
+                {
+                    pngEncoderParameters params;
+                    params.mode = (pngEncodeMode)mode;
+                    params.compressionLevel = level;
+                    params.numThreads = numThreads;
+
+                    PngEncoder encoder;
+                    encoder.Init(params);
+
+                    vector<uint8_t> png;
+                    encoder.Encode(png, image.data(), width, height, width*4, LCT_RGBA, 8);
+
+                    int numRepeats = (mode == PNG_ENCODE_DEFLATE) ? 3 : 10;
+                    double begin = NowMs();
+                    for(int repeat = 0; repeat < numRepeats; repeat++)
+                        encoder.Encode(png, image.data(), width, height, width*4, LCT_RGBA, 8);
+                    double encodeMs = (NowMs() - begin)/numRepeats;
+
+                    if(numThreads == 1)
+                        singleThreadMs = encodeMs;
+
+                    printf("PngEncoder %-7s level %d %u threads : %8.1f ms %6.2f MB  x%.2f %s\n", modeNames[mode], level, numThreads,
+                           encodeMs, png.size()/1048576.0, singleThreadMs/encodeMs,
+                           Decodes(png, image, width, height, LCT_RGBA, 8) ? "" : "BAD");
+                }
+            }
+        }
+    }
+
+    return 0;
+}
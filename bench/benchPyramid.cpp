@@ -0,0 +1,181 @@
+/**
+ * px2Pyramid host reference check on a random 1920x1208 BGR frame, 6 levels (BuildHost() after InitLevels(), no device) :
+ *    PYRAMID_GAUSSIAN : every level equal to cv::pyrDown() of the previous one
+ *    PYRAMID_BOX      : every level equal to the rounded 2x2 mean of the previous one (last row / column repeated on odd sizes)
+ * Then Level2Level() : level -> level -> back round trip on random points, and the point of a Gaussian blob on every level
+ * against the blob centroid in that level. Returns the number of failed checks.
+ */
+
+#include "px2pyramid.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+static const int numLevels = 6;
+
+static int numFailed = 0;
+
+static void Check(const char* line, bool passed)
+{
+    printf("%-72s %s\n", line, passed ? "ok" : "FAIL");
+    numFailed += passed ? 0 : 1;
+}
+
+static void BoxDownReference(const cv::Mat& src, cv::Mat& dst)
+{
+    dst.create((src.rows + 1)/2, (src.cols + 1)/2, CV_8UC3);
+
+    for(int y = 0; y < dst.rows; y++)
+    {
+        const uint8_t* row0 = src.ptr<uint8_t>(2*y);
+        const uint8_t* row1 = src.ptr<uint8_t>(min(2*y + 1, src.rows - 1));
+        for(int x = 0; x < dst.cols; x++)
+        {
+            int x0 = 2*x;
+            int x1 = min(2*x + 1, src.cols - 1);
+            for(int c = 0; c < 3; c++)
+            {
+                int sum = row0[x0*3 + c] + row0[x1*3 + c] + row1[x0*3 + c] + row1[x1*3 + c];
+                dst.ptr<uint8_t>(y)[x*3 + c] = (uint8_t)((sum + 2)/4);
+            }
+        }
+    }
+}
+
+static long CountDiffs(const cv::Mat& a, const cv::Mat& b)
+{
+    if((a.rows != b.rows) || (a.cols != b.cols))
+        return -1;
+
+    long numDiffs = 0;
+    for(int y = 0; y < a.rows; y++)
+        for(int x = 0; x < a.cols*3; x++)
+            numDiffs += (a.ptr<uint8_t>(y)[x] != b.ptr<uint8_t>(y)[x]) ? 1 : 0;
+    return numDiffs;
+}
+
+// Weighted mean position of channel 0
+static void Centroid(const cv::Mat& img, double& cx, double& cy)
+{
+    double sumX = 0.0, sumY = 0.0, sumW = 0.0;
+    for(int y = 0; y < img.rows; y++)
+    {
+        for(int x = 0; x < img.cols; x++)
+        {
+            double w = img.ptr<uint8_t>(y)[x*3];
+            sumX += w*x;
+            sumY += w*y;
+            sumW += w;
+        }
+    }
+    cx = sumX/sumW;
+    cy = sumY/sumW;
+}
+
+static void CheckFilter(px2Cam* px2CamObj, pyramidFilter filter, const cv::Mat& camImg)
+{
+    const char* filterName = (filter == PYRAMID_GAUSSIAN) ? "gaussian" : "box";
+    char line[128];
+
+    px2Pyramid px2PyramidObj(px2CamObj);
+    pyramidParameters pyrParams;
+    pyrParams.numLevels = numLevels;
+    pyrParams.filter = filter;
+    if(!px2PyramidObj.InitLevels(pyrParams))
+    {
+        snprintf(line, sizeof(line), "%s : InitLevels()", filterName);
+        Check(line, false);
+        return;
+    }
+
+    vector<cv::Mat> levels;
+    auto begin = chrono::steady_clock::now();
+    px2PyramidObj.BuildHost(camImg, levels);
+    double hostMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    printf("%s : %d levels, BuildHost() %.1fms\n", filterName, px2PyramidObj.GetNumLevels(), hostMs);
+
+    for(int level = 1; level < px2PyramidObj.GetNumLevels(); level++)
+    {
+        cv::Mat reference;
+        if(filter == PYRAMID_GAUSSIAN)
+            cv::pyrDown(levels[level - 1], reference);
+        else
+            BoxDownReference(levels[level - 1], reference);
+
+        long numDiffs = CountDiffs(levels[level], reference);
+        snprintf(line, sizeof(line), "%s : level %d %dx%d, %ld bytes differ from %s", filterName, level,
+                 levels[level].cols, levels[level].rows, numDiffs, (filter == PYRAMID_GAUSSIAN) ? "cv::pyrDown" : "the 2x2 mean");
+        Check(line, numDiffs == 0);
+    }
+
+    // Round trip between every pair of levels
+    mt19937 rng(1);
+    float maxRoundTripErr = 0.f;
+    for(int pointIdx = 0; pointIdx < 1000; pointIdx++)
+    {
+        float x = (rng()%(CAM_IMG_WIDTH*16))/16.f;
+        float y = (rng()%(CAM_IMG_HEIGHT*16))/16.f;
+        int srcLevel = rng()%numLevels;
+        int dstLevel = rng()%numLevels;
+
+        float xLevel, yLevel, xBack, yBack;
+        px2PyramidObj.Level2Level(x, y, srcLevel, dstLevel, xLevel, yLevel);
+        px2PyramidObj.Level2Level(xLevel, yLevel, dstLevel, srcLevel, xBack, yBack);
+        maxRoundTripErr = max(maxRoundTripErr, max(fabsf(xBack - x), fabsf(yBack - y)));
+    }
+    snprintf(line, sizeof(line), "%s : Level2Level() round trip, max %.2e px", filterName, maxRoundTripErr);
+    Check(line, maxRoundTripErr < 1e-3f);
+
+    // Blob (sigma 60 px) through the pyramid : its centroid follows Level2Level() of the level 0 center
+    const float blobX = 1000.3f;
+    const float blobY = 500.7f;
+    cv::Mat blobImg(CAM_IMG_HEIGHT, CAM_IMG_WIDTH, CV_8UC3);
+    for(int y = 0; y < CAM_IMG_HEIGHT; y++)
+    {
+        for(int x = 0; x < CAM_IMG_WIDTH; x++)
+        {
+            float r2 = (x - blobX)*(x - blobX) + (y - blobY)*(y - blobY);
+            uint8_t value = (uint8_t)(255.f*expf(-r2/(2.f*60.f*60.f)) + 0.5f);
+            for(int c = 0; c < 3; c++)
+                blobImg.ptr<uint8_t>(y)[x*3 + c] = value;
+        }
+    }
+
+    vector<cv::Mat> blobLevels;
+    px2PyramidObj.BuildHost(blobImg, blobLevels);
+
+    double maxBlobErr = 0.0;
+    for(int level = 1; level < px2PyramidObj.GetNumLevels(); level++)
+    {
+        double cx, cy;
+        float xLevel, yLevel;
+        Centroid(blobLevels[level], cx, cy);
+        px2PyramidObj.Level2Level(blobX, blobY, 0, level, xLevel, yLevel);
+
+        // In level 0 pixels
+        maxBlobErr = max(maxBlobErr, ldexp(max(fabs(cx - xLevel), fabs(cy - yLevel)), level));
+    }
+    snprintf(line, sizeof(line), "%s : blob centroid vs Level2Level(), max %.2f level 0 px", filterName, maxBlobErr);
+    Check(line, maxBlobErr < 0.5);
+}
+
+int main()
+{
+    cv::Mat camImg(CAM_IMG_HEIGHT, CAM_IMG_WIDTH, CV_8UC3);
+    mt19937 rng(1);
+    for(int y = 0; y < CAM_IMG_HEIGHT; y++)
+        for(int x = 0; x < CAM_IMG_WIDTH*3; x++)
+            camImg.ptr<uint8_t>(y)[x] = rng() & 0xFF;
+
+    px2Cam px2CamObj;
+
+    CheckFilter(&px2CamObj, PYRAMID_GAUSSIAN, camImg);
+    CheckFilter(&px2CamObj, PYRAMID_BOX, camImg);
+
+    return numFailed;
+}
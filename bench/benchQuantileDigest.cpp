@@ -0,0 +1,100 @@
+/**
+ * QuantileDigest / StatsCounter micro-benchmark : lognormal latencies (ms scale), 10M samples.
+ * Insert cost, p50/p90/p99/p99.9 against the exact quantiles of the sorted samples (relative and rank error),
+ * the same after merging 4 per-thread counters, and concurrent const readers of one compressed counter.
+ */
+
+#include <framework/StatsCounter.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace dw::common;
+
+static double ElapsedNs(chrono::steady_clock::time_point begin)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+}
+
+static void PrintErrors(const char* name, const StatsCounter& counter, const vector<float>& sorted)
+{
+    const float quantiles[4] = {0.5f, 0.9f, 0.99f, 0.999f};
+    size_t numSamples = sorted.size();
+
+    for(float q : quantiles)
+    {
+        float exact = sorted[(size_t)ceil(q*numSamples) - 1];
+        float estimate = counter.getQuantile(q);
+        double rank = (lower_bound(sorted.begin(), sorted.end(), estimate) - sorted.begin())/(double)numSamples;
+
+        printf("%-8s q=%.3f  exact %8.4f  estimate %8.4f  relative error %9.2e  rank error %9.2e\n",
+               name, q, exact, estimate, (estimate - exact)/exact, rank - q);
+    }
+}
+
+int main()
+{
+    const size_t numSamples = 10000000;
+
+    mt19937 rng(1);
+    lognormal_distribution<float> dist(2.5f, 0.4f);
+    vector<float> samples(numSamples);
+    for(float& sample : samples)
+        sample = dist(rng);
+
+    vector<float> sorted = samples;
+    sort(sorted.begin(), sorted.end());
+
+    StatsCounter counter;
+    auto begin = chrono::steady_clock::now();
+    for(float sample : samples)
+        counter.addSample(sample);
+    printf("insert %.1f ns/sample\n", ElapsedNs(begin)/numSamples);
+
+    counter.compress();
+    PrintErrors("single", counter, sorted);
+
+    // Per-thread counters merged for reporting
+    StatsCounter parts[4];
+    for(size_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+        parts[sampleIdx%4].addSample(samples[sampleIdx]);
+
+    StatsCounter merged;
+    begin = chrono::steady_clock::now();
+    for(const StatsCounter& part : parts)
+        merged.merge(part);
+    printf("merge of 4 counters %.1f us\n", ElapsedNs(begin)/1000.0);
+    PrintErrors("merged", merged, sorted);
+
+    // Const readers only : every thread must read the same values
+    const int numReaders = 4;
+    const int numReads = 100000;
+    vector<float> readerResults(numReaders);
+    vector<thread> readers;
+    begin = chrono::steady_clock::now();
+    for(int readerIdx = 0; readerIdx < numReaders; readerIdx++)
+    {
+        readers.emplace_back([&, readerIdx]
+        {
+            float sum = 0.f;
+            for(int readIdx = 0; readIdx < numReads; readIdx++)
+                sum += counter.getQuantile(0.99f);
+            readerResults[readerIdx] = sum/numReads;
+        });
+    }
+    for(thread& reader : readers)
+        reader.join();
+
+    bool readersEqual = all_of(readerResults.begin(), readerResults.end(),
+                               [&](float result){ return result == readerResults[0]; });
+    printf("%d concurrent readers : %.1f ns/getQuantile, results equal %s\n", numReaders,
+           ElapsedNs(begin)/((double)numReaders*numReads), readersEqual ? "yes" : "NO");
+
+    return 0;
+}
@@ -0,0 +1,287 @@
+/**
+ * Remap stages on a synthetic calibration : radial distortion (k1 = -0.08, f = 1000 px) and a camera 1.5 m above a flat ground,
+ * written as invRectMap.xml / ipmMat.xml and loaded as on the target. The camera image is a pattern defined on the rectified
+ * plane, so every output pixel has an analytic expected value.
+ *    px2Rectifier : RectifyHost() (forward map from BuildRect2DistMap(), resampled to the output size) against the pattern
+ *                   at the rectified point of the output pixel
+ *    px2BEV : GenerateHost() (invRectMap + ipmMat folded in one table) against the pattern at the ground point of the BEV pixel
+ * Then px2Remap::Apply() on the GPU against RemapBGRHost() over the same table, and its time.
+ */
+
+#include "px2bev.h"
+#include "px2rectify.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+static const float focal = 1000.f;
+static const float k1 = -0.08f;
+static const float centerX = CAM_IMG_WIDTH/2;
+static const float centerY = CAM_IMG_HEIGHT/2;
+static const float cameraHeight = 1.5f;
+
+static const char* invRectMapFilePath = "benchRemap_invRectMap.xml";
+static const char* ipmMatrixFilePath = "benchRemap_ipmMat.xml";
+
+// Rectified -> distorted : rd = ru*(1 + k1*ru^2), normalized coordinates
+static void Distort(float xu, float yu, float& xd, float& yd)
+{
+    float x = (xu - centerX)/focal;
+    float y = (yu - centerY)/focal;
+    float scale = 1.f + k1*(x*x + y*y);
+    xd = x*scale*focal + centerX;
+    yd = y*scale*focal + centerY;
+}
+
+// Distorted -> rectified, fixed point on the same model
+static void Undistort(float xd, float yd, float& xu, float& yu)
+{
+    float x = (xd - centerX)/focal;
+    float y = (yd - centerY)/focal;
+    float xr = x;
+    float yr = y;
+    for(int iter = 0; iter < 100; iter++)
+    {
+        float scale = 1.f + k1*(xr*xr + yr*yr);
+        xr = x/scale;
+        yr = y/scale;
+    }
+    xu = xr*focal + centerX;
+    yu = yr*focal + centerY;
+}
+
+// Defined on the rectified plane
+static void Pattern(float x, float y, uint8_t* px)
+{
+    px[0] = (uint8_t)(128.f + 100.f*sinf(x*0.02f));
+    px[1] = (uint8_t)(128.f + 100.f*cosf(y*0.017f));
+    px[2] = (uint8_t)(128.f + 60.f*sinf((x + y)*0.01f));
+}
+
+// Ground (lateral x, forward y, m) -> rectified pixel, flat ground and no pitch
+static void Ground2Rect(float xWorld, float yWorld, float& xRect, float& yRect)
+{
+    xRect = centerX + focal*xWorld/yWorld;
+    yRect = centerY + focal*cameraHeight/yWorld;
+}
+
+static bool WriteCalibration(cv::Mat& camImg)
+{
+    cv::Mat invMap1(CAM_IMG_HEIGHT, CAM_IMG_WIDTH, CV_32S);
+    cv::Mat invMap2(CAM_IMG_HEIGHT, CAM_IMG_WIDTH, CV_32S);
+    camImg.create(CAM_IMG_HEIGHT, CAM_IMG_WIDTH, CV_8UC3);
+
+    for(int y = 0; y < CAM_IMG_HEIGHT; y++)
+    {
+        for(int x = 0; x < CAM_IMG_WIDTH; x++)
+        {
+            float xu, yu;
+            Undistort(x, y, xu, yu);
+            invMap1.at<int>(y,x) = (int)lroundf(xu);
+            invMap2.at<int>(y,x) = (int)lroundf(yu);
+            Pattern(xu, yu, camImg.ptr<uint8_t>(y) + x*3);
+        }
+    }
+
+    // ipmMat : rectified -> top-view, the inverse of Ground2Rect
+    cv::Mat ground2Rect = (cv::Mat_<double>(3,3) << focal, centerX, 0.0,
+                                                    0.0, centerY, focal*cameraHeight,
+                                                    0.0, 1.0, 0.0);
+    cv::Mat ipmMat = ground2Rect.inv();
+
+    cv::FileStorage fs(invRectMapFilePath, cv::FileStorage::WRITE);
+    cv::FileStorage fs2(ipmMatrixFilePath, cv::FileStorage::WRITE);
+    if(!fs.isOpened() || !fs2.isOpened())
+    {
+        printf("Cannot write the calibration files\n");
+        return false;
+    }
+    fs << "invMap1" << invMap1 << "invMap2" << invMap2;
+    fs2 << "ipmMat" << ipmMat;
+
+    return true;
+}
+
+// Pixels whose source is inside the camera frame (1 pixel margin) : mean / max 8bit error against expected()
+template<typename ExpectedFn>
+static void CompareWithPattern(const cv::Mat& outImg, const cv::Mat& remapTable, ExpectedFn expected,
+                               double& meanErr, double& maxErr, long& numPx)
+{
+    double sumErr = 0.0;
+    maxErr = 0.0;
+    numPx = 0;
+
+    for(int v = 0; v < outImg.rows; v++)
+    {
+        for(int u = 0; u < outImg.cols; u++)
+        {
+            const cv::Vec2f& srcCoord = remapTable.at<cv::Vec2f>(v,u);
+            if((srcCoord[0] < 1.f) || (srcCoord[1] < 1.f) || (srcCoord[0] > CAM_IMG_WIDTH - 2) || (srcCoord[1] > CAM_IMG_HEIGHT - 2))
+                continue;
+
+            uint8_t expectedPx[3];
+            expected(u, v, expectedPx);
+
+            const uint8_t* px = outImg.ptr<uint8_t>(v) + u*3;
+            for(int c = 0; c < 3; c++)
+            {
+                double err = fabs((double)px[c] - expectedPx[c]);
+                sumErr += err;
+                maxErr = max(maxErr, err);
+            }
+            numPx++;
+        }
+    }
+
+    meanErr = numPx ? sumErr/(3.0*numPx) : 0.0;
+}
+
+// px2Remap::Apply() against RemapBGRHost(), result written into kernelResult
+static void CompareKernel(const cv::Mat& camImg, const cv::Mat& remapTable, const cv::Mat& hostImg, char* kernelResult, size_t resultSize)
+{
+    int numDevices = 0;
+    if((cudaGetDeviceCount(&numDevices) != cudaSuccess) || (numDevices == 0))
+    {
+        snprintf(kernelResult, resultSize, "no device");
+        return;
+    }
+
+    px2Remap remap;
+    if(!remap.Init(remapTable))
+    {
+        snprintf(kernelResult, resultSize, "init fail");
+        return;
+    }
+
+    cv::cuda::GpuMat camGpuMat, outGpuMat;
+    camGpuMat.upload(camImg);
+    remap.Apply(camGpuMat, outGpuMat);
+    cudaDeviceSynchronize();
+
+    const int numIters = 100;
+    auto begin = chrono::steady_clock::now();
+    for(int iter = 0; iter < numIters; iter++)
+        remap.Apply(camGpuMat, outGpuMat);
+    cudaDeviceSynchronize();
+    double kernelUs = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count()/numIters;
+
+    cv::Mat kernelImg;
+    outGpuMat.download(kernelImg);
+
+    long numDiffs = 0;
+    int maxDiff = 0;
+    for(int v = 0; v < hostImg.rows; v++)
+    {
+        for(int x = 0; x < hostImg.cols*3; x++)
+        {
+            int diff = abs((int)kernelImg.ptr<uint8_t>(v)[x] - (int)hostImg.ptr<uint8_t>(v)[x]);
+            numDiffs += (diff != 0) ? 1 : 0;
+            maxDiff = max(maxDiff, diff);
+        }
+    }
+
+    snprintf(kernelResult, resultSize, "%ld diffs, max %d, %.1f us", numDiffs, maxDiff, kernelUs);
+}
+
+int main()
+{
+    cv::Mat camImg;
+    if(!WriteCalibration(camImg))
+        return -1;
+
+    px2Cam px2CamObj;
+    char kernelResult[64];
+    char stageName[32];
+
+    printf("stage                 host vs analytic (8bit) : mean   max    pixels  host(ms)  kernel vs host\n");
+
+    // Rectifier : camera size, half size and a small display size
+    rectifyParameters rectParamsList[3];
+    rectParamsList[1].width = CAM_IMG_WIDTH/2;
+    rectParamsList[1].height = CAM_IMG_HEIGHT/2;
+    rectParamsList[2].width = 640;
+    rectParamsList[2].height = 400;
+
+    for(const rectifyParameters& rectParams : rectParamsList)
+    {
+        px2Rectifier px2RectObj(&px2CamObj);
+        if(!px2RectObj.LoadCalibration(rectParams, invRectMapFilePath))
+            return -1;
+
+        cv::Mat rectImg;
+        auto begin = chrono::steady_clock::now();
+        px2RectObj.RectifyHost(camImg, rectImg);
+        double hostMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+        double meanErr, maxErr;
+        long numPx;
+        CompareWithPattern(rectImg, px2RectObj.GetRemapTable(), [&](int u, int v, uint8_t* px)
+        {
+            float xRect, yRect;
+            px2RectObj.Pixel2Rect(u, v, xRect, yRect);
+            Pattern(xRect, yRect, px);
+        }, meanErr, maxErr, numPx);
+
+        CompareKernel(camImg, px2RectObj.GetRemapTable(), rectImg, kernelResult, sizeof(kernelResult));
+
+        snprintf(stageName, sizeof(stageName), "Rectify %dx%d", px2RectObj.GetWidth(), px2RectObj.GetHeight());
+        printf("%-20s  %31.2f  %4.0f  %8ld  %8.1f  %s\n", stageName, meanErr, maxErr, numPx, hostMs, kernelResult);
+    }
+
+    // BEV : default grid, and a coarser one
+    bevParameters bevParamsList[2];
+    bevParamsList[1].resolution = 0.2f;
+
+    for(const bevParameters& bevParams : bevParamsList)
+    {
+        px2BEV px2BEVObj(&px2CamObj);
+        if(!px2BEVObj.LoadCalibration(bevParams, invRectMapFilePath, ipmMatrixFilePath))
+            return -1;
+
+        cv::Mat bevImg;
+        auto begin = chrono::steady_clock::now();
+        px2BEVObj.GenerateHost(camImg, bevImg);
+        double hostMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+        double meanErr, maxErr;
+        long numPx;
+        CompareWithPattern(bevImg, px2BEVObj.GetRemapTable(), [&](int u, int v, uint8_t* px)
+        {
+            float xWorld, yWorld, xRect, yRect;
+            px2BEVObj.Pixel2Metric(u, v, xWorld, yWorld);
+            Ground2Rect(xWorld, yWorld, xRect, yRect);
+            Pattern(xRect, yRect, px);
+        }, meanErr, maxErr, numPx);
+
+        // Ground points seen by the camera (rectified and distorted inside the frame) the folded table misses
+        long numMissed = 0;
+        for(int v = 0; v < px2BEVObj.GetHeight(); v++)
+        {
+            for(int u = 0; u < px2BEVObj.GetWidth(); u++)
+            {
+                float xWorld, yWorld, xRect, yRect, xDist, yDist;
+                px2BEVObj.Pixel2Metric(u, v, xWorld, yWorld);
+                if(yWorld <= 0.f)
+                    continue;
+                Ground2Rect(xWorld, yWorld, xRect, yRect);
+                Distort(xRect, yRect, xDist, yDist);
+
+                bool visible = (xRect >= 2.f) && (yRect >= 2.f) && (xRect < CAM_IMG_WIDTH - 3) && (yRect < CAM_IMG_HEIGHT - 3) &&
+                               (xDist >= 2.f) && (yDist >= 2.f) && (xDist < CAM_IMG_WIDTH - 3) && (yDist < CAM_IMG_HEIGHT - 3);
+                if(visible && (px2BEVObj.GetRemapTable().at<cv::Vec2f>(v,u)[0] < 0.f))
+                    numMissed++;
+            }
+        }
+
+        CompareKernel(camImg, px2BEVObj.GetRemapTable(), bevImg, kernelResult, sizeof(kernelResult));
+
+        snprintf(stageName, sizeof(stageName), "BEV %dx%d (%.1f m)", px2BEVObj.GetWidth(), px2BEVObj.GetHeight(), bevParams.resolution);
+        printf("%-20s  %31.2f  %4.0f  %8ld  %8.1f  %s, %ld visible pixels missed\n",
+               stageName, meanErr, maxErr, numPx, hostMs, kernelResult, numMissed);
+    }
+
+    return 0;
+}
@@ -1,3 +1,6 @@
+#include <atomic>
+#include <csignal>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -5,6 +8,31 @@ using namespace std;
 #include "px2camlib.h"
 #include "px2od.h"
 #include "px2ld.h"
+#include "px2bev.h"
+#include "px2rectify.h"
+#include "px2pyramid.h"
+#include "px2pipeline.h"
+#include "frameBudget.h"
+#include "px2latency.h"
+#include "px2trace.h"
+#include "px2init.h"
+#include "px2framedump.h"
+
+// kill -USR1 <pid> : trace dump of the last frames
+static atomic<bool> gTraceDumpRequested(false);
+
+static void OnTraceDumpSignal(int)
+{
+    gTraceDumpRequested = true;
+}
+
+// Ctrl+C : the pipeline drains the frames in flight, then the summaries and the dumps are written
+static atomic<bool> gStopRequested(false);
+
+static void OnStopSignal(int)
+{
+    gStopRequested = true;
+}
 
 int main()
 {
@@ -28,150 +56,501 @@ int main()
     displayParameters dispParams;
     dispParams.onDisplay = true;
     dispParams.windowTitle = "Camera Viewer";
-    dispParams.windowWidth = CAM_IMG_WIDTH/2;
+    dispParams.windowWidth = CAM_IMG_WIDTH;     // 2 tiles of CAM_IMG_WIDTH/2 : camera, top view
     dispParams.windowHeight = CAM_IMG_HEIGHT/2;
+    dispParams.topViewTile = true;
 
 
     // Main에서 바뀐부분 시작(px2camlib.h, px2camlib.cu도 교체 필요)--------------------------
     camInputParameters camInputParams;
     camInputParams.camInputMode = GMSL_CAM_RAW;
 
-    // Camera library initialize
-    if(!px2CamObj.Init(camInputParams,
-                       imgCropParams,
-                       dispParams,
-                       MASTER_TEGRA))
+    // Main에서 바뀐부분  끝 ----------------------------------------------------------------
+
+    // Network input straight from the camera surface in one kernel : RCCB demosaic (RAW, fixed tonemap instead of SoftISP's)
+    // or NV12 conversion (YUV / H264), validate the networks on it first.
+    // The RGBA frame keeps being produced for the display, the BEV and the frame pipeline.
+    const bool fusedInferenceInput = false;
+    px2CamObj.RequestRGBAFrame();       // Frame slots : copies of the RGBA frame (UpdateCamImg)
+    if(fusedInferenceInput)
+    {
+        rawInferenceParameters rawInferParams;
+        rawInferParams.enable = true;
+        px2CamObj.SetRawInferenceParameters(rawInferParams);
+
+        yuvInferenceParameters yuvInferParams;
+        yuvInferParams.enable = true;
+        px2CamObj.SetYuvInferenceParameters(yuvInferParams);
+    }
+
+
+    // Per-stage latency (p50/p95/p99/max every 300 displayed frames)
+    LatencyMonitor latencyMonitor;
+    latencyMonitorParameters latencyParams;
+    latencyParams.csvFilePath = "latency.csv";
+    latencyParams.jsonFilePath = "latency.json";
+    if(!latencyMonitor.Init(latencyParams))
         return -1;
 
-    // Main에서 바뀐부분  끝 ----------------------------------------------------------------
+    // Timeline of the last frames (Chrome trace-event JSON), dumped on SIGUSR1 or a glass-to-result spike
+    TraceRecorder traceRecorder;
+    traceRecorderParameters traceParams;
+    traceParams.spikeThresholdMs = 150.f;
+    if(!traceRecorder.Init(traceParams))
+        return -1;
+    latencyMonitor.SetTraceRecorder(&traceRecorder);
+    signal(SIGUSR1, OnTraceDumpSignal);
+    signal(SIGINT, OnStopSignal);
+
+    // Dataset collection : camera frames with a pedestrian (at most 1 per 30 frames), encoded off the loop
+    const bool dumpPedestrianFrames = false;
+    // Screenshots of the displayed frame with its overlay and top-view inset (1 per 300 frames), composed off the loop
+    const bool dumpAnnotatedFrames = false;
+    FrameDumper frameDumper;
+    frameDumpParameters frameDumpParams;
+    frameDumpParams.directory = "dump";
+    frameDumpParams.compressionLevel = 1;
+    int32_t pedestrianTrigger = -1;
+    int32_t annotatedTrigger = -1;
+    if(dumpPedestrianFrames || dumpAnnotatedFrames)
+    {
+        if(!frameDumper.Init(frameDumpParams))
+            return -1;
+        if(dumpPedestrianFrames)
+            pedestrianTrigger = frameDumper.AddTrigger("pedestrian", 30);
+        if(dumpAnnotatedFrames)
+            annotatedTrigger = frameDumper.AddTrigger("screen", 300);
+    }
 
+    const string invRectMapFilePath = "/home/nvidia/swjung/git/DrivePX2_Recognition/data/invRectMap.xml";
+    const string ipmMatrixFilePath = "/home/nvidia/swjung/git/DrivePX2_Recognition/data/ipmMat.xml";
 
-    // Object Detector(DriveNet) initialize
+    // Object Detector(DriveNet), Lane Detector and bird's-eye-view image (default grid : 50m x 50m, 0.1m per pixel)
     px2OD px2ODObj(&px2CamObj);
-    px2ODObj.Init();
-
-    // Lane Detector initialize
     px2LD px2LDObj(&px2CamObj);
-    px2LDObj.Init(0.3f,
-                  "/home/nvidia/swjung/git/DrivePX2_Recognition/data/invRectMap.xml",
-                  "/home/nvidia/swjung/git/DrivePX2_Recognition/data/ipmMat.xml");
 
-    while(1)
+    // Lane detector of the lane stage. JUNG / HARMONY : custom lane segmentation engine on the px2Cam tensor of the frame,
+    // HARMONY lanes are top-view only (not drawn on the camera tile)
+    const laneDetectorType laneDetector = LANE_DETECTOR_DW;
+    const bool laneSegNet = (laneDetector != LANE_DETECTOR_DW);
+    const string laneSegEngineFilePath = "/home/nvidia/swjung/git/DrivePX2_Recognition/data/laneSegNet.engine";
+    laneDecoderParameters laneDecoderParams;
+    px2BEV px2BEVObj(&px2CamObj);
+    bevParameters bevParams;
+    const float topViewSampleStepM = 0.5f;     // Lane curve sampling in the top-view tile (scale : bevParams.resolution m per pixel)
+
+    // Rectified (undistorted) frame next to the camera frame in every slot, for the custom networks and geometry
+    const bool rectifyFrames = false;
+    px2Rectifier px2RectObj(&px2CamObj);
+    rectifyParameters rectParams;
+
+    // Frames in flight in the pipeline (see Frame pipeline below)
+    const uint32_t numFrameSlots = 5;   // One per stage + one being refilled by the camera
+
+    // Image pyramid of the camera frame, built in the capture stage, one level set per frame slot
+    const bool buildPyramid = false;
+    px2Pyramid px2PyramidObj(&px2CamObj);
+    pyramidParameters pyrParams;
+
+    // One inference per network before the first camera frame (engine setup, lazy allocations)
+    const bool warmUp = true;
+
+    /****************************************************
+     * Startup
+     * Driveworks / GL steps on the main thread, calibration files and object pools on workers meanwhile.
+     */
+    InitGraph initGraph;
+
+    initGraph.AddStep("camContext", {}, [&]
+    {
+        return px2CamObj.InitContext(camInputParams, imgCropParams, dispParams, MASTER_TEGRA);
+    }, INIT_MAIN_THREAD);
+
+    initGraph.AddStep("camDevices", {"camContext"}, [&]{ return px2CamObj.InitDevices(); }, INIT_MAIN_THREAD);
+
+    initGraph.AddStep("odObjectPool", {}, [&]{ px2ODObj.InitObjectPool(); return true; });
+    initGraph.AddStep("ldCalibration", {}, [&]{ return px2LDObj.LoadCalibration(invRectMapFilePath, ipmMatrixFilePath); });
+    initGraph.AddStep("bevCalibration", {}, [&]{ return px2BEVObj.LoadCalibration(bevParams, invRectMapFilePath, ipmMatrixFilePath); });
+    initGraph.AddStep("rectCalibration", {}, [&]
+    {
+        return !rectifyFrames || px2RectObj.LoadCalibration(rectParams, invRectMapFilePath);
+    });
+
+    initGraph.AddStep("driveNet", {"camContext"}, [&]{ px2ODObj.InitNetwork(); return true; }, INIT_MAIN_THREAD);
+    initGraph.AddStep("odBind", {"driveNet", "odObjectPool"}, [&]{ px2ODObj.BindOutputs(); return true; }, INIT_MAIN_THREAD);
+    initGraph.AddStep("laneNet", {"camContext", "ldCalibration"}, [&]{ px2LDObj.Init(0.3f); return true; }, INIT_MAIN_THREAD);
+    initGraph.AddStep("laneSegNet", {"camContext"}, [&]
+    {
+        return !laneSegNet || px2LDObj.InitJUNG(laneSegEngineFilePath, laneDecoderParams);
+    }, INIT_MAIN_THREAD);
+    initGraph.AddStep("bevRemap", {"camContext", "bevCalibration"}, [&]{ return px2BEVObj.InitDevice(); });
+    initGraph.AddStep("rectRemap", {"camContext", "rectCalibration"}, [&]{ return !rectifyFrames || px2RectObj.InitDevice(); });
+    initGraph.AddStep("pyramid", {"camContext"}, [&]{ return !buildPyramid || px2PyramidObj.Init(pyrParams, numFrameSlots); }, INIT_MAIN_THREAD);
+
+    initGraph.AddStep("warmUp", {"camDevices", "odBind", "laneNet"}, [&]
     {
-        auto begin = std::chrono::high_resolution_clock::now();
+        if(!warmUp)
+            return true;
+
+        // Black frame, results are dropped
+        dwImageHandle_t warmUpImgHandle = DW_NULL_HANDLE;
+        dwImageCUDA* warmUpImg = nullptr;
+        CHECK_DW_ERROR(dwImage_create(&warmUpImgHandle, px2CamObj.GetRGBAImgProperties(), px2CamObj.GetDwContext()));
+        CHECK_DW_ERROR(dwImage_getCUDA(&warmUpImg, warmUpImgHandle));
+        CHECK_CUDA_ERROR(cudaMemset2D(warmUpImg->dptr[0], warmUpImg->pitch[0], 0,
+                                      warmUpImg->prop.width*4, warmUpImg->prop.height));
+
+        vector<vector<dwRectf> > rectPerClass;
+        vector<const float32_t*> colorPerClass;
+        vector<vector<const char*> > labelPerClass;
+        vector<vector<float32_t> > confidencePerClass;
+        vector<vector<int> > idPerClass;
+        px2ODObj.DetectObjects(warmUpImg, rectPerClass, colorPerClass, labelPerClass, confidencePerClass, idPerClass);
+
+        LaneFrame laneFrame;
+        px2LDObj.DetectLanesByDW(warmUpImg, laneFrame);
+
+        CHECK_CUDA_ERROR(cudaDeviceSynchronize());
+        dwImage_destroy(&warmUpImgHandle);
+
+        return true;
+    }, INIT_MAIN_THREAD);
+
+    bool initSuccess = initGraph.Run(2);
+    initGraph.PrintReport();
+    if(!initSuccess)
+        return -1;
 
-        px2CamObj.UpdateCamImg();
+    // After the warm-up, so it is not in the latency statistics
+    px2CamObj.SetLatencyMonitor(&latencyMonitor);
 
-        // Get dwImageCUDA (all area of the original camera image)
-        dwImageCUDA* dnnInputImg = px2CamObj.GetDwImageCuda();
+    // Device memory held by px2Cam and px2LD
+    px2CamObj.GetDeviceArena()->PrintReport();
 
-        /****************************************************
-         * Object Detector
-         */
+    /****************************************************
+     * Frame pipeline
+     * capture(+BEV) -> object detector -> lane detector(+top-view fitting) -> display(main thread, GL)
+     * Every stage works on a different frame, each frame lives in its own slot until it is displayed.
+     */
 
+    typedef struct {
         vector<vector<dwRectf> > outputODRectPerClass;
         vector<const float32_t*> outputODRectColorPerClass;
         vector<vector<const char*> > outputODLabelPerClass;
         vector<vector<float32_t> > outputODConfidencePerClass;
         vector<vector<int> > outputODIDPerClass;
+    }odResults;
+
+    // Per-frame buffers and results
+    typedef struct {
+        dwImageHandle_t camImgHandle = DW_NULL_HANDLE;
+        dwImageCUDA* camImgCuda = nullptr;
+        cv::Mat topViewImg;
+        cv::cuda::GpuMat rectImg;       // Rectified camera frame (BGR), rectifyFrames only
+        float* trtImg = nullptr;        // px2Cam network tensor of the frame, laneSegNet only
+
+        frameBudgetDecision budget;
 
-        px2ODObj.DetectObjects(dnnInputImg,
-                               outputODRectPerClass,
-                               outputODRectColorPerClass,
-                               outputODLabelPerClass,
-                               outputODConfidencePerClass,
-                               outputODIDPerClass);
+        // Entries of odPool / lanePool (shared with the next frames on skips), released by the display stage
+        uint32_t odIdx = 0;
+        uint32_t laneIdx = 0;
 
-        /****************************************************/
+        // Fitted lanes sampled in top-view pixels, lane i : [topViewLaneOffsets[i], topViewLaneOffsets[i + 1])
+        vector<dwVector2f> topViewLanePts;
+        vector<uint32_t> topViewLaneOffsets;
+    }frameSlot;
+
+    vector<frameSlot> frameSlots(numFrameSlots);
+    const size_t trtImgBytes = 3*px2CamObj.GetTrtImgWidth()*px2CamObj.GetTrtImgHeight()*sizeof(float);
+
+    for(uint32_t slotIdx = 0; slotIdx < numFrameSlots; slotIdx++)
+    {
+        CHECK_DW_ERROR(dwImage_create(&frameSlots[slotIdx].camImgHandle, px2CamObj.GetRGBAImgProperties(), px2CamObj.GetDwContext()));
+        CHECK_DW_ERROR(dwImage_getCUDA(&frameSlots[slotIdx].camImgCuda, frameSlots[slotIdx].camImgHandle));
 
+        if(laneSegNet)
+            CHECK_CUDA_ERROR(cudaMalloc(&frameSlots[slotIdx].trtImg, trtImgBytes));
+    }
 
-        /****************************************************
-         * Lane Detector
-         */
+    SharedResultPool<odResults> odPool(numFrameSlots + 1);
+    SharedResultPool<LaneFrame> lanePool(numFrameSlots + 1);
 
-        vector<vector<dwVector2f> > outputLDPtsPerLane;
-        vector<dwVector4f> outputLDColorPerLane;
-        vector<string> outputLDPositionNamePerLane;
-        vector<string> outputLDTypeNamePerLane;
+    px2Pipeline pipeline(numFrameSlots);
 
-        px2LDObj.DetectLanesByDW(dnnInputImg,
-                                 outputLDPtsPerLane,
-                                 outputLDColorPerLane,
-                                 outputLDPositionNamePerLane,
-                                 outputLDTypeNamePerLane);
+    // Load shedding : the camera period is the frame budget (see frameBudgetParameters for the degrade policy)
+    FrameBudgetController budgetController;
+    frameBudgetParameters budgetParams;
+    budgetController.SetParameters(budgetParams);
 
-        vector< vector<float> > outputLDEqsPerLane;
+    // Capture waits for the camera, it sets the pace instead of consuming the budget
+    vector<int> budgetStageIds = {-1,
+                                  budgetController.AddStage("objectDetector"),
+                                  budgetController.AddStage("laneDetector"),
+                                  budgetController.AddStage("display")};
 
-        cv::Mat topViewImg = cv::Mat::zeros(500,500, CV_8UC3);
+    const vector<string> stageNames = {"capture", "objectDetector", "laneDetector", "display"};
+    vector<latencySectionId> traceStageIds;
+    for(const string& stageName : stageNames)
+        traceStageIds.push_back(LatencyMonitor::RegisterSection(stageName.c_str()));
 
-        for(uint32_t laneIdx = 0U;  laneIdx < outputLDPtsPerLane.size(); laneIdx++)
+    pipeline.SetStageObserver([&](uint32_t stageIdx, const frameToken& token, double costMs)
+    {
+        // Every stage has its own thread, named after the stage on its first frame
+        static thread_local bool traceThreadNamed = false;
+        if(!traceThreadNamed)
         {
-            vector<dwVector2f> outputLDPtsRectified = px2LDObj.DistortList2RectifiedList(outputLDPtsPerLane[laneIdx]);
-            vector<dwVector2f> outputLDPtsTopview = px2LDObj.RectifiedList2TopviewList(outputLDPtsRectified);
+            traceRecorder.SetThreadName(stageNames[stageIdx]);
+            traceThreadNamed = true;
+        }
+        traceRecorder.Record(TRACE_STAGE, traceStageIds[stageIdx], token.seq,
+                             TraceRecorder::NowUs() - costMs*1000.0, costMs*1000.0);
 
-            float minY = INT_MAX;
-            float maxY = INT_MIN;
+        const frameBudgetDecision& budget = frameSlots[token.slotIdx].budget;
+        bool skipped = ((stageIdx == 1) && !budget.runOD) ||
+                       ((stageIdx == 2) && !budget.runLD) ||
+                       ((stageIdx == 3) && !budget.render);
 
-            for(uint ptIdx = 0; ptIdx < outputLDPtsTopview.size(); ptIdx++)
-            {
-                dwVector2f pt = outputLDPtsTopview[ptIdx];
-                if(pt.y > maxY)
-                    maxY = pt.y;
+        budgetController.ReportStage(budgetStageIds[stageIdx], costMs, skipped);
 
-                if(pt.y < minY)
-                    minY = pt.y;
-            }
+        // Observer runs on the stage thread : resolves the GPU timings of this stage
+        latencyMonitor.Collect(token.seq);
+    });
 
+    pipeline.AddStage("capture", [&](frameToken& token)
+    {
+        frameSlot& slot = frameSlots[token.slotIdx];
 
-            if (outputLDPtsTopview.size() < 4)
-                continue;
+        if(gStopRequested)
+        {
+            pipeline.RequestStop();
+            return false;
+        }
+
+        // px2Cam buffers are overwritten by the next frame : the later stages only read the slot
+        // (camera frame for the display and the detectors, BEV, rectified image)
+        if(!px2CamObj.UpdateCamImg(slot.camImgCuda))
+        {
+            // End of stream
+            pipeline.RequestStop();
+            return false;
+        }
+
+        token.timestamp_us = slot.camImgCuda->timestamp_us;
+
+        if(laneSegNet)
+            CHECK_CUDA_ERROR(cudaMemcpy(slot.trtImg, px2CamObj.GetTrtImgData().trtImg, trtImgBytes, cudaMemcpyDeviceToDevice));
+
+        px2BEVObj.Generate();
+        px2BEVObj.GetBEVMatImgData().matImg.copyTo(slot.topViewImg);
 
-            vector<float> outputLDEqs = px2LDObj.TopviewList2Eq(outputLDPtsTopview);
-            outputLDEqsPerLane.push_back(outputLDEqs);
+        if(rectifyFrames)
+            px2RectObj.Rectify(slot.rectImg);
 
+        if(buildPyramid)
+            px2PyramidObj.Build(token.slotIdx);
 
-            for(uint y = 0; y < 500 ; y++)
+        slot.budget = budgetController.Decide(token.seq);
+
+        return true;
+    });
+
+    /****************************************************
+     * Object Detector
+     */
+    pipeline.AddStage("objectDetector", [&](frameToken& token)
+    {
+        frameSlot& slot = frameSlots[token.slotIdx];
+
+        // Skipped frame : show the last detections
+        if(!slot.budget.runOD)
+        {
+            slot.odIdx = odPool.ShareLast();
+            return true;
+        }
+
+        px2ODObj.SetROIScale(slot.budget.odROIScale);
+
+        slot.odIdx = odPool.Acquire();
+        odResults& od = odPool.Get(slot.odIdx);
+
+        px2ODObj.DetectObjects(slot.camImgCuda,
+                               od.outputODRectPerClass,
+                               od.outputODRectColorPerClass,
+                               od.outputODLabelPerClass,
+                               od.outputODConfidencePerClass,
+                               od.outputODIDPerClass);
+        odPool.Publish(slot.odIdx);
+
+        if(pedestrianTrigger >= 0)
+        {
+            for(uint32_t classIdx = 0; classIdx < od.outputODLabelPerClass.size(); classIdx++)
             {
-                float y_world = 50 - (float)y/10.f;
+                const vector<const char*>& labels = od.outputODLabelPerClass[classIdx];
+                if(!labels.empty() && (strcmp(labels[0], "pedestrian") == 0) && frameDumper.Trigger(pedestrianTrigger, token.seq))
+                    frameDumper.Dump(slot.camImgCuda, frameDumper.GetTriggerTag(pedestrianTrigger), token.seq);
+            }
+        }
 
-                if( (y_world < minY) || (y_world > maxY))
-                    continue;
+        return true;
+    });
 
-                float x_world = outputLDEqs[0] + (float)y_world*outputLDEqs[1] + (float)y_world*y_world*outputLDEqs[2] + (float)y_world*y_world*y_world*outputLDEqs[3];
-                int xInt = x_world*10.f + 250;
+    /****************************************************
+     * Lane Detector
+     */
+    pipeline.AddStage("laneDetector", [&](frameToken& token)
+    {
+        frameSlot& slot = frameSlots[token.slotIdx];
 
+        if(slot.budget.runLD)
+        {
+            slot.laneIdx = lanePool.Acquire();
+            LaneFrame& newLaneFrame = lanePool.Get(slot.laneIdx);
 
-                if((xInt >= 0) && (xInt < topViewImg.cols))
+            if(laneDetector == LANE_DETECTOR_HARMONY)
+            {
+                px2LDObj.DetectLanesByHarmony(slot.camImgCuda, slot.trtImg, newLaneFrame);
+            }
+            else
+            {
+                if(laneDetector == LANE_DETECTOR_JUNG)
+                    px2LDObj.DetectLanesByJUNG(slot.trtImg, slot.camImgCuda->timestamp_us, newLaneFrame);
+                else
+                    px2LDObj.DetectLanesByDW(slot.camImgCuda, newLaneFrame);
+
+                px2LDObj.RectifyLaneFrame(newLaneFrame);
+                px2LDObj.TopviewLaneFrame(newLaneFrame);
+            }
+            px2LDObj.FitLaneFrame(newLaneFrame);
+
+            lanePool.Publish(slot.laneIdx);
+        }
+        else
+        {
+            // Skipped frame : show the last lanes
+            slot.laneIdx = lanePool.ShareLast();
+        }
+
+        const LaneFrame& laneFrame = lanePool.Get(slot.laneIdx);
+
+        // Lane curves sampled once per frame for the top-view tile, every topViewSampleStepM in the BEV range
+        slot.topViewLanePts.clear();
+        slot.topViewLaneOffsets.assign(1, 0);
+        for(uint32_t laneIdx = 0U;  laneIdx < laneFrame.numLanes; laneIdx++)
+        {
+            const laneFrameLane& lane = laneFrame.lanes[laneIdx];
+
+            if(lane.fitValid)
+            {
+                const float32_t* outputLDEqs = lane.fitCoeffs;
+                float yBegin = max(lane.minY, bevParams.yMin);
+                float yEnd = min(lane.maxY, bevParams.yMax);
+
+                for(float y_world = yBegin; y_world <= yEnd; y_world += topViewSampleStepM)
                 {
-                    topViewImg.at<cv::Vec3b>(y, xInt)[0] = cv::saturate_cast<uchar>(outputLDColorPerLane[laneIdx].z*255);
-                    topViewImg.at<cv::Vec3b>(y, xInt)[1] = cv::saturate_cast<uchar>(outputLDColorPerLane[laneIdx].y*255);
-                    topViewImg.at<cv::Vec3b>(y, xInt)[2] = cv::saturate_cast<uchar>(outputLDColorPerLane[laneIdx].x*255);
+                    float x_world = outputLDEqs[0] + y_world*outputLDEqs[1] + y_world*y_world*outputLDEqs[2] + y_world*y_world*y_world*outputLDEqs[3];
+
+                    dwVector2f ptPx;
+                    px2BEVObj.Metric2Pixel(x_world, y_world, ptPx.x, ptPx.y);
+                    slot.topViewLanePts.push_back(ptPx);
                 }
             }
+
+            slot.topViewLaneOffsets.push_back(slot.topViewLanePts.size());
         }
 
-        cv::imshow("topView", topViewImg);
-        cv::waitKey(1);
+        return true;
+    });
+
+    /****************************************************
+     * Display (GL context belongs to the main thread)
+     */
+    pipeline.AddStage("display", [&](frameToken& token)
+    {
+        frameSlot& slot = frameSlots[token.slotIdx];
+
+        if(!slot.budget.render)
+        {
+            odPool.Release(slot.odIdx);
+            lanePool.Release(slot.laneIdx);
+            return true;
+        }
 
-        /****************************************************/
+        {
+            const odResults& od = odPool.Get(slot.odIdx);
+            const LaneFrame& laneFrame = lanePool.Get(slot.laneIdx);
+
+            static const latencySectionId renderSection = LatencyMonitor::RegisterSection("render");
+            LatencyScope renderScope(&latencyMonitor, renderSection);
+
+            px2CamObj.RenderCamImg(slot.camImgHandle);
+
+            // Draw Object Detection Results
+            px2CamObj.DrawBoundingBoxesWithLabelsPerClass(od.outputODRectPerClass, od.outputODRectColorPerClass, od.outputODLabelPerClass, 1.0f);
+
+            // Draw Lane Detection Results
+            for(uint32_t laneIdx = 0U; (laneDetector != LANE_DETECTOR_HARMONY) && (laneIdx < laneFrame.numLanes); ++laneIdx)
+            {
+                px2CamObj.DrawPolyLineDw(laneFrame.GetImagePts(laneIdx), laneFrame.lanes[laneIdx].numPts,
+                                         6.0f, laneFrame.lanes[laneIdx].color);
+            }
 
+            // Top-view tile : BEV image and the sampled lane curves
+            px2CamObj.RenderTopView(slot.topViewImg);
+            for(uint32_t laneIdx = 0U; laneIdx + 1 < slot.topViewLaneOffsets.size(); ++laneIdx)
+            {
+                uint32_t laneBegin = slot.topViewLaneOffsets[laneIdx];
+                px2CamObj.DrawTopViewPolyLineDw(slot.topViewLanePts.data() + laneBegin, slot.topViewLaneOffsets[laneIdx + 1] - laneBegin,
+                                                2.0f, laneFrame.lanes[laneIdx].color);
+            }
 
-        px2CamObj.RenderCamImg();
+            odPool.Release(slot.odIdx);
+            lanePool.Release(slot.laneIdx);
+        }
 
-        // Draw Object Detection Results
-        px2CamObj.DrawBoundingBoxesWithLabelsPerClass(outputODRectPerClass, outputODRectColorPerClass, outputODLabelPerClass, 1.0f);
+        // Before UpdateRendering() clears the overlay
+        if((annotatedTrigger >= 0) && frameDumper.Trigger(annotatedTrigger, token.seq))
+        {
+            static cv::Mat annotatedFrame;
+            const dwImageProperties& prop = slot.camImgCuda->prop;
+            annotatedFrame.create(prop.height, prop.width, CV_8UC4);
+            CHECK_CUDA_ERROR(cudaMemcpy2D(annotatedFrame.data, annotatedFrame.step, slot.camImgCuda->dptr[0], slot.camImgCuda->pitch[0],
+                                          prop.width*4, prop.height, cudaMemcpyDeviceToHost));
+            frameDumper.DumpAnnotated(annotatedFrame, px2CamObj.GetOverlay(), slot.topViewImg,
+                                      frameDumper.GetTriggerTag(annotatedTrigger), token.seq);
+        }
 
-        // Draw Lane Detection Results
-        for(uint32_t laneIdx = 0U; laneIdx < outputLDPtsPerLane.size(); ++laneIdx)
         {
-            px2CamObj.DrawPolyLineDw(outputLDPtsPerLane[laneIdx], 6.0f, outputLDColorPerLane[laneIdx]);
+            static const latencySectionId swapSection = LatencyMonitor::RegisterSection("swap");
+            LatencyScope swapScope(&latencyMonitor, swapSection);
+            px2CamObj.UpdateRendering();
         }
 
-        px2CamObj.UpdateRendering();
+        // Glass-to-result : camera capture -> result on screen, both in Driveworks time
+        dwTime_t now_us;
+        CHECK_DW_ERROR(dwContext_getCurrentTime(&now_us, px2CamObj.GetDwContext()));
+        latencyMonitor.AddGlassToResult(token.timestamp_us, now_us);
+
+        if(gTraceDumpRequested.exchange(false))
+            traceRecorder.RequestDump("signal");
 
-        auto end = std::chrono::high_resolution_clock::now();
+        return true;
+    }, true);
 
-        cout << "Camera & Recognition Total process time :  "
-             << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+    if(!pipeline.Start())
+        return -1;
+
+    while(pipeline.RunMainThreadStage());
+
+    pipeline.Stop();
+    frameDumper.Release();
+    budgetController.PrintSummary();
+    latencyMonitor.Flush();
+
+    for(uint32_t slotIdx = 0; slotIdx < numFrameSlots; slotIdx++)
+    {
+        dwImage_destroy(&frameSlots[slotIdx].camImgHandle);
+        cudaFree(frameSlots[slotIdx].trtImg);
     }
+
+    return 0;
 }
@@ -54,6 +54,19 @@ public:
         return m_isTimeValid;
     }
 
+    //Time (us) from 'reference' to the start event, both must be completed (e.g. after getTime())
+    float32_t getStartTime(cudaEvent_t reference)
+    {
+        float32_t res;
+        cudaEventElapsedTime(&res, reference, m_start);
+        return 1e3f*res;
+    }
+
+    cudaEvent_t getStartEvent() const
+    {
+        return m_start;
+    }
+
     //Result in us
     float32_t getTime()
     {
@@ -10,19 +10,76 @@
  */
 #include "ProfilerCUDA.hpp"
 
+#include <atomic>
+#include <deque>
+
 namespace dw
 {
 namespace common
 {
 
+namespace
+{
+struct SectionRegistry
+{
+    std::mutex mutex;
+    std::map<std::string, ProfilerCUDA::SectionId> ids;
+    std::deque<std::string> names;
+};
+
+SectionRegistry &getSectionRegistry()
+{
+    static SectionRegistry registry;
+    return registry;
+}
+
+std::atomic<uint64_t> g_nextProfilerSerial(1);
+
+// Last profiler used by this thread and its data, serial 0 : empty
+struct ThreadDataCache
+{
+    uint64_t profilerSerial;
+    ProfilerCUDA::ThreadData *data;
+};
+thread_local ThreadDataCache t_threadDataCache = {0, nullptr};
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
-ProfilerCUDA::ProfilerCUDA()
-    : m_showTotals(false)
+ProfilerCUDA::ProfilerCUDA(Backend backend)
+    : m_backend(backend)
+    , m_serial(g_nextProfilerSerial++)
+    , m_showTotals(false)
     , m_totalsFactor(1)
 {
     getThreadData()->setName("main");
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+ProfilerCUDA::SectionId ProfilerCUDA::registerSection(const std::string &sectionKey)
+{
+    SectionRegistry &registry = getSectionRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto it = registry.ids.find(sectionKey);
+    if (it != registry.ids.end())
+        return it->second;
+
+    SectionId id = static_cast<SectionId>(registry.names.size());
+    registry.names.push_back(sectionKey);
+    registry.ids.insert(std::make_pair(sectionKey, id));
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+std::string ProfilerCUDA::getSectionName(SectionId sectionId)
+{
+    SectionRegistry &registry = getSectionRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    assert(sectionId < registry.names.size());
+    return registry.names[sectionId];
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 bool ProfilerCUDA::empty()
 {
@@ -52,54 +109,40 @@ ProfilerCUDA::ThreadData::ThreadData(ProfilerCUDA *profiler, std::thread::id id)
     : m_profiler(profiler)
     , m_id(id)
     , m_rootSection(this, NULL,"root")
+    , m_gpuReferenceCPU(-1)
+    , m_pendingReferenceCPU(-1)
+    , m_gpuReferenceStream(nullptr)
 {
     m_activeSections.push(ActiveTimingData{&m_rootSection, decltype(ActiveTimingData::startTime)(), nullptr});
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
-void ProfilerCUDA::setCurrentThreadName(const std::string &name)
+ProfilerCUDA::ThreadData::~ThreadData()
 {
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-
-        //Search for a thread data with the same name
-        for(auto it=m_threads.begin(),end=m_threads.end(); it!=end; ++it)
-        {
-            ProfilerCUDA::ThreadData &data = *it->second;
-            if(data.getName() == name)
-            {
-                //Match!
-                //Update the id
-                data.setId(std::this_thread::get_id());
-
-                //Update the thread map
-                std::unique_ptr<ThreadData> dataPtr = std::move(it->second);
-                m_threads.erase(it);
-                m_threads.emplace(data.getId(), std::move(dataPtr));
-                return;
-            }
-        }
-    }
-
-    //Nobody with the same name
-    auto &data = *getThreadData();
-    data.setName(name);
+    if (m_gpuReferenceStream)
+        cudaStreamDestroy(m_gpuReferenceStream);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
 ProfilerCUDA::ThreadData *ProfilerCUDA::getThreadData()
 {
+    if(t_threadDataCache.profilerSerial == m_serial)
+        return t_threadDataCache.data;
+
     std::lock_guard<std::mutex> lock(m_mutex);
 
+    ThreadData *data;
     auto it=m_threads.find(std::this_thread::get_id());
     if(it==m_threads.end())
     {
-        ThreadData *data = new ThreadData(this, std::this_thread::get_id());
+        data = new ThreadData(this, std::this_thread::get_id());
         m_threads.insert(std::make_pair(data->getId(),std::unique_ptr<ThreadData>(data)));
-        return data;
     }
     else
-        return it->second.get();
+        data = it->second.get();
+
+    t_threadDataCache = ThreadDataCache{m_serial, data};
+    return data;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -112,6 +155,20 @@ void ProfilerCUDA::collectTimers()
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+void ProfilerCUDA::getMergedStats(std::map<std::string, StatsCounter> &statsCPU, std::map<std::string, StatsCounter> &statsGPU)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &thread : m_threads)
+    {
+        for (auto &section : thread.second->getRootSection()->getSubsections())
+        {
+            statsCPU[section.first].merge(section.second->getStatsCPU());
+            statsGPU[section.first].merge(section.second->getStatsGPU());
+        }
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 CudaTimer *ProfilerCUDA::ThreadData::getTimer()
 {
@@ -132,6 +189,53 @@ CudaTimer *ProfilerCUDA::ThreadData::getTimer()
 void ProfilerCUDA::ThreadData::collectTimers()
 {
     collectTimers(&m_rootSection);
+
+    if (m_profiler->getBackend() == BACKEND_CUDA && m_profiler->getSampleListener())
+        updateGpuReference();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+void ProfilerCUDA::ThreadData::updateGpuReference()
+{
+    // Reference older than a few seconds : float ms elapsed times lose sub-us precision
+    static constexpr int64_t REFERENCE_PERIOD_US = 5000000;
+
+    if (m_pendingReferenceCPU >= 0)
+    {
+        // Still in flight : the current reference stays
+        if (cudaEventQuery(m_pendingReference->getStartEvent()) != cudaSuccess)
+            return;
+
+        m_gpuReference.swap(m_pendingReference);
+        m_gpuReferenceCPU = m_pendingReferenceCPU;
+        m_pendingReferenceCPU = -1;
+    }
+
+    auto nowCPU = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (m_gpuReferenceCPU >= 0 && nowCPU - m_gpuReferenceCPU < REFERENCE_PERIOD_US)
+        return;
+
+    if (!m_gpuReferenceStream)
+        cudaStreamCreateWithFlags(&m_gpuReferenceStream, cudaStreamNonBlocking);
+    if (!m_pendingReference)
+        m_pendingReference.reset(new CudaTimer());
+
+    // Nothing else on this stream : the event runs right after the record call (a few us of offset)
+    m_pendingReference->setStream(m_gpuReferenceStream);
+    m_pendingReference->start();
+
+    m_pendingReferenceCPU = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+float64_t ProfilerCUDA::ThreadData::getStartTimeGPU(CudaTimer *timer)
+{
+    if (!timer || m_gpuReferenceCPU < 0)
+        return -1;
+
+    return m_gpuReferenceCPU + timer->getStartTime(m_gpuReference->getStartEvent());
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -140,7 +244,8 @@ void ProfilerCUDA::ThreadData::collectTimers(ProfilerCUDA::SectionData *section)
     auto timers = section->collectTimers();
     for (auto timer : timers)
     {
-        m_freeTimers.push(timer);
+        if (timer)
+            m_freeTimers.push(timer);
     }
 
     for (auto &child : section->getSubsections())
@@ -150,18 +255,42 @@ void ProfilerCUDA::ThreadData::collectTimers(ProfilerCUDA::SectionData *section)
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
-void ProfilerCUDA::SectionData::addTiming(dwTime_t timeCPU, CudaTimer *timer)
+void ProfilerCUDA::SectionData::addTiming(int64_t startCPU, dwTime_t timeCPU, CudaTimer *timer)
 {
     m_statsCPU.addSample(static_cast<float32_t>(timeCPU));
     m_pendingTimers.push_back(timer);
+    m_pendingTimesCPU.push_back(PendingTimeCPU{startCPU, timeCPU});
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
 std::vector<CudaTimer*> ProfilerCUDA::SectionData::collectTimers()
 {
-    for (auto timer : m_pendingTimers)
-        m_statsGPU.addSample(timer->getTime());
-    
+    const SampleListener &listener = m_threadData->getProfiler()->getSampleListener();
+
+    for (size_t i = 0; i < m_pendingTimers.size(); i++)
+    {
+        // Host backend : no GPU time
+        float32_t timeGPU = 0;
+        if (m_pendingTimers[i])
+        {
+            timeGPU = m_pendingTimers[i]->getTime();
+            m_statsGPU.addSample(timeGPU);
+        }
+
+        if (listener)
+        {
+            Sample sample;
+            sample.sectionId = m_id;
+            sample.sectionKey = &m_key;
+            sample.timeCPU = static_cast<float32_t>(m_pendingTimesCPU[i].duration);
+            sample.timeGPU = timeGPU;
+            sample.startCPU = m_pendingTimesCPU[i].start;
+            sample.startGPU = m_threadData->getStartTimeGPU(m_pendingTimers[i]);
+            listener(sample);
+        }
+    }
+    m_pendingTimesCPU.clear();
+
     return std::move(m_pendingTimers); //This clears the vector and returns it so they can be reused
 }
 
@@ -179,6 +308,7 @@ ProfilerCUDA::SectionData::SectionData(ProfilerCUDA::ThreadData *threadData, Pro
     : m_threadData(threadData)
     , m_parent(parent)
     , m_key(key)
+    , m_id(registerSection(key))
 {
 }
 
@@ -42,6 +42,7 @@
 #include <chrono>
 #include <ostream>
 #include <cassert>
+#include <functional>
 
 #include <dw/core/Types.h>
 #include <dw/core/Context.h>
@@ -62,7 +63,7 @@ namespace common
  * Can be used directly with tic(string) and toc(string), or through the ProfileSection() class. All
  * profiling code is removed if ENABLE_PROFILER is not defined.
  *
- * All profiling is done through cuda events. Thus, CPU time will not be measured.
+ * CPU time is measured with steady_clock, GPU time through cuda events on the tic stream (BACKEND_CUDA only).
  *
  * Profiler has a singleton instance and can be safely called from different threads. Timings from different
  * threads are kept separate.
@@ -70,11 +71,44 @@ namespace common
 class ProfilerCUDA
 {
 public:
-    ProfilerCUDA();
+    enum Backend
+    {
+        BACKEND_CUDA,   ///< CPU time + GPU time from CUDA events recorded on the tic stream
+        BACKEND_HOST    ///< CPU time only, no CUDA call (hot loop instrumentation, machines without GPU)
+    };
+
+    explicit ProfilerCUDA(Backend backend = BACKEND_CUDA);
+
+    Backend getBackend() const { return m_backend; }
 
-    inline void tic(const std::string &sectionKey, bool isTopLevelSection);
+    /// Interned section key, shared by all profilers. Register once (e.g. in a function static) and tic with the id:
+    /// the string overload of tic registers the key on every call.
+    typedef uint32_t SectionId;
+    static SectionId registerSection(const std::string &sectionKey);
+    static std::string getSectionName(SectionId sectionId);
+
+    /// GPU time is measured with events recorded on 'stream'
+    inline void tic(SectionId sectionId, bool isTopLevelSection, cudaStream_t stream = 0);
+    inline void tic(const std::string &sectionKey, bool isTopLevelSection, cudaStream_t stream = 0);
     inline void toc();
 
+    /// One timing, times in us. Start times are steady_clock time since epoch, the GPU one is
+    /// placed on that clock through a reference event (negative without GPU time).
+    struct Sample
+    {
+        SectionId sectionId;
+        const std::string *sectionKey;
+        float32_t timeCPU;
+        float32_t timeGPU;
+        int64_t startCPU;
+        float64_t startGPU;
+    };
+
+    /// Called for every timing when its GPU time is collected (from the thread calling collectTimers)
+    typedef std::function<void(const Sample &sample)> SampleListener;
+    void setSampleListener(SampleListener listener) { m_sampleListener = listener; }
+    const SampleListener &getSampleListener() const { return m_sampleListener; }
+
     /// Determines whether to show average or total timings
     void setShowTotals(bool value) {m_showTotals = value;}
     bool getShowTotals() const {return m_showTotals;}
@@ -90,10 +124,12 @@ public:
     bool empty();
     void reset();
 
-    void setCurrentThreadName(const std::string &name);
-
     void collectTimers();
 
+    /// Stats of each top level section merged over all threads (e.g. one stage run by several threads)
+    /// Note: Section stats are updated by their threads without lock, call it when the threads are done
+    void getMergedStats(std::map<std::string, StatsCounter> &statsCPU, std::map<std::string, StatsCounter> &statsGPU);
+
     ///////////////////////////////////////////////////////////
     // Child classes
     class ThreadData;
@@ -106,15 +142,17 @@ public:
 
         SectionData *getParent() const {return m_parent;}
         const std::string &getKey() const {return m_key;}
+        SectionId getId() const {return m_id;}
 
         const std::map<std::string, std::unique_ptr<SectionData>> &getSubsections() const {return m_childSections;}
 
+        inline SectionData *getSubsection(SectionId subId);
         inline SectionData *getSubsection(const std::string &subkey);
 
-        void addTiming(dwTime_t timeCPU, CudaTimer *timer);
+        void addTiming(int64_t startCPU, dwTime_t timeCPU, CudaTimer *timer);
         std::vector<CudaTimer*> collectTimers();
         
-        bool empty() const { return (m_statsGPU.getSampleCount() == 0) && m_pendingTimers.empty(); }
+        bool empty() const { return (m_statsCPU.getSampleCount() == 0) && m_pendingTimesCPU.empty(); }
         void reset();
 
         const StatsCounter &getStatsCPU() const {return m_statsCPU;}
@@ -131,18 +169,27 @@ public:
         SectionData *m_parent;
         
         std::string m_key;
+        SectionId m_id;
         StatsCounter m_statsGPU;
         StatsCounter m_statsCPU;
 
         std::map<std::string, std::unique_ptr<SectionData>> m_childSections;
+        std::vector<SectionData*> m_childById;  ///< Index into m_childSections by interned id, null if not created yet
 
-        std::vector<CudaTimer*> m_pendingTimers;
+        std::vector<CudaTimer*> m_pendingTimers;    ///< Null entries with BACKEND_HOST
+        struct PendingTimeCPU
+        {
+            int64_t start;
+            dwTime_t duration;
+        };
+        std::vector<PendingTimeCPU> m_pendingTimesCPU;
     };
 
     class ThreadData
     {
     public:
         ThreadData(ProfilerCUDA *profiler, std::thread::id id);
+        ~ThreadData();
 
         const std::thread::id &getId() const {return m_id;}
         void setId(const std::thread::id &newId) {m_id = newId;}
@@ -158,7 +205,10 @@ public:
         void collectTimers();
         void collectTimers(SectionData *section);
 
-        inline void tic(const std::string &sectionKey, bool isTopLevelSection);
+        /// steady_clock time (us) of a GPU timer start, negative if there is no reference yet
+        float64_t getStartTimeGPU(CudaTimer *timer);
+
+        inline void tic(SectionId sectionId, bool isTopLevelSection, cudaStream_t stream);
         inline void toc();
 
         template<typename T>
@@ -183,10 +233,23 @@ public:
 
         std::vector<std::unique_ptr<CudaTimer>> m_ownedTimers;
         std::stack<CudaTimer*> m_freeTimers;
+
+        /// Event completed at m_gpuReferenceCPU (us), re-recorded after collecting so the float
+        /// elapsed times stay short and every pending timer starts after it.
+        /// The new event goes on an idle non-blocking stream and replaces the current one once
+        /// cudaEventQuery reports it done, so no collect waits for the GPU.
+        std::unique_ptr<CudaTimer> m_gpuReference;
+        int64_t m_gpuReferenceCPU;
+        std::unique_ptr<CudaTimer> m_pendingReference;
+        int64_t m_pendingReferenceCPU;
+        cudaStream_t m_gpuReferenceStream;
+        void updateGpuReference();
     };
 
     ///////////////////////////////////////////////////////////
     // ProfilerCUDA member methods
+
+    /// Lock free after the first call of each thread (thread local cache)
     ThreadData *getThreadData();
 
     /// Note: The map returned is used by different threads and is therefore not thread-safe to use
@@ -200,8 +263,11 @@ protected:
     // ProfilerCUDA member variables
     std::mutex m_mutex;
     std::map<std::thread::id, std::unique_ptr<ThreadData>> m_threads;
+    Backend m_backend;
+    uint64_t m_serial;  ///< Unique per profiler instance, validates the thread local cache
     bool m_showTotals;
     int m_totalsFactor;
+    SampleListener m_sampleListener;
 };
 
 template<typename T>
@@ -221,7 +287,7 @@ T &operator <<(T &stream, ProfilerCUDA &profiler)
 class ProfileCUDASection
 {
 public:
-    ProfileCUDASection(ProfilerCUDA *profiler, const std::string &sectionKey, bool isTopLevel)
+    ProfileCUDASection(ProfilerCUDA *profiler, const std::string &sectionKey, bool isTopLevel, cudaStream_t stream = 0)
         : m_profiler(profiler)
         , m_running(true)
     {
@@ -231,10 +297,11 @@ public:
         //       the entire system and how the complete pipeline behaves.
         //       The sync must be commented in master but you may uncomment it to profile and compare.
         //cudaDeviceSynchronize();
-        m_profiler->tic(sectionKey, isTopLevel);
+        m_profiler->tic(sectionKey, isTopLevel, stream);
 #else
         (void) sectionKey;
         (void) isTopLevel;
+        (void) stream;
 #endif
     }
     ProfileCUDASection(ProfilerCUDA *profiler, const std::string &sectionKey)
@@ -267,6 +334,22 @@ private:
 // Implementation of inline methods
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ProfilerCUDA::SectionData *ProfilerCUDA::SectionData::getSubsection(SectionId subId)
+{
+    if(subId < m_childById.size() && m_childById[subId])
+        return m_childById[subId];
+
+    // First use in this thread
+    SectionData *data = getSubsection(getSectionName(subId));
+
+    if(subId >= m_childById.size())
+        m_childById.resize(subId + 1, nullptr);
+    m_childById[subId] = data;
+
+    return data;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ProfilerCUDA::SectionData *ProfilerCUDA::SectionData::getSubsection(const std::string &subkey)
 {
@@ -410,7 +493,7 @@ T &ProfilerCUDA::SectionData::logStats(T &stream, const std::string &prefix, con
         // Print empty to keep columns aligned
         stream << std::setw(6) << " ";
     }
-    stream << " | samples=" << m_statsGPU.getSampleCount() << "\n";
+    stream << " | samples=" << m_statsCPU.getSampleCount() << "\n";
 
     std::string newPrefix = prefix + "-";
     for(auto &child : m_childSections)
@@ -420,21 +503,27 @@ T &ProfilerCUDA::SectionData::logStats(T &stream, const std::string &prefix, con
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
-void ProfilerCUDA::ThreadData::tic(const std::string &sectionKey, bool isTopLevelSection)
+void ProfilerCUDA::ThreadData::tic(SectionId sectionId, bool isTopLevelSection, cudaStream_t stream)
 {
     ProfilerCUDA::SectionData *data;
     if(isTopLevelSection)
-        data = m_rootSection.getSubsection(sectionKey);
+        data = m_rootSection.getSubsection(sectionId);
     else
-        data = m_activeSections.top().section->getSubsection(sectionKey);
+        data = m_activeSections.top().section->getSubsection(sectionId);
+
+    CudaTimer *timer = nullptr;
+    if(m_profiler->getBackend() == BACKEND_CUDA)
+    {
+        timer = getTimer();
+        timer->setStream(stream);
+    }
 
-    CudaTimer *timer = getTimer();
-    
     auto timeCPU = std::chrono::steady_clock::now();
 
     m_activeSections.push(ActiveTimingData{data,timeCPU,timer});
 
-    timer->start();
+    if(timer)
+        timer->start();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -447,10 +536,12 @@ void ProfilerCUDA::ThreadData::toc()
     auto durationCPU = std::chrono::duration_cast<std::chrono::microseconds>(timeStopCPU - data.startTime).count();
 
     //Store ellapsed GPU time
-    data.timer->stop();
+    if(data.timer)
+        data.timer->stop();
 
     //Record data
-    data.section->addTiming(durationCPU, data.timer);
+    auto startCPU = std::chrono::duration_cast<std::chrono::microseconds>(data.startTime.time_since_epoch()).count();
+    data.section->addTiming(startCPU, durationCPU, data.timer);
 
     m_activeSections.pop();
 }
@@ -481,10 +572,16 @@ T &ProfilerCUDA::ThreadData::logStats(T &stream)
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
-void ProfilerCUDA::tic(const std::string &sectionKey, bool isTopLevelSection)
+void ProfilerCUDA::tic(SectionId sectionId, bool isTopLevelSection, cudaStream_t stream)
 {
     ThreadData *thread = getThreadData();
-    thread->tic(sectionKey, isTopLevelSection);
+    thread->tic(sectionId, isTopLevelSection, stream);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+void ProfilerCUDA::tic(const std::string &sectionKey, bool isTopLevelSection, cudaStream_t stream)
+{
+    tic(registerSection(sectionKey), isTopLevelSection, stream);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -23,6 +23,232 @@ namespace common
 {
 
 // Classes
+
+/*
+ * Mergeable streaming quantile sketch (merging t-digest, k1 scale function).
+ *
+ * Samples go to a fixed size buffer, which is sorted and merged into the centroids when full, so the
+ * memory is bounded by the compression (about compression/2 centroids) and the insert cost is amortized constant.
+ * Centroids are small near q=0 and q=1, so tail quantiles (p99, p99.9) stay accurate.
+ * Digests built on different threads can be merged for reporting.
+ * The const getters never modify the digest (concurrent readers are safe) : with samples still buffered,
+ * getQuantile() works on a compressed copy, call compress() first to avoid it.
+ */
+class QuantileDigest
+{
+  public:
+    explicit QuantileDigest(float32_t compression = 200.0f)
+        : m_compression(compression)
+        , m_bufferSize(std::max<size_t>(64, static_cast<size_t>(5*compression)))
+        , m_totalWeight(0)
+        , m_min(std::numeric_limits<float32_t>::max())
+        , m_max(std::numeric_limits<float32_t>::lowest())
+    {
+    }
+
+    void add(float32_t sample)
+    {
+        m_buffer.push_back(sample);
+        m_totalWeight += 1;
+        if (sample < m_min)
+            m_min = sample;
+        if (sample > m_max)
+            m_max = sample;
+
+        if (m_buffer.size() >= m_bufferSize)
+            compress();
+    }
+
+    void merge(const QuantileDigest &other)
+    {
+        if (other.m_totalWeight == 0)
+            return;
+
+        // Other's buffer goes through its centroids first (on a copy, other is const), so both sides are sorted centroid lists
+        if (!other.m_buffer.empty())
+        {
+            QuantileDigest compressed(other);
+            compressed.compress();
+            merge(compressed);
+            return;
+        }
+        compress();
+
+        std::vector<Centroid> merged(m_centroids.size() + other.m_centroids.size());
+        std::merge(m_centroids.begin(), m_centroids.end(), other.m_centroids.begin(), other.m_centroids.end(),
+                   merged.begin(), compareMean);
+
+        m_totalWeight += other.m_totalWeight;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+
+        mergeCentroids(merged);
+    }
+
+    void clear()
+    {
+        m_centroids.clear();
+        m_buffer.clear();
+        m_totalWeight = 0;
+        m_min = std::numeric_limits<float32_t>::max();
+        m_max = std::numeric_limits<float32_t>::lowest();
+    }
+
+    float64_t getCount() const
+    {
+        return m_totalWeight;
+    }
+
+    size_t getCentroidCount() const
+    {
+        return m_centroids.size();
+    }
+
+    /*
+     * q in [0,1]. Interpolates between the centroid centers, and between the extreme centroids and min/max.
+     */
+    float32_t getQuantile(float32_t q) const
+    {
+        if (m_totalWeight == 0)
+            return std::numeric_limits<float32_t>::quiet_NaN();
+
+        if (!m_buffer.empty())
+        {
+            QuantileDigest compressed(*this);
+            compressed.compress();
+            return compressed.getQuantile(q);
+        }
+
+        if (q <= 0)
+            return m_min;
+        if (q >= 1)
+            return m_max;
+
+        const std::vector<Centroid> &c = m_centroids;
+        float64_t target = q*m_totalWeight;
+
+        // Centroid i covers the weight [cumulative, cumulative + weight], its mean sits at the center
+        float64_t cumulative = 0;
+        float64_t prevCenter = 0;
+        float64_t prevMean   = m_min;
+        for (size_t i = 0; i < c.size(); i++)
+        {
+            float64_t center = cumulative + c[i].weight/2;
+
+            // Single samples are exact, no interpolation inside them
+            if (c[i].weight == 1 && target >= cumulative && target < cumulative + 1)
+                return static_cast<float32_t>(c[i].mean);
+
+            if (target < center)
+            {
+                float64_t t = (target - prevCenter)/(center - prevCenter);
+                return static_cast<float32_t>(prevMean + t*(c[i].mean - prevMean));
+            }
+
+            cumulative += c[i].weight;
+            prevCenter = center;
+            prevMean   = c[i].mean;
+        }
+
+        float64_t t = (target - prevCenter)/(m_totalWeight - prevCenter);
+        return static_cast<float32_t>(prevMean + t*(m_max - prevMean));
+    }
+
+    /*
+     * Merges the buffered samples into the centroids.
+     */
+    void compress()
+    {
+        if (m_buffer.empty())
+            return;
+
+        // Sorting plain floats is much cheaper than sorting centroids, the centroids are already sorted
+        std::sort(m_buffer.begin(), m_buffer.end());
+
+        std::vector<Centroid> &merged = m_mergeScratch;
+        merged.clear();
+        merged.reserve(m_buffer.size() + m_centroids.size());
+
+        size_t centroidIdx = 0;
+        for (float32_t sample : m_buffer)
+        {
+            while (centroidIdx < m_centroids.size() && m_centroids[centroidIdx].mean < sample)
+                merged.push_back(m_centroids[centroidIdx++]);
+            merged.push_back(Centroid{sample, 1.0});
+        }
+        merged.insert(merged.end(), m_centroids.begin() + centroidIdx, m_centroids.end());
+
+        m_buffer.clear();
+        mergeCentroids(merged);
+    }
+
+  protected:
+    static constexpr float64_t PI = 3.14159265358979323846;
+
+    struct Centroid
+    {
+        float64_t mean;
+        float64_t weight;
+    };
+
+    // k1 scale function : k(q) = compression/(2*pi)*asin(2q-1), a centroid spans at most 1 in k
+    float64_t scaleK(float64_t q) const
+    {
+        return m_compression/(2*PI)*std::asin(2*q - 1);
+    }
+
+    float64_t scaleKInv(float64_t k) const
+    {
+        k = std::min<float64_t>(k, m_compression/4);
+        return (std::sin(k*2*PI/m_compression) + 1)/2;
+    }
+
+    static bool compareMean(const Centroid &a, const Centroid &b)
+    {
+        return a.mean < b.mean;
+    }
+
+    // Sorted centroid list -> m_centroids, merging neighbours while they fit in one unit of k
+    void mergeCentroids(const std::vector<Centroid> &sorted)
+    {
+        m_centroids.clear();
+
+        Centroid current = sorted[0];
+        float64_t weightSoFar = 0;
+        float64_t weightLimit = m_totalWeight*scaleKInv(scaleK(0) + 1);
+
+        for (size_t i = 1; i < sorted.size(); i++)
+        {
+            const Centroid &next = sorted[i];
+
+            if (weightSoFar + current.weight + next.weight <= weightLimit)
+            {
+                current.weight += next.weight;
+                current.mean   += (next.mean - current.mean)*next.weight/current.weight;
+            }
+            else
+            {
+                weightSoFar += current.weight;
+                m_centroids.push_back(current);
+                weightLimit = m_totalWeight*scaleKInv(scaleK(weightSoFar/m_totalWeight) + 1);
+                current = next;
+            }
+        }
+        m_centroids.push_back(current);
+    }
+
+    float32_t m_compression;
+    size_t m_bufferSize;
+
+    std::vector<Centroid> m_centroids;
+    std::vector<float32_t> m_buffer;
+    std::vector<Centroid> m_mergeScratch;
+
+    float64_t m_totalWeight;
+    float32_t m_min;
+    float32_t m_max;
+};
+
 class StatsCounter
 {
   public:
@@ -37,12 +263,11 @@ class StatsCounter
 
     void addSample(float32_t sample)
     {
-        if(m_samples.size() < MAX_SAMPLE_COUNT)
-            m_samples.push_back(sample);
+        m_digest.add(sample);
 
         m_count++;
         m_sum += sample;
-        m_sumSq += sample*sample;
+        m_sumSq += static_cast<float64_t>(sample)*sample;
         if (sample > m_max)
             m_max = sample;
         if (sample < m_min)
@@ -64,6 +289,18 @@ class StatsCounter
             addSample(static_cast<float32_t>(array[i]));
     }
 
+    /// Adds the samples of another counter, e.g. the same section timed on another thread
+    void merge(const StatsCounter &other)
+    {
+        m_digest.merge(other.m_digest);
+
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_sumSq += other.m_sumSq;
+        m_max = std::max(m_max, other.m_max);
+        m_min = std::min(m_min, other.m_min);
+    }
+
     uint32_t getSampleCount() const
     {
         return m_count;
@@ -81,18 +318,18 @@ class StatsCounter
 
     float32_t getSum() const
     {
-        return m_sum;
+        return static_cast<float32_t>(m_sum);
     }
 
     float32_t getMean() const
     {
-        return m_sum/static_cast<float32_t>(m_count);
+        return static_cast<float32_t>(m_sum/static_cast<float64_t>(m_count));
     }
 
     float32_t getVariance() const
     {
-        float32_t mean = getMean();
-        float32_t var  = m_sumSq/static_cast<float32_t>(m_count) - mean*mean;
+        float64_t mean = m_sum/static_cast<float64_t>(m_count);
+        float32_t var  = static_cast<float32_t>(m_sumSq/static_cast<float64_t>(m_count) - mean*mean);
 
         return std::abs(var) <= 1e-7f ? 0 : var;
     }
@@ -103,43 +340,41 @@ class StatsCounter
     }
 
     /*
-    * Note: To simplify code and make the computation faster, this returns the true median only for odd sample counts.
-    *       For even counts the true median would be (samples[n/2] + samples[n/2+1])/2, but sample[n/2] is returned instead.
+    * q in [0,1], estimated by the quantile digest (exact for small sample counts, bounded memory for any count).
+    * NaN without samples.
     */
-    float32_t getMedian()
+    float32_t getQuantile(float32_t q) const
     {
-        if (m_samples.empty() || m_samples.size() >= MAX_SAMPLE_COUNT)
-            return std::numeric_limits<float32_t>::quiet_NaN();
+        return m_digest.getQuantile(q);
+    }
 
-        size_t n = m_samples.size() / 2;
-        std::nth_element(m_samples.begin(), m_samples.begin()+n, m_samples.end());
-        return m_samples[n];
+    /// Folds the buffered samples into the digest, so the following getQuantile() calls need no copy
+    void compress()
+    {
+        m_digest.compress();
     }
 
-    /*
-     * Note: This method overrides constness to reorder the samples vector. It is considered const because all stats remain the same.
-     */
     float32_t getMedian() const
     {
-        return const_cast<StatsCounter*>(this)->getMedian();
+        return getQuantile(0.5f);
     }
 
     template<class TStream>
     void writeToStream(TStream &stream) const
     {
-        stream << "Median=" << getMedian() << ", mean=" << getMean() << ", var=" << getVariance() << ", std dev=" << getStdDev()
+        stream << "Median=" << getMedian() << ", p90=" << getQuantile(0.9f) << ", p99=" << getQuantile(0.99f)
+            << ", p99.9=" << getQuantile(0.999f) << ", mean=" << getMean() << ", var=" << getVariance() << ", std dev=" << getStdDev()
             << ", sample count=" << getSampleCount() << ", min=" << getMin() << ", max=" << getMax();
     }
 
   protected:
-    //Full sample array stored to calculate median
-    static constexpr size_t MAX_SAMPLE_COUNT = 5000;
-    std::vector<float32_t> m_samples;
+    //Bounded memory sketch used to calculate the median and other quantiles
+    QuantileDigest m_digest;
 
-    //These are used to calculate mean and variance
+    //These are used to calculate mean and variance (double : long runs of small samples)
     uint32_t m_count;
-    float32_t m_sum;
-    float32_t m_sumSq;
+    float64_t m_sum;
+    float64_t m_sumSq;
     
     float32_t m_max;
     float32_t m_min;
@@ -787,6 +787,15 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings);
 
+/*
+Like lodepng_deflate, but the last block is only marked final if final is 1. Otherwise the data ends with
+an empty stored block (sync flush) on a byte boundary, so that parts compressed independently (e.g. on
+several threads) can be concatenated into one deflate stream. Each part starts with an empty window.
+*/
+unsigned lodepng_deflate_part(unsigned char** out, size_t* outsize,
+                              const unsigned char* in, size_t insize,
+                              const LodePNGCompressSettings* settings, unsigned final);
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
@@ -61,6 +61,89 @@ vector<float> LMSFit::FitLine(vector<dwVector2f> _pt_list, uint _poly_order)
     return coeff_return;
 }
 
+bool LMSFit::FitLine(const dwVector2f* _pt_list, uint _num_pts, uint _poly_order, float* _out_coeff)
+{
+    if((_poly_order > LMS_FIT_MAX_ORDER) || (_num_pts < _poly_order + 1))
+        return false;
+
+    const uint n = _poly_order + 1;
+
+    // y is normalized to [-1, 1] to keep the normal equations well conditioned
+    double y_scale = 0;
+    for(uint i = 0; i < _num_pts; i++)
+        y_scale = max(y_scale, fabs((double)_pt_list[i].y));
+
+    if(y_scale < 1e-9)
+        return false;
+
+    double A[LMS_FIT_MAX_ORDER + 1][LMS_FIT_MAX_ORDER + 2] = {};
+
+    for(uint i = 0; i < _num_pts; i++)
+    {
+        double y = _pt_list[i].y/y_scale;
+        double x = _pt_list[i].x;
+
+        double y_pow[2*LMS_FIT_MAX_ORDER + 1];
+        y_pow[0] = 1;
+        for(uint k = 1; k < 2*n - 1; k++)
+            y_pow[k] = y_pow[k - 1]*y;
+
+        for(uint r = 0; r < n; r++)
+        {
+            for(uint c = 0; c < n; c++)
+                A[r][c] += y_pow[r + c];
+
+            A[r][n] += y_pow[r]*x;
+        }
+    }
+
+    // Gaussian elimination with partial pivoting
+    for(uint c = 0; c < n; c++)
+    {
+        uint pivot = c;
+        for(uint r = c + 1; r < n; r++)
+        {
+            if(fabs(A[r][c]) > fabs(A[pivot][c]))
+                pivot = r;
+        }
+
+        if(fabs(A[pivot][c]) < 1e-12)
+            return false;
+
+        if(pivot != c)
+        {
+            for(uint k = c; k <= n; k++)
+                swap(A[c][k], A[pivot][k]);
+        }
+
+        for(uint r = c + 1; r < n; r++)
+        {
+            double f = A[r][c]/A[c][c];
+            for(uint k = c; k <= n; k++)
+                A[r][k] -= f*A[c][k];
+        }
+    }
+
+    double coeff[LMS_FIT_MAX_ORDER + 1];
+    for(int r = n - 1; r >= 0; r--)
+    {
+        double sum = A[r][n];
+        for(uint k = r + 1; k < n; k++)
+            sum -= A[r][k]*coeff[k];
+
+        coeff[r] = sum/A[r][r];
+    }
+
+    // Back to the original y scale
+    double scale_pow = 1;
+    for(uint i = 0; i < n; i++)
+    {
+        _out_coeff[i] = coeff[i]/scale_pow;
+        scale_pow *= y_scale;
+    }
+
+    return true;
+}
 
 bool outlierFilter::RANSACFilter(vector<cv::Point> _raw_ld_result, uint _poly_order, vector<float>& _out_model_coeff, vector<cv::Point>& _out_inlier_pt_list)
 {
@@ -23,6 +23,8 @@
 using namespace std;
 using namespace arma;
 
+#define LMS_FIT_MAX_ORDER 7
+
 class LMSFit{
 public:
 	LMSFit() {}
@@ -31,6 +33,9 @@ public:
     vector<double> FitLine(vector<cv::Point> _pt_list,uint _poly_order);
     vector<float> FitLine(vector<dwVector2f> _pt_list, uint _poly_order);
 
+    // Same fit (x = f(y)) through the normal equations on the stack, for per-frame use without heap allocation
+    bool FitLine(const dwVector2f* _pt_list, uint _num_pts, uint _poly_order, float* _out_coeff);
+
 };
 
 class outlierFilter {
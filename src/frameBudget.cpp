@@ -0,0 +1,239 @@
+#include "frameBudget.h"
+#include "px2log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+void FrameBudgetController::SetParameters(frameBudgetParameters params)
+{
+    lock_guard<mutex> lock(mMutex);
+    mParams = params;
+    mLevel = 0;
+    mOverCount = 0;
+    mUnderCount = 0;
+    mLevelFrames = 0;
+    mLevelSkippedOD = 0;
+    mLevelSkippedLD = 0;
+    mLevelSkippedRender = 0;
+}
+
+int FrameBudgetController::AddStage(string name)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    stageCost stage;
+    stage.name = name;
+    mStages.push_back(stage);
+
+    return mStages.size() - 1;
+}
+
+void FrameBudgetController::ReportStage(int stageId, double costMs, bool skipped)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    if((stageId < 0) || (stageId >= (int)mStages.size()))
+        return;
+
+    stageCost& stage = mStages[stageId];
+    double frameCostMs = skipped ? 0.0 : costMs;
+
+    if(!stage.hasSample)
+    {
+        stage.emaMs = frameCostMs;
+        stage.hasSample = true;
+    }
+    else
+    {
+        stage.emaMs += mParams.emaAlpha*(frameCostMs - stage.emaMs);
+    }
+
+    if(skipped)
+        return;
+
+    if(!stage.hasRunSample)
+    {
+        stage.runEmaMs = costMs;
+        stage.hasRunSample = true;
+    }
+    else
+    {
+        stage.runEmaMs += mParams.emaAlpha*(costMs - stage.runEmaMs);
+    }
+}
+
+double FrameBudgetController::GetLoadMs()
+{
+    lock_guard<mutex> lock(mMutex);
+    return CombineStages(false);
+}
+
+double FrameBudgetController::GetRunLoadMs()
+{
+    lock_guard<mutex> lock(mMutex);
+    return CombineStages(true);
+}
+
+frameBudgetDecision FrameBudgetController::Decide(uint64_t seq)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    double loadMs = CombineStages(false);
+    double runLoadMs = CombineStages(true);
+
+    mNumFrames++;
+
+    // Level update with hysteresis
+    int maxLevel = mParams.policy.size();
+    if(loadMs > mParams.frameBudgetMs)
+    {
+        mUnderCount = 0;
+        if((++mOverCount >= mParams.escalateFrames) && (mLevel < maxLevel))
+        {
+            LogLevelWindow(mLevel + 1);
+            int level = ++mLevel;
+            mOverCount = 0;
+            mNumLevelChanges++;
+
+            PX2_LOG_INFO("[BUDGET] Frame %llu : load %.1fms > %.1fms, level %d (+%s)",
+                         seq, loadMs, mParams.frameBudgetMs, level,
+                         GetActionName(mParams.policy[level - 1]));
+        }
+    }
+    else if(runLoadMs < mParams.relaxRatio*mParams.frameBudgetMs)
+    {
+        mOverCount = 0;
+        if((++mUnderCount >= mParams.relaxFrames) && (mLevel > 0))
+        {
+            LogLevelWindow(mLevel - 1);
+            int level = --mLevel;
+            mUnderCount = 0;
+            mNumLevelChanges++;
+
+            PX2_LOG_INFO("[BUDGET] Frame %llu : load without shedding %.1fms < %.1fms, level %d (-%s)",
+                         seq, runLoadMs, mParams.relaxRatio*mParams.frameBudgetMs, level,
+                         GetActionName(mParams.policy[level]));
+        }
+    }
+    else
+    {
+        mOverCount = 0;
+        mUnderCount = 0;
+    }
+
+    frameBudgetDecision decision;
+    decision.seq = seq;
+    decision.level = mLevel;
+
+    if(IsActive(BUDGET_SKIP_RENDER))
+        decision.render = (seq%2 == 0);
+
+    if(IsActive(BUDGET_ALTERNATE_OD_LD))
+    {
+        decision.runOD = (seq%2 == 0);
+        decision.runLD = (seq%2 == 1);
+    }
+
+    // Lower LaneNet rate, an odd divider so it still hits the odd (LD) frames when alternating
+    if(IsActive(BUDGET_LOWER_LANENET_RATE) && (mParams.laneNetRateDivider > 1))
+    {
+        int divider = mParams.laneNetRateDivider;
+        if(IsActive(BUDGET_ALTERNATE_OD_LD) && (divider%2 == 0))
+            divider++;
+
+        decision.runLD = decision.runLD && (seq%divider == 1%divider);
+    }
+
+    if(IsActive(BUDGET_SHRINK_OD_ROI))
+        decision.odROIScale = mParams.odROIScale;
+
+    mSkippedOD += !decision.runOD;
+    mSkippedLD += !decision.runLD;
+    mSkippedRender += !decision.render;
+    mShrunkOD += (decision.runOD && (decision.odROIScale < 1.f));
+
+    mLevelFrames++;
+    mLevelSkippedOD += !decision.runOD;
+    mLevelSkippedLD += !decision.runLD;
+    mLevelSkippedRender += !decision.render;
+
+    return decision;
+}
+
+// Skips of the level that ends, called under mMutex
+void FrameBudgetController::LogLevelWindow(int newLevel)
+{
+    PX2_LOG_INFO("[BUDGET] Level %d -> %d after %llu frames : skipped OD %llu, LD %llu, render %llu",
+                 mLevel.load(), newLevel, (unsigned long long)mLevelFrames,
+                 (unsigned long long)mLevelSkippedOD, (unsigned long long)mLevelSkippedLD,
+                 (unsigned long long)mLevelSkippedRender);
+
+    mLevelFrames = 0;
+    mLevelSkippedOD = 0;
+    mLevelSkippedLD = 0;
+    mLevelSkippedRender = 0;
+}
+
+void FrameBudgetController::PrintSummary()
+{
+    lock_guard<mutex> lock(mMutex);
+
+    double loadMs = CombineStages(false);
+
+    printf("[BUDGET] %llu frames, level %d, %llu level changes, load %.1fms / %.1fms\n",
+           (unsigned long long)mNumFrames, mLevel.load(), (unsigned long long)mNumLevelChanges,
+           loadMs, mParams.frameBudgetMs);
+    printf("[BUDGET] Skipped OD %llu, LD %llu, render %llu, shrunk OD ROI %llu\n",
+           (unsigned long long)mSkippedOD, (unsigned long long)mSkippedLD,
+           (unsigned long long)mSkippedRender, (unsigned long long)mShrunkOD);
+
+    for(uint32_t stageIdx = 0; stageIdx < mStages.size(); stageIdx++)
+        printf("[BUDGET]   %-16s %7.2fms per frame, %7.2fms per run\n",
+               mStages[stageIdx].name.c_str(), mStages[stageIdx].emaMs, mStages[stageIdx].runEmaMs);
+}
+
+const char* FrameBudgetController::GetActionName(frameBudgetAction action)
+{
+    switch(action)
+    {
+    case BUDGET_SKIP_RENDER:
+        return "SKIP_RENDER";
+    case BUDGET_ALTERNATE_OD_LD:
+        return "ALTERNATE_OD_LD";
+    case BUDGET_LOWER_LANENET_RATE:
+        return "LOWER_LANENET_RATE";
+    case BUDGET_SHRINK_OD_ROI:
+        return "SHRINK_OD_ROI";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+// Levels are cumulative : the first mLevel actions of the policy are active
+bool FrameBudgetController::IsActive(frameBudgetAction action) const
+{
+    for(int levelIdx = 0; (levelIdx < mLevel) && (levelIdx < (int)mParams.policy.size()); levelIdx++)
+    {
+        if(mParams.policy[levelIdx] == action)
+            return true;
+    }
+
+    return false;
+}
+
+double FrameBudgetController::CombineStages(bool perRun) const
+{
+    double loadMs = 0.0;
+    for(uint32_t stageIdx = 0; stageIdx < mStages.size(); stageIdx++)
+    {
+        double stageMs = perRun ? mStages[stageIdx].runEmaMs : mStages[stageIdx].emaMs;
+
+        if(mParams.pipelined)
+            loadMs = max(loadMs, stageMs);
+        else
+            loadMs += stageMs;
+    }
+
+    return loadMs;
+}
@@ -0,0 +1,117 @@
+#ifndef FRAMEBUDGET_H
+#define FRAMEBUDGET_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Frame budget controller (load shedding) for the recognition loop.
+ *
+ * Every stage reports its cost per frame, the controller keeps two EMAs per stage :
+ * per frame (a skipped stage costs 0) and per run (skipped frames ignored), and compares the load with the camera period :
+ *  - pipelined loop : load = slowest stage (each stage has one camera period per frame)
+ *  - sequential loop : load = sum of the stages
+ * Per frame load over budget for escalateFrames frames -> next degrade level of the policy.
+ * Per run load (= load without any shedding) under relaxRatio*budget for relaxFrames frames -> back one level,
+ * so the controller does not oscillate between a level and the one that overran.
+ * Decide() is called once per frame (by the capture stage) and tells the other stages what to run.
+ */
+
+typedef enum {
+    BUDGET_SKIP_RENDER = 0,         // Render every other frame
+    BUDGET_ALTERNATE_OD_LD = 1,     // Object detector on even frames, lane detector on odd frames
+    BUDGET_LOWER_LANENET_RATE = 2,  // Lane detector every laneNetRateDivider-th frame
+    BUDGET_SHRINK_OD_ROI = 3        // DriveNet ROI scaled by odROIScale (same DriveNet cost, not in the default policy)
+}frameBudgetAction;
+
+typedef struct {
+    float frameBudgetMs = 33.f;     // Camera period
+    bool pipelined = true;
+    float emaAlpha = 0.1f;
+    int escalateFrames = 10;
+    int relaxFrames = 90;
+    float relaxRatio = 0.9f;
+    int laneNetRateDivider = 3;
+    float odROIScale = 0.6f;
+
+    // Degrade levels, applied cumulatively in this order
+    vector<frameBudgetAction> policy = {BUDGET_SKIP_RENDER,
+                                        BUDGET_ALTERNATE_OD_LD,
+                                        BUDGET_LOWER_LANENET_RATE};
+}frameBudgetParameters;
+
+typedef struct {
+    uint64_t seq = 0;
+    int level = 0;
+    bool runOD = true;
+    bool runLD = true;
+    bool render = true;
+    float odROIScale = 1.f;
+}frameBudgetDecision;
+
+class FrameBudgetController{
+public:
+    FrameBudgetController() : mLevel(0) {}
+
+    void SetParameters(frameBudgetParameters params);
+
+    // Stage ids are given in AddStage order, starting at 0
+    int AddStage(string name);
+
+    // Thread safe
+    void ReportStage(int stageId, double costMs, bool skipped = false);
+
+    frameBudgetDecision Decide(uint64_t seq);
+
+    // Any thread
+    int GetLevel() const { return mLevel.load(); }
+    double GetLoadMs();         // Per frame
+    double GetRunLoadMs();      // Per run
+
+    void PrintSummary();
+
+    static const char* GetActionName(frameBudgetAction action);
+
+private:
+    bool IsActive(frameBudgetAction action) const;
+    void LogLevelWindow(int newLevel);
+    double CombineStages(bool perRun) const;
+
+private:
+    frameBudgetParameters mParams;
+
+    typedef struct {
+        string name;
+        double emaMs = 0.0;
+        double runEmaMs = 0.0;
+        bool hasSample = false;
+        bool hasRunSample = false;
+    }stageCost;
+
+    mutex mMutex;
+    vector<stageCost> mStages;
+
+    atomic<int> mLevel;         // Written under mMutex
+    int mOverCount = 0;
+    int mUnderCount = 0;
+
+    uint64_t mNumFrames = 0;
+    uint64_t mNumLevelChanges = 0;
+    uint64_t mSkippedOD = 0;
+    uint64_t mSkippedLD = 0;
+    uint64_t mSkippedRender = 0;
+    uint64_t mShrunkOD = 0;
+
+    // Since the last level change
+    uint64_t mLevelFrames = 0;
+    uint64_t mLevelSkippedOD = 0;
+    uint64_t mLevelSkippedLD = 0;
+    uint64_t mLevelSkippedRender = 0;
+};
+
+#endif // FRAMEBUDGET_H
@@ -0,0 +1,177 @@
+#include "homography.h"
+
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static inline void ProjectPoint(const float* H, float x, float y, float& xOut, float& yOut)
+{
+    float w = H[6]*x + H[7]*y + H[8];
+    xOut = (H[0]*x + H[1]*y + H[2])/w;
+    yOut = (H[3]*x + H[4]*y + H[5])/w;
+}
+
+BatchHomography::BatchHomography()
+{
+    for(int i = 0; i < 9; i++)
+    {
+        mH[i] = (i%4 == 0) ? 1.f : 0.f;
+        mHinv[i] = mH[i];
+    }
+}
+
+bool BatchHomography::SetMatrix(const double* H)
+{
+    // Inverse by adjugate, in double
+    double adj[9];
+    adj[0] = H[4]*H[8] - H[5]*H[7];
+    adj[1] = H[2]*H[7] - H[1]*H[8];
+    adj[2] = H[1]*H[5] - H[2]*H[4];
+    adj[3] = H[5]*H[6] - H[3]*H[8];
+    adj[4] = H[0]*H[8] - H[2]*H[6];
+    adj[5] = H[2]*H[3] - H[0]*H[5];
+    adj[6] = H[3]*H[7] - H[4]*H[6];
+    adj[7] = H[1]*H[6] - H[0]*H[7];
+    adj[8] = H[0]*H[4] - H[1]*H[3];
+
+    double det = H[0]*adj[0] + H[1]*adj[3] + H[2]*adj[6];
+    if(fabs(det) < 1e-15)
+        return false;
+
+    for(int i = 0; i < 9; i++)
+    {
+        mH[i] = (float)H[i];
+        mHinv[i] = (float)(adj[i]/det);
+    }
+
+    return true;
+}
+
+void BatchHomography::Transform(const float* xIn, const float* yIn, float* xOut, float* yOut, uint32_t numPts) const
+{
+    ProjectSoA(mH, xIn, yIn, xOut, yOut, numPts);
+}
+
+void BatchHomography::InverseTransform(const float* xIn, const float* yIn, float* xOut, float* yOut, uint32_t numPts) const
+{
+    ProjectSoA(mHinv, xIn, yIn, xOut, yOut, numPts);
+}
+
+void BatchHomography::TransformInterleaved(const float* ptsIn, float* ptsOut, uint32_t numPts) const
+{
+    ProjectInterleaved(mH, ptsIn, ptsOut, numPts);
+}
+
+void BatchHomography::InverseTransformInterleaved(const float* ptsIn, float* ptsOut, uint32_t numPts) const
+{
+    ProjectInterleaved(mHinv, ptsIn, ptsOut, numPts);
+}
+
+void BatchHomography::ProjectSoA(const float* H, const float* xIn, const float* yIn, float* xOut, float* yOut, uint32_t numPts)
+{
+    uint32_t i = 0;
+
+#if defined(__AVX__)
+    const __m256 h0 = _mm256_set1_ps(H[0]), h1 = _mm256_set1_ps(H[1]), h2 = _mm256_set1_ps(H[2]);
+    const __m256 h3 = _mm256_set1_ps(H[3]), h4 = _mm256_set1_ps(H[4]), h5 = _mm256_set1_ps(H[5]);
+    const __m256 h6 = _mm256_set1_ps(H[6]), h7 = _mm256_set1_ps(H[7]), h8 = _mm256_set1_ps(H[8]);
+
+    for(; i + 8 <= numPts; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(xIn + i);
+        __m256 y = _mm256_loadu_ps(yIn + i);
+
+        __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h0, x), _mm256_mul_ps(h1, y)), h2);
+        __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h3, x), _mm256_mul_ps(h4, y)), h5);
+        __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h6, x), _mm256_mul_ps(h7, y)), h8);
+
+        _mm256_storeu_ps(xOut + i, _mm256_div_ps(u, w));
+        _mm256_storeu_ps(yOut + i, _mm256_div_ps(v, w));
+    }
+#elif defined(__SSE2__)
+    const __m128 h0 = _mm_set1_ps(H[0]), h1 = _mm_set1_ps(H[1]), h2 = _mm_set1_ps(H[2]);
+    const __m128 h3 = _mm_set1_ps(H[3]), h4 = _mm_set1_ps(H[4]), h5 = _mm_set1_ps(H[5]);
+    const __m128 h6 = _mm_set1_ps(H[6]), h7 = _mm_set1_ps(H[7]), h8 = _mm_set1_ps(H[8]);
+
+    for(; i + 4 <= numPts; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(xIn + i);
+        __m128 y = _mm_loadu_ps(yIn + i);
+
+        __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h0, x), _mm_mul_ps(h1, y)), h2);
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h3, x), _mm_mul_ps(h4, y)), h5);
+        __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h6, x), _mm_mul_ps(h7, y)), h8);
+
+        _mm_storeu_ps(xOut + i, _mm_div_ps(u, w));
+        _mm_storeu_ps(yOut + i, _mm_div_ps(v, w));
+    }
+#elif defined(__aarch64__)
+    for(; i + 4 <= numPts; i += 4)
+    {
+        float32x4_t x = vld1q_f32(xIn + i);
+        float32x4_t y = vld1q_f32(yIn + i);
+
+        float32x4_t u = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(H[2]), x, H[0]), y, H[1]);
+        float32x4_t v = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(H[5]), x, H[3]), y, H[4]);
+        float32x4_t w = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(H[8]), x, H[6]), y, H[7]);
+
+        vst1q_f32(xOut + i, vdivq_f32(u, w));
+        vst1q_f32(yOut + i, vdivq_f32(v, w));
+    }
+#endif
+
+    for(; i < numPts; i++)
+        ProjectPoint(H, xIn[i], yIn[i], xOut[i], yOut[i]);
+}
+
+void BatchHomography::ProjectInterleaved(const float* H, const float* ptsIn, float* ptsOut, uint32_t numPts)
+{
+    uint32_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 h0 = _mm_set1_ps(H[0]), h1 = _mm_set1_ps(H[1]), h2 = _mm_set1_ps(H[2]);
+    const __m128 h3 = _mm_set1_ps(H[3]), h4 = _mm_set1_ps(H[4]), h5 = _mm_set1_ps(H[5]);
+    const __m128 h6 = _mm_set1_ps(H[6]), h7 = _mm_set1_ps(H[7]), h8 = _mm_set1_ps(H[8]);
+
+    for(; i + 4 <= numPts; i += 4)
+    {
+        // x0 y0 x1 y1 | x2 y2 x3 y3 -> x0..x3, y0..y3
+        __m128 p01 = _mm_loadu_ps(ptsIn + 2*i);
+        __m128 p23 = _mm_loadu_ps(ptsIn + 2*i + 4);
+        __m128 x = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1));
+
+        __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h0, x), _mm_mul_ps(h1, y)), h2);
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h3, x), _mm_mul_ps(h4, y)), h5);
+        __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h6, x), _mm_mul_ps(h7, y)), h8);
+
+        __m128 xo = _mm_div_ps(u, w);
+        __m128 yo = _mm_div_ps(v, w);
+
+        _mm_storeu_ps(ptsOut + 2*i, _mm_unpacklo_ps(xo, yo));
+        _mm_storeu_ps(ptsOut + 2*i + 4, _mm_unpackhi_ps(xo, yo));
+    }
+#elif defined(__aarch64__)
+    for(; i + 4 <= numPts; i += 4)
+    {
+        float32x4x2_t pts = vld2q_f32(ptsIn + 2*i);
+        float32x4_t x = pts.val[0];
+        float32x4_t y = pts.val[1];
+
+        float32x4_t u = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(H[2]), x, H[0]), y, H[1]);
+        float32x4_t v = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(H[5]), x, H[3]), y, H[4]);
+        float32x4_t w = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(H[8]), x, H[6]), y, H[7]);
+
+        pts.val[0] = vdivq_f32(u, w);
+        pts.val[1] = vdivq_f32(v, w);
+        vst2q_f32(ptsOut + 2*i, pts);
+    }
+#endif
+
+    for(; i < numPts; i++)
+        ProjectPoint(H, ptsIn[2*i], ptsIn[2*i + 1], ptsOut[2*i], ptsOut[2*i + 1]);
+}
@@ -0,0 +1,38 @@
+#ifndef HOMOGRAPHY_H
+#define HOMOGRAPHY_H
+
+#include <cstdint>
+
+/**
+ * Batched projective transform of 2D point sets (e.g. rectified image <-> top-view).
+ * AVX / SSE2 on x86, NEON on aarch64 (Tegra), scalar otherwise. No CUDA / Driveworks dependency.
+ *
+ * SoA : separate x and y arrays.
+ * Interleaved : x0 y0 x1 y1 ... (same layout as dwVector2f / cv::Point2f arrays), in/out may be the same buffer.
+ */
+class BatchHomography{
+public:
+    BatchHomography();
+
+    // Row major 3x3 matrix, the inverse is computed here
+    bool SetMatrix(const double* H);
+
+    const float* GetMatrix() const { return mH; }
+    const float* GetInverseMatrix() const { return mHinv; }
+
+    void Transform(const float* xIn, const float* yIn, float* xOut, float* yOut, uint32_t numPts) const;
+    void InverseTransform(const float* xIn, const float* yIn, float* xOut, float* yOut, uint32_t numPts) const;
+
+    void TransformInterleaved(const float* ptsIn, float* ptsOut, uint32_t numPts) const;
+    void InverseTransformInterleaved(const float* ptsIn, float* ptsOut, uint32_t numPts) const;
+
+    // Kernels for an arbitrary matrix
+    static void ProjectSoA(const float* H, const float* xIn, const float* yIn, float* xOut, float* yOut, uint32_t numPts);
+    static void ProjectInterleaved(const float* H, const float* ptsIn, float* ptsOut, uint32_t numPts);
+
+private:
+    float mH[9];
+    float mHinv[9];
+};
+
+#endif // HOMOGRAPHY_H
@@ -0,0 +1,226 @@
+#include "laneDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Returns the first index in [start, width) whose value is above thres, or width if there is none.
+// Most of a lane probability map is background, so skipping it vector-wise is where the time goes.
+static inline int FindFirstAbove(const float* rowData, int start, int width, float thres)
+{
+    int x = start;
+
+#if defined(__AVX__)
+    const __m256 thres8 = _mm256_set1_ps(thres);
+    for(; x + 8 <= width; x += 8)
+    {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(rowData + x), thres8, _CMP_GT_OQ));
+        if(mask)
+            return x + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128 thres4 = _mm_set1_ps(thres);
+    for(; x + 4 <= width; x += 4)
+    {
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(rowData + x), thres4));
+        if(mask)
+            return x + __builtin_ctz(mask);
+    }
+#elif defined(__aarch64__)
+    const float32x4_t thres4 = vdupq_n_f32(thres);
+    for(; x + 4 <= width; x += 4)
+    {
+        uint32x4_t cmp = vcgtq_f32(vld1q_f32(rowData + x), thres4);
+        if(vmaxvq_u32(cmp))
+            break;
+    }
+#endif
+
+    for(; x < width; x++)
+    {
+        if(rowData[x] > thres)
+            return x;
+    }
+
+    return width;
+}
+
+void LaneSegDecoder::SetParameters(laneDecoderParameters params)
+{
+    mParams = params;
+}
+
+laneDecoderParameters LaneSegDecoder::GetParameters() const
+{
+    return mParams;
+}
+
+int LaneSegDecoder::ExtractRowPeaks(const float* rowData, int mapWidth, float* peakX, float* peakProb, int maxPeaks) const
+{
+    int numPeaks = 0;
+    int x = FindFirstAbove(rowData, 0, mapWidth, mParams.probThres);
+
+    while((x < mapWidth) && (numPeaks < maxPeaks))
+    {
+        float probSum = 0.f;
+        float weightedXSum = 0.f;
+        float probMax = 0.f;
+
+        int runStart = x;
+        for(; (x < mapWidth) && (rowData[x] > mParams.probThres); x++)
+        {
+            probSum += rowData[x];
+            weightedXSum += rowData[x]*(float)x;
+            probMax = max(probMax, rowData[x]);
+        }
+
+        int runWidth = x - runStart;
+        if((runWidth >= mParams.minPeakWidth) && (runWidth <= mParams.maxPeakWidth))
+        {
+            peakX[numPeaks] = weightedXSum/probSum;
+            peakProb[numPeaks] = probMax;
+            numPeaks++;
+        }
+
+        x = FindFirstAbove(rowData, x, mapWidth, mParams.probThres);
+    }
+
+    return numPeaks;
+}
+
+void LaneSegDecoder::Decode(const float* probMap, int mapWidth, int mapHeight, vector<laneInstance>& outputLanes)
+{
+    outputLanes.clear();
+    mActiveTracks.clear();
+
+    // At most one peak per minPeakWidth pixels
+    int maxPeaks = mapWidth/max(mParams.minPeakWidth, 1) + 1;
+    mPeakX.resize(maxPeaks);
+    mPeakProb.resize(maxPeaks);
+    mPeakUsed.resize(maxPeaks);
+
+    int rowStep = max(mParams.rowStep, 1);
+
+    for(int y = mapHeight - 1; y >= 0; y -= rowStep)
+    {
+        int numPeaks = ExtractRowPeaks(probMap + (size_t)y*mapWidth, mapWidth, &mPeakX[0], &mPeakProb[0], maxPeaks);
+
+        LinkPeaks((float)y, &mPeakX[0], &mPeakProb[0], numPeaks);
+
+        for(uint trackIdx = 0; trackIdx < mActiveTracks.size();)
+        {
+            if(mActiveTracks[trackIdx].missedRows > mParams.maxRowGap)
+            {
+                CloseTrack(mActiveTracks[trackIdx], outputLanes);
+                mActiveTracks.erase(mActiveTracks.begin() + trackIdx);
+            }
+            else
+            {
+                trackIdx++;
+            }
+        }
+    }
+
+    for(uint trackIdx = 0; trackIdx < mActiveTracks.size(); trackIdx++)
+    {
+        CloseTrack(mActiveTracks[trackIdx], outputLanes);
+    }
+    mActiveTracks.clear();
+
+    // Keep the longest lanes, then order them from left to right (by bottom point)
+    if((int)outputLanes.size() > mParams.maxLanes)
+    {
+        sort(outputLanes.begin(), outputLanes.end(),
+             [](const laneInstance& a, const laneInstance& b) { return a.pts.size() > b.pts.size(); });
+        outputLanes.resize(mParams.maxLanes);
+    }
+
+    sort(outputLanes.begin(), outputLanes.end(),
+         [](const laneInstance& a, const laneInstance& b) { return a.pts[0].x < b.pts[0].x; });
+}
+
+void LaneSegDecoder::LinkPeaks(float y, const float* peakX, const float* peakProb, int numPeaks)
+{
+    for(int peakIdx = 0; peakIdx < numPeaks; peakIdx++)
+        mPeakUsed[peakIdx] = 0;
+
+    uint numTracks = mActiveTracks.size();
+    mTrackUsed.assign(numTracks, 0);
+
+    // Greedy nearest-first matching between active lanes and the peaks of this row
+    while(true)
+    {
+        float bestDx = INFINITY;
+        int bestTrack = -1;
+        int bestPeak = -1;
+
+        for(uint trackIdx = 0; trackIdx < numTracks; trackIdx++)
+        {
+            if(mTrackUsed[trackIdx])
+                continue;
+
+            const laneTrack& track = mActiveTracks[trackIdx];
+            float maxDx = mParams.maxLinkDx*(float)(track.missedRows + 1);
+
+            for(int peakIdx = 0; peakIdx < numPeaks; peakIdx++)
+            {
+                if(mPeakUsed[peakIdx])
+                    continue;
+
+                float dx = fabs(peakX[peakIdx] - track.lastX);
+                if((dx <= maxDx) && (dx < bestDx))
+                {
+                    bestDx = dx;
+                    bestTrack = trackIdx;
+                    bestPeak = peakIdx;
+                }
+            }
+        }
+
+        if(bestTrack < 0)
+            break;
+
+        laneTrack& track = mActiveTracks[bestTrack];
+        track.lane.pts.push_back(laneMapPoint{peakX[bestPeak], y});
+        track.lastX = peakX[bestPeak];
+        track.missedRows = 0;
+        track.probSum += peakProb[bestPeak];
+
+        mTrackUsed[bestTrack] = 1;
+        mPeakUsed[bestPeak] = 1;
+    }
+
+    for(uint trackIdx = 0; trackIdx < numTracks; trackIdx++)
+    {
+        if(!mTrackUsed[trackIdx])
+            mActiveTracks[trackIdx].missedRows++;
+    }
+
+    // Unmatched peaks start new lanes
+    for(int peakIdx = 0; peakIdx < numPeaks; peakIdx++)
+    {
+        if(mPeakUsed[peakIdx])
+            continue;
+
+        laneTrack track;
+        track.lane.pts.push_back(laneMapPoint{peakX[peakIdx], y});
+        track.lastX = peakX[peakIdx];
+        track.missedRows = 0;
+        track.probSum = peakProb[peakIdx];
+        mActiveTracks.push_back(track);
+    }
+}
+
+void LaneSegDecoder::CloseTrack(laneTrack& track, vector<laneInstance>& outputLanes)
+{
+    if((int)track.lane.pts.size() < mParams.minLanePts)
+        return;
+
+    track.lane.confidence = track.probSum/(float)track.lane.pts.size();
+    outputLanes.push_back(track.lane);
+}
@@ -0,0 +1,73 @@
+#ifndef LANEDECODER_H
+#define LANEDECODER_H
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Host decoder for per-pixel lane probability maps (output of the custom lane segmentation network).
+ * No CUDA / Driveworks dependency, so it can be run and checked on any machine.
+ *
+ * Pipeline : threshold -> row-wise peak extraction -> lane instance grouping (row to row linking)
+ * All coordinates are in probability map pixels.
+ */
+
+typedef struct {
+    float probThres = 0.5f;     // Pixels above this probability belong to a lane
+    int rowStep = 4;            // Decode every rowStep-th row (from the bottom of the map)
+    int minPeakWidth = 2;       // Minimum run length(px) of a lane peak
+    int maxPeakWidth = 40;      // Runs wider than this are not lane markings
+    float maxLinkDx = 12.f;     // Maximum x jump(px) between two consecutive decoded rows of one lane
+    int maxRowGap = 6;          // A lane is closed after this many decoded rows without a new peak
+    int minLanePts = 6;         // Lanes with fewer points are discarded
+    int maxLanes = 8;
+}laneDecoderParameters;
+
+typedef struct {
+    float x;
+    float y;
+}laneMapPoint;
+
+typedef struct {
+    vector<laneMapPoint> pts;   // Ordered from the bottom of the map to the top
+    float confidence = 0.f;     // Mean peak probability
+}laneInstance;
+
+class LaneSegDecoder{
+public:
+    LaneSegDecoder() {}
+    ~LaneSegDecoder() {}
+
+    void SetParameters(laneDecoderParameters params);
+    laneDecoderParameters GetParameters() const;
+
+    // probMap : row major, mapWidth x mapHeight, row pitch = mapWidth
+    void Decode(const float* probMap, int mapWidth, int mapHeight, vector<laneInstance>& outputLanes);
+
+    // Row-wise peak extraction of one map row (weighted centroid of each above-threshold run)
+    int ExtractRowPeaks(const float* rowData, int mapWidth, float* peakX, float* peakProb, int maxPeaks) const;
+
+private:
+    typedef struct {
+        laneInstance lane;
+        float lastX;
+        int missedRows;
+        float probSum;
+    }laneTrack;
+
+    void LinkPeaks(float y, const float* peakX, const float* peakProb, int numPeaks);
+    void CloseTrack(laneTrack& track, vector<laneInstance>& outputLanes);
+
+private:
+    laneDecoderParameters mParams;
+
+    vector<laneTrack> mActiveTracks;
+    vector<float> mPeakX;
+    vector<float> mPeakProb;
+    vector<uint8_t> mPeakUsed;
+    vector<uint8_t> mTrackUsed;
+};
+
+#endif // LANEDECODER_H
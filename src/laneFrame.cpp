@@ -0,0 +1,78 @@
+#include "laneFrame.h"
+
+#include <cstring>
+
+LaneFrame::LaneFrame()
+{
+    Clear();
+}
+
+void LaneFrame::Clear()
+{
+    timestamp_us = 0;
+    numLanes = 0;
+    numPts = 0;
+}
+
+bool LaneFrame::AddLane(const dwVector2f* pts, uint32_t numLanePts,
+                        dwLanePositionType position, dwLaneMarkingType type,
+                        float32_t confidence, dwVector4f color)
+{
+    if((numLanes >= LANE_FRAME_MAX_LANES) || (numPts + numLanePts > LANE_FRAME_MAX_POINTS))
+        return false;
+
+    laneFrameLane& lane = lanes[numLanes];
+    lane.ptOffset = numPts;
+    lane.numPts = numLanePts;
+    lane.numTopviewPts = 0;
+    lane.position = position;
+    lane.type = type;
+    lane.confidence = confidence;
+    lane.color = color;
+    lane.fitValid = false;
+    lane.minY = 0.f;
+    lane.maxY = 0.f;
+
+    memcpy(&imagePts[numPts], pts, numLanePts*sizeof(dwVector2f));
+
+    numPts += numLanePts;
+    numLanes++;
+
+    return true;
+}
+
+const char* LaneFrame::GetPositionName(dwLanePositionType position)
+{
+    switch(position)
+    {
+    case DW_LANEMARK_POSITION_ADJACENT_LEFT:
+        return "LEFT-LEFT";
+    case DW_LANEMARK_POSITION_EGO_LEFT:
+        return "LEFT";
+    case DW_LANEMARK_POSITION_EGO_RIGHT:
+        return "RIGHT";
+    case DW_LANEMARK_POSITION_ADJACENT_RIGHT:
+        return "RIGHT-RIGHT";
+    case DW_LANEMARK_POSITION_UNDEFINED:
+        return "UNKNOWN";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+const char* LaneFrame::GetTypeName(dwLaneMarkingType type)
+{
+    switch(type)
+    {
+    case DW_LANEMARK_TYPE_SOLID:
+        return "SOLID";
+    case DW_LANEMARK_TYPE_DASHED:
+        return "DASHED";
+    case DW_LANEMARK_TYPE_ROAD_BOUNDARY:
+        return "ROAD_BOUNDARY";
+    case DW_LANEMARK_TYPE_UNDEFINED:
+        return "UNKNOWN";
+    default:
+        return "UNKNOWN";
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef LANEFRAME_H
+#define LANEFRAME_H
+
+#include <dw/core/Types.h>
+#include <dw/laneperception/LaneDetector.h>
+
+#include <cstdint>
+
+#define LANE_FRAME_MAX_LANES 16
+#define LANE_FRAME_MAX_POINTS 4096
+#define LANE_FRAME_POLY_ORDER 3
+
+/**
+ * Lane detection result of one frame, reused from frame to frame without any heap allocation.
+ *
+ * All lanes share one point buffer (imagePts), each lane keeps its offset and count.
+ * topviewPts is filled by the rectify stage at the same offsets (invalid points are dropped, so numTopviewPts <= numPts),
+ * then converted to top-view and fitted in place. See px2LD::RectifyLaneFrame / TopviewLaneFrame / FitLaneFrame.
+ */
+
+typedef struct {
+    uint32_t ptOffset;
+    uint32_t numPts;
+    uint32_t numTopviewPts;
+
+    dwLanePositionType position;
+    dwLaneMarkingType type;
+    float32_t confidence;
+    dwVector4f color;
+
+    // x = c0 + c1*y + c2*y^2 + c3*y^3 in the top-view, valid in [minY, maxY]
+    bool fitValid;
+    float32_t fitCoeffs[LANE_FRAME_POLY_ORDER + 1];
+    float32_t minY;
+    float32_t maxY;
+}laneFrameLane;
+
+class LaneFrame{
+public:
+    LaneFrame();
+
+    void Clear();
+
+    // Returns false (and adds nothing) if the lane or point capacity is exceeded
+    bool AddLane(const dwVector2f* pts, uint32_t numPts,
+                 dwLanePositionType position, dwLaneMarkingType type,
+                 float32_t confidence, dwVector4f color);
+
+    const dwVector2f* GetImagePts(uint32_t laneIdx) const { return &imagePts[lanes[laneIdx].ptOffset]; }
+    dwVector2f* GetTopviewPts(uint32_t laneIdx) { return &topviewPts[lanes[laneIdx].ptOffset]; }
+    const dwVector2f* GetTopviewPts(uint32_t laneIdx) const { return &topviewPts[lanes[laneIdx].ptOffset]; }
+
+    static const char* GetPositionName(dwLanePositionType position);
+    static const char* GetTypeName(dwLaneMarkingType type);
+
+public:
+    uint64_t timestamp_us = 0;
+
+    uint32_t numLanes = 0;
+    laneFrameLane lanes[LANE_FRAME_MAX_LANES];
+
+    uint32_t numPts = 0;
+    dwVector2f imagePts[LANE_FRAME_MAX_POINTS];
+    dwVector2f topviewPts[LANE_FRAME_MAX_POINTS];
+};
+
+#endif // LANEFRAME_H
@@ -0,0 +1,248 @@
+#include "px2arena.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+void* HostArenaAllocator::Allocate(size_t bytes, size_t alignment, string& error)
+{
+    if((mLimitBytes > 0) && (mAllocatedBytes + bytes > mLimitBytes))
+    {
+        error = "host mock limit reached";
+        return nullptr;
+    }
+
+    void* ptr = nullptr;
+    if(posix_memalign(&ptr, max<size_t>(alignment, sizeof(void*)), max<size_t>(bytes, 1)) != 0)
+    {
+        error = "posix_memalign failed";
+        return nullptr;
+    }
+
+    mAllocations.push_back(make_pair(ptr, bytes));
+    mNumAllocations++;
+    mAllocatedBytes += bytes;
+    mPeakAllocatedBytes = max(mPeakAllocatedBytes, mAllocatedBytes);
+
+    return ptr;
+}
+
+void HostArenaAllocator::Free(void* ptr)
+{
+    for(size_t allocIdx = 0; allocIdx < mAllocations.size(); allocIdx++)
+    {
+        if(mAllocations[allocIdx].first == ptr)
+        {
+            mAllocatedBytes -= mAllocations[allocIdx].second;
+            mAllocations.erase(mAllocations.begin() + allocIdx);
+            free(ptr);
+            return;
+        }
+    }
+}
+
+DeviceArena::DeviceArena(arenaAllocator* allocator)
+    : mAllocator(allocator)
+{
+}
+
+DeviceArena::~DeviceArena()
+{
+    Release();
+}
+
+size_t DeviceArena::AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+arenaBufferId DeviceArena::Request(const string& module, const string& name, size_t bytes, size_t alignment,
+                                   uint32_t firstStep, uint32_t lastStep)
+{
+    // Power of 2, at least 1
+    size_t powerOf2 = 1;
+    while(powerOf2 < alignment)
+        powerOf2 <<= 1;
+
+    arenaBuffer buffer;
+    buffer.module = module;
+    buffer.name = name;
+    buffer.bytes = bytes;
+    buffer.alignment = powerOf2;
+    buffer.firstStep = min(firstStep, lastStep);
+    buffer.lastStep = max(firstStep, lastStep);
+    buffer.blockIdx = -1;
+    buffer.offset = 0;
+
+    mBuffers.push_back(buffer);
+
+    return mBuffers.size() - 1;
+}
+
+// Greedy by size : largest buffers first, each at the lowest offset which does not overlap
+// a placed buffer alive at the same time. Returns the block size.
+size_t DeviceArena::PlanPending(const vector<arenaBufferId>& pendingIds)
+{
+    vector<arenaBufferId> order = pendingIds;
+    stable_sort(order.begin(), order.end(), [this](arenaBufferId a, arenaBufferId b)
+    {
+        return mBuffers[a].bytes > mBuffers[b].bytes;
+    });
+
+    vector<arenaBufferId> placed;
+    size_t blockBytes = 0;
+
+    for(arenaBufferId bufferId : order)
+    {
+        arenaBuffer& buffer = mBuffers[bufferId];
+
+        // Placed buffers alive with this one, by offset
+        vector<arenaBufferId> conflicts;
+        for(arenaBufferId placedId : placed)
+        {
+            const arenaBuffer& other = mBuffers[placedId];
+            if((other.firstStep <= buffer.lastStep) && (buffer.firstStep <= other.lastStep))
+                conflicts.push_back(placedId);
+        }
+        sort(conflicts.begin(), conflicts.end(), [this](arenaBufferId a, arenaBufferId b)
+        {
+            return mBuffers[a].offset < mBuffers[b].offset;
+        });
+
+        size_t offset = 0;
+        for(arenaBufferId conflictId : conflicts)
+        {
+            const arenaBuffer& other = mBuffers[conflictId];
+            if(offset + buffer.bytes <= other.offset)
+                break;
+            offset = max(offset, AlignUp(other.offset + other.bytes, buffer.alignment));
+        }
+
+        buffer.offset = offset;
+        placed.push_back(bufferId);
+        blockBytes = max(blockBytes, offset + buffer.bytes);
+    }
+
+    return blockBytes;
+}
+
+bool DeviceArena::Commit()
+{
+    vector<arenaBufferId> pendingIds;
+    size_t blockAlignment = 256;
+    for(arenaBufferId bufferId = 0; bufferId < mBuffers.size(); bufferId++)
+    {
+        if(mBuffers[bufferId].blockIdx < 0)
+        {
+            pendingIds.push_back(bufferId);
+            blockAlignment = max(blockAlignment, mBuffers[bufferId].alignment);
+        }
+    }
+
+    if(pendingIds.empty())
+        return true;
+
+    size_t blockBytes = PlanPending(pendingIds);
+
+    string error;
+    void* ptr = mAllocator->Allocate(max<size_t>(blockBytes, 1), blockAlignment, error);
+    if(!ptr)
+    {
+        cout << "[ARENA] Cannot allocate " << blockBytes << " bytes (" << mAllocator->GetName() << ") : " << error << endl;
+        return false;
+    }
+
+    arenaBlock block;
+    block.ptr = ptr;
+    block.bytes = blockBytes;
+    mBlocks.push_back(block);
+
+    for(arenaBufferId bufferId : pendingIds)
+        mBuffers[bufferId].blockIdx = mBlocks.size() - 1;
+
+    mReservedBytes += blockBytes;
+    mPeakReservedBytes = max(mPeakReservedBytes, mReservedBytes);
+
+    return true;
+}
+
+void* DeviceArena::GetPtr(arenaBufferId bufferId) const
+{
+    if((bufferId >= mBuffers.size()) || (mBuffers[bufferId].blockIdx < 0))
+        return nullptr;
+
+    const arenaBuffer& buffer = mBuffers[bufferId];
+    return static_cast<uint8_t*>(mBlocks[buffer.blockIdx].ptr) + buffer.offset;
+}
+
+size_t DeviceArena::GetOffset(arenaBufferId bufferId) const
+{
+    return (bufferId < mBuffers.size()) ? mBuffers[bufferId].offset : 0;
+}
+
+void DeviceArena::Release()
+{
+    for(arenaBlock& block : mBlocks)
+        mAllocator->Free(block.ptr);
+
+    mBlocks.clear();
+    mBuffers.clear();
+    mReservedBytes = 0;
+}
+
+arenaReport DeviceArena::GetReport() const
+{
+    arenaReport report;
+    report.numBlocks = mBlocks.size();
+    report.reservedBytes = mReservedBytes;
+    report.peakReservedBytes = mPeakReservedBytes;
+
+    for(const arenaBuffer& buffer : mBuffers)
+    {
+        if(buffer.blockIdx < 0)
+            continue;
+
+        report.requestedBytes += buffer.bytes;
+
+        auto usage = find_if(report.modules.begin(), report.modules.end(),
+                             [&buffer](const arenaModuleUsage& entry){ return entry.module == buffer.module; });
+        if(usage == report.modules.end())
+        {
+            arenaModuleUsage entry;
+            entry.module = buffer.module;
+            report.modules.push_back(entry);
+            usage = report.modules.end() - 1;
+        }
+
+        usage->numBuffers++;
+        usage->requestedBytes += buffer.bytes;
+    }
+
+    return report;
+}
+
+void DeviceArena::PrintReport() const
+{
+    arenaReport report = GetReport();
+
+    printf("[ARENA] %s, %u blocks : reserved %.2fMB (peak %.2fMB), requested %.2fMB\n",
+           mAllocator->GetName(), report.numBlocks, report.reservedBytes/1048576.0,
+           report.peakReservedBytes/1048576.0, report.requestedBytes/1048576.0);
+
+    for(const arenaModuleUsage& usage : report.modules)
+        printf("[ARENA]   %-8s %3u buffers %8.2fMB\n", usage.module.c_str(), usage.numBuffers, usage.requestedBytes/1048576.0);
+
+    for(const arenaBuffer& buffer : mBuffers)
+    {
+        if(buffer.blockIdx < 0)
+            continue;
+
+        printf("[ARENA]     %-8s %-24s block %d offset %10zu size %10zu steps %u-", buffer.module.c_str(), buffer.name.c_str(),
+               buffer.blockIdx, buffer.offset, buffer.bytes, buffer.firstStep);
+        if(buffer.lastStep == ARENA_LIFETIME_FOREVER)
+            printf("end\n");
+        else
+            printf("%u\n", buffer.lastStep);
+    }
+}
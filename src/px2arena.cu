@@ -0,0 +1,39 @@
+#include "px2arena.h"
+
+#include <cuda_runtime.h>
+
+class CudaArenaAllocator : public arenaAllocator{
+public:
+    // cudaMalloc memory is aligned to 256 bytes at least
+    void* Allocate(size_t bytes, size_t alignment, string& error)
+    {
+        if(alignment > 256)
+        {
+            error = "alignment over 256 bytes";
+            return nullptr;
+        }
+
+        void* ptr = nullptr;
+        cudaError_t status = cudaMalloc(&ptr, bytes);
+        if(status != cudaSuccess)
+        {
+            error = cudaGetErrorString(status);
+            return nullptr;
+        }
+
+        return ptr;
+    }
+
+    void Free(void* ptr)
+    {
+        cudaFree(ptr);
+    }
+
+    const char* GetName() const { return "cuda"; }
+};
+
+arenaAllocator* GetCudaArenaAllocator()
+{
+    static CudaArenaAllocator allocator;
+    return &allocator;
+}
@@ -0,0 +1,135 @@
+#ifndef PX2ARENA_H
+#define PX2ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Device memory arena with named sub-allocations.
+ *
+ * Modules request their buffers (size, alignment, lifetime), then Commit() plans the pending requests
+ * and makes one allocation for all of them (a block). Every Commit() makes a new block, so modules initialized
+ * one after the other share the arena.
+ * A lifetime is the range of steps of the module frame processing where the buffer is used :
+ * buffers whose lifetimes do not overlap may share memory (greedy by size placement).
+ * Buffers are only valid after Commit() and all of them are freed by Release().
+ *
+ *    arenaBufferId pitchedId = arena.Request("cam", "pitchedRGBA", size, 256, CAM_STEP_COPY, CAM_STEP_CONVERT);
+ *    arena.Commit();
+ *    uint8_t* pitched = arena.Get<uint8_t>(pitchedId);
+ *
+ * The allocation itself goes to an arenaAllocator : CUDA device memory on target, or a host mock
+ * to run the planning off-target.
+ */
+
+typedef uint32_t arenaBufferId;
+
+#define ARENA_LIFETIME_FOREVER 0xFFFFFFFFu
+
+class arenaAllocator{
+public:
+    virtual ~arenaAllocator() {}
+
+    // Null on failure, with the reason in error
+    virtual void* Allocate(size_t bytes, size_t alignment, string& error) = 0;
+    virtual void Free(void* ptr) = 0;
+    virtual const char* GetName() const = 0;
+};
+
+// cudaMalloc / cudaFree (px2arena.cu)
+arenaAllocator* GetCudaArenaAllocator();
+
+// Aligned host memory, records the allocations (planning tests without a GPU)
+class HostArenaAllocator : public arenaAllocator{
+public:
+    void* Allocate(size_t bytes, size_t alignment, string& error);
+    void Free(void* ptr);
+    const char* GetName() const { return "host"; }
+
+    uint32_t GetNumAllocations() const { return mNumAllocations; }
+    size_t GetAllocatedBytes() const { return mAllocatedBytes; }
+    size_t GetPeakAllocatedBytes() const { return mPeakAllocatedBytes; }
+
+    // Next allocations over this total fail, 0 : no limit (out of memory tests)
+    void SetLimit(size_t limitBytes) { mLimitBytes = limitBytes; }
+
+private:
+    vector<pair<void*, size_t> > mAllocations;
+    uint32_t mNumAllocations = 0;
+    size_t mAllocatedBytes = 0;
+    size_t mPeakAllocatedBytes = 0;
+    size_t mLimitBytes = 0;
+};
+
+typedef struct {
+    string module;
+    uint32_t numBuffers = 0;
+    size_t requestedBytes = 0;      // Sum of its buffer sizes
+}arenaModuleUsage;
+
+typedef struct {
+    uint32_t numBlocks = 0;
+    size_t requestedBytes = 0;      // Sum of all buffer sizes
+    size_t reservedBytes = 0;       // Allocated blocks (aliasing saves requested - reserved, minus the alignment padding)
+    size_t peakReservedBytes = 0;
+    vector<arenaModuleUsage> modules;
+}arenaReport;
+
+class DeviceArena{
+public:
+    explicit DeviceArena(arenaAllocator* allocator);
+    ~DeviceArena();
+
+    // Pending until the next Commit(), alignment : power of 2
+    arenaBufferId Request(const string& module, const string& name, size_t bytes, size_t alignment = 256,
+                          uint32_t firstStep = 0, uint32_t lastStep = ARENA_LIFETIME_FOREVER);
+
+    // Plans and allocates the pending requests, false (nothing allocated) on allocation failure
+    bool Commit();
+
+    // Null if not committed (or failed)
+    void* GetPtr(arenaBufferId bufferId) const;
+
+    template<typename T>
+    T* Get(arenaBufferId bufferId) const { return static_cast<T*>(GetPtr(bufferId)); }
+
+    size_t GetOffset(arenaBufferId bufferId) const;
+
+    void Release();
+
+    arenaReport GetReport() const;
+    void PrintReport() const;
+
+private:
+    typedef struct {
+        string module;
+        string name;
+        size_t bytes;
+        size_t alignment;
+        uint32_t firstStep;
+        uint32_t lastStep;
+        int32_t blockIdx;       // -1 : pending
+        size_t offset;
+    }arenaBuffer;
+
+    typedef struct {
+        void* ptr;
+        size_t bytes;
+    }arenaBlock;
+
+    static size_t AlignUp(size_t value, size_t alignment);
+    size_t PlanPending(const vector<arenaBufferId>& pendingIds);
+
+private:
+    arenaAllocator* mAllocator;
+    vector<arenaBuffer> mBuffers;
+    vector<arenaBlock> mBlocks;
+    size_t mReservedBytes = 0;
+    size_t mPeakReservedBytes = 0;
+};
+
+#endif // PX2ARENA_H
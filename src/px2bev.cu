@@ -0,0 +1,149 @@
+#include "px2bev.h"
+
+px2BEV::px2BEV(px2Cam* _px2Cam)
+{
+    mPx2Cam = _px2Cam;
+
+    // Reads GetOriGpuMatImgData()
+    mPx2Cam->RequestRGBAFrame();
+}
+
+bool px2BEV::Init(bevParameters bevParams, string invRectMapFilePath, string ipmMatrixFilePath)
+{
+    if(!LoadCalibration(bevParams, invRectMapFilePath, ipmMatrixFilePath))
+        return false;
+
+    return InitDevice();
+}
+
+bool px2BEV::LoadCalibration(bevParameters bevParams, string invRectMapFilePath, string ipmMatrixFilePath)
+{
+    mBEVParams = bevParams;
+    mWidth = (int)roundf((mBEVParams.xMax - mBEVParams.xMin)/mBEVParams.resolution);
+    mHeight = (int)roundf((mBEVParams.yMax - mBEVParams.yMin)/mBEVParams.resolution);
+
+    if((mWidth <= 0) || (mHeight <= 0))
+    {
+        cout << "[BEV_INIT] Invalid metric grid" << endl;
+        return false;
+    }
+
+    cv::Mat invMap1, invMap2, ipmMat;
+
+    cv::FileStorage fs(invRectMapFilePath, cv::FileStorage::READ);
+    fs["invMap1"] >> invMap1;
+    fs["invMap2"] >> invMap2;
+    fs.release();
+
+    cv::FileStorage fs2(ipmMatrixFilePath, cv::FileStorage::READ);
+    fs2["ipmMat"] >> ipmMat;
+    fs2.release();
+
+    if(ipmMat.empty())
+    {
+        cout << "[BEV_INIT] Cannot read IPM matrix : " << ipmMatrixFilePath << endl;
+        return false;
+    }
+
+    // Rectified image is assumed to have the camera resolution
+    cv::Mat rect2DistMap;
+    if(!BuildRect2DistMap(invMap1, invMap2, CAM_IMG_WIDTH, CAM_IMG_HEIGHT, rect2DistMap))
+        return false;
+
+    // ipmMat : rectified -> top-view, so the BEV needs its inverse
+    cv::Mat topview2Rect = ipmMat.inv();
+    const double* Hinv = topview2Rect.ptr<double>(0);
+
+    // The homogeneous scale of ground points in front of the camera has one sign (it depends on the ipmMat scale),
+    // points with the other sign are behind the camera and would be mirrored into the image
+    double refW = Hinv[6]*0.5*(mBEVParams.xMin + mBEVParams.xMax) + Hinv[7]*mBEVParams.yMax + Hinv[8];
+
+    mRemapTable.create(mHeight, mWidth, CV_32FC2);
+
+    int numValid = 0;
+    for(int v = 0; v < mHeight; v++)
+    {
+        for(int u = 0; u < mWidth; u++)
+        {
+            float xWorld, yWorld;
+            Pixel2Metric(u, v, xWorld, yWorld);
+
+            cv::Vec2f& srcCoord = mRemapTable.at<cv::Vec2f>(v,u);
+            srcCoord = cv::Vec2f(-1.f, -1.f);
+
+            double w = Hinv[6]*xWorld + Hinv[7]*yWorld + Hinv[8];
+            if(w*refW <= 0.0)
+                continue;
+
+            float rectX = (Hinv[0]*xWorld + Hinv[1]*yWorld + Hinv[2])/w;
+            float rectY = (Hinv[3]*xWorld + Hinv[4]*yWorld + Hinv[5])/w;
+
+            float distX, distY;
+            if(SampleRemapTable(rect2DistMap, rectX, rectY, distX, distY))
+            {
+                srcCoord = cv::Vec2f(distX, distY);
+                numValid++;
+            }
+        }
+    }
+
+    cout << "[BEV_INIT] " << mWidth << "x" << mHeight << " BEV, "
+         << numValid*100/(mWidth*mHeight) << "% of the grid is visible" << endl;
+
+    return true;
+}
+
+bool px2BEV::InitDevice()
+{
+    return mRemap.Init(mRemapTable);
+}
+
+void px2BEV::Generate(cudaStream_t stream)
+{
+    gpuMatImgData camImg = mPx2Cam->GetOriGpuMatImgData();
+
+    mRemap.Apply(camImg.gpuMatImg, mBEVGpuMat, stream);
+    mBEVStream = stream;
+    mBEVTimestamp = camImg.timestamp_us;
+}
+
+void px2BEV::GenerateHost(const cv::Mat& camImg, cv::Mat& bevImg)
+{
+    RemapBGRHost(camImg, mRemapTable, bevImg);
+}
+
+gpuMatImgData px2BEV::GetBEVGpuMatImgData()
+{
+    gpuMatImgData bevData;
+    bevData.timestamp_us = mBEVTimestamp;
+    bevData.gpuMatImg = mBEVGpuMat;
+    return bevData;
+}
+
+matImgData px2BEV::GetBEVMatImgData()
+{
+    // Ordered after the remap kernel, one synchronization
+    mBEVMat.create(mBEVGpuMat.rows, mBEVGpuMat.cols, mBEVGpuMat.type());
+    CHECK_CUDA_ERROR(cudaMemcpy2DAsync(mBEVMat.data, mBEVMat.step, mBEVGpuMat.data, mBEVGpuMat.step,
+                                       mBEVGpuMat.cols*mBEVGpuMat.elemSize(), mBEVGpuMat.rows,
+                                       cudaMemcpyDeviceToHost, mBEVStream));
+    CHECK_CUDA_ERROR(cudaStreamSynchronize(mBEVStream));
+
+    matImgData bevData;
+    bevData.timestamp_us = mBEVTimestamp;
+    bevData.matImg = mBEVMat;
+    return bevData;
+}
+
+// Pixel centers, image top = yMax
+void px2BEV::Metric2Pixel(float xIn, float yIn, float& xOut, float& yOut) const
+{
+    xOut = (xIn - mBEVParams.xMin)/mBEVParams.resolution - 0.5f;
+    yOut = (mBEVParams.yMax - yIn)/mBEVParams.resolution - 0.5f;
+}
+
+void px2BEV::Pixel2Metric(float xIn, float yIn, float& xOut, float& yOut) const
+{
+    xOut = mBEVParams.xMin + (xIn + 0.5f)*mBEVParams.resolution;
+    yOut = mBEVParams.yMax - (yIn + 0.5f)*mBEVParams.resolution;
+}
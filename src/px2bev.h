@@ -0,0 +1,69 @@
+#ifndef PX2BEV_H
+#define PX2BEV_H
+
+#include "px2camlib.h"
+#include "px2remap.h"
+
+/**
+ * Bird's-eye-view image of the camera frame on a metric grid.
+ *
+ * Undistortion (invRectMap.xml) and inverse perspective mapping (ipmMat.xml) are folded at Init()
+ * into one remap table (BEV pixel -> distorted camera pixel), so Generate() is a single GPU pass.
+ * Default grid is the same as the top-view drawing in main : 50m x 50m in front of the camera, 0.1m per pixel.
+ */
+
+typedef struct {
+    float xMin = -25.f;         // Lateral range(m), left edge of the image
+    float xMax = 25.f;          // Lateral range(m), right edge of the image
+    float yMin = 0.f;           // Longitudinal range(m), bottom of the image
+    float yMax = 50.f;          // Longitudinal range(m), top of the image
+    float resolution = 0.1f;    // m per pixel
+}bevParameters;
+
+class px2BEV{
+public:
+    px2BEV(px2Cam* _px2Cam);
+    ~px2BEV() {}
+
+    bool Init(bevParameters bevParams, string invRectMapFilePath, string ipmMatrixFilePath);
+
+    // Init() in two parts : the remap table is built on the host (any thread), then uploaded
+    bool LoadCalibration(bevParameters bevParams, string invRectMapFilePath, string ipmMatrixFilePath);
+    bool InitDevice();
+
+    // BEV of the current px2Cam frame (device, BGR), GetBEVMatImgData() downloads on the same stream
+    void Generate(cudaStream_t stream = 0);
+
+    // Host reference of Generate() for a BGR camera image
+    void GenerateHost(const cv::Mat& camImg, cv::Mat& bevImg);
+
+    gpuMatImgData GetBEVGpuMatImgData();
+    matImgData GetBEVMatImgData();
+
+    int GetWidth() const { return mWidth; }
+    int GetHeight() const { return mHeight; }
+
+    // Folded table (BEV pixel -> distorted camera pixel, -1 : not visible)
+    const cv::Mat& GetRemapTable() const { return mRemapTable; }
+
+    // Top-view metric coordinate(m) <-> BEV pixel
+    void Metric2Pixel(float xIn, float yIn, float& xOut, float& yOut) const;
+    void Pixel2Metric(float xIn, float yIn, float& xOut, float& yOut) const;
+
+private:
+    px2Cam* mPx2Cam;
+
+    bevParameters mBEVParams;
+    int mWidth = 0;
+    int mHeight = 0;
+
+    cv::Mat mRemapTable;
+    px2Remap mRemap;
+
+    cudaStream_t mBEVStream = 0;
+    uint64_t mBEVTimestamp = 0;
+    cv::cuda::GpuMat mBEVGpuMat;
+    cv::Mat mBEVMat;
+};
+
+#endif // PX2BEV_H
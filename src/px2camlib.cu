@@ -39,7 +39,50 @@ void GpuMat2Img(uint8_t* imgGpuMatOri, float* imgTrt, uint8_t* imgGpuMat,
     }
 }
 
+// Area downscale of a pitched RGBA image for the display : every output pixel averages its source footprint
+__global__
+void DownscaleRGBA(const uint8_t* src, int srcWidth, int srcHeight, size_t srcPitch,
+                   uint8_t* dst, int dstWidth, int dstHeight, size_t dstPitch)
+{
+    int xIndex = blockIdx.x*blockDim.x + threadIdx.x;
+    int yIndex = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if((xIndex < dstWidth) && (yIndex < dstHeight))
+    {
+        int srcX0 = xIndex*srcWidth/dstWidth;
+        int srcX1 = max((xIndex + 1)*srcWidth/dstWidth, srcX0 + 1);
+        int srcY0 = yIndex*srcHeight/dstHeight;
+        int srcY1 = max((yIndex + 1)*srcHeight/dstHeight, srcY0 + 1);
+
+        uint32_t sum[4] = {0, 0, 0, 0};
+        for(int srcY = srcY0; srcY < srcY1; srcY++)
+        {
+            const uint8_t* srcRow = src + srcY*srcPitch;
+            for(int srcX = srcX0; srcX < srcX1; srcX++)
+            {
+                for(int c = 0; c < 4; c++)
+                    sum[c] += srcRow[srcX*4 + c];
+            }
+        }
+
+        uint32_t numPixels = (srcX1 - srcX0)*(srcY1 - srcY0);
+        uint8_t* dstPixel = dst + yIndex*dstPitch + xIndex*4;
+        for(int c = 0; c < 4; c++)
+            dstPixel[c] = (uint8_t)((sum[c] + numPixels/2)/numPixels);
+    }
+}
+
+// UpdateCamImg steps, for the device buffer lifetimes
+enum
+{
+    CAM_STEP_COPY = 0,      // Camera image -> pitched RGBA
+    CAM_STEP_CONVERT = 1,   // Pitched RGBA -> BGR GpuMat
+    CAM_STEP_RESIZE = 2,    // BGR GpuMat -> resized
+    CAM_STEP_CROP = 3       // Resized -> TensorRT input and cropped GpuMat
+};
+
 px2Cam::px2Cam()
+    : mDeviceArena(GetCudaArenaAllocator())
 {
     mArguments = ProgramArguments(
     {           ProgramArguments::Option_t("camera-type", "ar0231-rccb-bae-sf3324"),
@@ -66,6 +109,24 @@ void px2Cam::ReleaseModules()
         dwImageStreamer_release(&mStreamerCUDA2GL);
     }
 
+    if(mDisplayImgHandle)
+    {
+        dwImage_destroy(&mDisplayImgHandle);
+    }
+
+    if(mStreamerCPU2GL)
+    {
+        dwImageStreamer_release(&mStreamerCPU2GL);
+    }
+
+    if(mTopViewImgHandle)
+    {
+        dwImage_destroy(&mTopViewImgHandle);
+    }
+
+    // Gives the queued frames back before the camera goes
+    mRecorder.Release();
+
     if(mCamera)
     {
         dwSensor_stop(mCamera);
@@ -82,6 +143,8 @@ void px2Cam::ReleaseModules()
         dwRenderer_release(&mRenderer);
     }
 
+    mDeviceArena.Release();
+
     dwSAL_release(&mSAL);
     dwRelease(&mContext);
 }
@@ -100,6 +163,17 @@ bool px2Cam::Init(camInputParameters camInputParams,
                   imgCropParameters imgCropParams,
                   displayParameters dispParams,
                   dwTegraMode tegraMode)
+{
+    if(!InitContext(camInputParams, imgCropParams, dispParams, tegraMode))
+        return false;
+
+    return InitDevices();
+}
+
+bool px2Cam::InitContext(camInputParameters camInputParams,
+                         imgCropParameters imgCropParams,
+                         displayParameters dispParams,
+                         dwTegraMode tegraMode)
 {
     mCamInputParams = camInputParams;
 
@@ -112,7 +186,8 @@ bool px2Cam::Init(camInputParameters camInputParams,
 
     if(mRecordCamera)
     {
-        mArguments.set("fifo-size","6");
+        // Recorder queue + frame being processed + next frame read
+        mArguments.set("fifo-size", to_string(max<uint32_t>(mRecorderParams.queueCapacity + 2, 6)).c_str());
     }
 
 
@@ -177,12 +252,14 @@ bool px2Cam::Init(camInputParameters camInputParams,
     }
 
     // Initialize Modules
-    bool status;
     InitGL();
 
-    status = InitSDK();
-    if(!status)
-        return status;
+    return InitSDK();
+}
+
+bool px2Cam::InitDevices()
+{
+    bool status;
 
     status = InitRenderer();
     if(!status)
@@ -393,6 +470,35 @@ bool px2Cam::InitPipeline()
         CHECK_DW_ERROR(dwImage_getCUDA(&mCamImgCudaRCB, mRCBImageHandle));
 
         CHECK_DW_ERROR(dwSoftISP_bindOutputDemosaic(mCamImgCudaRCB, mISP));
+
+        mFusedRawInference = mRawInferParams.enable;
+    }
+    else
+    {
+        mFusedYuvInference = mYuvInferParams.enable;
+    }
+
+    // RGBA frame : the inference input without a fused path, the display, the recording and the requested consumers
+    bool rgbaConsumers = mDispParams.onDisplay || mRecordCamera || mRGBAFrameRequested;
+    mRGBAFrame = (!mFusedRawInference && !mFusedYuvInference) || rgbaConsumers;
+
+    // Inference input straight from the raw / NV12 frame, same resize / crop as the RGBA chain
+    if(mFusedRawInference || mFusedYuvInference)
+    {
+        mInferTensorGeometry.scaleX = mResizeEnable ? (float)mResizeWidth/CAM_IMG_WIDTH : 1.f;
+        mInferTensorGeometry.scaleY = mResizeEnable ? (float)mResizeHeight/CAM_IMG_HEIGHT : 1.f;
+        mInferTensorGeometry.roiX = mROIx;
+        mInferTensorGeometry.roiY = mROIy;
+        mInferTensorGeometry.roiW = mROIw;
+        mInferTensorGeometry.roiH = mROIh;
+        mInferTensorGeometry.halfRes = (mInferTensorGeometry.scaleX <= 0.5f) && (mInferTensorGeometry.scaleY <= 0.5f);
+
+        if(mFusedRawInference)
+            cout << "Raw inference : fused RCCB demosaic (" << (mInferTensorGeometry.halfRes ? "half" : "full") << " res)"
+                 << (mRGBAFrame ? "" : ", SoftISP off") << endl;
+        else
+            cout << "YUV inference : fused NV12 conversion (" << (mInferTensorGeometry.halfRes ? "half" : "full") << " res)"
+                 << (mRGBAFrame ? "" : ", RGBA off") << endl;
     }
 
 
@@ -417,7 +523,38 @@ bool px2Cam::InitPipeline()
         glImgProps.height = mCamProp.resolution.y;
     }
 
-    status = dwImageStreamer_initialize(&mStreamerCUDA2GL, &glImgProps, DW_IMAGE_GL, mContext);
+    mRGBAImgProp = glImgProps;
+
+    // Window layout : the camera tile, then the top-view tile next to it
+    mCamTileRect = {0.f, 0.f, (float32_t)mWindow->width(), (float32_t)mWindow->height()};
+    if(mDispParams.topViewTile)
+    {
+        GridData_t grid;
+        configureGrid(&grid, mWindow->width(), mWindow->height(), glImgProps.width, glImgProps.height, 2);
+
+        dwRect cellRect;
+        gridCellRect(&cellRect, grid, 0);
+        mCamTileRect = {(float32_t)cellRect.x, (float32_t)cellRect.y, (float32_t)cellRect.width, (float32_t)cellRect.height};
+        gridCellRect(&cellRect, grid, 1);
+        mTopViewCellRect = {(float32_t)cellRect.x, (float32_t)cellRect.y, (float32_t)cellRect.width, (float32_t)cellRect.height};
+    }
+
+    // Display surface : the frame is downscaled to the camera tile size on the GPU, only that goes through the streamer
+    dwImageProperties displayImgProps = glImgProps;
+    if(mDispParams.streamAtWindowSize)
+    {
+        displayImgProps.width = min<uint32_t>(mCamTileRect.width, glImgProps.width);
+        displayImgProps.height = min<uint32_t>(mCamTileRect.height, glImgProps.height);
+    }
+
+    if((displayImgProps.width != glImgProps.width) || (displayImgProps.height != glImgProps.height))
+    {
+        CHECK_DW_ERROR(dwImage_create(&mDisplayImgHandle, displayImgProps, mContext));
+        CHECK_DW_ERROR(dwImage_getCUDA(&mDisplayImgCuda, mDisplayImgHandle));
+        cout << "Display stream : " << displayImgProps.width << "x" << displayImgProps.height << endl;
+    }
+
+    status = dwImageStreamer_initialize(&mStreamerCUDA2GL, &displayImgProps, DW_IMAGE_GL, mContext);
 
     if(status == DW_SUCCESS)
     {
@@ -432,8 +569,6 @@ bool px2Cam::InitPipeline()
     // Init Serializer
     if (mRecordCamera)
     {
-        dwSerializerParams seriParams;
-        seriParams.parameters = "";
         std::string seriParamsStr = "";
 
         if(mCamInputParams.camInputMode == GMSL_CAM_YUV)
@@ -450,41 +585,54 @@ bool px2Cam::InitPipeline()
             seriParamsStr += std::string(",type=disk,file=") + std::string(mArguments.get("write-file"));
         }
 
-        seriParams.parameters = seriParamsStr.c_str();
-        seriParams.onData = nullptr;
+        cameraRecorderParameters recorderParams = mRecorderParams;
+        recorderParams.filePath = mArguments.get("write-file");
 
-        status = dwSensorSerializer_initialize(&mSerializer, &seriParams, mCamera);
-        status = dwSensorSerializer_start(mSerializer);
-
-        if(status == DW_SUCCESS)
+        if(mRecorder.Init(recorderParams, mCamera, seriParamsStr))
         {
             cout << "[DW_INIT_STEP_6] Serializer init success" << endl;
         }
         else
         {
-            cout << "[DW_INIT_STEP_6] Serializer init fail : " << dwGetStatusName(status) <<endl;
+            cout << "[DW_INIT_STEP_6] Serializer init fail" << endl;
             return false;
         }
     }
 
     // Allocation Img Data memory
-    cudaMalloc(&mPitchedImgCudaRGBA, CUDA_PITCH*CAM_IMG_HEIGHT*sizeof(uint8_t));
+    // The pitched copy is dead once converted, so the resized image (same stream, later step) reuses its memory
+    arenaBufferId pitchedId = mDeviceArena.Request("cam", "pitchedRGBA", CUDA_PITCH*CAM_IMG_HEIGHT*sizeof(uint8_t), 256,
+                                                   CAM_STEP_COPY, CAM_STEP_CONVERT);
+    arenaBufferId gpuMatId = mDeviceArena.Request("cam", "gpuMatBGR", CAM_IMG_WIDTH*CAM_IMG_HEIGHT*3*sizeof(uint8_t));
+    arenaBufferId resizedId = 0;
+    if(mResizeEnable && !mFusedRawInference && !mFusedYuvInference)
+    {
+        resizedId = mDeviceArena.Request("cam", "gpuMatResized", mResizeWidth*mResizeHeight*3*sizeof(uint8_t), 256,
+                                         CAM_STEP_RESIZE, CAM_STEP_CROP);
+    }
+    arenaBufferId trtImgId = mDeviceArena.Request("cam", "trtImg", mROIw*mROIh*3*sizeof(float));
+    arenaBufferId croppedId = mDeviceArena.Request("cam", "gpuMatResizedAndCropped", mROIw*mROIh*3*sizeof(uint8_t));
 
-    cudaMalloc(&mGpuMat_data, CAM_IMG_WIDTH*CAM_IMG_HEIGHT*3*sizeof(uint8_t));
+    if(!mDeviceArena.Commit())
+    {
+        cout << "[DW_INIT_STEP_7] Image buffers allocation fail" << endl;
+        return false;
+    }
+
+    mPitchedImgCudaRGBA = mDeviceArena.Get<uint8_t>(pitchedId);
+    mGpuMat_data = mDeviceArena.Get<uint8_t>(gpuMatId);
+    mTrtImg = mDeviceArena.Get<float>(trtImgId);
+    mGpuMatResizedAndCropped_data = mDeviceArena.Get<uint8_t>(croppedId);
 
     mGpuMat = cv::cuda::GpuMat(CAM_IMG_HEIGHT, CAM_IMG_WIDTH, CV_8UC3, (uint8_t*) mGpuMat_data);
 
-    if(mResizeEnable)
+    if(mResizeEnable && !mFusedRawInference && !mFusedYuvInference)
     {
-        cudaMalloc(&mGpuMatResized_data, mResizeWidth*mResizeHeight*3*sizeof(uint8_t));
+        mGpuMatResized_data = mDeviceArena.Get<uint8_t>(resizedId);
 
         mGpuMatResized = cv::cuda::GpuMat(mResizeHeight, mResizeWidth, CV_8UC3, (uint8_t*)mGpuMatResized_data);
     }
 
-    cudaMalloc(&mTrtImg, mROIw*mROIh*3*sizeof(float));
-
-    cudaMalloc(&mGpuMatResizedAndCropped_data, mROIw*mROIh*3*sizeof(uint8_t));
-
     mGpuMatResizedAndCropped = cv::cuda::GpuMat(mROIh, mROIw, CV_8UC3, (uint8_t*)mGpuMatResizedAndCropped_data);
 
     mMatResizedAndCropped = cv::Mat(mROIh, mROIw, CV_8UC3);
@@ -494,77 +642,99 @@ bool px2Cam::InitPipeline()
     return true;
 }
 
-bool px2Cam::UpdateCamImg()
+bool px2Cam::UpdateCamImg(dwImageCUDA* frameCopy)
 {
     dwStatus status;
+    bool recorded = false;
 
-    status = dwSensorCamera_readFrame(&mFrameHandle, sibling, timeout_us, mCamera);
+    // Frames the recorder is done with
+    mRecorder.ReturnFrames();
 
-    if (status == DW_END_OF_STREAM)
     {
-        cout << "Camera reached end of stream." << endl;
-        return false;
-    }
-    else if((status == DW_NOT_READY) || (status == DW_TIME_OUT)){
-        while((status == DW_NOT_READY) || (status == DW_TIME_OUT))
+        // Includes the wait for the next camera frame
+        static const latencySectionId readFrameSection = LatencyMonitor::RegisterSection("readFrame");
+        LatencyScope readFrameScope(mLatencyMonitor, readFrameSection);
+
+        status = dwSensorCamera_readFrame(&mFrameHandle, sibling, timeout_us, mCamera);
+
+        if (status == DW_END_OF_STREAM)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            status = dwSensorCamera_readFrame(&mFrameHandle, sibling, timeout_us, mCamera);
-            printf("."); fflush(stdout);
+            cout << "Camera reached end of stream." << endl;
+            return false;
+        }
+        else if((status == DW_NOT_READY) || (status == DW_TIME_OUT)){
+            uint32_t numRetries = 0;
+            while((status == DW_NOT_READY) || (status == DW_TIME_OUT))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                mRecorder.ReturnFrames();
+                status = dwSensorCamera_readFrame(&mFrameHandle, sibling, timeout_us, mCamera);
+                numRetries++;
+            }
+            PX2_LOG_DEBUG_RATE(1, "[DW_PROC_STEP_1] Frame ready after %u retries", numRetries);
+        }
+        else if(status == DW_SUCCESS)
+        {
+    //        cout << "[DW_PROC_STEP_1] Read frame success" << endl;
+        }
+        else
+        {
+            PX2_LOG_ERROR_RATE(1, "[DW_PROC_STEP_1] Read frame fail : %s", dwGetStatusName(status));
         }
     }
-    else if(status == DW_SUCCESS)
-    {
-//        cout << "[DW_PROC_STEP_1] Read frame success" << endl;
-    }
-    else
-    {
-        cout << "[DW_PROC_STEP_1] Read frame fail : " <<  dwGetStatusName(status) << endl;
-    }
+
+    // Written on the recorder thread while this frame is processed, returned by a later ReturnFrames()
+    if(mRecordCamera && (status == DW_SUCCESS))
+        recorded = mRecorder.Submit(mFrameHandle);
 
 //    auto begin = std::chrono::high_resolution_clock::now();
 
     if((mCamInputParams.camInputMode == GMSL_CAM_YUV) || (mCamInputParams.camInputMode == H264_FILE))
     {
-        status = dwSensorCamera_getImage(&mFrameCUDAHandle, DW_CAMERA_OUTPUT_CUDA_RGBA_UINT8, mFrameHandle);
-
-        if(status == DW_SUCCESS)
+        // Native NV12 surface for the fused inference input
+        if(mFusedYuvInference)
         {
-    //        cout << "[DW_PROC_STEP_2] Get CUDA frame handle success" << endl;
-        }
-        else
-        {
-            cout << "[DW_PROC_STEP_2] Get CUDA frame handle fail : " <<  dwGetStatusName(status) << endl;
+            status = dwSensorCamera_getImage(&mYuvImageHandle, DW_CAMERA_OUTPUT_CUDA_YUV420_UINT8_SEMIPLANAR, mFrameHandle);
+            if(status == DW_SUCCESS)
+                status = dwImage_getCUDA(&mCamImgCudaYuv, mYuvImageHandle);
+
+            if(status != DW_SUCCESS)
+            {
+                PX2_LOG_ERROR_RATE(1, "[DW_PROC_STEP_2] Get YUV CUDA frame fail : %s", dwGetStatusName(status));
+            }
         }
 
-        if(mRecordCamera)
+        // RGBA frame (display, recording consumers, GetOri*)
+        if(mRGBAFrame)
         {
-            status = dwSensorSerializer_serializeCameraFrameAsync(mFrameHandle, mSerializer);
+            status = dwSensorCamera_getImage(&mFrameCUDAHandle, DW_CAMERA_OUTPUT_CUDA_RGBA_UINT8, mFrameHandle);
 
             if(status == DW_SUCCESS)
             {
-    //            cout << "[DW_PROC_STEP_2.5] Serializing success" << endl;
+        //        cout << "[DW_PROC_STEP_2] Get CUDA frame handle success" << endl;
             }
             else
             {
-                cout << "[DW_PROC_STEP_2.5] Serializing fail : " <<  dwGetStatusName(status) << endl;
+                PX2_LOG_ERROR_RATE(1, "[DW_PROC_STEP_2] Get CUDA frame handle fail : %s", dwGetStatusName(status));
             }
 
-        }
-
-        status = dwImage_getCUDA(&mCamImgCuda, mFrameCUDAHandle);
+            status = dwImage_getCUDA(&mCamImgCuda, mFrameCUDAHandle);
 
-        if(status == DW_SUCCESS)
-        {
-    //        cout << "[DW_PROC_STEP_3] Get CUDA frame success" << endl;
-        }
-        else
-        {
-            cout << "[DW_PROC_STEP_3] Get CUDA frame fail : " <<  dwGetStatusName(status) << endl;
+            if(status == DW_SUCCESS)
+            {
+        //        cout << "[DW_PROC_STEP_3] Get CUDA frame success" << endl;
+            }
+            else
+            {
+                PX2_LOG_ERROR_RATE(1, "[DW_PROC_STEP_3] Get CUDA frame fail : %s", dwGetStatusName(status));
+            }
         }
     }
     else if( (mCamInputParams.camInputMode == GMSL_CAM_RAW) || (mCamInputParams.camInputMode == RAW_FILE))
     {
+        static const latencySectionId ispSection = LatencyMonitor::RegisterSection("isp");
+        LatencyScope ispScope(mLatencyMonitor, ispSection);
+
         status = dwSensorCamera_getImage(&mRawImageHandle, DW_CAMERA_OUTPUT_CUDA_RAW_UINT16, mFrameHandle);
 
         if(status == DW_SUCCESS)
@@ -573,55 +743,76 @@ bool px2Cam::UpdateCamImg()
         }
         else
         {
-            cout << "[DW_PROC_STEP_2] Get Raw Image Handle fail : " << dwGetStatusName(status) << endl;
-        }
-
-        if(mRecordCamera)
-        {
-            status = dwSensorSerializer_serializeCameraFrameAsync(mFrameHandle, mSerializer);
-            if(status == DW_BUFFER_FULL)
-            {
-                cout << "SensorSerializer failed to serialize data, aborting" << endl;
-                return -1;
-            }
-            else
-            {
-                CHECK_DW_ERROR(status);
-            }
-
+            PX2_LOG_ERROR_RATE(1, "[DW_PROC_STEP_2] Get Raw Image Handle fail : %s", dwGetStatusName(status));
         }
 
         status = dwImage_getCUDA(&mCamImgCudaRaw, mRawImageHandle);
 
         if(status == DW_SUCCESS)
         {
-            cout << "[DW_PROC_STEP_3] Get Raw CUDA frame success" << endl;
+//            cout << "[DW_PROC_STEP_3] Get Raw CUDA frame success" << endl;
         }
         else
         {
-            cout << "[DW_PROC_STEP_3] Get Raw CUDA frame failed : " << dwGetStatusName(status) << endl;
+            PX2_LOG_ERROR_RATE(1, "[DW_PROC_STEP_3] Get Raw CUDA frame failed : %s", dwGetStatusName(status));
         }
 
-        CHECK_DW_ERROR(dwSoftISP_bindInputRaw(mCamImgCudaRaw, mISP));
-        CHECK_DW_ERROR(dwSoftISP_setProcessType(mISPoutput, mISP));
-        CHECK_DW_ERROR(dwSoftISP_processDeviceAsync(mISP));
+        if(mRGBAFrame)
+        {
+            CHECK_DW_ERROR(dwSoftISP_bindInputRaw(mCamImgCudaRaw, mISP));
+            CHECK_DW_ERROR(dwSoftISP_setProcessType(mISPoutput, mISP));
+            CHECK_DW_ERROR(dwSoftISP_processDeviceAsync(mISP));
+        }
     }
 
 
-    // Get Camera image capture time
-    mCamTimestamp = mCamImgCuda->timestamp_us;
+    bool rawInput = (mCamInputParams.camInputMode == GMSL_CAM_RAW) || (mCamInputParams.camInputMode == RAW_FILE);
+    // Get Camera image capture time (the ISP output does not carry it)
+    if(rawInput)
+        mCamTimestamp = mCamImgCudaRaw->timestamp_us;
+    else if(mRGBAFrame)
+        mCamTimestamp = mCamImgCuda->timestamp_us;
+    else
+        mCamTimestamp = mCamImgCudaYuv->timestamp_us;
 
-    // Copy dwImageCUDA to Pitched pointer
-    cudaMemcpy(mPitchedImgCudaRGBA, mCamImgCuda->dptr[0], (CUDA_PITCH*CAM_IMG_HEIGHT), cudaMemcpyDeviceToDevice);
+    static const latencySectionId preprocessSection = LatencyMonitor::RegisterSection("preprocess");
+    LatencyScope preprocessScope(mLatencyMonitor, preprocessSection);
 
     const dim3 block(16,16);
-    const dim3 grid((CAM_IMG_WIDTH*3 + block.x - 1)/block.x, (CAM_IMG_HEIGHT + block.y -1)/block.y);
 
-    PitchedRGBA2GpuMat <<< grid, block >>> (mPitchedImgCudaRGBA, mGpuMat_data, CAM_IMG_WIDTH, CAM_IMG_HEIGHT, CUDA_PITCH);
+    // Full resolution BGR (GetOri*), from the RGBA frame
+    if(mRGBAFrame)
+    {
+        // Copy dwImageCUDA to Pitched pointer
+        cudaMemcpy(mPitchedImgCudaRGBA, mCamImgCuda->dptr[0], (CUDA_PITCH*CAM_IMG_HEIGHT), cudaMemcpyDeviceToDevice);
+
+        const dim3 grid((CAM_IMG_WIDTH*3 + block.x - 1)/block.x, (CAM_IMG_HEIGHT + block.y -1)/block.y);
+
+        PitchedRGBA2GpuMat <<< grid, block >>> (mPitchedImgCudaRGBA, mGpuMat_data, CAM_IMG_WIDTH, CAM_IMG_HEIGHT, CUDA_PITCH);
+
+        // The camera RGBA surface goes back to the sensor below
+        if(frameCopy)
+            CopyCamImg(frameCopy);
+    }
 
     const dim3 gridROI((mROIw*3 + block.x - 1)/block.x, (mROIh + block.y - 1)/block.y);
 
-    if(mResizeEnable)
+    if(mFusedRawInference)
+    {
+        DemosaicRCCB((const uint16_t*)mCamImgCudaRaw->dptr[0], mCamImgCudaRaw->pitch[0],
+                     mCamImgCudaRaw->prop.width, mCamImgCudaRaw->prop.height,
+                     mRawInferParams.demosaic, mInferTensorGeometry,
+                     mTrtImg, mGpuMatResizedAndCropped_data);
+    }
+    else if(mFusedYuvInference)
+    {
+        NV12ToTensor((const uint8_t*)mCamImgCudaYuv->dptr[0], mCamImgCudaYuv->pitch[0],
+                     (const uint8_t*)mCamImgCudaYuv->dptr[1], mCamImgCudaYuv->pitch[1],
+                     mCamImgCudaYuv->prop.width, mCamImgCudaYuv->prop.height,
+                     mYuvInferParams.color, mInferTensorGeometry,
+                     mTrtImg, mGpuMatResizedAndCropped_data);
+    }
+    else if(mResizeEnable)
     {
         cv::cuda::resize(mGpuMat, mGpuMatResized, cv::Size(mResizeWidth, mResizeHeight));
 
@@ -636,7 +827,8 @@ bool px2Cam::UpdateCamImg()
                                            mROIx, mROIy, mROIw, mROIh);
     }
 
-    dwSensorCamera_returnFrame(&mFrameHandle);
+    if(!recorded)
+        dwSensorCamera_returnFrame(&mFrameHandle);
 
 //    auto end = std::chrono::high_resolution_clock::now();
 
@@ -647,21 +839,51 @@ bool px2Cam::UpdateCamImg()
 
 void px2Cam::RenderCamImg()
 {
+    RenderCamImg(mRGBAFrame ? mFrameCUDAHandle : DW_NULL_HANDLE);
+}
+
+void px2Cam::RenderCamImg(dwImageHandle_t frameCUDAHandle)
+{
+    // No RGBA frame (fused inference input without consumer)
+    if(frameCUDAHandle == DW_NULL_HANDLE)
+    {
+        PX2_LOG_ERROR_RATE(1, "[DW_RENDER] No RGBA frame to render, RequestRGBAFrame() before Init");
+        return;
+    }
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     dwTime_t timeout = 132000;
 
+    // Downscale to the display surface (default stream, ordered before the streamer copy)
+    dwImageHandle_t streamedHandle = frameCUDAHandle;
+    if(mDisplayImgHandle)
+    {
+        dwImageCUDA* frameCuda;
+        CHECK_DW_ERROR(dwImage_getCUDA(&frameCuda, frameCUDAHandle));
+
+        const dim3 block(16,16);
+        const dim3 grid((mDisplayImgCuda->prop.width + block.x - 1)/block.x, (mDisplayImgCuda->prop.height + block.y - 1)/block.y);
+
+        DownscaleRGBA <<< grid, block >>> ((const uint8_t*)frameCuda->dptr[0], frameCuda->prop.width, frameCuda->prop.height, frameCuda->pitch[0],
+                                           (uint8_t*)mDisplayImgCuda->dptr[0], mDisplayImgCuda->prop.width, mDisplayImgCuda->prop.height,
+                                           mDisplayImgCuda->pitch[0]);
+        streamedHandle = mDisplayImgHandle;
+    }
+
     // stream that image to the GL domain
-    CHECK_DW_ERROR(dwImageStreamer_producerSend(mFrameCUDAHandle, mStreamerCUDA2GL));
+    CHECK_DW_ERROR(dwImageStreamer_producerSend(streamedHandle, mStreamerCUDA2GL));
 
     CHECK_DW_ERROR(dwImageStreamer_consumerReceive(&mFrameGLHandle, timeout, mStreamerCUDA2GL));
 
     CHECK_DW_ERROR(dwImage_getGL(&mImgGl, mFrameGLHandle));
 
-    // render received texture
+    // render received texture, stretched over the frame size : overlay coordinates stay in camera pixels
     dwVector2f range{};
-    range.x = mImgGl->prop.width;
-    range.y = mImgGl->prop.height;
+    range.x = mRGBAImgProp.width;
+    range.y = mRGBAImgProp.height;
+    if(mDispParams.topViewTile)
+        CHECK_DW_ERROR(dwRenderEngine_setViewport(mCamTileRect, mRenderEngine));
     CHECK_DW_ERROR(dwRenderEngine_setCoordinateRange2D(range, mRenderEngine));
     CHECK_DW_ERROR(dwRenderEngine_renderImage2D(mImgGl, {0.0f, 0.0f, range.x, range.y}, mRenderEngine));
 
@@ -672,153 +894,255 @@ void px2Cam::RenderCamImg()
     CHECK_DW_ERROR(dwImageStreamer_producerReturn(nullptr, timeout, mStreamerCUDA2GL));
 }
 
-void px2Cam::DrawBoundingBoxes(vector<cv::Rect>  bbRectList, vector<float32_t*> bbColorList, float32_t lineWidth)
+static dwVector4f ToDwColor(const float32_t* color)
+{
+    return {color[0], color[1], color[2], color[3]};
+}
+
+// Draw* only append to the overlay, UpdateRendering() renders it over the camera image
+void px2Cam::DrawBoundingBoxes(const vector<cv::Rect>& bbRectList, const vector<float32_t*>& bbColorList, float32_t lineWidth)
 {
-    CHECK_DW_ERROR(dwRenderEngine_setLineWidth(lineWidth, mRenderEngine));
     for(uint bbInd = 0; bbInd < bbRectList.size(); bbInd++)
     {
-        float32_t* bBoxColor = bbColorList[bbInd];
-        dwRenderEngineColorRGBA bBoxColorDw;
-        bBoxColorDw.x = bBoxColor[0];
-        bBoxColorDw.y = bBoxColor[1];
-        bBoxColorDw.z = bBoxColor[2];
-        bBoxColorDw.w = bBoxColor[3];
-        CHECK_DW_ERROR(dwRenderEngine_setColor(bBoxColorDw, mRenderEngine));
-
-        cv::Rect bBoxRect = bbRectList[bbInd];
-        dwRectf bBoxRectDw;
-        bBoxRectDw.x = bBoxRect.x;
-        bBoxRectDw.y = bBoxRect.y;
-        bBoxRectDw.width = bBoxRect.width;
-        bBoxRectDw.height = bBoxRect.height;
-
-        dwRenderEngine_render(DW_RENDER_ENGINE_PRIMITIVE_TYPE_BOXES_2D, &bBoxRectDw, sizeof(dwRectf), 0, 1, mRenderEngine);
+        const cv::Rect& bBoxRect = bbRectList[bbInd];
+        dwRectf bBoxRectDw{(float32_t)bBoxRect.x, (float32_t)bBoxRect.y, (float32_t)bBoxRect.width, (float32_t)bBoxRect.height};
+        mOverlay.AddBox(bBoxRectDw, ToDwColor(bbColorList[bbInd]), lineWidth);
     }
 }
 
-void px2Cam::DrawBoundingBoxesWithLabels(vector<cv::Rect>  bbRectList, vector<float32_t*> bbColorList, vector<const char*> bbLabelList, float32_t lineWidth)
+void px2Cam::DrawBoundingBoxesWithLabels(const vector<cv::Rect>& bbRectList, const vector<float32_t*>& bbColorList, const vector<const char*>& bbLabelList, float32_t lineWidth)
 {
-    CHECK_DW_ERROR(dwRenderEngine_setLineWidth(lineWidth, mRenderEngine));
     for(uint bbInd = 0; bbInd < bbRectList.size(); bbInd++)
     {
-        float32_t* bBoxColor = bbColorList[bbInd];
-        dwRenderEngineColorRGBA bBoxColorDw;
-        bBoxColorDw.x = bBoxColor[0];
-        bBoxColorDw.y = bBoxColor[1];
-        bBoxColorDw.z = bBoxColor[2];
-        bBoxColorDw.w = bBoxColor[3];
-        CHECK_DW_ERROR(dwRenderEngine_setColor(bBoxColorDw, mRenderEngine));
-
-        cv::Rect bBoxRect = bbRectList[bbInd];
-        dwRectf bBoxRectDw;
-        bBoxRectDw.x = bBoxRect.x;
-        bBoxRectDw.y = bBoxRect.y;
-        bBoxRectDw.width = bBoxRect.width;
-        bBoxRectDw.height = bBoxRect.height;
-
-        const char* bbLabel = bbLabelList[bbInd];
-
-        dwRenderEngine_renderWithLabel(DW_RENDER_ENGINE_PRIMITIVE_TYPE_BOXES_2D, &bBoxRectDw, sizeof(dwRectf), 0, bbLabel, 1, mRenderEngine);
+        const cv::Rect& bBoxRect = bbRectList[bbInd];
+        dwRectf bBoxRectDw{(float32_t)bBoxRect.x, (float32_t)bBoxRect.y, (float32_t)bBoxRect.width, (float32_t)bBoxRect.height};
+        mOverlay.AddBox(bBoxRectDw, ToDwColor(bbColorList[bbInd]), lineWidth, bbLabelList[bbInd]);
     }
 }
 
-void px2Cam::DrawBoundingBoxesWithLabelsPerClass(vector<vector<dwRectf> >  bbRectList, vector<const float32_t*> bbColorList, vector<vector<const char*> > bbLabelList, float32_t lineWidth)
+void px2Cam::DrawBoundingBoxesWithLabelsPerClass(const vector<vector<dwRectf> >& bbRectList, const vector<const float32_t*>& bbColorList, const vector<vector<const char*> >& bbLabelList, float32_t lineWidth)
 {
-    CHECK_DW_ERROR(dwRenderEngine_setLineWidth(lineWidth, mRenderEngine));
     for(uint classIdx = 0; classIdx < bbRectList.size(); classIdx++)
     {
-        const float32_t* bBoxColor = bbColorList[classIdx];
-        dwRenderEngineColorRGBA bBoxColorDw;
-        bBoxColorDw.x = bBoxColor[0];
-        bBoxColorDw.y = bBoxColor[1];
-        bBoxColorDw.z = bBoxColor[2];
-        bBoxColorDw.w = bBoxColor[3];
-        CHECK_DW_ERROR(dwRenderEngine_setColor(bBoxColorDw, mRenderEngine));
-
         if (bbRectList[classIdx].size() == 0)
             continue;
 
-        CHECK_DW_ERROR(dwRenderEngine_renderWithLabels(DW_RENDER_ENGINE_PRIMITIVE_TYPE_BOXES_2D, &bbRectList[classIdx][0], sizeof(dwRectf), 0, &bbLabelList[classIdx][0], bbRectList[classIdx].size(), mRenderEngine));
+        mOverlay.AddBoxes(&bbRectList[classIdx][0], &bbLabelList[classIdx][0], bbRectList[classIdx].size(),
+                          ToDwColor(bbColorList[classIdx]), lineWidth);
     }
 }
 
-void px2Cam::DrawPoints(vector<cv::Point> ptList, float32_t ptSize, float32_t* ptColor)
+void px2Cam::DrawPoints(const vector<cv::Point>& ptList, float32_t ptSize, float32_t* ptColor)
 {
-    CHECK_DW_ERROR(dwRenderEngine_setPointSize(ptSize, mRenderEngine));
-    vector<dwVector2f> ptDwList;
-    for(uint ptInd = 0; ptInd < ptList.size(); ptInd++)
-    {
-        cv::Point pt = ptList[ptInd];
-        dwVector2f ptDw;
-        ptDw.x = pt.x;
-        ptDw.y = pt.y;
-        ptDwList.push_back(ptDw);
-    }
+    if(ptList.empty())
+        return;
+
+    mOverlay.AddPoints(&ptList[0], ptList.size(), ToDwColor(ptColor), ptSize);
+}
+
+void px2Cam::DrawPolyLine(const vector<cv::Point>& ptList, float32_t lineWidth, float32_t* lineColor)
+{
+    if(ptList.empty())
+        return;
+
+    mOverlay.AddPolyLine(&ptList[0], ptList.size(), ToDwColor(lineColor), lineWidth);
+}
+
+void px2Cam::DrawPolyLineDw(const vector<dwVector2f>& ptList, float32_t lineWidth, dwVector4f lineColor)
+{
+    if(ptList.empty())
+        return;
 
-    dwRenderEngineColorRGBA ptColorDw;
-    ptColorDw.x = ptColor[0];
-    ptColorDw.y = ptColor[1];
-    ptColorDw.z = ptColor[2];
-    ptColorDw.w = ptColor[3];
+    mOverlay.AddPolyLine(&ptList[0], ptList.size(), lineColor, lineWidth);
+}
 
-    CHECK_DW_ERROR(dwRenderEngine_setColor(ptColorDw, mRenderEngine));
+void px2Cam::DrawPolyLineDw(const dwVector2f* ptList, uint32_t numPts, float32_t lineWidth, dwVector4f lineColor)
+{
+    mOverlay.AddPolyLine(ptList, numPts, lineColor, lineWidth);
+}
 
-    dwRenderEngine_render(DW_RENDER_ENGINE_PRIMITIVE_TYPE_POINTS_2D, &ptDwList[0], sizeof(dwVector2f), 0, ptDwList.size(), mRenderEngine);
+void px2Cam::DrawText(const char* text, cv::Point textPos, float32_t* textColor)
+{
+    dwVector2f textPosDw{(float32_t)textPos.x, (float32_t)textPos.y};
+    mOverlay.AddText(text, textPosDw, ToDwColor(textColor));
 }
 
-void px2Cam::DrawPolyLine(vector<cv::Point> ptList, float32_t lineWidth, float32_t* lineColor)
+void px2Cam::RenderTopView(const cv::Mat& topViewImg)
 {
-    CHECK_DW_ERROR(dwRenderEngine_setLineWidth(lineWidth, mRenderEngine));
-    vector<dwVector2f> ptDwList;
-    for(uint ptInd = 0; ptInd < ptList.size(); ptInd++)
+    if(!mDispParams.topViewTile || topViewImg.empty())
+        return;
+
+    dwTime_t timeout = 132000;
+
+    // Host RGBA image streamed to GL, created on the first frame (and again if the size changes)
+    if(!mTopViewImgHandle || (mTopViewImgProp.width != (uint32_t)topViewImg.cols) || (mTopViewImgProp.height != (uint32_t)topViewImg.rows))
     {
-        cv::Point pt = ptList[ptInd];
-        dwVector2f ptDw;
-        ptDw.x = pt.x;
-        ptDw.y = pt.y;
-        ptDwList.push_back(ptDw);
+        if(mStreamerCPU2GL)
+            dwImageStreamer_release(&mStreamerCPU2GL);
+        if(mTopViewImgHandle)
+            dwImage_destroy(&mTopViewImgHandle);
+
+        mTopViewImgProp = dwImageProperties{};
+        mTopViewImgProp.type = DW_IMAGE_CPU;
+        mTopViewImgProp.format = DW_IMAGE_FORMAT_RGBA_UINT8;
+        mTopViewImgProp.width = topViewImg.cols;
+        mTopViewImgProp.height = topViewImg.rows;
+        CHECK_DW_ERROR(dwImage_create(&mTopViewImgHandle, mTopViewImgProp, mContext));
+        CHECK_DW_ERROR(dwImageStreamer_initialize(&mStreamerCPU2GL, &mTopViewImgProp, DW_IMAGE_GL, mContext));
+
+        // Largest area of the cell with the top-view aspect ratio, centered
+        float32_t scale = min(mTopViewCellRect.width/topViewImg.cols, mTopViewCellRect.height/topViewImg.rows);
+        mTopViewTileRect.width = topViewImg.cols*scale;
+        mTopViewTileRect.height = topViewImg.rows*scale;
+        mTopViewTileRect.x = mTopViewCellRect.x + (mTopViewCellRect.width - mTopViewTileRect.width)*0.5f;
+        mTopViewTileRect.y = mTopViewCellRect.y + (mTopViewCellRect.height - mTopViewTileRect.height)*0.5f;
     }
 
-    dwRenderEngineColorRGBA lineColorDw;
-    lineColorDw.x = lineColor[0];
-    lineColorDw.y = lineColor[1];
-    lineColorDw.z = lineColor[2];
-    lineColorDw.w = lineColor[3];
+    dwImageCPU* topViewImgCpu;
+    CHECK_DW_ERROR(dwImage_getCPU(&topViewImgCpu, mTopViewImgHandle));
+    cv::Mat topViewRGBA(topViewImg.rows, topViewImg.cols, CV_8UC4, topViewImgCpu->data[0], topViewImgCpu->pitch[0]);
+    if(topViewImg.channels() == 4)
+        topViewImg.copyTo(topViewRGBA);
+    else
+        cv::cvtColor(topViewImg, topViewRGBA, cv::COLOR_BGR2RGBA);
+
+    CHECK_DW_ERROR(dwImageStreamer_producerSend(mTopViewImgHandle, mStreamerCPU2GL));
+
+    dwImageHandle_t topViewGLHandle = DW_NULL_HANDLE;
+    CHECK_DW_ERROR(dwImageStreamer_consumerReceive(&topViewGLHandle, timeout, mStreamerCPU2GL));
 
-    CHECK_DW_ERROR(dwRenderEngine_setColor(lineColorDw, mRenderEngine));
+    dwImageGL* topViewImgGl;
+    CHECK_DW_ERROR(dwImage_getGL(&topViewImgGl, topViewGLHandle));
 
-    dwRenderEngine_render(DW_RENDER_ENGINE_PRIMITIVE_TYPE_LINESTRIP_2D, &ptDwList[0], sizeof(dwVector2f), 0, ptDwList.size(), mRenderEngine);
+    dwVector2f range{(float32_t)topViewImg.cols, (float32_t)topViewImg.rows};
+    CHECK_DW_ERROR(dwRenderEngine_setViewport(mTopViewTileRect, mRenderEngine));
+    CHECK_DW_ERROR(dwRenderEngine_setCoordinateRange2D(range, mRenderEngine));
+    CHECK_DW_ERROR(dwRenderEngine_renderImage2D(topViewImgGl, {0.0f, 0.0f, range.x, range.y}, mRenderEngine));
+
+    CHECK_DW_ERROR(dwImageStreamer_consumerReturn(&topViewGLHandle, mStreamerCPU2GL));
+    CHECK_DW_ERROR(dwImageStreamer_producerReturn(nullptr, timeout, mStreamerCPU2GL));
+}
+
+void px2Cam::DrawTopViewPolyLineDw(const dwVector2f* ptList, uint32_t numPts, float32_t lineWidth, dwVector4f lineColor)
+{
+    mTopViewOverlay.AddPolyLine(ptList, numPts, lineColor, lineWidth);
 }
 
-void px2Cam::DrawPolyLineDw(vector<dwVector2f> ptList, float32_t lineWidth, dwVector4f lineColor)
+OverlayBatch& px2Cam::GetOverlay()
 {
-    CHECK_DW_ERROR(dwRenderEngine_setLineWidth(lineWidth, mRenderEngine));
+    return mOverlay;
+}
 
-    CHECK_DW_ERROR(dwRenderEngine_setColor(lineColor, mRenderEngine));
+// Camera overlay, then the top-view overlay in its tile. Returns the number of render engine calls.
+uint32_t px2Cam::FlushOverlay()
+{
+    uint32_t numCalls = 0;
 
-    dwRenderEngine_render(DW_RENDER_ENGINE_PRIMITIVE_TYPE_LINESTRIP_2D, &ptList[0], sizeof(dwVector2f), 0, ptList.size(), mRenderEngine);
+    if(mDispParams.topViewTile)
+    {
+        dwVector2f range{(float32_t)mRGBAImgProp.width, (float32_t)mRGBAImgProp.height};
+        CHECK_DW_ERROR(dwRenderEngine_setViewport(mCamTileRect, mRenderEngine));
+        CHECK_DW_ERROR(dwRenderEngine_setCoordinateRange2D(range, mRenderEngine));
+    }
+    numCalls += RenderOverlay(mOverlay);
+
+    if(mDispParams.topViewTile && !mTopViewOverlay.Empty())
+    {
+        dwVector2f range{(float32_t)mTopViewImgProp.width, (float32_t)mTopViewImgProp.height};
+        CHECK_DW_ERROR(dwRenderEngine_setViewport(mTopViewTileRect, mRenderEngine));
+        CHECK_DW_ERROR(dwRenderEngine_setCoordinateRange2D(range, mRenderEngine));
+        numCalls += RenderOverlay(mTopViewOverlay);
+    }
+
+    return numCalls;
 }
 
-void px2Cam::DrawText(const char* text, cv::Point textPos, float32_t* textColor)
+// One render call per batch, the render engine state (color, width, size) only set when it changes.
+// Texts last, over the boxes and lines. Returns the number of render engine calls.
+uint32_t px2Cam::RenderOverlay(OverlayBatch& overlay)
 {
-    dwVector2f textPosDw;
-    textPosDw.x = textPos.x;
-    textPosDw.y = textPos.y;
+    uint32_t numCalls = 0;
+    if(overlay.Empty())
+        return numCalls;
+
+    bool stateSet = false;
+    dwVector4f curColor{};
+    float32_t curLineWidth = -1.f;
+    float32_t curPointSize = -1.f;
 
+    auto setColor = [&](const dwVector4f& color)
+    {
+        if(stateSet && (curColor.x == color.x) && (curColor.y == color.y) && (curColor.z == color.z) && (curColor.w == color.w))
+            return;
+        CHECK_DW_ERROR(dwRenderEngine_setColor(color, mRenderEngine));
+        curColor = color;
+        stateSet = true;
+        numCalls++;
+    };
+
+    for(const overlayBatch& batch : overlay.GetBatches())
+    {
+        if(batch.boxes.empty() && batch.vertices.empty())
+            continue;
+
+        setColor(batch.color);
+
+        if(batch.primitive == OVERLAY_POINTS)
+        {
+            if(batch.size != curPointSize)
+            {
+                CHECK_DW_ERROR(dwRenderEngine_setPointSize(batch.size, mRenderEngine));
+                curPointSize = batch.size;
+                numCalls++;
+            }
+        }
+        else if(batch.size != curLineWidth)
+        {
+            CHECK_DW_ERROR(dwRenderEngine_setLineWidth(batch.size, mRenderEngine));
+            curLineWidth = batch.size;
+            numCalls++;
+        }
 
-    dwRenderEngineColorRGBA textColorDw;
-    textColorDw.x = textColor[0];
-    textColorDw.y = textColor[1];
-    textColorDw.z = textColor[2];
-    textColorDw.w = textColor[3];
+        switch(batch.primitive)
+        {
+        case OVERLAY_BOXES:
+            CHECK_DW_ERROR(dwRenderEngine_render(DW_RENDER_ENGINE_PRIMITIVE_TYPE_BOXES_2D, &batch.boxes[0], sizeof(dwRectf), 0,
+                                                 batch.boxes.size(), mRenderEngine));
+            break;
+        case OVERLAY_LABELED_BOXES:
+            mOverlayLabels.clear();
+            for(uint32_t labelOffset : batch.labelOffsets)
+                mOverlayLabels.push_back(overlay.GetText(labelOffset));
+            CHECK_DW_ERROR(dwRenderEngine_renderWithLabels(DW_RENDER_ENGINE_PRIMITIVE_TYPE_BOXES_2D, &batch.boxes[0], sizeof(dwRectf), 0,
+                                                           &mOverlayLabels[0], batch.boxes.size(), mRenderEngine));
+            break;
+        case OVERLAY_LINES:
+            CHECK_DW_ERROR(dwRenderEngine_render(DW_RENDER_ENGINE_PRIMITIVE_TYPE_LINES_2D, &batch.vertices[0], sizeof(dwVector2f), 0,
+                                                 batch.vertices.size()/2, mRenderEngine));
+            break;
+        case OVERLAY_POINTS:
+            CHECK_DW_ERROR(dwRenderEngine_render(DW_RENDER_ENGINE_PRIMITIVE_TYPE_POINTS_2D, &batch.vertices[0], sizeof(dwVector2f), 0,
+                                                 batch.vertices.size(), mRenderEngine));
+            break;
+        }
+        numCalls++;
+    }
 
-    CHECK_DW_ERROR(dwRenderEngine_setColor(textColorDw, mRenderEngine));
+    for(const overlayText& text : overlay.GetTexts())
+    {
+        setColor(text.color);
+        CHECK_DW_ERROR(dwRenderEngine_renderText2D(overlay.GetText(text.textOffset), text.position, mRenderEngine));
+        numCalls++;
+    }
 
-    dwRenderEngine_renderText2D(text, textPosDw, mRenderEngine);
+    overlay.Clear();
+
+    return numCalls;
 }
 
 void px2Cam::UpdateRendering()
 {
+    FlushOverlay();
     mWindow->swapBuffers();
 }
 
@@ -834,6 +1158,16 @@ trtImgData px2Cam::GetTrtImgData()
     return mCurTrtImgData;
 }
 
+int px2Cam::GetTrtImgWidth()
+{
+    return mROIw;
+}
+
+int px2Cam::GetTrtImgHeight()
+{
+    return mROIh;
+}
+
 matImgData px2Cam::GetCroppedMatImgData()
 {
     mGpuMatResizedAndCropped.download(mMatResizedAndCropped);
@@ -850,7 +1184,80 @@ matImgData px2Cam::GetOriMatImgData()
     return mCurOriMatImgData;
 }
 
+// Device BGR image of the whole camera frame, no copy
+gpuMatImgData px2Cam::GetOriGpuMatImgData()
+{
+    mCurOriGpuMatImgData.timestamp_us = mCamTimestamp;
+    mCurOriGpuMatImgData.gpuMatImg = mGpuMat;
+    return mCurOriGpuMatImgData;
+}
+
 dwImageCUDA* px2Cam::GetDwImageCuda()
 {
     return mCamImgCuda;
 }
+
+DeviceArena* px2Cam::GetDeviceArena()
+{
+    return &mDeviceArena;
+}
+
+void px2Cam::SetRecorderParameters(cameraRecorderParameters recorderParams)
+{
+    mRecorderParams = recorderParams;
+}
+
+cameraRecorderStats px2Cam::GetRecorderStats()
+{
+    return mRecorder.GetStats();
+}
+
+void px2Cam::SetRawInferenceParameters(rawInferenceParameters rawInferParams)
+{
+    mRawInferParams = rawInferParams;
+}
+
+void px2Cam::SetYuvInferenceParameters(yuvInferenceParameters yuvInferParams)
+{
+    mYuvInferParams = yuvInferParams;
+}
+
+void px2Cam::RequestRGBAFrame()
+{
+    mRGBAFrameRequested = true;
+}
+
+bool px2Cam::HasRGBAFrame()
+{
+    return mRGBAFrame;
+}
+
+void px2Cam::SetLatencyMonitor(LatencyMonitor* latencyMonitor)
+{
+    mLatencyMonitor = latencyMonitor;
+}
+
+LatencyMonitor* px2Cam::GetLatencyMonitor()
+{
+    return mLatencyMonitor;
+}
+
+dwImageProperties px2Cam::GetRGBAImgProperties()
+{
+    return mRGBAImgProp;
+}
+
+void px2Cam::CopyCamImg(dwImageCUDA* dstImg)
+{
+    if(!mRGBAFrame || !mCamImgCuda)
+    {
+        PX2_LOG_ERROR_RATE(1, "[DW_COPY] No RGBA frame to copy, RequestRGBAFrame() before Init");
+        return;
+    }
+
+    CHECK_CUDA_ERROR(cudaMemcpy2D(dstImg->dptr[0], dstImg->pitch[0],
+                                  mCamImgCuda->dptr[0], mCamImgCuda->pitch[0],
+                                  mCamImgCuda->prop.width*4, mCamImgCuda->prop.height,
+                                  cudaMemcpyDeviceToDevice));
+    dstImg->timestamp_us = mCamTimestamp;
+}
@@ -25,6 +25,7 @@
 #include <framework/ProgramArguments.hpp>
 #include <framework/WindowGLFW.hpp>
 #include <framework/Checks.hpp>
+#include <framework/Grid.hpp>
 #include <dw/renderer/RenderEngine.h>
 
 #include <dw/isp/SoftISP.h>
@@ -33,6 +34,14 @@
 
 #include "img_dev.h"
 
+#include "px2arena.h"
+#include "px2demosaic.h"
+#include "px2latency.h"
+#include "px2log.h"
+#include "px2overlay.h"
+#include "px2recorder.h"
+#include "px2yuv.h"
+
 #define CAM_IMG_WIDTH 1920
 #define CAM_IMG_HEIGHT 1208
 #define CUDA_PITCH 7680
@@ -64,11 +73,28 @@ typedef struct {
     int roiH = CAM_IMG_HEIGHT;
 }imgCropParameters;
 
+// RAW modes : the TensorRT input (and the cropped image) demosaiced straight from the RCCB frame in one kernel,
+// instead of SoftISP RGBA -> BGR -> resize -> crop. Half-res demosaic when resizeRatio <= 0.5.
+// SoftISP still runs when the RGBA frame has a consumer (see px2Cam::RequestRGBAFrame).
+typedef struct {
+    bool enable = false;
+    rccbDemosaicParameters demosaic;
+}rawInferenceParameters;
+
+// GMSL_CAM_YUV / H264_FILE : the TensorRT input (and the cropped image) converted from the native NV12 surface in one kernel,
+// instead of DriveWorks RGBA -> BGR -> resize -> crop. The RGBA frame is still read when it has a consumer (see px2Cam::RequestRGBAFrame).
+typedef struct {
+    bool enable = false;
+    yuvColorParameters color;
+}yuvInferenceParameters;
+
 typedef struct {
     bool onDisplay = true;
     string windowTitle = "";
     int windowWidth = 1280;
     int windowHeight = 720;
+    bool streamAtWindowSize = true;     // GPU downscale of the frame to the window size before the CUDA->GL streamer
+    bool topViewTile = false;           // Window split in 2 grid cells : camera, top view (RenderTopView)
 }displayParameters;
 
 typedef struct{
@@ -81,6 +107,11 @@ typedef struct{
     cv::Mat matImg;
 }matImgData;
 
+typedef struct{
+    uint64_t timestamp_us = 0;
+    cv::cuda::GpuMat gpuMatImg;
+}gpuMatImgData;
+
 
 class px2Cam
 {
@@ -100,24 +131,73 @@ public:
               dwTegraMode tegraMode,
               const char* writePath);
 
-    bool UpdateCamImg();
+    // Init() in two parts, for the init graph : the Driveworks context (with GL) is enough for the networks,
+    // InitDevices() then starts the renderer, the camera and the image pipeline. Both on the GL thread.
+    bool InitContext(camInputParameters camInputParams,
+                     imgCropParameters imgCropParams,
+                     displayParameters dispParams,
+                     dwTegraMode tegraMode);
+    bool InitDevices();
+
+    // frameCopy (GetRGBAImgProperties() image) : copy of the RGBA frame, taken before the camera frame is returned.
+    // Everything else (GetOri*, GetTrtImgData, ...) is rewritten by the next call.
+    bool UpdateCamImg(dwImageCUDA* frameCopy = nullptr);
     void RenderCamImg();
-    void DrawBoundingBoxes(vector<cv::Rect>  bbRectList, vector<float32_t*> bbColorList, float32_t lineWidth);
-    void DrawBoundingBoxesWithLabels(vector<cv::Rect>  bbRectList, vector<float32_t*> bbColorList, vector<const char*> bbLabelList, float32_t lineWidth);
-    void DrawBoundingBoxesWithLabelsPerClass(vector<vector<dwRectf> >  bbRectList, vector<const float32_t*> bbColorList, vector<vector<const char*> > bbLabelList, float32_t lineWidth);
-    void DrawPoints(vector<cv::Point> ptList, float32_t ptSize, float32_t* ptColor);
-    void DrawPolyLine(vector<cv::Point> ptList, float32_t lineWidth, float32_t* lineColor);
-    void DrawPolyLineDw(vector<dwVector2f> ptList, float32_t lineWidth, dwVector4f lineColor);
+    // Reads only frameCUDAHandle (the display surface is written by this call), safe while UpdateCamImg() runs
+    void RenderCamImg(dwImageHandle_t frameCUDAHandle);
+    void DrawBoundingBoxes(const vector<cv::Rect>& bbRectList, const vector<float32_t*>& bbColorList, float32_t lineWidth);
+    void DrawBoundingBoxesWithLabels(const vector<cv::Rect>& bbRectList, const vector<float32_t*>& bbColorList, const vector<const char*>& bbLabelList, float32_t lineWidth);
+    void DrawBoundingBoxesWithLabelsPerClass(const vector<vector<dwRectf> >& bbRectList, const vector<const float32_t*>& bbColorList, const vector<vector<const char*> >& bbLabelList, float32_t lineWidth);
+    void DrawPoints(const vector<cv::Point>& ptList, float32_t ptSize, float32_t* ptColor);
+    void DrawPolyLine(const vector<cv::Point>& ptList, float32_t lineWidth, float32_t* lineColor);
+    void DrawPolyLineDw(const vector<dwVector2f>& ptList, float32_t lineWidth, dwVector4f lineColor);
+    void DrawPolyLineDw(const dwVector2f* ptList, uint32_t numPts, float32_t lineWidth, dwVector4f lineColor);
     void DrawText(const char* text, cv::Point textPos, float32_t* textColor);
 
+    // Top-view tile (displayParameters::topViewTile) : BGR / RGBA host image, lines in its pixel coordinates
+    void RenderTopView(const cv::Mat& topViewImg);
+    void DrawTopViewPolyLineDw(const dwVector2f* ptList, uint32_t numPts, float32_t lineWidth, dwVector4f lineColor);
+
+    // Draw* append to this overlay, rendered by UpdateRendering() (FlushOverlay() for a flush without swap)
+    OverlayBatch& GetOverlay();
+    uint32_t FlushOverlay();
+
     void UpdateRendering();
 
     dwContextHandle_t GetDwContext();
     trtImgData GetTrtImgData();
+    int GetTrtImgWidth();           // TensorRT input size (CHW, 3 channels) : ROI of the resized image
+    int GetTrtImgHeight();
     matImgData GetCroppedMatImgData();
     matImgData GetOriMatImgData();
+    gpuMatImgData GetOriGpuMatImgData();
     dwImageCUDA* GetDwImageCuda();
 
+    // For frame pipelining : copy of the current RGBA camera frame into an image created with GetRGBAImgProperties()
+    // (nothing copied without an RGBA frame, see RequestRGBAFrame)
+    dwImageProperties GetRGBAImgProperties();
+    void CopyCamImg(dwImageCUDA* dstImg);
+
+    // Device buffers of px2Cam and of the modules built on it (px2LD)
+    DeviceArena* GetDeviceArena();
+
+    // Recording (write-file) policy, before Init
+    void SetRecorderParameters(cameraRecorderParameters recorderParams);
+    cameraRecorderStats GetRecorderStats();
+
+    // Fused inference input paths (RAW / YUV modes), before Init
+    void SetRawInferenceParameters(rawInferenceParameters rawInferParams);
+    void SetYuvInferenceParameters(yuvInferenceParameters yuvInferParams);
+
+    // Before Init : the RGBA frame (CopyCamImg, GetOri*) has a consumer besides the display and the recording.
+    // px2BEV, px2Rectifier and px2Pyramid request it when built, with a fused inference input and no consumer it is skipped.
+    void RequestRGBAFrame();
+    bool HasRGBAFrame();
+
+    // Per-stage latency sections (readFrame, isp, preprocess), null : disabled
+    void SetLatencyMonitor(LatencyMonitor* latencyMonitor);
+    LatencyMonitor* GetLatencyMonitor();
+
     void CoordTrans_Resize2Ori(int xIn, int yIn, int& xOut, int& yOut);
     void CoordTrans_ResizeAndCrop2Ori(float xIn, float yIn, float &xOut, float &yOut);
 
@@ -134,6 +214,8 @@ protected:
 
     void ReleaseModules();
 
+    uint32_t RenderOverlay(OverlayBatch& overlay);
+
 
 private:
     dwContextHandle_t mContext = DW_NULL_HANDLE;
@@ -141,16 +223,20 @@ private:
     dwRendererHandle_t mRenderer = DW_NULL_HANDLE;
     dwSensorHandle_t mCamera = DW_NULL_HANDLE;
     dwImageProperties mCamImgProp;
+    dwImageProperties mRGBAImgProp{};
     dwCameraProperties mCamProp;
     dwImageStreamerHandle_t mStreamerCUDA2GL = DW_NULL_HANDLE;
     dwCameraFrameHandle_t mFrameHandle = DW_NULL_HANDLE;
     dwImageHandle_t mFrameCUDAHandle = DW_NULL_HANDLE;
     dwImageHandle_t mFrameGLHandle = DW_NULL_HANDLE;
-    dwSensorSerializerHandle_t mSerializer = DW_NULL_HANDLE;
+    dwImageHandle_t mDisplayImgHandle = DW_NULL_HANDLE;    // Null : streamed at the frame size
+    dwImageCUDA* mDisplayImgCuda = nullptr;
+    CameraRecorder mRecorder;
 
     bool mRecordCamera = false;
     bool mResizeEnable = false;
     dwTegraMode mTegraMode = MASTER_TEGRA;
+    cameraRecorderParameters mRecorderParams;
 
     float mResizeRatio = 1.f;
     int mResizeWidth = CAM_IMG_WIDTH;
@@ -162,11 +248,24 @@ private:
 
     WindowBase* mWindow = nullptr;
     dwRenderEngineHandle_t mRenderEngine = DW_NULL_HANDLE;
+    OverlayBatch mOverlay;
+    vector<const char*> mOverlayLabels;
+
+    // Top-view tile
+    dwRectf mCamTileRect{};
+    dwRectf mTopViewCellRect{};
+    dwRectf mTopViewTileRect{};             // Cell area with the top-view aspect ratio
+    dwImageStreamerHandle_t mStreamerCPU2GL = DW_NULL_HANDLE;
+    dwImageHandle_t mTopViewImgHandle = DW_NULL_HANDLE;
+    dwImageProperties mTopViewImgProp{};
+    OverlayBatch mTopViewOverlay;
 
     uint32_t sibling = 0;
     dwTime_t timeout_us = 40000;
 
-    dwImageCUDA* mCamImgCuda;
+    dwImageCUDA* mCamImgCuda = nullptr;
+    DeviceArena mDeviceArena;
+
     uint8_t* mPitchedImgCudaRGBA;
     uint8_t* mGpuMat_data;
     cv::cuda::GpuMat mGpuMat;
@@ -182,6 +281,7 @@ private:
     trtImgData mCurTrtImgData;
     matImgData mCurCroppedMatImgData;
     matImgData mCurOriMatImgData;
+    gpuMatImgData mCurOriGpuMatImgData;
 
     displayParameters mDispParams;
     dwImageGL* mImgGl;
@@ -196,6 +296,21 @@ private:
     dwImageHandle_t mRawImageHandle = DW_NULL_HANDLE;
     dwImageHandle_t mRCBImageHandle = DW_NULL_HANDLE;
     dwImageProperties mRCBImgProp{};
+    rawInferenceParameters mRawInferParams;
+    bool mFusedRawInference = false;
+    tensorCropGeometry mInferTensorGeometry;
+
+    // For YUV
+    yuvInferenceParameters mYuvInferParams;
+    bool mFusedYuvInference = false;
+    dwImageHandle_t mYuvImageHandle = DW_NULL_HANDLE;
+    dwImageCUDA* mCamImgCudaYuv = nullptr;
+
+    // RGBA frame (SoftISP / DriveWorks), decided in InitPipeline() from its consumers
+    bool mRGBAFrameRequested = false;
+    bool mRGBAFrame = true;
+
+    LatencyMonitor* mLatencyMonitor = nullptr;
 
 };
 
@@ -0,0 +1,413 @@
+#include "px2compositor.h"
+#include "px2log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static double NowMs()
+{
+    return chrono::duration_cast<chrono::duration<double, milli> >(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void ToColor8(const dwVector4f& color, uint8_t* color8)
+{
+    color8[0] = (uint8_t)(min(max(color.x, 0.f), 1.f)*255.f + 0.5f);
+    color8[1] = (uint8_t)(min(max(color.y, 0.f), 1.f)*255.f + 0.5f);
+    color8[2] = (uint8_t)(min(max(color.z, 0.f), 1.f)*255.f + 0.5f);
+    color8[3] = (uint8_t)(min(max(color.w, 0.f), 1.f)*255.f + 0.5f);
+}
+
+// dst = (src*a + dst*(255 - a))/255, rounded, on the RGBA pixels [x0, x1) of a row.
+// The destination alpha goes to 255 the same way.
+static void FillSpan(uint8_t* row, int x0, int x1, const uint8_t* color)
+{
+    const uint32_t alpha = color[3];
+
+    if(alpha == 255)
+    {
+        uint32_t pixel;
+        memcpy(&pixel, color, 4);
+        uint32_t* dst = reinterpret_cast<uint32_t*>(row) + x0;
+        fill(dst, dst + (x1 - x0), pixel);
+        return;
+    }
+    if(alpha == 0)
+        return;
+
+    const uint16_t invAlpha = 255 - alpha;
+    const uint16_t srcTerm[4] = {(uint16_t)(color[0]*alpha), (uint16_t)(color[1]*alpha), (uint16_t)(color[2]*alpha), (uint16_t)(255*alpha)};
+
+    uint8_t* dst = row + 4*x0;
+    int x = x0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i invAlpha8 = _mm_set1_epi16(invAlpha);
+    const __m128i srcTerm8 = _mm_setr_epi16(srcTerm[0], srcTerm[1], srcTerm[2], srcTerm[3],
+                                            srcTerm[0], srcTerm[1], srcTerm[2], srcTerm[3]);
+    const __m128i round8 = _mm_set1_epi16(128);
+    for(; x + 4 <= x1; x += 4, dst += 16)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), invAlpha8), srcTerm8), round8);
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), invAlpha8), srcTerm8), round8);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__aarch64__)
+    const uint8x8_t invAlpha8 = vdup_n_u8((uint8_t)invAlpha);
+    const uint16x8_t srcTerm8 = {srcTerm[0], srcTerm[1], srcTerm[2], srcTerm[3],
+                                 srcTerm[0], srcTerm[1], srcTerm[2], srcTerm[3]};
+    const uint16x8_t round8 = vdupq_n_u16(128);
+    for(; x + 4 <= x1; x += 4, dst += 16)
+    {
+        uint8x16_t pixels = vld1q_u8(dst);
+        uint16x8_t lo = vaddq_u16(vmlal_u8(srcTerm8, vget_low_u8(pixels), invAlpha8), round8);
+        uint16x8_t hi = vaddq_u16(vmlal_u8(srcTerm8, vget_high_u8(pixels), invAlpha8), round8);
+        lo = vaddq_u16(lo, vshrq_n_u16(lo, 8));
+        hi = vaddq_u16(hi, vshrq_n_u16(hi, 8));
+        vst1q_u8(dst, vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+#endif
+
+    for(; x < x1; x++, dst += 4)
+    {
+        for(int c = 0; c < 4; c++)
+        {
+            uint32_t blend = srcTerm[c] + dst[c]*invAlpha + 128;
+            dst[c] = (uint8_t)((blend + (blend >> 8)) >> 8);
+        }
+    }
+}
+
+OverlayCompositor::OverlayCompositor()
+{
+}
+
+OverlayCompositor::~OverlayCompositor()
+{
+    Release();
+}
+
+void OverlayCompositor::SetParameters(compositorParameters params)
+{
+    mParams = params;
+}
+
+void OverlayCompositor::FillRect(cv::Mat& rgba, int x0, int y0, int x1, int y1, const uint8_t* color)
+{
+    x0 = max(x0, 0);
+    y0 = max(y0, 0);
+    x1 = min(x1, rgba.cols);
+    y1 = min(y1, rgba.rows);
+    if((x0 >= x1) || (y0 >= y1))
+        return;
+
+    for(int y = y0; y < y1; y++)
+        FillSpan(rgba.ptr<uint8_t>(y), x0, x1, color);
+}
+
+// Outline inside the box, the 4 sides do not overlap (translucent colors are blended once)
+void OverlayCompositor::DrawRect(cv::Mat& rgba, float32_t x, float32_t y, float32_t width, float32_t height, float32_t lineWidth,
+                                 const uint8_t* color)
+{
+    int x0 = lround(x);
+    int y0 = lround(y);
+    int x1 = lround(x + width);
+    int y1 = lround(y + height);
+    int lw = max<int>(lround(lineWidth), 1);
+
+    if((x1 - x0 <= 2*lw) || (y1 - y0 <= 2*lw))
+    {
+        FillRect(rgba, x0, y0, x1, y1, color);
+        return;
+    }
+
+    FillRect(rgba, x0, y0, x1, y0 + lw, color);
+    FillRect(rgba, x0, y1 - lw, x1, y1, color);
+    FillRect(rgba, x0, y0 + lw, x0 + lw, y1 - lw, color);
+    FillRect(rgba, x1 - lw, y0 + lw, x1, y1 - lw, color);
+}
+
+// Segment with square caps : a convex quad, filled by rows (pixel centers inside)
+void OverlayCompositor::DrawSegment(cv::Mat& rgba, float32_t x0, float32_t y0, float32_t x1, float32_t y1, float32_t lineWidth,
+                                    const uint8_t* color)
+{
+    float32_t halfWidth = max(lineWidth, 1.f)*0.5f;
+
+    float32_t dx = x1 - x0;
+    float32_t dy = y1 - y0;
+    float32_t length = sqrt(dx*dx + dy*dy);
+    if(length > 0.f)
+    {
+        dx *= halfWidth/length;
+        dy *= halfWidth/length;
+    }
+    else
+    {
+        dx = halfWidth;
+        dy = 0.f;
+    }
+
+    // Direction (dx, dy), normal (-dy, dx), both halfWidth long
+    const float32_t quadX[4] = {x0 - dx - dy, x1 + dx - dy, x1 + dx + dy, x0 - dx + dy};
+    const float32_t quadY[4] = {y0 - dy + dx, y1 + dy + dx, y1 + dy - dx, y0 - dy - dx};
+
+    float32_t minY = *min_element(quadY, quadY + 4);
+    float32_t maxY = *max_element(quadY, quadY + 4);
+    int rowBegin = max<int>(ceil(minY - 0.5f), 0);
+    int rowEnd = min<int>(ceil(maxY - 0.5f), rgba.rows);
+
+    for(int row = rowBegin; row < rowEnd; row++)
+    {
+        float32_t yc = row + 0.5f;
+        float32_t spanMin = 1e30f;
+        float32_t spanMax = -1e30f;
+        for(int edge = 0; edge < 4; edge++)
+        {
+            float32_t ya = quadY[edge];
+            float32_t yb = quadY[(edge + 1) % 4];
+            if(((ya <= yc) && (yb > yc)) || ((yb <= yc) && (ya > yc)))
+            {
+                float32_t xa = quadX[edge];
+                float32_t xb = quadX[(edge + 1) % 4];
+                float32_t xc = xa + (yc - ya)*(xb - xa)/(yb - ya);
+                spanMin = min(spanMin, xc);
+                spanMax = max(spanMax, xc);
+            }
+        }
+        if(spanMin > spanMax)
+            continue;
+
+        int spanBegin = max<int>(ceil(spanMin - 0.5f), 0);
+        int spanEnd = min<int>(ceil(spanMax - 0.5f), rgba.cols);
+        if(spanBegin < spanEnd)
+            FillSpan(rgba.ptr<uint8_t>(row), spanBegin, spanEnd, color);
+    }
+}
+
+void OverlayCompositor::DrawInset(cv::Mat& rgba, const cv::Mat& topView)
+{
+    int insetHeight = lround(rgba.rows*mParams.insetScale);
+    int insetWidth = lround((float32_t)insetHeight*topView.cols/topView.rows);
+    if((insetHeight <= 0) || (insetWidth <= 0))
+        return;
+
+    cv::Rect insetRect(rgba.cols - insetWidth - mParams.insetMargin, rgba.rows - insetHeight - mParams.insetMargin,
+                       insetWidth, insetHeight);
+    insetRect &= cv::Rect(0, 0, rgba.cols, rgba.rows);
+    if(insetRect.area() == 0)
+        return;
+
+    cv::resize(topView, mInset, insetRect.size(), 0, 0, cv::INTER_AREA);
+    if(mInset.channels() != 4)
+        cv::cvtColor(mInset, mInset, (mInset.channels() == 3) ? cv::COLOR_BGR2RGBA : cv::COLOR_GRAY2RGBA);
+    mInset.copyTo(rgba(insetRect));
+}
+
+void OverlayCompositor::Compose(cv::Mat& rgba, const OverlayBatch& overlay, const cv::Mat& topView)
+{
+    if(rgba.empty() || (rgba.type() != CV_8UC4))
+        return;
+
+    float32_t scaleX = (mParams.coordWidth > 0.f) ? rgba.cols/mParams.coordWidth : 1.f;
+    float32_t scaleY = (mParams.coordHeight > 0.f) ? rgba.rows/mParams.coordHeight : 1.f;
+
+    if(!topView.empty())
+        DrawInset(rgba, topView);
+
+    uint8_t color[4];
+    for(const overlayBatch& batch : overlay.GetBatches())
+    {
+        ToColor8(batch.color, color);
+
+        switch(batch.primitive)
+        {
+        case OVERLAY_BOXES:
+        case OVERLAY_LABELED_BOXES:
+            for(uint32_t boxIdx = 0; boxIdx < batch.boxes.size(); boxIdx++)
+            {
+                const dwRectf& box = batch.boxes[boxIdx];
+                DrawRect(rgba, box.x*scaleX, box.y*scaleY, box.width*scaleX, box.height*scaleY, batch.size, color);
+
+                if(batch.primitive == OVERLAY_LABELED_BOXES)
+                {
+                    cv::Point labelPos(lround(box.x*scaleX), max<int>(lround(box.y*scaleY) - 3, 10));
+                    cv::putText(rgba, overlay.GetText(batch.labelOffsets[boxIdx]), labelPos, cv::FONT_HERSHEY_SIMPLEX,
+                                mParams.textScale, cv::Scalar(color[0], color[1], color[2], 255));
+                }
+            }
+            break;
+        case OVERLAY_LINES:
+            for(uint32_t vertexIdx = 0; vertexIdx + 1 < batch.vertices.size(); vertexIdx += 2)
+            {
+                const dwVector2f& begin = batch.vertices[vertexIdx];
+                const dwVector2f& end = batch.vertices[vertexIdx + 1];
+                DrawSegment(rgba, begin.x*scaleX, begin.y*scaleY, end.x*scaleX, end.y*scaleY, batch.size, color);
+            }
+            break;
+        case OVERLAY_POINTS:
+            {
+                float32_t halfSize = max(batch.size, 1.f)*0.5f;
+                for(const dwVector2f& point : batch.vertices)
+                {
+                    FillRect(rgba, lround(point.x*scaleX - halfSize), lround(point.y*scaleY - halfSize),
+                             lround(point.x*scaleX + halfSize), lround(point.y*scaleY + halfSize), color);
+                }
+            }
+            break;
+        }
+    }
+
+    for(const overlayText& text : overlay.GetTexts())
+    {
+        ToColor8(text.color, color);
+        cv::Point textPos(lround(text.position.x*scaleX), lround(text.position.y*scaleY));
+        cv::putText(rgba, overlay.GetText(text.textOffset), textPos, cv::FONT_HERSHEY_SIMPLEX,
+                    mParams.textScale, cv::Scalar(color[0], color[1], color[2], 255));
+    }
+}
+
+bool OverlayCompositor::Init(compositorParameters params, compositorSink sink)
+{
+    Release();
+
+    mParams = params;
+    mParams.queueCapacity = max<uint32_t>(mParams.queueCapacity, 1);
+    mSink = sink;
+
+    mSlots.assign(mParams.queueCapacity, compositorSlot());
+    mFreeSlots.clear();
+    mQueuedSlots.clear();
+    for(uint32_t slotIdx = 0; slotIdx < mSlots.size(); slotIdx++)
+        mFreeSlots.push_back(slotIdx);
+
+    mStats = compositorStats();
+    mComposeMsSum = 0.0;
+
+    mRunning = true;
+    mWorker = thread(&OverlayCompositor::Worker, this);
+
+    return true;
+}
+
+bool OverlayCompositor::Submit(const cv::Mat& frame, const OverlayBatch& overlay, const cv::Mat& topView, uint64_t frameIdx,
+                               uint64_t timestamp_us)
+{
+    if((frame.type() != CV_8UC4) && (frame.type() != CV_8UC3))
+        return false;
+
+    uint32_t slotIdx;
+    {
+        unique_lock<mutex> lock(mMutex);
+        if(!mRunning)
+            return false;
+
+        mStats.numSubmitted++;
+        if(mFreeSlots.empty())
+        {
+            if(mParams.dropWhenFull)
+            {
+                mStats.numDropped++;
+                return false;
+            }
+            mCond.wait(lock, [this]{ return !mFreeSlots.empty() || !mRunning; });
+            if(!mRunning)
+                return false;
+        }
+
+        slotIdx = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+
+    // The slot is ours until queued : copies into its buffers (no allocation at a constant frame size)
+    compositorSlot& slot = mSlots[slotIdx];
+    if(frame.channels() == 3)
+        cv::cvtColor(frame, slot.frame, cv::COLOR_BGR2RGBA);
+    else
+        frame.copyTo(slot.frame);
+    if(topView.empty())
+        slot.topView.release();
+    else
+        topView.copyTo(slot.topView);
+    slot.overlay = overlay;
+    slot.frameIdx = frameIdx;
+    slot.timestamp_us = timestamp_us;
+
+    {
+        lock_guard<mutex> lock(mMutex);
+        mQueuedSlots.push_back(slotIdx);
+    }
+    mCond.notify_all();
+
+    return true;
+}
+
+void OverlayCompositor::Worker()
+{
+    while(true)
+    {
+        uint32_t slotIdx;
+        {
+            unique_lock<mutex> lock(mMutex);
+            mCond.wait(lock, [this]{ return !mQueuedSlots.empty() || !mRunning; });
+            if(mQueuedSlots.empty())
+                return;
+
+            slotIdx = mQueuedSlots.front();
+            mQueuedSlots.erase(mQueuedSlots.begin());
+        }
+
+        compositorSlot& slot = mSlots[slotIdx];
+
+        double beginMs = NowMs();
+        Compose(slot.frame, slot.overlay, slot.topView);
+        if(mSink)
+            mSink(slot.frame, slot.frameIdx, slot.timestamp_us);
+        float composeMs = NowMs() - beginMs;
+
+        {
+            lock_guard<mutex> lock(mMutex);
+            mStats.numComposed++;
+            mComposeMsSum += composeMs;
+            mStats.composeMsMax = max(mStats.composeMsMax, composeMs);
+            mFreeSlots.push_back(slotIdx);
+        }
+        mCond.notify_all();
+    }
+}
+
+void OverlayCompositor::Release()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        if(!mRunning)
+            return;
+        mRunning = false;
+    }
+    mCond.notify_all();
+
+    if(mWorker.joinable())
+        mWorker.join();
+
+    compositorStats stats = GetStats();
+    PX2_LOG_INFO("[COMPOSITOR] composed %llu/%llu, dropped %llu, compose %.1fms (max %.1fms)",
+                 stats.numComposed, stats.numSubmitted, stats.numDropped, stats.composeMsAvg, stats.composeMsMax);
+}
+
+compositorStats OverlayCompositor::GetStats()
+{
+    lock_guard<mutex> lock(mMutex);
+    compositorStats stats = mStats;
+    stats.composeMsAvg = (stats.numComposed > 0) ? mComposeMsSum/stats.numComposed : 0.0;
+    return stats;
+}
@@ -0,0 +1,105 @@
+#ifndef PX2COMPOSITOR_H
+#define PX2COMPOSITOR_H
+
+#include "common_cv.h"
+#include "px2overlay.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Headless overlay compositor : draws an OverlayBatch (boxes, labels, lanes, points, texts) and a top-view inset
+ * onto an RGBA cv::Mat on the CPU, without window, GL context or render engine.
+ * Spans are alpha blended with SSE2 / NEON (scalar otherwise, same rounding), labels and texts use cv::putText.
+ *
+ * Compose() draws in place on the calling thread. Init() + Submit() run it on a worker thread : the frame,
+ * the overlay and the top view are copied into one of queueCapacity preallocated slots and the composed frame
+ * is handed to the sink (video encoder, PNG sequence...) on the worker thread.
+ *
+ *    OverlayCompositor compositor;
+ *    compositor.Init(compositorParameters(), [&](const cv::Mat& rgba, uint64_t frameIdx, uint64_t timestamp_us){ ... });
+ *    compositor.Submit(frameRGBA, overlay, topView, frameIdx, timestamp_us);
+ */
+
+typedef struct {
+    float32_t coordWidth = 0.f;     // Overlay coordinate range (render engine range), 0 : the frame size
+    float32_t coordHeight = 0.f;
+    float32_t insetScale = 0.3f;    // Top-view inset height / frame height, placed at the bottom right
+    int insetMargin = 8;
+    double textScale = 0.5;         // cv::putText font scale
+    uint32_t queueCapacity = 4;     // Submit slots
+    bool dropWhenFull = true;       // False : Submit waits for a free slot
+}compositorParameters;
+
+typedef struct {
+    uint64_t numSubmitted = 0;
+    uint64_t numComposed = 0;
+    uint64_t numDropped = 0;
+    float composeMsAvg = 0.f;       // Compose() + sink
+    float composeMsMax = 0.f;
+}compositorStats;
+
+// Runs on the worker thread, rgba is only valid during the call
+typedef function<void(const cv::Mat& rgba, uint64_t frameIdx, uint64_t timestamp_us)> compositorSink;
+
+class OverlayCompositor{
+public:
+    OverlayCompositor();
+    ~OverlayCompositor();
+
+    void SetParameters(compositorParameters params);
+
+    // rgba : CV_8UC4, topView : CV_8UC4 / CV_8UC3 / CV_8UC1, may be empty
+    void Compose(cv::Mat& rgba, const OverlayBatch& overlay, const cv::Mat& topView);
+
+    bool Init(compositorParameters params, compositorSink sink);
+
+    // frame : CV_8UC4 or CV_8UC3 (BGR, converted). False : dropped (queue full) or not started
+    bool Submit(const cv::Mat& frame, const OverlayBatch& overlay, const cv::Mat& topView, uint64_t frameIdx, uint64_t timestamp_us);
+
+    // Composes the queued frames and stops the worker
+    void Release();
+
+    compositorStats GetStats();
+
+    // Drawing primitives, in output pixels ; color : RGBA 0-255
+    static void FillRect(cv::Mat& rgba, int x0, int y0, int x1, int y1, const uint8_t* color);
+    static void DrawRect(cv::Mat& rgba, float32_t x, float32_t y, float32_t width, float32_t height, float32_t lineWidth, const uint8_t* color);
+    static void DrawSegment(cv::Mat& rgba, float32_t x0, float32_t y0, float32_t x1, float32_t y1, float32_t lineWidth, const uint8_t* color);
+
+private:
+    typedef struct {
+        cv::Mat frame;
+        OverlayBatch overlay;
+        cv::Mat topView;
+        uint64_t frameIdx;
+        uint64_t timestamp_us;
+    }compositorSlot;
+
+    void DrawInset(cv::Mat& rgba, const cv::Mat& topView);
+    void Worker();
+
+private:
+    compositorParameters mParams;
+    compositorSink mSink;
+    cv::Mat mInset;
+
+    vector<compositorSlot> mSlots;
+    vector<uint32_t> mFreeSlots;
+    vector<uint32_t> mQueuedSlots;      // FIFO
+    mutex mMutex;
+    condition_variable mCond;
+    thread mWorker;
+    bool mRunning = false;
+
+    compositorStats mStats;
+    double mComposeMsSum = 0.0;
+};
+
+#endif // PX2COMPOSITOR_H
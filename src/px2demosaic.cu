@@ -0,0 +1,176 @@
+#include "px2demosaic.h"
+
+#include <cmath>
+
+// Shared by the kernel and the host reference
+
+__host__ __device__
+inline float ClampIndex(float value, int count)
+{
+    return fminf(fmaxf(value, 0.f), (float)(count - 1));
+}
+
+// Bilinear on one CFA lattice : samples at (2*i + offsetX, 2*j + offsetY)
+__host__ __device__
+inline float SampleLattice(const uint8_t* raw, size_t rawPitch, int rawWidth, int rawHeight,
+                           int offsetX, int offsetY, float sx, float sy)
+{
+    int numX = (rawWidth - offsetX + 1)/2;
+    int numY = (rawHeight - offsetY + 1)/2;
+    float lx = ClampIndex((sx - offsetX)*0.5f, numX);
+    float ly = ClampIndex((sy - offsetY)*0.5f, numY);
+
+    int x0 = (int)lx;
+    int y0 = (int)ly;
+    int x1 = (x0 + 1 < numX) ? x0 + 1 : x0;
+    int y1 = (y0 + 1 < numY) ? y0 + 1 : y0;
+    float fx = lx - (float)x0;
+    float fy = ly - (float)y0;
+
+    const uint16_t* row0 = (const uint16_t*)(raw + (2*y0 + offsetY)*rawPitch);
+    const uint16_t* row1 = (const uint16_t*)(raw + (2*y1 + offsetY)*rawPitch);
+    float top = (1.f - fx)*row0[2*x0 + offsetX] + fx*row0[2*x1 + offsetX];
+    float bottom = (1.f - fx)*row1[2*x0 + offsetX] + fx*row1[2*x1 + offsetX];
+    return (1.f - fy)*top + fy*bottom;
+}
+
+// R, C (mean of the 2 sites), B of a 2x2 quad
+__host__ __device__
+inline void QuadRCB(const uint8_t* raw, size_t rawPitch, int redX, int redY, int qx, int qy, float* rcb)
+{
+    const uint16_t* row0 = (const uint16_t*)(raw + 2*qy*rawPitch) + 2*qx;
+    const uint16_t* row1 = (const uint16_t*)(raw + (2*qy + 1)*rawPitch) + 2*qx;
+    const uint16_t* redRow = redY ? row1 : row0;
+    const uint16_t* blueRow = redY ? row0 : row1;
+
+    rcb[0] = redRow[redX];
+    rcb[1] = 0.5f*((float)redRow[1 - redX] + (float)blueRow[redX]);
+    rcb[2] = blueRow[1 - redX];
+}
+
+__host__ __device__
+inline void SampleQuads(const uint8_t* raw, size_t rawPitch, int rawWidth, int rawHeight,
+                        int redX, int redY, float sx, float sy, float* rcb)
+{
+    // Quad (qx, qy) is centered on raw (2*qx + 0.5, 2*qy + 0.5)
+    int numX = rawWidth/2;
+    int numY = rawHeight/2;
+    float qx = ClampIndex((sx - 0.5f)*0.5f, numX);
+    float qy = ClampIndex((sy - 0.5f)*0.5f, numY);
+
+    int x0 = (int)qx;
+    int y0 = (int)qy;
+    int x1 = (x0 + 1 < numX) ? x0 + 1 : x0;
+    int y1 = (y0 + 1 < numY) ? y0 + 1 : y0;
+    float fx = qx - (float)x0;
+    float fy = qy - (float)y0;
+
+    float q00[3], q01[3], q10[3], q11[3];
+    QuadRCB(raw, rawPitch, redX, redY, x0, y0, q00);
+    QuadRCB(raw, rawPitch, redX, redY, x1, y0, q01);
+    QuadRCB(raw, rawPitch, redX, redY, x0, y1, q10);
+    QuadRCB(raw, rawPitch, redX, redY, x1, y1, q11);
+
+    for(int c = 0; c < 3; c++)
+    {
+        float top = (1.f - fx)*q00[c] + fx*q01[c];
+        float bottom = (1.f - fx)*q10[c] + fx*q11[c];
+        rcb[c] = (1.f - fy)*top + fy*bottom;
+    }
+}
+
+__host__ __device__
+inline float ToneCurve(float value, float gamma)
+{
+    return powf(fminf(fmaxf(value, 0.f), 1.f), gamma);
+}
+
+// Tensor pixel (x, y) -> RGB 0-1
+__host__ __device__
+inline void DemosaicPixel(const uint8_t* raw, size_t rawPitch, int rawWidth, int rawHeight,
+                          const rccbDemosaicParameters& params, const tensorCropGeometry& geometry,
+                          int x, int y, float* rgb)
+{
+    float sx = ((float)(geometry.roiX + x) + 0.5f)/geometry.scaleX - 0.5f;
+    float sy = ((float)(geometry.roiY + y) + 0.5f)/geometry.scaleY - 0.5f;
+
+    float rcb[3];
+    if(geometry.halfRes)
+    {
+        SampleQuads(raw, rawPitch, rawWidth, rawHeight, params.redX, params.redY, sx, sy, rcb);
+    }
+    else
+    {
+        int blueX = 1 - params.redX;
+        int blueY = 1 - params.redY;
+        rcb[0] = SampleLattice(raw, rawPitch, rawWidth, rawHeight, params.redX, params.redY, sx, sy);
+        rcb[1] = 0.5f*(SampleLattice(raw, rawPitch, rawWidth, rawHeight, blueX, params.redY, sx, sy) +
+                       SampleLattice(raw, rawPitch, rawWidth, rawHeight, params.redX, blueY, sx, sy));
+        rcb[2] = SampleLattice(raw, rawPitch, rawWidth, rawHeight, blueX, blueY, sx, sy);
+    }
+
+    float scale = 1.f/(params.whiteLevel - params.blackLevel);
+    float r = (rcb[0] - params.blackLevel)*scale*params.gainR;
+    float c = (rcb[1] - params.blackLevel)*scale*params.gainC;
+    float b = (rcb[2] - params.blackLevel)*scale*params.gainB;
+
+    rgb[0] = ToneCurve(r, params.gamma);
+    rgb[1] = ToneCurve(c - r - b, params.gamma);
+    rgb[2] = ToneCurve(b, params.gamma);
+}
+
+__host__ __device__
+inline void StoreTensorPixel(const float* rgb, int x, int y, int roiW, int roiH, float* tensor, uint8_t* bgr)
+{
+    int j = y*roiW + x;
+    for(int c = 0; c < 3; c++)
+    {
+        tensor[c*roiH*roiW + j] = rgb[c];
+        if(bgr)
+            bgr[j*3 + 2 - c] = (uint8_t)(rgb[c]*255.f + 0.5f);
+    }
+}
+
+__global__
+void DemosaicRCCB2Tensor(const uint8_t* raw, size_t rawPitch, int rawWidth, int rawHeight,
+                         rccbDemosaicParameters params, tensorCropGeometry geometry,
+                         float* tensor, uint8_t* bgr)
+{
+    int xIndex = blockIdx.x*blockDim.x + threadIdx.x;
+    int yIndex = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if((xIndex < geometry.roiW) && (yIndex < geometry.roiH))
+    {
+        float rgb[3];
+        DemosaicPixel(raw, rawPitch, rawWidth, rawHeight, params, geometry, xIndex, yIndex, rgb);
+        StoreTensorPixel(rgb, xIndex, yIndex, geometry.roiW, geometry.roiH, tensor, bgr);
+    }
+}
+
+void DemosaicRCCB(const uint16_t* raw, size_t rawPitch, int rawWidth, int rawHeight,
+                  const rccbDemosaicParameters& params, const tensorCropGeometry& geometry,
+                  float* tensor, uint8_t* bgr, cudaStream_t stream)
+{
+    const dim3 block(16,16);
+    const dim3 grid((geometry.roiW + block.x - 1)/block.x, (geometry.roiH + block.y - 1)/block.y);
+
+    DemosaicRCCB2Tensor <<< grid, block, 0, stream >>> ((const uint8_t*)raw, rawPitch, rawWidth, rawHeight,
+                                                        params, geometry, tensor, bgr);
+}
+
+void DemosaicRCCBHost(const cv::Mat& raw, const rccbDemosaicParameters& params, const tensorCropGeometry& geometry,
+                      vector<float>& tensor, cv::Mat& bgr)
+{
+    tensor.resize(3*geometry.roiH*geometry.roiW);
+    bgr.create(geometry.roiH, geometry.roiW, CV_8UC3);
+
+    for(int y = 0; y < geometry.roiH; y++)
+    {
+        for(int x = 0; x < geometry.roiW; x++)
+        {
+            float rgb[3];
+            DemosaicPixel(raw.data, raw.step, raw.cols, raw.rows, params, geometry, x, y, rgb);
+            StoreTensorPixel(rgb, x, y, geometry.roiW, geometry.roiH, tensor.data(), bgr.data);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef PX2DEMOSAIC_H
+#define PX2DEMOSAIC_H
+
+#include "common_cv.h"
+
+#include <cuda_runtime.h>
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Fused RCCB demosaic for inference : raw sensor frame -> resized / cropped TensorRT input in one kernel,
+ * without the SoftISP RGBA frame and the BGR -> resize -> crop chain behind it.
+ *
+ * Every tensor pixel is sampled at its position in the raw frame (resize then crop, pixel centers as cv::cuda::resize) :
+ *    full res : R, B and the two C sites bilinear on their own CFA lattice
+ *    half res : one RGB per 2x2 quad, bilinear between quads (resize ratio <= 0.5 : the network is smaller than the quads)
+ * then black / white level, per channel gains, G = C - R - B (clear ~ R + G + B) and a global gamma curve.
+ * This is a fixed tonemap, not the adaptive SoftISP one.
+ *
+ * Outputs : CHW float RGB 0-1 (px2Cam::GetTrtImgData() layout) and optionally the cropped BGR 8bit image.
+ * DemosaicRCCBHost() is the host reference of DemosaicRCCB() (same sampling, same rounding).
+ */
+
+typedef struct {
+    float blackLevel = 0.f;
+    float whiteLevel = 4095.f;      // 12bit sensor data
+    float gainR = 1.f;
+    float gainC = 1.f;
+    float gainB = 1.f;
+    float gamma = 1.f/2.2f;
+    int redX = 0;                   // Position of R in the 2x2 CFA quad (RCCB : 0, 0), B on the diagonal, C elsewhere
+    int redY = 0;
+}rccbDemosaicParameters;
+
+// Resize then crop of the camera frame into the tensor (px2demosaic, px2yuv)
+typedef struct {
+    float scaleX = 1.f;             // Resized size / frame size
+    float scaleY = 1.f;
+    int roiX = 0;                   // Crop in the resized image = tensor size
+    int roiY = 0;
+    int roiW = 0;
+    int roiH = 0;
+    bool halfRes = false;           // Sampled on the 2x2 quad grid (Bayer quads, 4:2:0 chroma)
+}tensorCropGeometry;
+
+// raw : 16bit samples, rawPitch in bytes ; tensor : 3*roiH*roiW ; bgr : roiW*3 bytes per row, may be null
+void DemosaicRCCB(const uint16_t* raw, size_t rawPitch, int rawWidth, int rawHeight,
+                  const rccbDemosaicParameters& params, const tensorCropGeometry& geometry,
+                  float* tensor, uint8_t* bgr, cudaStream_t stream = 0);
+
+// raw : CV_16UC1 ; bgr : CV_8UC3 roiH x roiW
+void DemosaicRCCBHost(const cv::Mat& raw, const rccbDemosaicParameters& params, const tensorCropGeometry& geometry,
+                      vector<float>& tensor, cv::Mat& bgr);
+
+#endif // PX2DEMOSAIC_H
@@ -0,0 +1,413 @@
+#include "px2framedump.h"
+#include "px2log.h"
+
+#include <lodepng.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+
+static double NowMs()
+{
+    return chrono::duration_cast<chrono::duration<double, milli> >(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameDumper::FrameDumper()
+{
+}
+
+FrameDumper::~FrameDumper()
+{
+    Release();
+}
+
+bool FrameDumper::Init(frameDumpParameters params)
+{
+    Release();
+
+    mParams = params;
+    mParams.numStagingSlots = max<uint32_t>(mParams.numStagingSlots, 1);
+    mParams.numWorkers = max<uint32_t>(mParams.numWorkers, 1);
+
+    if((mkdir(mParams.directory.c_str(), 0755) != 0) && (errno != EEXIST))
+    {
+        cout << "[FRAMEDUMP] Cannot create " << mParams.directory << endl;
+        return false;
+    }
+
+    mSlots.assign(mParams.numStagingSlots, dumpSlot());
+    mFreeSlots.clear();
+    mQueuedSlots.clear();
+    for(uint32_t slotIdx = 0; slotIdx < mSlots.size(); slotIdx++)
+    {
+        dumpSlot& slot = mSlots[slotIdx];
+        if((cudaMallocHost(&slot.hostData, mParams.stagingSlotBytes) != cudaSuccess) ||
+           (cudaEventCreateWithFlags(&slot.copyDone, cudaEventDisableTiming) != cudaSuccess))
+        {
+            cout << "[FRAMEDUMP] Staging slot allocation fail (" << mParams.stagingSlotBytes << " bytes)" << endl;
+            Release();
+            return false;
+        }
+        mFreeSlots.push_back(slotIdx);
+    }
+
+    pngEncoderParameters pngParams;
+    pngParams.mode = mParams.pngMode;
+    pngParams.compressionLevel = mParams.compressionLevel;
+    pngParams.numThreads = mParams.pngThreads;
+    mPngEncoder.Init(pngParams);
+
+    mStats = frameDumpStats();
+    mEncodeMsSum = 0.0;
+    mStop = false;
+
+    for(uint32_t workerIdx = 0; workerIdx < mParams.numWorkers; workerIdx++)
+        mWorkers.push_back(thread(&FrameDumper::Worker, this));
+
+    mAnnotatedTags.clear();
+    mCompositor.Init(mParams.annotateParams, [this](const cv::Mat& rgba, uint64_t frameIdx, uint64_t)
+    {
+        WriteAnnotated(rgba, frameIdx);
+    });
+
+    return true;
+}
+
+void FrameDumper::Release()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStop = true;
+    }
+    mCond.notify_all();
+
+    for(thread& worker : mWorkers)
+        worker.join();
+
+    // Composes and writes the queued annotated frames (PNG encoder still running)
+    mCompositor.Release();
+
+    bool printStats = !mWorkers.empty();
+    mWorkers.clear();
+    mPngEncoder.Release();
+
+    for(dumpSlot& slot : mSlots)
+    {
+        if(slot.copyDone)
+            cudaEventDestroy(slot.copyDone);
+        if(slot.hostData)
+            cudaFreeHost(slot.hostData);
+    }
+    mSlots.clear();
+    mFreeSlots.clear();
+
+    if(printStats)
+    {
+        frameDumpStats stats = GetStats();
+        PX2_LOG_INFO("[FRAMEDUMP] dumped %llu/%llu, dropped %llu, errors %llu, %.1fMB written, encode %.1fms (max %.1fms)",
+                     stats.numDumped, stats.numRequested, stats.numDropped, stats.numErrors,
+                     stats.bytesWritten/1048576.0, stats.encodeMsAvg, stats.encodeMsMax);
+    }
+}
+
+bool FrameDumper::Dump(const void* devPtr, size_t pitch, uint32_t width, uint32_t height, dumpPixelFormat pixelFormat,
+                       uint32_t bytesPerPixel, const string& tag, uint64_t frameIdx, cudaStream_t stream)
+{
+    size_t rowBytes = (size_t)width*bytesPerPixel;
+
+    uint32_t slotIdx;
+    {
+        lock_guard<mutex> lock(mMutex);
+        if(mWorkers.empty() || mStop)
+            return false;
+
+        mStats.numRequested++;
+        if(mFreeSlots.empty() || (rowBytes*height > mParams.stagingSlotBytes))
+        {
+            mStats.numDropped++;
+            return false;
+        }
+
+        slotIdx = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+
+    dumpSlot& slot = mSlots[slotIdx];
+    slot.width = width;
+    slot.height = height;
+    slot.bytesPerPixel = bytesPerPixel;
+    slot.pixelFormat = pixelFormat;
+    slot.tag = tag;
+    slot.frameIdx = frameIdx;
+
+    // The only work on the caller's thread : packed rows into the pinned slot, and the event the worker waits for
+    cudaError_t status = cudaMemcpy2DAsync(slot.hostData, rowBytes, devPtr, pitch, rowBytes, height, cudaMemcpyDeviceToHost, stream);
+    if(status == cudaSuccess)
+        status = cudaEventRecord(slot.copyDone, stream);
+
+    {
+        lock_guard<mutex> lock(mMutex);
+        if(status != cudaSuccess)
+        {
+            mStats.numErrors++;
+            mFreeSlots.push_back(slotIdx);
+            return false;
+        }
+        mQueuedSlots.push_back(slotIdx);
+    }
+    mCond.notify_one();
+
+    return true;
+}
+
+bool FrameDumper::Dump(const dwImageCUDA* img, const string& tag, uint64_t frameIdx, cudaStream_t stream)
+{
+    if(img->prop.format != DW_IMAGE_FORMAT_RGBA_UINT8)
+    {
+        PX2_LOG_WARN_RATE(1, "[FRAMEDUMP] Only RGBA_UINT8 dwImageCUDA can be dumped");
+        return false;
+    }
+
+    return Dump(img->dptr[0], img->pitch[0], img->prop.width, img->prop.height, DUMP_PIXEL_RGBA8, 4, tag, frameIdx, stream);
+}
+
+bool FrameDumper::Dump(const cv::cuda::GpuMat& img, const string& tag, uint64_t frameIdx, cudaStream_t stream)
+{
+    dumpPixelFormat pixelFormat;
+    switch(img.type())
+    {
+    case CV_8UC4:  pixelFormat = DUMP_PIXEL_RGBA8;  break;
+    case CV_8UC3:  pixelFormat = DUMP_PIXEL_BGR8;   break;
+    case CV_8UC1:  pixelFormat = DUMP_PIXEL_GRAY8;  break;
+    case CV_16UC1: pixelFormat = DUMP_PIXEL_GRAY16; break;
+    default:       pixelFormat = DUMP_PIXEL_OTHER;  break;
+    }
+
+    return Dump(img.data, img.step, img.cols, img.rows, pixelFormat, img.elemSize(), tag, frameIdx, stream);
+}
+
+bool FrameDumper::DumpAnnotated(const cv::Mat& frame, const OverlayBatch& overlay, const cv::Mat& topView, const string& tag,
+                                uint64_t frameIdx)
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        if(mWorkers.empty() || mStop)
+            return false;
+        mStats.numRequested++;
+    }
+
+    // The compositor thread pops the tags in submission order
+    bool submitted;
+    {
+        lock_guard<mutex> lock(mAnnotateMutex);
+        mAnnotatedTags.push_back(tag);
+        submitted = mCompositor.Submit(frame, overlay, topView, frameIdx, 0);
+        if(!submitted)
+            mAnnotatedTags.pop_back();
+    }
+
+    if(!submitted)
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStats.numDropped++;
+    }
+
+    return submitted;
+}
+
+// Compositor thread
+void FrameDumper::WriteAnnotated(const cv::Mat& rgba, uint64_t frameIdx)
+{
+    dumpSlot slot;
+    {
+        lock_guard<mutex> lock(mAnnotateMutex);
+        slot.tag = mAnnotatedTags.front() + "_annotated";
+        mAnnotatedTags.pop_front();
+    }
+
+    // Composed frames are continuous, so the rows are packed as in a staging slot
+    slot.hostData = const_cast<uint8_t*>(rgba.ptr<uint8_t>(0));
+    slot.width = rgba.cols;
+    slot.height = rgba.rows;
+    slot.bytesPerPixel = 4;
+    slot.pixelFormat = DUMP_PIXEL_RGBA8;
+    slot.frameIdx = frameIdx;
+
+    double beginMs = NowMs();
+    uint64_t fileBytes = 0;
+    bool success = WriteDump(slot, mAnnotateScratch, mAnnotatePng, fileBytes);
+    float encodeMs = NowMs() - beginMs;
+
+    lock_guard<mutex> lock(mMutex);
+    if(success)
+    {
+        mStats.numDumped++;
+        mStats.bytesWritten += fileBytes;
+        mEncodeMsSum += encodeMs;
+        mStats.encodeMsMax = max(mStats.encodeMsMax, encodeMs);
+    }
+    else
+    {
+        mStats.numErrors++;
+    }
+}
+
+int32_t FrameDumper::AddTrigger(const string& tag, uint32_t minIntervalFrames)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    dumpTrigger trigger;
+    trigger.tag = tag;
+    trigger.minIntervalFrames = minIntervalFrames;
+    trigger.fired = false;
+    trigger.lastFrameIdx = 0;
+    mTriggers.push_back(trigger);
+
+    return mTriggers.size() - 1;
+}
+
+bool FrameDumper::Trigger(int32_t triggerId, uint64_t frameIdx)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    dumpTrigger& trigger = mTriggers[triggerId];
+    if(trigger.fired && (frameIdx < trigger.lastFrameIdx + trigger.minIntervalFrames))
+        return false;
+
+    trigger.fired = true;
+    trigger.lastFrameIdx = frameIdx;
+    return true;
+}
+
+void FrameDumper::Worker()
+{
+    vector<uint8_t> scratch;
+    vector<uint8_t> png;
+
+    while(true)
+    {
+        uint32_t slotIdx;
+        {
+            unique_lock<mutex> lock(mMutex);
+            mCond.wait(lock, [this]{ return !mQueuedSlots.empty() || mStop; });
+            if(mQueuedSlots.empty())
+                return;
+
+            slotIdx = mQueuedSlots.front();
+            mQueuedSlots.pop_front();
+        }
+
+        dumpSlot& slot = mSlots[slotIdx];
+
+        double beginMs = NowMs();
+        uint64_t fileBytes = 0;
+        bool success = (cudaEventSynchronize(slot.copyDone) == cudaSuccess) && WriteDump(slot, scratch, png, fileBytes);
+        float encodeMs = NowMs() - beginMs;
+
+        {
+            lock_guard<mutex> lock(mMutex);
+            if(success)
+            {
+                mStats.numDumped++;
+                mStats.bytesWritten += fileBytes;
+                mEncodeMsSum += encodeMs;
+                mStats.encodeMsMax = max(mStats.encodeMsMax, encodeMs);
+            }
+            else
+            {
+                mStats.numErrors++;
+            }
+            mFreeSlots.push_back(slotIdx);
+        }
+    }
+}
+
+bool FrameDumper::WriteDump(const dumpSlot& slot, vector<uint8_t>& scratch, vector<uint8_t>& png, uint64_t& fileBytes)
+{
+    static const char* pixelFormatNames[] = {"rgba8", "bgr8", "gray8", "gray16", "other"};
+
+    char filePath[512];
+    bool raw = (mParams.fileFormat == DUMP_FILE_RAW) || (slot.pixelFormat == DUMP_PIXEL_OTHER);
+    if(raw)
+    {
+        snprintf(filePath, sizeof(filePath), "%s/%s_%06llu_%s_%ux%u_%s.raw", mParams.directory.c_str(), mParams.prefix.c_str(),
+                 (unsigned long long)slot.frameIdx, slot.tag.c_str(), slot.width, slot.height, pixelFormatNames[slot.pixelFormat]);
+
+        size_t numBytes = (size_t)slot.width*slot.height*slot.bytesPerPixel;
+        FILE* file = fopen(filePath, "wb");
+        bool written = file && (fwrite(slot.hostData, 1, numBytes, file) == numBytes);
+        if(file)
+            fclose(file);
+        if(!written)
+        {
+            PX2_LOG_ERROR_RATE(1, "[FRAMEDUMP] Cannot write %s", filePath);
+            return false;
+        }
+
+        fileBytes = numBytes;
+        return true;
+    }
+
+    snprintf(filePath, sizeof(filePath), "%s/%s_%06llu_%s.png", mParams.directory.c_str(), mParams.prefix.c_str(),
+             (unsigned long long)slot.frameIdx, slot.tag.c_str());
+
+    // PNG wants RGB order and big endian 16bit samples
+    const uint8_t* pixels = slot.hostData;
+    size_t numPixels = (size_t)slot.width*slot.height;
+    LodePNGColorType colorType = LCT_RGBA;
+    unsigned bitDepth = 8;
+    switch(slot.pixelFormat)
+    {
+    case DUMP_PIXEL_BGR8:
+        scratch.resize(numPixels*3);
+        for(size_t pixelIdx = 0; pixelIdx < numPixels; pixelIdx++)
+        {
+            scratch[pixelIdx*3] = slot.hostData[pixelIdx*3 + 2];
+            scratch[pixelIdx*3 + 1] = slot.hostData[pixelIdx*3 + 1];
+            scratch[pixelIdx*3 + 2] = slot.hostData[pixelIdx*3];
+        }
+        pixels = scratch.data();
+        colorType = LCT_RGB;
+        break;
+    case DUMP_PIXEL_GRAY8:
+        colorType = LCT_GREY;
+        break;
+    case DUMP_PIXEL_GRAY16:
+        scratch.resize(numPixels*2);
+        for(size_t pixelIdx = 0; pixelIdx < numPixels; pixelIdx++)
+        {
+            scratch[pixelIdx*2] = slot.hostData[pixelIdx*2 + 1];
+            scratch[pixelIdx*2 + 1] = slot.hostData[pixelIdx*2];
+        }
+        pixels = scratch.data();
+        colorType = LCT_GREY;
+        bitDepth = 16;
+        break;
+    default:
+        break;
+    }
+
+    unsigned error = mPngEncoder.Encode(png, pixels, slot.width, slot.height, (size_t)slot.width*slot.bytesPerPixel, colorType, bitDepth);
+    if(!error)
+        error = lodepng_save_file(png.data(), png.size(), filePath);
+
+    if(error)
+    {
+        PX2_LOG_ERROR_RATE(1, "[FRAMEDUMP] %s : %s", filePath, lodepng_error_text(error));
+        return false;
+    }
+
+    fileBytes = png.size();
+    return true;
+}
+
+frameDumpStats FrameDumper::GetStats()
+{
+    lock_guard<mutex> lock(mMutex);
+    frameDumpStats stats = mStats;
+    stats.encodeMsAvg = (stats.numDumped > 0) ? mEncodeMsSum/stats.numDumped : 0.0;
+    return stats;
+}
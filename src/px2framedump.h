@@ -0,0 +1,153 @@
+#ifndef PX2FRAMEDUMP_H
+#define PX2FRAMEDUMP_H
+
+#include "common_cv.h"
+#include "px2compositor.h"
+#include "px2pngencoder.h"
+
+#include <dw/image/Image.h>
+#include <cuda_runtime.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Frame dump service for dataset collection and screenshots of device images.
+ *
+ * Dump() costs the caller one asynchronous device -> host copy into a pinned staging slot (+ an event),
+ * the PNG / raw encoding and the file write happen on a pool of worker threads (PNG bands on PngEncoder's pool).
+ * Without a free staging slot the dump is dropped (counted), the caller never waits.
+ * Triggers rate-limit dumps requested from code, e.g. one dump per second while a pedestrian is detected :
+ *
+ *    FrameDumper frameDumper;
+ *    frameDumper.Init(frameDumpParameters());
+ *    int32_t pedestrianTrigger = frameDumper.AddTrigger("pedestrian", 30);
+ *    ...
+ *    if(pedestrianDetected && frameDumper.Trigger(pedestrianTrigger, frameIdx))
+ *        frameDumper.Dump(camImgCuda, frameDumper.GetTriggerTag(pedestrianTrigger), frameIdx, stream);
+ *
+ * DumpAnnotated() hands a host frame and its overlay to an OverlayCompositor : the overlay is drawn and the frame
+ * PNG encoded on the compositor thread, dropped when its queue is full.
+ *
+ * Files : <directory>/<prefix>_<frameIdx>_<tag>.png, or .._<width>x<height>_<format>.raw (rows packed, no header).
+ */
+
+typedef enum {
+    DUMP_FILE_PNG = 0,
+    DUMP_FILE_RAW = 1
+}dumpFileFormat;
+
+typedef enum {
+    DUMP_PIXEL_RGBA8 = 0,
+    DUMP_PIXEL_BGR8 = 1,        // cv::cuda::GpuMat CV_8UC3
+    DUMP_PIXEL_GRAY8 = 2,
+    DUMP_PIXEL_GRAY16 = 3,      // Raw sensor data, PNG 16bit grey
+    DUMP_PIXEL_OTHER = 4        // Raw file only (e.g. float tensors)
+}dumpPixelFormat;
+
+typedef struct {
+    string directory = "dump";
+    string prefix = "frame";
+    dumpFileFormat fileFormat = DUMP_FILE_PNG;
+    int compressionLevel = 1;                   // PNG : 0 stored ... 9 smallest
+    pngEncodeMode pngMode = PNG_ENCODE_DEFLATE; // PNG_ENCODE_STORE / RLE for high-rate dumps
+    uint32_t pngThreads = 4;                    // Row bands of one PNG encoded in parallel, pool shared by the workers
+    uint32_t numStagingSlots = 4;               // Pinned host buffers, dumps in flight
+    size_t stagingSlotBytes = 1920*1208*4;      // Largest image (packed rows)
+    uint32_t numWorkers = 2;
+    compositorParameters annotateParams;        // DumpAnnotated(), coordinate range 0 : camera pixels
+}frameDumpParameters;
+
+typedef struct {
+    uint64_t numRequested = 0;
+    uint64_t numDumped = 0;
+    uint64_t numDropped = 0;        // No free staging slot, or too large
+    uint64_t numErrors = 0;         // Encoding / file write
+    uint64_t bytesWritten = 0;
+    float encodeMsAvg = 0.f;        // Wait for the copy + encode + write, per dump
+    float encodeMsMax = 0.f;
+}frameDumpStats;
+
+class FrameDumper{
+public:
+    FrameDumper();
+    ~FrameDumper();
+
+    bool Init(frameDumpParameters params);
+
+    // Encodes the queued dumps and stops the workers
+    void Release();
+
+    bool IsRunning() const { return !mWorkers.empty(); }
+
+    // False : dropped. The copy is ordered on stream, the image may be overwritten once the stream has passed it.
+    bool Dump(const void* devPtr, size_t pitch, uint32_t width, uint32_t height, dumpPixelFormat pixelFormat,
+              uint32_t bytesPerPixel, const string& tag, uint64_t frameIdx, cudaStream_t stream = 0);
+    bool Dump(const dwImageCUDA* img, const string& tag, uint64_t frameIdx, cudaStream_t stream = 0);        // RGBA_UINT8
+    bool Dump(const cv::cuda::GpuMat& img, const string& tag, uint64_t frameIdx, cudaStream_t stream = 0);   // 8UC1/3/4, 16UC1, others raw
+
+    // frame : host CV_8UC4 (RGBA) or CV_8UC3 (BGR), topView may be empty. Copied, the caller may reuse them on return.
+    bool DumpAnnotated(const cv::Mat& frame, const OverlayBatch& overlay, const cv::Mat& topView, const string& tag, uint64_t frameIdx);
+
+    // Rate-limited trigger : true at most once every minIntervalFrames frames
+    int32_t AddTrigger(const string& tag, uint32_t minIntervalFrames);
+    bool Trigger(int32_t triggerId, uint64_t frameIdx);
+    const string& GetTriggerTag(int32_t triggerId) const { return mTriggers[triggerId].tag; }
+
+    frameDumpStats GetStats();
+
+private:
+    typedef struct {
+        uint8_t* hostData = nullptr;    // Pinned
+        cudaEvent_t copyDone = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t bytesPerPixel = 0;
+        dumpPixelFormat pixelFormat = DUMP_PIXEL_RGBA8;
+        string tag;
+        uint64_t frameIdx = 0;
+    }dumpSlot;
+
+    typedef struct {
+        string tag;
+        uint32_t minIntervalFrames;
+        bool fired;
+        uint64_t lastFrameIdx;
+    }dumpTrigger;
+
+    void Worker();
+    void WriteAnnotated(const cv::Mat& rgba, uint64_t frameIdx);
+    bool WriteDump(const dumpSlot& slot, vector<uint8_t>& scratch, vector<uint8_t>& png, uint64_t& fileBytes);
+
+private:
+    frameDumpParameters mParams;
+    PngEncoder mPngEncoder;
+
+    vector<dumpSlot> mSlots;
+    vector<uint32_t> mFreeSlots;
+    deque<uint32_t> mQueuedSlots;
+    vector<dumpTrigger> mTriggers;
+
+    OverlayCompositor mCompositor;
+    mutex mAnnotateMutex;
+    deque<string> mAnnotatedTags;       // Tags of the frames queued in mCompositor, same order
+    vector<uint8_t> mAnnotateScratch;   // Compositor thread
+    vector<uint8_t> mAnnotatePng;
+
+    mutex mMutex;
+    condition_variable mCond;
+    vector<thread> mWorkers;
+    bool mStop = false;
+
+    frameDumpStats mStats;
+    double mEncodeMsSum = 0.0;
+};
+
+#endif // PX2FRAMEDUMP_H
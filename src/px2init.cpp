@@ -0,0 +1,304 @@
+#include "px2init.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+static double NowS()
+{
+    return chrono::duration_cast<chrono::duration<double> >(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void InitGraph::AddStep(const string& name, const vector<string>& dependencies, function<bool()> step,
+                        initAffinity affinity)
+{
+    initStep newStep;
+    newStep.name = name;
+    newStep.dependencyNames = dependencies;
+    newStep.step = step;
+    newStep.affinity = affinity;
+    newStep.numPending = 0;
+
+    mSteps.push_back(newStep);
+}
+
+// Names -> indices, and a topological order must exist
+bool InitGraph::Resolve()
+{
+    for(initStep& step : mSteps)
+    {
+        step.dependencies.clear();
+        step.dependents.clear();
+    }
+
+    for(uint32_t stepIdx = 0; stepIdx < mSteps.size(); stepIdx++)
+    {
+        for(const string& dependencyName : mSteps[stepIdx].dependencyNames)
+        {
+            auto dependency = find_if(mSteps.begin(), mSteps.end(),
+                                      [&dependencyName](const initStep& step){ return step.name == dependencyName; });
+            if(dependency == mSteps.end())
+            {
+                cout << "[INIT] " << mSteps[stepIdx].name << " depends on unknown step " << dependencyName << endl;
+                return false;
+            }
+
+            uint32_t dependencyIdx = dependency - mSteps.begin();
+            mSteps[stepIdx].dependencies.push_back(dependencyIdx);
+            mSteps[dependencyIdx].dependents.push_back(stepIdx);
+        }
+        mSteps[stepIdx].numPending = mSteps[stepIdx].dependencies.size();
+    }
+
+    // Kahn : every step reached, else there is a cycle
+    vector<uint32_t> numPending(mSteps.size());
+    vector<uint32_t> ready;
+    for(uint32_t stepIdx = 0; stepIdx < mSteps.size(); stepIdx++)
+    {
+        numPending[stepIdx] = mSteps[stepIdx].numPending;
+        if(numPending[stepIdx] == 0)
+            ready.push_back(stepIdx);
+    }
+
+    uint32_t numReached = 0;
+    while(!ready.empty())
+    {
+        uint32_t stepIdx = ready.back();
+        ready.pop_back();
+        numReached++;
+
+        for(uint32_t dependentIdx : mSteps[stepIdx].dependents)
+        {
+            if(--numPending[dependentIdx] == 0)
+                ready.push_back(dependentIdx);
+        }
+    }
+
+    if(numReached != mSteps.size())
+    {
+        cout << "[INIT] Dependency cycle between steps" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Without workers, the main thread runs every step
+initAffinity InitGraph::GetAffinity(uint32_t stepIdx) const
+{
+    return (mNumWorkers == 0) ? INIT_MAIN_THREAD : mSteps[stepIdx].affinity;
+}
+
+bool InitGraph::Run(uint32_t numWorkers)
+{
+    if(!Resolve())
+        return false;
+
+    mNumWorkers = numWorkers;
+
+    mReports.assign(mSteps.size(), initStepReport());
+    mReady[INIT_WORKER_THREAD].clear();
+    mReady[INIT_MAIN_THREAD].clear();
+    mNumRunning = 0;
+    mNumFinished = 0;
+    mFailed = false;
+
+    for(uint32_t stepIdx = 0; stepIdx < mSteps.size(); stepIdx++)
+    {
+        mReports[stepIdx].name = mSteps[stepIdx].name;
+        if(mSteps[stepIdx].numPending == 0)
+            mReady[GetAffinity(stepIdx)].push_back(stepIdx);
+    }
+
+    mStartS = NowS();
+
+    vector<thread> workers;
+    for(uint32_t workerIdx = 0; workerIdx < numWorkers; workerIdx++)
+        workers.push_back(thread(&InitGraph::RunWorker, this, (int32_t)workerIdx));
+
+    uint32_t stepIdx;
+    while(NextStep(INIT_MAIN_THREAD, stepIdx))
+        RunStep(stepIdx, -1);
+
+    {
+        unique_lock<mutex> lock(mMutex);
+        mCond.wait(lock, [this]{ return (mNumFinished == mSteps.size()) || (mFailed && (mNumRunning == 0)); });
+        mFailed = mFailed || (mNumFinished != mSteps.size());
+    }
+    mCond.notify_all();
+
+    for(thread& worker : workers)
+        worker.join();
+
+    mTotalMs = (NowS() - mStartS)*1000.0;
+
+    for(initStepReport& report : mReports)
+    {
+        if(report.status == INIT_STEP_PENDING)
+            report.status = INIT_STEP_SKIPPED;
+    }
+
+    MarkCriticalPath();
+
+    return !mFailed;
+}
+
+// Blocks until a step of this affinity is ready, false when there is nothing left for it
+bool InitGraph::NextStep(initAffinity affinity, uint32_t& stepIdx)
+{
+    unique_lock<mutex> lock(mMutex);
+
+    while(true)
+    {
+        if(mFailed || (mNumFinished == mSteps.size()))
+            return false;
+
+        // Ready steps are taken in the order they were added
+        if(!mReady[affinity].empty())
+        {
+            auto first = min_element(mReady[affinity].begin(), mReady[affinity].end());
+            stepIdx = *first;
+            mReady[affinity].erase(first);
+            mNumRunning++;
+            mReports[stepIdx].status = INIT_STEP_RUNNING;
+            return true;
+        }
+
+        // Nothing of this affinity can become ready any more
+        bool pending = false;
+        for(uint32_t idx = 0; idx < mSteps.size(); idx++)
+        {
+            if((GetAffinity(idx) == affinity) && (mReports[idx].status == INIT_STEP_PENDING))
+            {
+                pending = true;
+                break;
+            }
+        }
+        if(!pending)
+            return false;
+
+        mCond.wait(lock);
+    }
+}
+
+void InitGraph::RunStep(uint32_t stepIdx, int32_t threadIdx)
+{
+    double beginS = NowS();
+
+    bool success;
+    try
+    {
+        success = mSteps[stepIdx].step();
+    }
+    catch(const exception& error)
+    {
+        cout << "[INIT] " << mSteps[stepIdx].name << " : " << error.what() << endl;
+        success = false;
+    }
+
+    double endS = NowS();
+
+    {
+        lock_guard<mutex> lock(mMutex);
+
+        initStepReport& report = mReports[stepIdx];
+        report.status = success ? INIT_STEP_DONE : INIT_STEP_FAILED;
+        report.threadIdx = threadIdx;
+        report.startMs = (beginS - mStartS)*1000.0;
+        report.durationMs = (endS - beginS)*1000.0;
+
+        mNumRunning--;
+        mNumFinished++;
+
+        if(!success)
+        {
+            cout << "[INIT] " << mSteps[stepIdx].name << " failed" << endl;
+            mFailed = true;
+        }
+        else
+        {
+            for(uint32_t dependentIdx : mSteps[stepIdx].dependents)
+            {
+                if(--mSteps[dependentIdx].numPending == 0)
+                    mReady[GetAffinity(dependentIdx)].push_back(dependentIdx);
+            }
+        }
+    }
+    mCond.notify_all();
+}
+
+void InitGraph::RunWorker(int32_t threadIdx)
+{
+    uint32_t stepIdx;
+    while(NextStep(INIT_WORKER_THREAD, stepIdx))
+        RunStep(stepIdx, threadIdx);
+}
+
+// Chain of dependencies ending last : what bounds the startup time
+void InitGraph::MarkCriticalPath()
+{
+    int32_t lastIdx = -1;
+    float lastEndMs = -1.f;
+    for(uint32_t stepIdx = 0; stepIdx < mReports.size(); stepIdx++)
+    {
+        const initStepReport& report = mReports[stepIdx];
+        if((report.status == INIT_STEP_DONE) && (report.startMs + report.durationMs > lastEndMs))
+        {
+            lastEndMs = report.startMs + report.durationMs;
+            lastIdx = stepIdx;
+        }
+    }
+
+    while(lastIdx >= 0)
+    {
+        mReports[lastIdx].onCriticalPath = true;
+
+        // The dependency done last is the one it waited for
+        int32_t waitedIdx = -1;
+        float waitedEndMs = -1.f;
+        for(uint32_t dependencyIdx : mSteps[lastIdx].dependencies)
+        {
+            const initStepReport& report = mReports[dependencyIdx];
+            if(report.startMs + report.durationMs > waitedEndMs)
+            {
+                waitedEndMs = report.startMs + report.durationMs;
+                waitedIdx = dependencyIdx;
+            }
+        }
+        lastIdx = waitedIdx;
+    }
+}
+
+void InitGraph::PrintReport() const
+{
+    static const char* statusNames[] = {"pending", "running", "done", "FAILED", "skipped"};
+
+    vector<uint32_t> order(mReports.size());
+    for(uint32_t stepIdx = 0; stepIdx < order.size(); stepIdx++)
+        order[stepIdx] = stepIdx;
+    stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+    {
+        return mReports[a].startMs < mReports[b].startMs;
+    });
+
+    float sumMs = 0.f;
+    printf("[INIT] %-20s %-8s %-8s %9s %9s\n", "step", "thread", "status", "start", "duration");
+    for(uint32_t stepIdx : order)
+    {
+        const initStepReport& report = mReports[stepIdx];
+        sumMs += report.durationMs;
+
+        char threadName[24];
+        if(report.threadIdx < 0)
+            snprintf(threadName, sizeof(threadName), "main");
+        else
+            snprintf(threadName, sizeof(threadName), "worker%d", report.threadIdx);
+
+        printf("[INIT] %-20s %-8s %-8s %7.1fms %7.1fms%s\n", report.name.c_str(), threadName, statusNames[report.status],
+               report.startMs, report.durationMs, report.onCriticalPath ? "  *" : "");
+    }
+    printf("[INIT] Total %.1fms (sequential %.1fms), * : critical path\n", mTotalMs, sumMs);
+}
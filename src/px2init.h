@@ -0,0 +1,99 @@
+#ifndef PX2INIT_H
+#define PX2INIT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Startup as a dependency graph.
+ *
+ * Every init step names the steps it needs, the graph runs a step as soon as they are done :
+ * independent steps (calibration files, object pools) run on worker threads while the main thread
+ * goes on with the Driveworks / GL steps, which keep INIT_MAIN_THREAD (GL context, Driveworks context use).
+ * A step fails by returning false (or throwing, e.g. CHECK_DW_ERROR) : no new step starts, the running ones finish,
+ * Run() returns false.
+ * Every step is timed, PrintReport() shows the timeline and the critical path.
+ *
+ *    InitGraph initGraph;
+ *    initGraph.AddStep("camera", {}, [&]{ return cam.Init(...); }, INIT_MAIN_THREAD);
+ *    initGraph.AddStep("ldCalibration", {}, [&]{ return ld.LoadCalibration(...); });
+ *    initGraph.AddStep("laneNet", {"camera", "ldCalibration"}, [&]{ ld.Init(0.3f); return true; }, INIT_MAIN_THREAD);
+ *    if(!initGraph.Run(2)) return -1;
+ */
+
+typedef enum {
+    INIT_WORKER_THREAD = 0,
+    INIT_MAIN_THREAD = 1        // Thread calling Run()
+}initAffinity;
+
+typedef enum {
+    INIT_STEP_PENDING = 0,
+    INIT_STEP_RUNNING = 1,
+    INIT_STEP_DONE = 2,
+    INIT_STEP_FAILED = 3,
+    INIT_STEP_SKIPPED = 4       // Not run after a failure
+}initStepStatus;
+
+typedef struct {
+    string name;
+    initStepStatus status = INIT_STEP_PENDING;
+    int32_t threadIdx = -1;     // -1 : main thread
+    float startMs = 0.f;        // From Run()
+    float durationMs = 0.f;
+    bool onCriticalPath = false;
+}initStepReport;
+
+class InitGraph{
+public:
+    void AddStep(const string& name, const vector<string>& dependencies, function<bool()> step,
+                 initAffinity affinity = INIT_WORKER_THREAD);
+
+    // False on a failed step or an invalid graph (unknown dependency, cycle)
+    bool Run(uint32_t numWorkers = 2);
+
+    float GetTotalMs() const { return mTotalMs; }
+    vector<initStepReport> GetReport() const { return mReports; }
+    void PrintReport() const;
+
+private:
+    typedef struct {
+        string name;
+        vector<string> dependencyNames;
+        function<bool()> step;
+        initAffinity affinity;
+
+        vector<uint32_t> dependencies;
+        vector<uint32_t> dependents;
+        uint32_t numPending;
+    }initStep;
+
+    bool Resolve();
+    initAffinity GetAffinity(uint32_t stepIdx) const;
+    bool NextStep(initAffinity affinity, uint32_t& stepIdx);
+    void RunStep(uint32_t stepIdx, int32_t threadIdx);
+    void RunWorker(int32_t threadIdx);
+    void MarkCriticalPath();
+
+private:
+    vector<initStep> mSteps;
+    vector<initStepReport> mReports;
+
+    mutex mMutex;
+    condition_variable mCond;
+    vector<uint32_t> mReady[2];     // Per affinity
+    uint32_t mNumWorkers = 0;
+    uint32_t mNumRunning = 0;
+    uint32_t mNumFinished = 0;
+    bool mFailed = false;
+
+    double mStartS = 0.0;
+    float mTotalMs = 0.f;
+};
+
+#endif // PX2INIT_H
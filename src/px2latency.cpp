@@ -0,0 +1,347 @@
+#include "px2latency.h"
+#include "px2log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+// Frame whose timings the calling thread is collecting
+static thread_local uint64_t tCollectFrameSeq = 0;
+
+LatencyMonitor::LatencyMonitor(dw::common::ProfilerCUDA::Backend backend)
+    : mProfiler(backend)
+{
+    mProfiler.setSampleListener([this](const dw::common::ProfilerCUDA::Sample& sample)
+    {
+        OnSample(sample);
+    });
+}
+
+LatencyMonitor::~LatencyMonitor()
+{
+    mProfiler.setSampleListener(nullptr);
+
+    if(mCSVFile.is_open())
+        mCSVFile.close();
+
+    if(mJSONFile.is_open())
+        mJSONFile.close();
+}
+
+bool LatencyMonitor::Init(latencyMonitorParameters params)
+{
+    mParams = params;
+
+    if(!mParams.csvFilePath.empty())
+    {
+        mCSVFile.open(mParams.csvFilePath, ios::out | ios::trunc);
+        if(!mCSVFile.is_open())
+        {
+            cout << "[LATENCY] Cannot open " << mParams.csvFilePath << endl;
+            return false;
+        }
+
+        mCSVFile << "window,first_frame,frames,stage,count,"
+                 << "cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,cpu_max_ms,"
+                 << "gpu_p50_ms,gpu_p95_ms,gpu_p99_ms,gpu_max_ms" << endl;
+    }
+
+    if(!mParams.jsonFilePath.empty())
+    {
+        mJSONFile.open(mParams.jsonFilePath, ios::out | ios::trunc);
+        if(!mJSONFile.is_open())
+        {
+            cout << "[LATENCY] Cannot open " << mParams.jsonFilePath << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+latencySectionId LatencyMonitor::RegisterSection(const char* key)
+{
+    return dw::common::ProfilerCUDA::registerSection(key);
+}
+
+void LatencyMonitor::Collect(uint64_t frameSeq)
+{
+    tCollectFrameSeq = frameSeq;
+    mProfiler.getThreadData()->collectTimers();
+}
+
+void LatencyMonitor::AddGlassToResult(dwTime_t captureTime_us, dwTime_t resultTime_us)
+{
+    bool closeWindow;
+    {
+        lock_guard<mutex> lock(mMutex);
+        mGlassToResult.push_back((resultTime_us - captureTime_us)/1000.f);
+        mGlassToResultRun.addSample(mGlassToResult.back());
+        mNumFrames++;
+        closeWindow = (mGlassToResult.size() >= mParams.windowFrames);
+    }
+
+    if(mTraceRecorder)
+    {
+        float spikeThresholdMs = mTraceRecorder->GetParameters().spikeThresholdMs;
+        float latencyMs = (resultTime_us - captureTime_us)/1000.f;
+
+        if((spikeThresholdMs > 0.f) && (latencyMs > spikeThresholdMs) && mTraceRecorder->RequestDump("spike"))
+            PX2_LOG_WARN("[LATENCY] Glass-to-result %.1fms > %.1fms, trace dump", latencyMs, spikeThresholdMs);
+    }
+
+    if(closeWindow)
+        CloseWindow();
+}
+
+void LatencyMonitor::Flush()
+{
+    CloseWindow();
+}
+
+vector<latencyWindowReport> LatencyMonitor::GetReports()
+{
+    lock_guard<mutex> lock(mMutex);
+    return vector<latencyWindowReport>(mReports.begin(), mReports.end());
+}
+
+void LatencyMonitor::OnSample(const dw::common::ProfilerCUDA::Sample& sample)
+{
+    if(mTraceRecorder)
+    {
+        mTraceRecorder->Record(TRACE_CPU, sample.sectionId, tCollectFrameSeq, sample.startCPU, sample.timeCPU);
+
+        if(sample.startGPU >= 0)
+            mTraceRecorder->Record(TRACE_GPU, sample.sectionId, tCollectFrameSeq, sample.startGPU, sample.timeGPU);
+    }
+
+    lock_guard<mutex> lock(mMutex);
+
+    stageSamples& samples = mWindowSamples[*sample.sectionKey];
+    stageRunStats& runStats = mRunStats[*sample.sectionKey];
+    samples.cpu.push_back(sample.timeCPU/1000.f);
+    runStats.cpu.addSample(samples.cpu.back());
+
+    // CPU only sections (host backend, no stream) have no GPU interval
+    if(sample.startGPU >= 0)
+    {
+        samples.gpu.push_back(sample.timeGPU/1000.f);
+        runStats.gpu.addSample(samples.gpu.back());
+    }
+}
+
+void LatencyMonitor::CloseWindow()
+{
+    latencyWindowReport report;
+    {
+        lock_guard<mutex> lock(mMutex);
+
+        if(mGlassToResult.empty() && mWindowSamples.empty())
+            return;
+
+        report.windowIdx = mNumWindows++;
+        report.firstFrame = mWindowFirstFrame;
+        report.numFrames = mNumFrames - mWindowFirstFrame;
+
+        for(auto& entry : mWindowSamples)
+        {
+            if(entry.second.cpu.empty())
+                continue;
+
+            latencyStageReport stage;
+            stage.name = entry.first;
+            stage.cpu = ComputePercentiles(entry.second.cpu);
+            stage.gpu = ComputePercentiles(entry.second.gpu);
+            report.stages.push_back(stage);
+
+            // Keys (and vector capacity) are kept for the next window
+            entry.second.cpu.clear();
+            entry.second.gpu.clear();
+        }
+
+        latencyStageReport glass;
+        glass.name = "glassToResult";
+        glass.cpu = ComputePercentiles(mGlassToResult);
+        report.stages.push_back(glass);
+        mGlassToResult.clear();
+
+        mWindowFirstFrame = mNumFrames;
+        mReports.push_back(report);
+        while(mReports.size() > max(mParams.maxReports, 1U))
+            mReports.pop_front();
+    }
+
+    if(mParams.printReport)
+    {
+        PrintReport(report);
+        PrintRunSummary();
+    }
+
+    WriteCSV(report);
+    WriteJSON(report);
+}
+
+void LatencyMonitor::PrintReport(const latencyWindowReport& report)
+{
+    printf("[LATENCY] Window %u, frames %llu-%llu (ms)\n", report.windowIdx,
+           (unsigned long long)report.firstFrame, (unsigned long long)(report.firstFrame + report.numFrames));
+    printf("[LATENCY] %-16s %6s | %7s %7s %7s %7s | %7s %7s %7s %7s\n",
+           "stage", "count", "cpu p50", "p95", "p99", "max", "gpu p50", "p95", "p99", "max");
+
+    for(const latencyStageReport& stage : report.stages)
+    {
+        printf("[LATENCY] %-16s %6u | %7.2f %7.2f %7.2f %7.2f",
+               stage.name.c_str(), stage.cpu.count, stage.cpu.p50, stage.cpu.p95, stage.cpu.p99, stage.cpu.max);
+
+        if(stage.gpu.count > 0)
+            printf(" | %7.2f %7.2f %7.2f %7.2f\n", stage.gpu.p50, stage.gpu.p95, stage.gpu.p99, stage.gpu.max);
+        else
+            printf(" |\n");
+    }
+}
+
+void LatencyMonitor::WriteCSV(const latencyWindowReport& report)
+{
+    if(!mCSVFile.is_open())
+        return;
+
+    for(const latencyStageReport& stage : report.stages)
+    {
+        mCSVFile << report.windowIdx << "," << report.firstFrame << "," << report.numFrames << ","
+                 << stage.name << "," << stage.cpu.count << ","
+                 << stage.cpu.p50 << "," << stage.cpu.p95 << "," << stage.cpu.p99 << "," << stage.cpu.max << ",";
+
+        if(stage.gpu.count > 0)
+            mCSVFile << stage.gpu.p50 << "," << stage.gpu.p95 << "," << stage.gpu.p99 << "," << stage.gpu.max;
+        else
+            mCSVFile << ",,,";
+
+        mCSVFile << "\n";
+    }
+
+    mCSVFile.flush();
+}
+
+// One window appended per call : the closing brackets are written back after it, so the file is always a valid document
+void LatencyMonitor::WriteJSON(const latencyWindowReport& report)
+{
+    if(!mJSONFile.is_open())
+        return;
+
+    static const char jsonFooter[] = "\n  ]\n}\n";
+
+    if(report.windowIdx == 0)
+        mJSONFile << "{\n  \"unit\": \"ms\",\n  \"windows\": [\n";
+    else
+        mJSONFile.seekp(-(streamoff)(sizeof(jsonFooter) - 1), ios::end) << ",\n";
+
+    auto writePercentiles = [this](const latencyPercentiles& p)
+    {
+        mJSONFile << "{\"count\": " << p.count << ", \"p50\": " << p.p50 << ", \"p95\": " << p.p95
+                  << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << "}";
+    };
+
+    mJSONFile << "    {\"window\": " << report.windowIdx
+              << ", \"firstFrame\": " << report.firstFrame << ", \"frames\": " << report.numFrames
+              << ", \"stages\": [";
+
+    for(uint32_t stageIdx = 0; stageIdx < report.stages.size(); stageIdx++)
+    {
+        const latencyStageReport& stage = report.stages[stageIdx];
+
+        mJSONFile << (stageIdx ? ",\n" : "\n") << "      {\"name\": \"" << stage.name << "\", \"cpu\": ";
+        writePercentiles(stage.cpu);
+        if(stage.gpu.count > 0)
+        {
+            mJSONFile << ", \"gpu\": ";
+            writePercentiles(stage.gpu);
+        }
+        mJSONFile << "}";
+    }
+
+    mJSONFile << "\n    ]}" << jsonFooter;
+    mJSONFile.flush();
+}
+
+void LatencyMonitor::PrintRunSummary()
+{
+    lock_guard<mutex> lock(mMutex);
+
+    printf("[LATENCY] Whole run, frames 0-%llu (ms)\n", (unsigned long long)mNumFrames);
+    printf("[LATENCY] %-16s %8s | %7s %7s %7s %7s | %7s %7s %7s %7s\n",
+           "stage", "count", "cpu p50", "p90", "p99", "p99.9", "gpu p50", "p90", "p99", "p99.9");
+
+    for(auto& entry : mRunStats)
+    {
+        dw::common::StatsCounter& cpu = entry.second.cpu;
+        dw::common::StatsCounter& gpu = entry.second.gpu;
+
+        if(cpu.getSampleCount() == 0)
+            continue;
+
+        cpu.compress();
+        printf("[LATENCY] %-16s %8u | %7.2f %7.2f %7.2f %7.2f",
+               entry.first.c_str(), cpu.getSampleCount(),
+               cpu.getQuantile(0.5f), cpu.getQuantile(0.9f), cpu.getQuantile(0.99f), cpu.getQuantile(0.999f));
+
+        if(gpu.getSampleCount() > 0)
+        {
+            gpu.compress();
+            printf(" | %7.2f %7.2f %7.2f %7.2f\n",
+                   gpu.getQuantile(0.5f), gpu.getQuantile(0.9f), gpu.getQuantile(0.99f), gpu.getQuantile(0.999f));
+        }
+        else
+        {
+            printf(" |\n");
+        }
+    }
+
+    if(mGlassToResultRun.getSampleCount() > 0)
+    {
+        mGlassToResultRun.compress();
+
+        printf("[LATENCY] %-16s %8u | %7.2f %7.2f %7.2f %7.2f |\n",
+               "glassToResult", mGlassToResultRun.getSampleCount(),
+               mGlassToResultRun.getQuantile(0.5f), mGlassToResultRun.getQuantile(0.9f),
+               mGlassToResultRun.getQuantile(0.99f), mGlassToResultRun.getQuantile(0.999f));
+    }
+}
+
+// Nearest rank percentiles, reorders the samples
+latencyPercentiles LatencyMonitor::ComputePercentiles(vector<float>& samples)
+{
+    latencyPercentiles result;
+    result.count = samples.size();
+
+    if(samples.empty())
+        return result;
+
+    auto rank = [&samples](float p)
+    {
+        size_t idx = (size_t)ceil(p*samples.size());
+        idx = (idx > 0) ? idx - 1 : 0;
+        nth_element(samples.begin(), samples.begin() + idx, samples.end());
+        return samples[idx];
+    };
+
+    result.p50 = rank(0.50f);
+    result.p95 = rank(0.95f);
+    result.p99 = rank(0.99f);
+    result.max = *max_element(samples.begin(), samples.end());
+
+    return result;
+}
+
+LatencyScope::LatencyScope(LatencyMonitor* monitor, latencySectionId section, cudaStream_t stream)
+    : mMonitor(monitor)
+{
+    if(mMonitor)
+        mMonitor->GetProfiler()->tic(section, true, stream);
+}
+
+LatencyScope::~LatencyScope()
+{
+    if(mMonitor)
+        mMonitor->GetProfiler()->toc();
+}
@@ -0,0 +1,147 @@
+#ifndef PX2LATENCY_H
+#define PX2LATENCY_H
+
+#include <framework/ProfilerCUDA.hpp>
+
+#include "px2trace.h"
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Per-stage latency instrumentation on top of dw::common::ProfilerCUDA.
+ *
+ * Stages are timed with LatencyScope (CPU with steady_clock, GPU with CUDA events on the stage stream),
+ * on a section id registered once per call site, so a scope costs no lookup nor allocation.
+ * The host backend (CPU time only) needs no GPU.
+ * Every thread calls Collect() once per frame, which resolves its CUDA events and feeds the samples to the monitor.
+ * Glass-to-result latency = result time - camera capture timestamp (both Driveworks time, us).
+ * Every windowFrames results, p50/p95/p99/max of each stage are reported and exported (CSV rows, JSON file),
+ * both files are appended one window at a time, the last maxReports windows stay in memory (GetReports).
+ * Every window (and Flush()) also prints whole run p50/p90/p99/p99.9, from quantile digests fed with the same samples,
+ * so the run summary does not depend on a clean exit.
+ * With a TraceRecorder, every section (CPU and GPU interval) goes to the timeline and a glass-to-result
+ * spike triggers a trace dump.
+ */
+
+typedef dw::common::ProfilerCUDA::SectionId latencySectionId;
+
+typedef struct {
+    uint32_t windowFrames = 300;    // Results per report window (10s at 30fps)
+    string csvFilePath = "";        // Empty : no CSV export
+    string jsonFilePath = "";       // Empty : no JSON export
+    uint32_t maxReports = 60;       // Windows kept for GetReports() (10min at 30fps)
+    bool printReport = true;
+}latencyMonitorParameters;
+
+typedef struct {
+    uint32_t count = 0;
+    float p50 = 0.f;    // ms
+    float p95 = 0.f;
+    float p99 = 0.f;
+    float max = 0.f;
+}latencyPercentiles;
+
+typedef struct {
+    string name;
+    latencyPercentiles cpu;
+    latencyPercentiles gpu;     // count = 0 for CPU only entries (glass-to-result)
+}latencyStageReport;
+
+typedef struct {
+    uint32_t windowIdx = 0;
+    uint64_t firstFrame = 0;
+    uint64_t numFrames = 0;
+    vector<latencyStageReport> stages;
+}latencyWindowReport;
+
+class LatencyMonitor{
+public:
+    explicit LatencyMonitor(dw::common::ProfilerCUDA::Backend backend = dw::common::ProfilerCUDA::BACKEND_CUDA);
+    ~LatencyMonitor();
+
+    bool Init(latencyMonitorParameters params);
+
+    static latencySectionId RegisterSection(const char* key);
+
+    dw::common::ProfilerCUDA* GetProfiler() { return &mProfiler; }
+
+    void SetTraceRecorder(TraceRecorder* traceRecorder) { mTraceRecorder = traceRecorder; }
+
+    // GPU timings of the calling thread, once per frame after its stages (frameSeq : frame id in the trace)
+    void Collect(uint64_t frameSeq = 0);
+
+    // Closes the window every windowFrames calls
+    void AddGlassToResult(dwTime_t captureTime_us, dwTime_t resultTime_us);
+
+    // Reports the current (partial) window and the whole run, at exit
+    void Flush();
+
+    // Last maxReports windows
+    vector<latencyWindowReport> GetReports();
+
+private:
+    typedef struct {
+        vector<float> cpu;
+        vector<float> gpu;
+    }stageSamples;
+
+    typedef struct {
+        dw::common::StatsCounter cpu;
+        dw::common::StatsCounter gpu;
+    }stageRunStats;
+
+    void OnSample(const dw::common::ProfilerCUDA::Sample& sample);
+    void CloseWindow();
+    void PrintReport(const latencyWindowReport& report);
+    void WriteCSV(const latencyWindowReport& report);
+    void WriteJSON(const latencyWindowReport& report);
+    void PrintRunSummary();
+
+    static latencyPercentiles ComputePercentiles(vector<float>& samples);
+
+private:
+    latencyMonitorParameters mParams;
+    dw::common::ProfilerCUDA mProfiler;
+
+    mutex mMutex;
+    map<string, stageSamples> mWindowSamples;
+    map<string, stageRunStats> mRunStats;
+    vector<float> mGlassToResult;
+    dw::common::StatsCounter mGlassToResultRun;
+    uint64_t mNumFrames = 0;
+    uint64_t mWindowFirstFrame = 0;
+
+    uint32_t mNumWindows = 0;
+    deque<latencyWindowReport> mReports;
+    ofstream mCSVFile;
+    ofstream mJSONFile;
+
+    TraceRecorder* mTraceRecorder = nullptr;
+};
+
+/**
+ * Times a stage until the end of the scope. No-op if monitor is null.
+ *    {
+ *        static const latencySectionId section = LatencyMonitor::RegisterSection("driveNetDevice");
+ *        LatencyScope scope(monitor, section, stream);
+ *        ...
+ *    }
+ */
+class LatencyScope{
+public:
+    LatencyScope(LatencyMonitor* monitor, latencySectionId section, cudaStream_t stream = 0);
+    ~LatencyScope();
+
+private:
+    LatencyMonitor* mMonitor;
+};
+
+#endif // PX2LATENCY_H
@@ -7,7 +7,29 @@ px2LD::px2LD(px2Cam *_px2Cam)
 
 px2LD::~px2LD()
 {
+    // Waits for a branch still running from DetectLanesByHarmony
+    StopHarmonyWorkers();
 
+    if(mDWBranchInputHandle != DW_NULL_HANDLE)
+        dwImage_destroy(&mDWBranchInputHandle);
+
+    if(mTrtContext)
+        mTrtContext->destroy();
+
+    if(mTrtEngine)
+        mTrtEngine->destroy();
+
+    if(mTrtRuntime)
+        mTrtRuntime->destroy();
+
+    if(mLaneMapHost)
+        cudaFreeHost(mLaneMapHost);
+
+    if(mTrtCudaStream)
+        cudaStreamDestroy(mTrtCudaStream);
+
+    if(mCudaStream)
+        cudaStreamDestroy(mCudaStream);
 }
 
 void px2LD::Init(float32_t thresVal)
@@ -23,12 +45,23 @@ void px2LD::Init(float32_t thresVal)
     CHECK_DW_ERROR(dwLaneDetector_initializeFromLaneNet(&mLaneDetector, mLaneNet,
                                                         CAM_IMG_WIDTH, CAM_IMG_HEIGHT, mPx2Cam->GetDwContext()));
 
+    // Own stream, so LaneNet can overlap with the custom lane network (DetectLanesByHarmony)
+    CHECK_CUDA_ERROR(cudaStreamCreate(&mCudaStream));
     CHECK_DW_ERROR(dwLaneDetector_setCUDAStream(mCudaStream, mLaneDetector));
 
     CHECK_DW_ERROR(dwLaneDetector_setDetectionThreshold(mThresVal, mLaneDetector));
 }
 
-void px2LD::Init(float32_t thresVal, string invRectMapFilePath, string ipmMatrixFilePath)
+bool px2LD::Init(float32_t thresVal, string invRectMapFilePath, string ipmMatrixFilePath)
+{
+    if(!LoadCalibration(invRectMapFilePath, ipmMatrixFilePath))
+        return false;
+
+    Init(thresVal);
+    return true;
+}
+
+bool px2LD::LoadCalibration(string invRectMapFilePath, string ipmMatrixFilePath)
 {
     cv::FileStorage fs(invRectMapFilePath, cv::FileStorage::READ);
     fs["invMap1"] >> mInvMap1;
@@ -39,10 +72,134 @@ void px2LD::Init(float32_t thresVal, string invRectMapFilePath, string ipmMatrix
     fs2["ipmMat"] >> mIPMMat;
     fs2.release();
 
-    Init(thresVal);
+    // Dist2Rect() reads both maps with the bounds of invMap1
+    if(mInvMap1.empty() || mInvMap2.empty())
+    {
+        cout << "[LD_INIT] Cannot read inverse rectification map : " << invRectMapFilePath << endl;
+        return false;
+    }
+
+    if((mInvMap1.size() != mInvMap2.size()) || (mInvMap1.type() != CV_32S) || (mInvMap2.type() != CV_32S))
+    {
+        cout << "[LD_INIT] invMap1 / invMap2 must be two int maps of the same size : " << invRectMapFilePath << endl;
+        return false;
+    }
+
+    if(mIPMMat.empty())
+    {
+        cout << "[LD_INIT] Cannot read IPM matrix : " << ipmMatrixFilePath << endl;
+        return false;
+    }
+
+    if((mIPMMat.rows != 3) || (mIPMMat.cols != 3) || (mIPMMat.type() != CV_64F))
+    {
+        cout << "[LD_INIT] IPM matrix must be a 3x3 double matrix : " << ipmMatrixFilePath << endl;
+        return false;
+    }
+
+    for(int rowIdx = 0; rowIdx < 3; rowIdx++)
+    {
+        for(int colIdx = 0; colIdx < 3; colIdx++)
+            mIPMH[rowIdx*3 + colIdx] = mIPMMat.at<double>(rowIdx, colIdx);
+    }
+
+    if(!mIPMHomography.SetMatrix(mIPMH))
+    {
+        cout << "[LD_INIT] IPM matrix is singular : " << ipmMatrixFilePath << endl;
+        return false;
+    }
+
+    return true;
 }
 
-vector<dwVector2f> px2LD::DistortList2RectifiedList(vector<dwVector2f> distortionCoordList)
+bool px2LD::InitJUNG(string trtEngineFilePath, laneDecoderParameters decoderParams)
+{
+    ifstream engineFile(trtEngineFilePath, ios::binary);
+    if(!engineFile.good())
+    {
+        cout << "[LD_INIT] Cannot open TensorRT engine : " << trtEngineFilePath << endl;
+        return false;
+    }
+
+    vector<char> engineData((istreambuf_iterator<char>(engineFile)), istreambuf_iterator<char>());
+    engineFile.close();
+
+    mTrtRuntime = nvinfer1::createInferRuntime(mTrtLogger);
+    mTrtEngine = mTrtRuntime->deserializeCudaEngine(engineData.data(), engineData.size(), nullptr);
+
+    if(!mTrtEngine || (mTrtEngine->getNbBindings() != 2))
+    {
+        cout << "[LD_INIT] TensorRT engine must have one input and one output : " << trtEngineFilePath << endl;
+        return false;
+    }
+
+    mTrtInputIdx = mTrtEngine->bindingIsInput(0) ? 0 : 1;
+    mTrtOutputIdx = 1 - mTrtInputIdx;
+
+    // Binding dimensions are CHW
+    nvinfer1::Dims inputDims = mTrtEngine->getBindingDimensions(mTrtInputIdx);
+    nvinfer1::Dims outputDims = mTrtEngine->getBindingDimensions(mTrtOutputIdx);
+
+    // Input : the px2Cam tensor as it is (resize + crop geometry of px2Cam::Init)
+    int trtImgWidth = mPx2Cam->GetTrtImgWidth();
+    int trtImgHeight = mPx2Cam->GetTrtImgHeight();
+    if((inputDims.nbDims != 3) || (inputDims.d[0] != 3) || (inputDims.d[1] != trtImgHeight) || (inputDims.d[2] != trtImgWidth))
+    {
+        cout << "[LD_INIT] TensorRT engine input must be 3x" << trtImgHeight << "x" << trtImgWidth
+             << " (px2Cam ROI) : " << trtEngineFilePath << endl;
+        return false;
+    }
+
+    // Output : 1 (lane) or 2 (background, lane) probability channels, at most the input size,
+    // with enough decoded rows for a lane of minLanePts points
+    if((outputDims.nbDims != 3) || (outputDims.d[0] < 1) || (outputDims.d[0] > 2) ||
+       (outputDims.d[1] <= 0) || (outputDims.d[2] <= 0) ||
+       (outputDims.d[1] > trtImgHeight) || (outputDims.d[2] > trtImgWidth) ||
+       (outputDims.d[1] < decoderParams.rowStep*decoderParams.minLanePts))
+    {
+        cout << "[LD_INIT] TensorRT engine output is not a lane probability map for the decoder : " << trtEngineFilePath << endl;
+        return false;
+    }
+
+    mTrtContext = mTrtEngine->createExecutionContext();
+
+    mTrtInputHeight = inputDims.d[1];
+    mTrtInputWidth = inputDims.d[2];
+
+    int laneMapChannels = outputDims.d[0];
+    mLaneMapHeight = outputDims.d[1];
+    mLaneMapWidth = outputDims.d[2];
+
+    // Single channel : lane probability, otherwise channel 0 is background and channel 1 is lane
+    mLaneMapChannel = (laneMapChannels > 1) ? 1 : 0;
+
+    CHECK_CUDA_ERROR(cudaStreamCreate(&mTrtCudaStream));
+
+    // Freed with the px2Cam device arena
+    DeviceArena* deviceArena = mPx2Cam->GetDeviceArena();
+    arenaBufferId laneMapId = deviceArena->Request("ld", "laneMap", laneMapChannels*mLaneMapHeight*mLaneMapWidth*sizeof(float));
+    arenaBufferId harmonyInputId = deviceArena->Request("ld", "harmonyInput", 3*mTrtInputHeight*mTrtInputWidth*sizeof(float));
+    if(!deviceArena->Commit())
+    {
+        cout << "[LD_INIT] Lane map allocation fail" << endl;
+        return false;
+    }
+    mLaneMapCuda = deviceArena->Get<float>(laneMapId);
+    mJUNGBranchInput = deviceArena->Get<float>(harmonyInputId);
+
+    CHECK_CUDA_ERROR(cudaMallocHost(&mLaneMapHost, mLaneMapHeight*mLaneMapWidth*sizeof(float)));
+
+    mTrtBindings[mTrtOutputIdx] = mLaneMapCuda;
+
+    mLaneDecoder.SetParameters(decoderParams);
+
+    cout << "[LD_INIT] Lane segmentation network : input " << mTrtInputWidth << "x" << mTrtInputHeight
+         << ", lane map " << mLaneMapWidth << "x" << mLaneMapHeight << "x" << laneMapChannels << endl;
+
+    return true;
+}
+
+vector<dwVector2f> px2LD::DistortList2RectifiedList(const vector<dwVector2f>& distortionCoordList)
 {
     vector<dwVector2f> rectifiedCoordList;
 
@@ -65,6 +222,14 @@ dwVector2f px2LD::Dist2Rect(dwVector2f distortionCoord)
     int x = (int)distortionCoord.x;
     int y = (int)distortionCoord.y;
 
+    if((x < 0) || (y < 0) || (x >= mInvMap1.cols) || (y >= mInvMap1.rows))
+    {
+        dwVector2f invalidCoord;
+        invalidCoord.x = -1;
+        invalidCoord.y = -1;
+        return invalidCoord;
+    }
+
     int oriX = mInvMap1.at<int>(y,x);
     int oriY = mInvMap2.at<int>(y,x);
 
@@ -83,45 +248,30 @@ dwVector2f px2LD::Dist2Rect(dwVector2f distortionCoord)
     return rectifiedCoord;
 }
 
-vector<dwVector2f> px2LD::RectifiedList2TopviewList(vector<dwVector2f> rectifiedCoordList)
+vector<dwVector2f> px2LD::RectifiedList2TopviewList(const vector<dwVector2f>& rectifiedCoordList)
 {
-    vector<dwVector2f> topViewPtList;
-
-    for(uint ptIdx = 0U; ptIdx < rectifiedCoordList.size(); ptIdx++)
-    {
-        dwVector2f topViewPt = Rect2Topview(rectifiedCoordList[ptIdx]);
+    vector<dwVector2f> topViewPtList(rectifiedCoordList.size());
 
-        topViewPtList.push_back(topViewPt);
-    }
+    if(!rectifiedCoordList.empty())
+        RectifiedPts2TopviewPts(rectifiedCoordList.data(), topViewPtList.data(), rectifiedCoordList.size());
 
     return topViewPtList;
 }
 
+static_assert(sizeof(dwVector2f) == 2*sizeof(float32_t), "dwVector2f must be two packed floats");
 
-dwVector2f px2LD::Rect2Topview(dwVector2f rectifiedCoord)
+void px2LD::RectifiedPts2TopviewPts(const dwVector2f* rectifiedPts, dwVector2f* topviewPts, uint32_t numPts)
 {
-    double H11 = mIPMMat.at<double>(0, 0);
-    double H12 = mIPMMat.at<double>(0, 1);
-    double H13 = mIPMMat.at<double>(0, 2);
-    double H21 = mIPMMat.at<double>(1, 0);
-    double H22 = mIPMMat.at<double>(1, 1);
-    double H23 = mIPMMat.at<double>(1, 2);
-    double H31 = mIPMMat.at<double>(2, 0);
-    double H32 = mIPMMat.at<double>(2, 1);
-    double H33 = mIPMMat.at<double>(2, 2);
-
-    float x = rectifiedCoord.x;
-    float y = rectifiedCoord.y;
-
-    dwVector2f topViewPt;
-
-    topViewPt.x = (H11*x + H12*y + H13)/(H31*x + H32*y + H33);
-    topViewPt.y = (H21*x + H22*y + H23)/(H31*x + H32*y + H33);
+    mIPMHomography.TransformInterleaved(&rectifiedPts[0].x, &topviewPts[0].x, numPts);
+}
 
-    return topViewPt;
+void px2LD::TopviewPts2RectifiedPts(const dwVector2f* topviewPts, dwVector2f* rectifiedPts, uint32_t numPts)
+{
+    mIPMHomography.InverseTransformInterleaved(&topviewPts[0].x, &rectifiedPts[0].x, numPts);
 }
 
-vector<float> px2LD::TopviewList2Eq(vector<dwVector2f> topviewList)
+
+vector<float> px2LD::TopviewList2Eq(const vector<dwVector2f>& topviewList)
 {
     vector<float> eqCoeffs = laneFitter.FitLine(topviewList, 3);
 
@@ -134,87 +284,563 @@ void px2LD::DetectLanesByDW(dwImageCUDA* dwLDInputImg,
                      vector<string>& outputLDPositionNamePerLane,
                      vector<string>& outputLDTypeNamePerLane)
 {
+    laneDetectionList ldList;
+    RunLaneNet(dwLDInputImg, ldList);
+
+    ExportLaneList(ldList, outputLDPtsPerLane, outputLDColorPerLane, outputLDPositionNamePerLane, outputLDTypeNamePerLane);
+}
+
+void px2LD::DetectLanesByDW(dwImageCUDA* dwLDInputImg, LaneFrame& laneFrame)
+{
+    lock_guard<mutex> laneNetLock(mLaneNetMutex);
+
     mLDInputImg = dwLDInputImg;
-    CHECK_DW_ERROR(dwLaneDetector_processDeviceAsync(mLDInputImg, mLaneDetector));
-    CHECK_DW_ERROR(dwLaneDetector_interpretHost(mLaneDetector));
-    CHECK_DW_ERROR(dwLaneDetector_getLaneDetections(&mLaneDetectionResult, mLaneDetector));
-
-    vector<vector<dwVector2f> > ldPtsPerLane;
-    vector<dwVector4f> ldColorPerLane;
-    vector<string> ldPositionNamePerLane;
-    vector<string> ldTypeNamePerLane;
+    {
+        static const latencySectionId laneNetSection = LatencyMonitor::RegisterSection("laneNet");
+        LatencyScope laneNetScope(mPx2Cam->GetLatencyMonitor(), laneNetSection, mCudaStream);
+        CHECK_DW_ERROR(dwLaneDetector_processDeviceAsync(mLDInputImg, mLaneDetector));
+        CHECK_DW_ERROR(dwLaneDetector_interpretHost(mLaneDetector));
+        CHECK_DW_ERROR(dwLaneDetector_getLaneDetections(&mLaneDetectionResult, mLaneDetector));
+    }
+
+    laneFrame.Clear();
+    laneFrame.timestamp_us = dwLDInputImg->timestamp_us;
+
     for(uint32_t laneIdx = 0U; laneIdx < mLaneDetectionResult.numLaneMarkings; ++laneIdx)
     {
         const dwLaneMarking& laneMarking = mLaneDetectionResult.laneMarkings[laneIdx];
 
-        dwLanePositionType lanePos = laneMarking.positionType;
+        if(!laneFrame.AddLane(laneMarking.imagePoints, laneMarking.numPoints,
+                              laneMarking.positionType, laneMarking.lineType,
+                              laneMarking.confidence, GetLaneMarkingColor(laneMarking.positionType)))
+            break;
+    }
+}
+
+void px2LD::RectifyLaneFrame(LaneFrame& laneFrame)
+{
+    for(uint32_t laneIdx = 0U; laneIdx < laneFrame.numLanes; laneIdx++)
+    {
+        laneFrameLane& lane = laneFrame.lanes[laneIdx];
+        const dwVector2f* imagePts = laneFrame.GetImagePts(laneIdx);
+        dwVector2f* rectifiedPts = laneFrame.GetTopviewPts(laneIdx);
 
-        vector<dwVector2f> lanePts(laneMarking.imagePoints, laneMarking.imagePoints + laneMarking.numPoints);
-        ldPtsPerLane.push_back(lanePts);
+        uint32_t numValidPts = 0;
+        for(uint32_t ptIdx = 0U; ptIdx < lane.numPts; ptIdx++)
+        {
+            dwVector2f rectifiedCoord = Dist2Rect(imagePts[ptIdx]);
 
-        dwVector4f laneColorVec = GetLaneMarkingColor(lanePos);
-        ldColorPerLane.push_back(laneColorVec);
+            if((rectifiedCoord.x >= 0) && (rectifiedCoord.y > 0))
+                rectifiedPts[numValidPts++] = rectifiedCoord;
+        }
+
+        lane.numTopviewPts = numValidPts;
+    }
+}
+
+void px2LD::TopviewLaneFrame(LaneFrame& laneFrame)
+{
+    for(uint32_t laneIdx = 0U; laneIdx < laneFrame.numLanes; laneIdx++)
+    {
+        dwVector2f* lanePts = laneFrame.GetTopviewPts(laneIdx);
+
+        RectifiedPts2TopviewPts(lanePts, lanePts, laneFrame.lanes[laneIdx].numTopviewPts);
+    }
+}
+
+void px2LD::FitLaneFrame(LaneFrame& laneFrame, uint32_t minPts)
+{
+    static const latencySectionId laneFittingSection = LatencyMonitor::RegisterSection("laneFitting");
+    LatencyScope fittingScope(mPx2Cam->GetLatencyMonitor(), laneFittingSection);
 
-        string lanePosNameStr;
-        switch(lanePos)
+    for(uint32_t laneIdx = 0U; laneIdx < laneFrame.numLanes; laneIdx++)
+    {
+        laneFrameLane& lane = laneFrame.lanes[laneIdx];
+        const dwVector2f* lanePts = laneFrame.GetTopviewPts(laneIdx);
+
+        lane.fitValid = false;
+        if(lane.numTopviewPts < minPts)
+            continue;
+
+        lane.minY = lanePts[0].y;
+        lane.maxY = lanePts[0].y;
+        for(uint32_t ptIdx = 1U; ptIdx < lane.numTopviewPts; ptIdx++)
         {
-        case DW_LANEMARK_POSITION_ADJACENT_LEFT:
-            lanePosNameStr = "LEFT-LEFT";
-            break;
-        case DW_LANEMARK_POSITION_EGO_LEFT:
-            lanePosNameStr = "LEFT";
-            break;
-        case DW_LANEMARK_POSITION_EGO_RIGHT:
-            lanePosNameStr = "RIGHT";
-            break;
-        case DW_LANEMARK_POSITION_ADJACENT_RIGHT:
-            lanePosNameStr = "RIGHT-RIGHT";
-            break;
-        case DW_LANEMARK_POSITION_UNDEFINED:
-            lanePosNameStr = "UNKNOWN";
-            break;
-        default:
-            lanePosNameStr = "UNKNOWN";
+            lane.minY = min(lane.minY, lanePts[ptIdx].y);
+            lane.maxY = max(lane.maxY, lanePts[ptIdx].y);
+        }
+
+        lane.fitValid = laneFitter.FitLine(lanePts, lane.numTopviewPts, LANE_FRAME_POLY_ORDER, lane.fitCoeffs);
+    }
+}
+
+void px2LD::DetectLanesByJUNG(float* trtLDInputImg,
+                              vector<vector<dwVector2f> >& outputLDPtsPerLane,
+                              vector<dwVector4f>& outputLDColorPerLane,
+                              vector<string>& outputLDPositionNamePerLane,
+                              vector<string>& outputLDTypeNamePerLane)
+{
+    laneDetectionList ldList;
+    RunLaneSegNet(trtLDInputImg, ldList);
+
+    ExportLaneList(ldList, outputLDPtsPerLane, outputLDColorPerLane, outputLDPositionNamePerLane, outputLDTypeNamePerLane);
+}
+
+void px2LD::DetectLanesByJUNG(float* trtLDInputImg, uint64_t timestamp_us, LaneFrame& laneFrame)
+{
+    laneDetectionList ldList;
+    RunLaneSegNet(trtLDInputImg, ldList);
+
+    laneFrame.Clear();
+    laneFrame.timestamp_us = timestamp_us;
+    ImportLaneList(ldList, laneFrame);
+}
+
+void px2LD::SetHarmonyParameters(harmonyParameters params)
+{
+    mHarmonyParams = params;
+}
+
+void px2LD::DetectLanesByHarmony(dwImageCUDA *dwLDInputImg, float *trtLDInputImg,
+                                 vector<vector<dwVector2f> >& outputLDTopviewPtsPerLane,
+                                 vector<dwVector4f>& outputLDColorPerLane,
+                                 vector<string>& outputLDPositionNamePerLane,
+                                 vector<string>& outputLDTypeNamePerLane)
+{
+    laneDetectionList fusedList;
+    RunHarmony(dwLDInputImg, trtLDInputImg, fusedList);
+
+    ExportLaneList(fusedList, outputLDTopviewPtsPerLane, outputLDColorPerLane, outputLDPositionNamePerLane, outputLDTypeNamePerLane);
+}
+
+void px2LD::DetectLanesByHarmony(dwImageCUDA* dwLDInputImg, float* trtLDInputImg, LaneFrame& laneFrame)
+{
+    laneDetectionList fusedList;
+    RunHarmony(dwLDInputImg, trtLDInputImg, fusedList);
+
+    laneFrame.Clear();
+    laneFrame.timestamp_us = dwLDInputImg->timestamp_us;
+    ImportLaneList(fusedList, laneFrame);
+
+    // Fused points are top-view already
+    for(uint32_t laneIdx = 0U; laneIdx < laneFrame.numLanes; laneIdx++)
+    {
+        laneFrameLane& lane = laneFrame.lanes[laneIdx];
+        memcpy(laneFrame.GetTopviewPts(laneIdx), laneFrame.GetImagePts(laneIdx), lane.numPts*sizeof(dwVector2f));
+        lane.numTopviewPts = lane.numPts;
+    }
+}
+
+void px2LD::RunHarmony(dwImageCUDA* dwLDInputImg, float* trtLDInputImg, laneDetectionList& fusedList)
+{
+    auto frameBegin = std::chrono::steady_clock::now();
+
+    if(!mDWBranch.worker.joinable())
+        StartHarmonyWorkers(dwLDInputImg);
+
+    // A branch that missed its deadline on a previous frame is still busy with its own input copy.
+    // It is not launched again until it finishes, and its late result is dropped.
+    // An idle branch gets a copy of this frame's input, made before the call returns (the caller's buffers are
+    // overwritten by the next frame), on the branch stream which is idle too.
+    bool dwLaunched = false;
+    bool jungLaunched = false;
+    {
+        unique_lock<mutex> lock(mHarmonyMutex);
+        dwLaunched = !mDWBranch.busy;
+        jungLaunched = mTrtContext && !mJUNGBranch.busy;
+    }
+
+    if(dwLaunched)
+    {
+        CHECK_CUDA_ERROR(cudaMemcpy2DAsync(mDWBranchInput->dptr[0], mDWBranchInput->pitch[0],
+                                           dwLDInputImg->dptr[0], dwLDInputImg->pitch[0],
+                                           dwLDInputImg->prop.width*4, dwLDInputImg->prop.height,
+                                           cudaMemcpyDeviceToDevice, mCudaStream));
+        mDWBranchInput->timestamp_us = dwLDInputImg->timestamp_us;
+    }
+
+    if(jungLaunched)
+    {
+        CHECK_CUDA_ERROR(cudaMemcpyAsync(mJUNGBranchInput, trtLDInputImg, 3*mTrtInputHeight*mTrtInputWidth*sizeof(float),
+                                         cudaMemcpyDeviceToDevice, mTrtCudaStream));
+    }
+
+    if(dwLaunched)
+        CHECK_CUDA_ERROR(cudaStreamSynchronize(mCudaStream));
+    if(jungLaunched)
+        CHECK_CUDA_ERROR(cudaStreamSynchronize(mTrtCudaStream));
+
+    {
+        lock_guard<mutex> lock(mHarmonyMutex);
+        if(dwLaunched)
+        {
+            mDWBranch.pending = mDWBranch.busy = true;
+            mDWBranch.cond.notify_all();
+        }
+        if(jungLaunched)
+        {
+            mJUNGBranch.pending = mJUNGBranch.busy = true;
+            mJUNGBranch.cond.notify_all();
+        }
+    }
+
+    auto dwDeadline = frameBegin + std::chrono::microseconds((int64_t)(mHarmonyParams.dwBudgetMs*1000.f));
+    auto jungDeadline = frameBegin + std::chrono::microseconds((int64_t)(mHarmonyParams.jungBudgetMs*1000.f));
+
+    bool dwValid = false;
+    bool jungValid = false;
+    {
+        unique_lock<mutex> lock(mHarmonyMutex);
+
+        if(dwLaunched)
+            dwValid = mDWBranch.cond.wait_until(lock, dwDeadline, [this]{ return !mDWBranch.busy; });
+        if(jungLaunched)
+            jungValid = mJUNGBranch.cond.wait_until(lock, jungDeadline, [this]{ return !mJUNGBranch.busy; });
+
+        if(!dwValid)
+            mDWBranch.missCount++;
+        if(!jungValid && mTrtContext)
+            mJUNGBranch.missCount++;
+    }
+
+    if(!dwValid || (!jungValid && mTrtContext))
+    {
+        PX2_LOG_WARN_RATE(1, "[LD_HARMONY] Branch deadline missed (LaneNet : %llu, custom : %llu frames)",
+                          mDWBranch.missCount, mJUNGBranch.missCount);
+    }
+
+    // Every lane goes to the top-view, then lanes with the same position are merged
+    map<int, vector<dwVector2f> > dwTopviewPerPos;
+    map<int, vector<dwVector2f> > jungTopviewPerPos;
+    map<int, float32_t> dwConfidencePerPos;
+    map<int, float32_t> jungConfidencePerPos;
+    map<int, dwLaneMarkingType> typePerPos;
+
+    fusedList.ptsPerLane.clear();
+    fusedList.positionPerLane.clear();
+    fusedList.typePerLane.clear();
+    fusedList.confidencePerLane.clear();
+
+    if(dwValid)
+    {
+        for(uint laneIdx = 0; laneIdx < mDWBranchResult.ptsPerLane.size(); laneIdx++)
+        {
+            vector<dwVector2f> topviewPts = RectifiedList2TopviewList(DistortList2RectifiedList(mDWBranchResult.ptsPerLane[laneIdx]));
+            dwLanePositionType lanePos = mDWBranchResult.positionPerLane[laneIdx];
+
+            if((lanePos == DW_LANEMARK_POSITION_UNDEFINED) || dwTopviewPerPos.count(lanePos))
+            {
+                fusedList.ptsPerLane.push_back(topviewPts);
+                fusedList.positionPerLane.push_back(lanePos);
+                fusedList.typePerLane.push_back(mDWBranchResult.typePerLane[laneIdx]);
+                fusedList.confidencePerLane.push_back(mDWBranchResult.confidencePerLane[laneIdx]);
+                continue;
+            }
+
+            dwTopviewPerPos[lanePos] = topviewPts;
+            dwConfidencePerPos[lanePos] = mDWBranchResult.confidencePerLane[laneIdx];
+            typePerPos[lanePos] = mDWBranchResult.typePerLane[laneIdx];
+        }
+    }
+
+    if(jungValid)
+    {
+        for(uint laneIdx = 0; laneIdx < mJUNGBranchResult.ptsPerLane.size(); laneIdx++)
+        {
+            dwLanePositionType lanePos = mJUNGBranchResult.positionPerLane[laneIdx];
+
+            // Custom network lanes without an ego/adjacent position are only used when LaneNet has no result
+            if((lanePos == DW_LANEMARK_POSITION_UNDEFINED) && dwValid)
+                continue;
+
+            vector<dwVector2f> topviewPts = RectifiedList2TopviewList(DistortList2RectifiedList(mJUNGBranchResult.ptsPerLane[laneIdx]));
+
+            if(lanePos == DW_LANEMARK_POSITION_UNDEFINED)
+            {
+                fusedList.ptsPerLane.push_back(topviewPts);
+                fusedList.positionPerLane.push_back(lanePos);
+                fusedList.typePerLane.push_back(mJUNGBranchResult.typePerLane[laneIdx]);
+                fusedList.confidencePerLane.push_back(mJUNGBranchResult.confidencePerLane[laneIdx]);
+                continue;
+            }
+
+            jungTopviewPerPos[lanePos] = topviewPts;
+            jungConfidencePerPos[lanePos] = mJUNGBranchResult.confidencePerLane[laneIdx];
+
+            if(!typePerPos.count(lanePos))
+                typePerPos[lanePos] = mJUNGBranchResult.typePerLane[laneIdx];
+        }
+    }
+
+    for(auto& posType : typePerPos)
+    {
+        dwLanePositionType lanePos = (dwLanePositionType)posType.first;
+
+        bool inDW = dwTopviewPerPos.count(lanePos);
+        bool inJUNG = jungTopviewPerPos.count(lanePos);
+
+        if(inDW && inJUNG)
+        {
+            fusedList.ptsPerLane.push_back(MergeTopviewLanes(dwTopviewPerPos[lanePos], dwConfidencePerPos[lanePos],
+                                                             jungTopviewPerPos[lanePos], jungConfidencePerPos[lanePos]));
+            fusedList.confidencePerLane.push_back(max(dwConfidencePerPos[lanePos], jungConfidencePerPos[lanePos]));
+        }
+        else if(inDW)
+        {
+            fusedList.ptsPerLane.push_back(dwTopviewPerPos[lanePos]);
+            fusedList.confidencePerLane.push_back(dwConfidencePerPos[lanePos]);
+        }
+        else
+        {
+            fusedList.ptsPerLane.push_back(jungTopviewPerPos[lanePos]);
+            fusedList.confidencePerLane.push_back(jungConfidencePerPos[lanePos]);
+        }
+
+        fusedList.positionPerLane.push_back(lanePos);
+        fusedList.typePerLane.push_back(posType.second);
+    }
+}
+
+void px2LD::StartHarmonyWorkers(dwImageCUDA* dwLDInputImg)
+{
+    // LaneNet input copy : same properties as the caller's image
+    CHECK_DW_ERROR(dwImage_create(&mDWBranchInputHandle, dwLDInputImg->prop, mPx2Cam->GetDwContext()));
+    CHECK_DW_ERROR(dwImage_getCUDA(&mDWBranchInput, mDWBranchInputHandle));
+
+    mHarmonyStop = false;
+    mDWBranch.worker = thread(&px2LD::RunHarmonyBranch, this, &mDWBranch);
+    if(mTrtContext)
+        mJUNGBranch.worker = thread(&px2LD::RunHarmonyBranch, this, &mJUNGBranch);
+}
+
+void px2LD::StopHarmonyWorkers()
+{
+    {
+        lock_guard<mutex> lock(mHarmonyMutex);
+        mHarmonyStop = true;
+    }
+    mDWBranch.cond.notify_all();
+    mJUNGBranch.cond.notify_all();
+
+    if(mDWBranch.worker.joinable())
+        mDWBranch.worker.join();
+    if(mJUNGBranch.worker.joinable())
+        mJUNGBranch.worker.join();
+}
+
+void px2LD::RunHarmonyBranch(harmonyBranch* branch)
+{
+    unique_lock<mutex> lock(mHarmonyMutex);
+
+    while(true)
+    {
+        branch->cond.wait(lock, [this, branch]{ return mHarmonyStop || branch->pending; });
+
+        if(mHarmonyStop)
             break;
+
+        branch->pending = false;
+        lock.unlock();
+
+        if(branch == &mDWBranch)
+            RunLaneNet(mDWBranchInput, mDWBranchResult);
+        else
+            RunLaneSegNet(mJUNGBranchInput, mJUNGBranchResult);
+
+        lock.lock();
+        branch->busy = false;
+        branch->cond.notify_all();
+    }
+}
+
+vector<dwVector2f> px2LD::MergeTopviewLanes(const vector<dwVector2f>& lanePtsA, float32_t confidenceA,
+                                            const vector<dwVector2f>& lanePtsB, float32_t confidenceB)
+{
+    // Mean x per y bin of each lane
+    map<int, pair<float, int> > binsA;
+    map<int, pair<float, int> > binsB;
+
+    float binSize = mHarmonyParams.fusionBinSize;
+
+    for(uint ptIdx = 0; ptIdx < lanePtsA.size(); ptIdx++)
+    {
+        pair<float, int>& bin = binsA[(int)floor(lanePtsA[ptIdx].y/binSize)];
+        bin.first += lanePtsA[ptIdx].x;
+        bin.second++;
+    }
+
+    for(uint ptIdx = 0; ptIdx < lanePtsB.size(); ptIdx++)
+    {
+        pair<float, int>& bin = binsB[(int)floor(lanePtsB[ptIdx].y/binSize)];
+        bin.first += lanePtsB[ptIdx].x;
+        bin.second++;
+    }
+
+    // Bins seen by both lanes are confidence-weighted, the others are taken as they are
+    map<int, float> mergedBins;
+    for(auto& bin : binsA)
+        mergedBins[bin.first] = bin.second.first/bin.second.second;
+
+    float weightSum = max(confidenceA + confidenceB, 1e-6f);
+    for(auto& bin : binsB)
+    {
+        float xB = bin.second.first/bin.second.second;
+
+        auto itA = mergedBins.find(bin.first);
+        if(itA == mergedBins.end())
+            mergedBins[bin.first] = xB;
+        else
+            itA->second = (confidenceA*itA->second + confidenceB*xB)/weightSum;
+    }
+
+    vector<dwVector2f> mergedPts;
+    mergedPts.reserve(mergedBins.size());
+    for(auto& bin : mergedBins)
+    {
+        dwVector2f pt;
+        pt.x = bin.second;
+        pt.y = ((float)bin.first + 0.5f)*binSize;
+        mergedPts.push_back(pt);
+    }
+
+    return mergedPts;
+}
+
+void px2LD::RunLaneNet(dwImageCUDA* dwLDInputImg, laneDetectionList& ldList)
+{
+    // Same detection as the LaneFrame path, converted for the vector based callers
+    lock_guard<mutex> laneNetFrameLock(mLaneNetFrameMutex);
+    DetectLanesByDW(dwLDInputImg, mLaneNetFrame);
+
+    ldList.ptsPerLane.clear();
+    ldList.positionPerLane.clear();
+    ldList.typePerLane.clear();
+    ldList.confidencePerLane.clear();
+
+    for(uint32_t laneIdx = 0U; laneIdx < mLaneNetFrame.numLanes; ++laneIdx)
+    {
+        const laneFrameLane& lane = mLaneNetFrame.lanes[laneIdx];
+        const dwVector2f* lanePts = mLaneNetFrame.GetImagePts(laneIdx);
+
+        ldList.ptsPerLane.push_back(vector<dwVector2f>(lanePts, lanePts + lane.numPts));
+        ldList.positionPerLane.push_back(lane.position);
+        ldList.typePerLane.push_back(lane.type);
+        ldList.confidencePerLane.push_back(lane.confidence);
+    }
+}
+
+void px2LD::RunLaneSegNet(float* trtLDInputImg, laneDetectionList& ldList)
+{
+    ldList.ptsPerLane.clear();
+    ldList.positionPerLane.clear();
+    ldList.typePerLane.clear();
+    ldList.confidencePerLane.clear();
+
+    if(!mTrtContext)
+        return;
+
+    lock_guard<mutex> laneSegNetLock(mLaneSegNetMutex);
+
+    mTrtBindings[mTrtInputIdx] = trtLDInputImg;
+    mTrtContext->enqueue(1, mTrtBindings, mTrtCudaStream, nullptr);
+
+    int laneMapSize = mLaneMapWidth*mLaneMapHeight;
+    CHECK_CUDA_ERROR(cudaMemcpyAsync(mLaneMapHost, mLaneMapCuda + mLaneMapChannel*laneMapSize, laneMapSize*sizeof(float),
+                                     cudaMemcpyDeviceToHost, mTrtCudaStream));
+    CHECK_CUDA_ERROR(cudaStreamSynchronize(mTrtCudaStream));
+
+    // Lanes are ordered from left to right
+    mLaneDecoder.Decode(mLaneMapHost, mLaneMapWidth, mLaneMapHeight, mLaneInstances);
+
+    // Lane map -> network input(resized and cropped image) -> original image
+    float mapScaleX = (float)mTrtInputWidth/(float)mLaneMapWidth;
+    float mapScaleY = (float)mTrtInputHeight/(float)mLaneMapHeight;
+
+    int numLanes = mLaneInstances.size();
+    vector<float> bottomXPerLane(numLanes);
+    for(int laneIdx = 0; laneIdx < numLanes; laneIdx++)
+    {
+        const vector<laneMapPoint>& mapPts = mLaneInstances[laneIdx].pts;
+
+        vector<dwVector2f> lanePts(mapPts.size());
+        for(uint ptIdx = 0; ptIdx < mapPts.size(); ptIdx++)
+        {
+            mPx2Cam->CoordTrans_ResizeAndCrop2Ori(mapPts[ptIdx].x*mapScaleX, mapPts[ptIdx].y*mapScaleY,
+                                                  lanePts[ptIdx].x, lanePts[ptIdx].y);
         }
-        ldPositionNamePerLane.push_back(lanePosNameStr);
 
-        string laneTypeNameStr;
-        switch(laneMarking.lineType)
+        bottomXPerLane[laneIdx] = lanePts[0].x;
+        ldList.ptsPerLane.push_back(lanePts);
+        ldList.confidencePerLane.push_back(mLaneInstances[laneIdx].confidence);
+
+        // Segmentation map has no marking type
+        ldList.typePerLane.push_back(DW_LANEMARK_TYPE_UNDEFINED);
+    }
+
+    // Ego lanes are the nearest lanes on each side of the image center
+    int firstRightIdx = 0;
+    while((firstRightIdx < numLanes) && (bottomXPerLane[firstRightIdx] < CAM_IMG_WIDTH/2))
+        firstRightIdx++;
+
+    for(int laneIdx = 0; laneIdx < numLanes; laneIdx++)
+    {
+        dwLanePositionType lanePos;
+        switch(laneIdx - firstRightIdx)
         {
-        case DW_LANEMARK_TYPE_SOLID:
-            laneTypeNameStr = "SOLID";
+        case -2:
+            lanePos = DW_LANEMARK_POSITION_ADJACENT_LEFT;
             break;
-        case DW_LANEMARK_TYPE_DASHED:
-            laneTypeNameStr = "DASHED";
+        case -1:
+            lanePos = DW_LANEMARK_POSITION_EGO_LEFT;
             break;
-        case DW_LANEMARK_TYPE_ROAD_BOUNDARY:
-            laneTypeNameStr = "ROAD_BOUNDARY";
+        case 0:
+            lanePos = DW_LANEMARK_POSITION_EGO_RIGHT;
             break;
-        case DW_LANEMARK_TYPE_UNDEFINED:
-            laneTypeNameStr = "UNKNOWN";
+        case 1:
+            lanePos = DW_LANEMARK_POSITION_ADJACENT_RIGHT;
             break;
         default:
-            laneTypeNameStr = "UNKNOWN";
+            lanePos = DW_LANEMARK_POSITION_UNDEFINED;
             break;
         }
-        ldTypeNamePerLane.push_back(laneTypeNameStr);
-    }
 
-    outputLDPtsPerLane = ldPtsPerLane;
-    outputLDColorPerLane = ldColorPerLane;
-    outputLDPositionNamePerLane = ldPositionNamePerLane;
-    outputLDTypeNamePerLane = ldTypeNamePerLane;
+        ldList.positionPerLane.push_back(lanePos);
+    }
 }
 
-void px2LD::DetectLanesByJUNG(float* trtLDInputImg)
+void px2LD::ExportLaneList(const laneDetectionList& ldList,
+                           vector<vector<dwVector2f> >& outputLDPtsPerLane,
+                           vector<dwVector4f>& outputLDColorPerLane,
+                           vector<string>& outputLDPositionNamePerLane,
+                           vector<string>& outputLDTypeNamePerLane)
 {
-    // TBD
+    outputLDPtsPerLane = ldList.ptsPerLane;
+
+    outputLDColorPerLane.clear();
+    outputLDPositionNamePerLane.clear();
+    outputLDTypeNamePerLane.clear();
+
+    for(uint laneIdx = 0; laneIdx < ldList.ptsPerLane.size(); laneIdx++)
+    {
+        outputLDColorPerLane.push_back(GetLaneMarkingColor(ldList.positionPerLane[laneIdx]));
+        outputLDPositionNamePerLane.push_back(LaneFrame::GetPositionName(ldList.positionPerLane[laneIdx]));
+        outputLDTypeNamePerLane.push_back(LaneFrame::GetTypeName(ldList.typePerLane[laneIdx]));
+    }
 }
 
-void px2LD::DetectLanesByHarmony(dwImageCUDA *dwLDInputImg, float *trtLDInputImg)
+bool px2LD::ImportLaneList(const laneDetectionList& ldList, LaneFrame& laneFrame)
 {
-    // TBD
+    for(uint laneIdx = 0; laneIdx < ldList.ptsPerLane.size(); laneIdx++)
+    {
+        const vector<dwVector2f>& lanePts = ldList.ptsPerLane[laneIdx];
+
+        if(!laneFrame.AddLane(lanePts.data(), lanePts.size(),
+                              ldList.positionPerLane[laneIdx], ldList.typePerLane[laneIdx],
+                              ldList.confidencePerLane[laneIdx], GetLaneMarkingColor(ldList.positionPerLane[laneIdx])))
+            return false;
+    }
+
+    return true;
 }
 
 dwVector4f px2LD::GetLaneMarkingColor(dwLanePositionType positionType)
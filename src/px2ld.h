@@ -4,17 +4,66 @@
 #include "px2camlib.h"
 
 #include "fittingAlgorithm.h"
+#include "homography.h"
+#include "laneDecoder.h"
+#include "laneFrame.h"
 
 #include <dw/dnn/LaneNet.h>
 #include <dw/laneperception/LaneDetector.h>
 
+#include <NvInfer.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+class trtLogger : public nvinfer1::ILogger
+{
+public:
+    void log(Severity severity, const char* msg) override
+    {
+        // Only warnings and errors from TensorRT
+        if(severity <= Severity::kWARNING)
+            cout << "[TensorRT] " << msg << endl;
+    }
+};
+
+typedef struct {
+    float dwBudgetMs = 25.f;        // Latency budget of the Driveworks LaneNet branch
+    float jungBudgetMs = 25.f;      // Latency budget of the custom lane network branch
+    float fusionBinSize = 1.f;      // Top-view y bin(m) in which points of the same lane are merged
+}harmonyParameters;
+
+// Lane detector of the application's lane stage
+typedef enum {
+    LANE_DETECTOR_DW = 0,           // Driveworks LaneNet
+    LANE_DETECTOR_JUNG,             // Custom lane segmentation network (InitJUNG)
+    LANE_DETECTOR_HARMONY           // Both, fused in the top-view
+}laneDetectorType;
+
+// Lane detections of one detector, before any conversion for the caller
+typedef struct {
+    vector<vector<dwVector2f> > ptsPerLane;
+    vector<dwLanePositionType> positionPerLane;
+    vector<dwLaneMarkingType> typePerLane;
+    vector<float32_t> confidencePerLane;
+}laneDetectionList;
+
 class px2LD{
 public:
     px2LD(px2Cam* _px2Cam);
     ~px2LD();
 
     void Init(float32_t thresVal);
-    void Init(float32_t thresVal, string invRectMapFilePath, string ipmMatrixFilePath);
+    // False if the calibration files cannot be loaded
+    bool Init(float32_t thresVal, string invRectMapFilePath, string ipmMatrixFilePath);
+
+    // Calibration part of Init(), host only (any thread)
+    bool LoadCalibration(string invRectMapFilePath, string ipmMatrixFilePath);
+
+    // Custom lane segmentation network (serialized TensorRT engine, input : px2Cam::GetTrtImgData())
+    bool InitJUNG(string trtEngineFilePath, laneDecoderParameters decoderParams);
 
     void DetectLanesByDW(dwImageCUDA* dwLDInputImg,
                          vector<vector<dwVector2f> >& outputLDPtsPerLane,
@@ -22,24 +71,82 @@ public:
                          vector<string>& outputLDPositionNamePerLane,
                          vector<string>& outputLDTypeNamePerLane);
 
-    void DetectLanesByJUNG(float* trtLDInputImg);
+    // Allocation-free variant, followed by RectifyLaneFrame -> TopviewLaneFrame -> FitLaneFrame
+    void DetectLanesByDW(dwImageCUDA* dwLDInputImg, LaneFrame& laneFrame);
+
+    void DetectLanesByJUNG(float* trtLDInputImg,
+                           vector<vector<dwVector2f> >& outputLDPtsPerLane,
+                           vector<dwVector4f>& outputLDColorPerLane,
+                           vector<string>& outputLDPositionNamePerLane,
+                           vector<string>& outputLDTypeNamePerLane);
 
+    // LaneFrame variant, followed by RectifyLaneFrame -> TopviewLaneFrame -> FitLaneFrame as DetectLanesByDW
+    void DetectLanesByJUNG(float* trtLDInputImg, uint64_t timestamp_us, LaneFrame& laneFrame);
+
+    void SetHarmonyParameters(harmonyParameters params);
+
+    // Runs LaneNet and the custom network concurrently and fuses them per lane position in the top-view.
+    // Output points are top-view coordinates(m), so Init() must have been given the calibration files.
+    // Both inputs (RGBA image, TensorRT tensor) are copied before the branches start, so they can be reused on return.
     void DetectLanesByHarmony(dwImageCUDA* dwLDInputImg,
-                             float* trtLDInputImg);
+                              float* trtLDInputImg,
+                              vector<vector<dwVector2f> >& outputLDTopviewPtsPerLane,
+                              vector<dwVector4f>& outputLDColorPerLane,
+                              vector<string>& outputLDPositionNamePerLane,
+                              vector<string>& outputLDTypeNamePerLane);
+
+    // LaneFrame variant : lanes are already in the top-view (topviewPts, imagePts holds the same points), followed by FitLaneFrame only
+    void DetectLanesByHarmony(dwImageCUDA* dwLDInputImg, float* trtLDInputImg, LaneFrame& laneFrame);
+
+    vector<dwVector2f> DistortList2RectifiedList(const vector<dwVector2f>& distortionCoordList);
 
-    vector<dwVector2f> DistortList2RectifiedList(vector<dwVector2f> distortionCoordList);
+    vector<dwVector2f> RectifiedList2TopviewList(const vector<dwVector2f>& rectifiedCoordList);
 
-    vector<dwVector2f> RectifiedList2TopviewList(vector<dwVector2f> rectifiedCoordList);
+    // Batched (SIMD) projection, in place allowed. Topview -> rectified is used to draw fitted lanes / world guides.
+    void RectifiedPts2TopviewPts(const dwVector2f* rectifiedPts, dwVector2f* topviewPts, uint32_t numPts);
+    void TopviewPts2RectifiedPts(const dwVector2f* topviewPts, dwVector2f* rectifiedPts, uint32_t numPts);
 
-    vector<float> TopviewList2Eq(vector<dwVector2f> topviewList);
+    vector<float> TopviewList2Eq(const vector<dwVector2f>& topviewList);
+
+    // In-place stages of a LaneFrame
+    void RectifyLaneFrame(LaneFrame& laneFrame);
+    void TopviewLaneFrame(LaneFrame& laneFrame);
+    void FitLaneFrame(LaneFrame& laneFrame, uint32_t minPts = 4);
 
 private:
+    void RunLaneNet(dwImageCUDA* dwLDInputImg, laneDetectionList& ldList);
+    void RunLaneSegNet(float* trtLDInputImg, laneDetectionList& ldList);
+    void RunHarmony(dwImageCUDA* dwLDInputImg, float* trtLDInputImg, laneDetectionList& fusedList);
+
+    // Lanes of ldList into laneFrame (image points), false if the frame is full
+    bool ImportLaneList(const laneDetectionList& ldList, LaneFrame& laneFrame);
+
+    // Harmony branch workers
+    typedef struct {
+        thread worker;
+        condition_variable cond;
+        bool pending = false;       // New input for the worker
+        bool busy = false;          // Input copied, until the worker has written its result
+        uint64_t missCount = 0;
+    }harmonyBranch;
+
+    void StartHarmonyWorkers(dwImageCUDA* dwLDInputImg);
+    void StopHarmonyWorkers();
+    void RunHarmonyBranch(harmonyBranch* branch);
+
+    void ExportLaneList(const laneDetectionList& ldList,
+                        vector<vector<dwVector2f> >& outputLDPtsPerLane,
+                        vector<dwVector4f>& outputLDColorPerLane,
+                        vector<string>& outputLDPositionNamePerLane,
+                        vector<string>& outputLDTypeNamePerLane);
+
+    vector<dwVector2f> MergeTopviewLanes(const vector<dwVector2f>& lanePtsA, float32_t confidenceA,
+                                         const vector<dwVector2f>& lanePtsB, float32_t confidenceB);
+
     dwVector4f GetLaneMarkingColor(dwLanePositionType positionType);
 
     dwVector2f Dist2Rect(dwVector2f distortionCoord);
 
-    dwVector2f Rect2Topview(dwVector2f rectifiedCoord);
-
 private:
     px2Cam* mPx2Cam;
 
@@ -58,8 +165,52 @@ private:
     cv::Mat mInvMap2;
 
     cv::Mat mIPMMat;
+    double mIPMH[9];
+    BatchHomography mIPMHomography;
 
     LMSFit laneFitter;
+
+    // Custom lane segmentation network
+    trtLogger mTrtLogger;
+    nvinfer1::IRuntime* mTrtRuntime = nullptr;
+    nvinfer1::ICudaEngine* mTrtEngine = nullptr;
+    nvinfer1::IExecutionContext* mTrtContext = nullptr;
+    cudaStream_t mTrtCudaStream = 0;
+    void* mTrtBindings[2];
+    int mTrtInputIdx = 0;
+    int mTrtOutputIdx = 1;
+    int mTrtInputWidth = 0;
+    int mTrtInputHeight = 0;
+
+    int mLaneMapWidth = 0;
+    int mLaneMapHeight = 0;
+    int mLaneMapChannel = 0;
+    float* mLaneMapCuda = nullptr;
+    float* mLaneMapHost = nullptr;
+
+    LaneSegDecoder mLaneDecoder;
+    vector<laneInstance> mLaneInstances;
+
+    // One caller at a time on each network (stage threads, Harmony workers)
+    mutex mLaneNetMutex;
+    mutex mLaneSegNetMutex;
+
+    // LaneNet result of RunLaneNet(), before its conversion to a laneDetectionList
+    mutex mLaneNetFrameMutex;
+    LaneFrame mLaneNetFrame;
+
+    // Harmony (LaneNet + custom network) : one long-lived worker per branch, working on its own copy of the input.
+    // A branch that misses its deadline keeps its input and result until it finishes, its result is then dropped.
+    harmonyParameters mHarmonyParams;
+    mutex mHarmonyMutex;
+    bool mHarmonyStop = false;
+    harmonyBranch mDWBranch;
+    harmonyBranch mJUNGBranch;
+    dwImageHandle_t mDWBranchInputHandle = DW_NULL_HANDLE;
+    dwImageCUDA* mDWBranchInput = nullptr;
+    float* mJUNGBranchInput = nullptr;
+    laneDetectionList mDWBranchResult;
+    laneDetectionList mJUNGBranchResult;
 };
 
 #endif // PX2LD_H
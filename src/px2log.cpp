@@ -0,0 +1,332 @@
+#include "px2log.h"
+
+#include <chrono>
+#include <iostream>
+
+AsyncLogger& AsyncLogger::Instance()
+{
+    // Constructed on first use, destroyed (drained) after main returns
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+    : mRing(new logSlot[RING_SIZE]), mWriteIdx(0), mLevel(PX2_LOG_COMPILE_LEVEL),
+      mNumDropped(0), mStop(false), mSleeping(false)
+{
+    for(uint32_t slotIdx = 0; slotIdx < RING_SIZE; slotIdx++)
+        mRing[slotIdx].seq.store(slotIdx, memory_order_relaxed);
+
+    mThread = thread(&AsyncLogger::Run, this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStop.store(true);
+        mWake.notify_one();
+    }
+
+    if(mThread.joinable())
+        mThread.join();
+
+    if(mLogFile)
+        fclose(mLogFile);
+    if(mNextLogFile)
+        fclose(mNextLogFile);
+}
+
+bool AsyncLogger::SetLogFile(const string& filePath)
+{
+    FILE* logFile = fopen(filePath.c_str(), "w");
+    if(!logFile)
+    {
+        cout << "[LOG] Cannot open " << filePath << endl;
+        return false;
+    }
+
+    // Swapped (and the previous file closed) by the logger thread, between two records
+    unique_lock<mutex> lock(mMutex);
+    mFlushed.wait(lock, [this]{ return !mSwapLogFile || mStop.load(); });
+    if(mStop.load())
+    {
+        fclose(logFile);
+        return false;
+    }
+
+    mNextLogFile = logFile;
+    mSwapLogFile = true;
+    mWake.notify_one();
+    mFlushed.wait(lock, [this]{ return !mSwapLogFile || mStop.load(); });
+
+    return true;
+}
+
+int64_t AsyncLogger::NowUs()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool AsyncLogger::AllowRate(logRateSite& site, uint32_t maxPerSecond, uint32_t& numSuppressed)
+{
+    int64_t nowUs = NowUs();
+    int64_t windowStartUs = site.windowStartUs.load(memory_order_relaxed);
+
+    // The thread which wins the exchange opens the new 1s window
+    if((nowUs - windowStartUs >= 1000000) &&
+        site.windowStartUs.compare_exchange_strong(windowStartUs, nowUs, memory_order_relaxed))
+    {
+        site.numInWindow.store(0, memory_order_relaxed);
+    }
+
+    if(site.numInWindow.fetch_add(1, memory_order_relaxed) >= maxPerSecond)
+    {
+        site.numSuppressed.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    numSuppressed = site.numSuppressed.exchange(0, memory_order_relaxed);
+    return true;
+}
+
+bool AsyncLogger::TryClaim(uint64_t& writeIdx)
+{
+    writeIdx = mWriteIdx.load(memory_order_relaxed);
+
+    while(true)
+    {
+        logSlot& slot = mRing[writeIdx & (RING_SIZE - 1)];
+        int64_t diff = (int64_t)slot.seq.load(memory_order_acquire) - (int64_t)writeIdx;
+
+        if(diff == 0)
+        {
+            if(mWriteIdx.compare_exchange_weak(writeIdx, writeIdx + 1, memory_order_relaxed))
+                return true;
+        }
+        else if(diff < 0)
+        {
+            // Slot not read yet : full
+            return false;
+        }
+        else
+        {
+            writeIdx = mWriteIdx.load(memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLogger::Publish(uint64_t writeIdx)
+{
+    mRing[writeIdx & (RING_SIZE - 1)].seq.store(writeIdx + 1, memory_order_release);
+
+    // No lock : a wake-up lost against the logger going to sleep is caught by its timeout
+    if(mSleeping.load())
+        mWake.notify_one();
+}
+
+void AsyncLogger::Flush()
+{
+    uint64_t target = mWriteIdx.load();
+
+    unique_lock<mutex> lock(mMutex);
+    mWake.notify_one();
+    mFlushed.wait(lock, [this, target]{ return (mNumFlushed >= target) || mStop.load(); });
+}
+
+bool AsyncLogger::IsRecordReady()
+{
+    return mRing[mReadIdx & (RING_SIZE - 1)].seq.load(memory_order_acquire) == mReadIdx + 1;
+}
+
+void AsyncLogger::Run()
+{
+    while(true)
+    {
+        bool stop = mStop.load();
+        uint32_t numRead = 0;
+
+        while(IsRecordReady())
+        {
+            logSlot& slot = mRing[mReadIdx & (RING_SIZE - 1)];
+
+            WriteRecord(slot.record);
+
+            slot.seq.store(mReadIdx + RING_SIZE, memory_order_release);
+            mReadIdx++;
+            numRead++;
+        }
+
+        uint64_t numDropped = mNumDropped.load(memory_order_relaxed);
+        if(numDropped != mNumDroppedReported)
+        {
+            fprintf(stderr, "[LOG] %llu messages dropped (ring full)\n", (unsigned long long)(numDropped - mNumDroppedReported));
+            mNumDroppedReported = numDropped;
+        }
+
+        if(numRead > 0)
+        {
+            fflush(stdout);
+            if(mLogFile)
+                fflush(mLogFile);
+        }
+
+        unique_lock<mutex> lock(mMutex);
+
+        // Records read so far went to the previous file
+        if(mSwapLogFile)
+        {
+            if(mLogFile)
+                fclose(mLogFile);
+            mLogFile = mNextLogFile;
+            mNextLogFile = nullptr;
+            mSwapLogFile = false;
+        }
+
+        mNumFlushed = mReadIdx;
+        mFlushed.notify_all();
+
+        // Drained after the stop request : a producer still running past exit is not waited for
+        if(stop)
+            break;
+
+        if(numRead == 0)
+        {
+            mSleeping.store(true);
+            mWake.wait_for(lock, chrono::milliseconds(100), [this]{ return mStop.load() || mSwapLogFile || IsRecordReady(); });
+            mSleeping.store(false);
+        }
+    }
+}
+
+void AsyncLogger::WriteRecord(const logRecord& record)
+{
+    string text = FormatRecord(record);
+
+    while(!text.empty() && (text.back() == '\n'))
+        text.pop_back();
+
+    if(record.numSuppressed > 0)
+        text += " (" + to_string(record.numSuppressed) + " suppressed)";
+
+    FILE* console = (record.level >= PX2_LOG_LEVEL_WARN) ? stderr : stdout;
+    fprintf(console, "%s\n", text.c_str());
+
+    if(mLogFile)
+    {
+        static const char* levelNames[] = {"D", "I", "W", "E"};
+        fprintf(mLogFile, "%.6f %s %s\n", record.timeUs/1e6, levelNames[record.level & 3], text.c_str());
+    }
+}
+
+// printf conversions, one snprintf per specifier on its stored argument.
+// Length modifiers of the format are ignored (arguments are stored as 64 bits), '*' width/precision is not supported.
+string AsyncLogger::FormatRecord(const logRecord& record)
+{
+    const char* payload = record.payload;
+    const char* payloadEnd = record.payload + record.payloadSize;
+
+    string text;
+    char buffer[512];
+
+    const char* cur = record.format;
+    while(*cur)
+    {
+        if(*cur != '%')
+        {
+            text += *cur++;
+            continue;
+        }
+
+        if(cur[1] == '%')
+        {
+            text += '%';
+            cur += 2;
+            continue;
+        }
+
+        // Flags, width and precision are kept
+        string spec = "%";
+        cur++;
+        while(*cur && strchr("-+ #0123456789.", *cur))
+            spec += *cur++;
+        while(*cur && strchr("hljztL", *cur))
+            cur++;
+
+        char conversion = *cur;
+        if(!conversion)
+            break;
+        cur++;
+
+        if(payload >= payloadEnd)
+        {
+            text += "<?>";
+            continue;
+        }
+
+        char tag = *payload++;
+        int64_t valueInt = 0;
+        uint64_t valueUInt = 0;
+        double valueDouble = 0.0;
+        const void* valuePtr = nullptr;
+        string valueString;
+
+        switch(tag)
+        {
+        case 'i': memcpy(&valueInt, payload, 8); payload += 8; valueUInt = valueInt; valueDouble = valueInt; break;
+        case 'u': memcpy(&valueUInt, payload, 8); payload += 8; valueInt = valueUInt; valueDouble = valueUInt; break;
+        case 'f': memcpy(&valueDouble, payload, 8); payload += 8; valueInt = valueDouble; valueUInt = valueInt; break;
+        case 'p': memcpy(&valuePtr, payload, sizeof(valuePtr)); payload += sizeof(valuePtr); valueUInt = (uintptr_t)valuePtr; break;
+        case 's':
+        {
+            uint16_t length;
+            memcpy(&length, payload, 2);
+            valueString.assign(payload + 2, length);
+            payload += 2 + length;
+            break;
+        }
+        default:
+            payload = payloadEnd;
+            text += "<?>";
+            continue;
+        }
+
+        switch(conversion)
+        {
+        case 'd': case 'i':
+            spec += "lld";
+            snprintf(buffer, sizeof(buffer), spec.c_str(), (long long)valueInt);
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            spec += "ll";
+            spec += conversion;
+            snprintf(buffer, sizeof(buffer), spec.c_str(), (unsigned long long)valueUInt);
+            break;
+        case 'c':
+            spec += 'c';
+            snprintf(buffer, sizeof(buffer), spec.c_str(), (int)valueInt);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec += conversion;
+            snprintf(buffer, sizeof(buffer), spec.c_str(), valueDouble);
+            break;
+        case 'p':
+            spec += 'p';
+            snprintf(buffer, sizeof(buffer), spec.c_str(), valuePtr);
+            break;
+        case 's':
+            if(tag != 's')
+                valueString = "<?>";
+            spec += 's';
+            snprintf(buffer, sizeof(buffer), spec.c_str(), valueString.c_str());
+            break;
+        default:
+            snprintf(buffer, sizeof(buffer), "<%%%c?>", conversion);
+            break;
+        }
+
+        text += buffer;
+    }
+
+    return text;
+}
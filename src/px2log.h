@@ -0,0 +1,245 @@
+#ifndef PX2LOG_H
+#define PX2LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+using namespace std;
+
+/**
+ * Asynchronous logger for the recognition loop.
+ *
+ * A log call copies the format pointer and its arguments (strings are copied) into a slot of a bounded
+ * lock-free multi-producer ring and returns : formatting and stdout/stderr writes happen on the logger thread.
+ * Full ring -> the message is dropped and counted, a producer never waits.
+ * The idle logger thread sleeps on a condition variable, woken by the producers (or its timeout).
+ *
+ *    PX2_LOG_INFO("[LD_INIT] %d lanes", numLanes);
+ *    PX2_LOG_ERROR_RATE(1, "[DW_PROC_STEP_1] Read frame fail : %s", dwGetStatusName(status));  // At most 1 per second
+ *
+ * Format strings must be literals (the pointer is kept). Severities under PX2_LOG_COMPILE_LEVEL are compiled out,
+ * the others are filtered at runtime with AsyncLogger::SetLevel().
+ */
+
+#define PX2_LOG_LEVEL_DEBUG 0
+#define PX2_LOG_LEVEL_INFO  1
+#define PX2_LOG_LEVEL_WARN  2
+#define PX2_LOG_LEVEL_ERROR 3
+
+#ifndef PX2_LOG_COMPILE_LEVEL
+#define PX2_LOG_COMPILE_LEVEL PX2_LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_PAYLOAD_SIZE 200
+
+// Per call site state of the rate limited macros (static, zero initialized)
+typedef struct {
+    atomic<int64_t> windowStartUs;
+    atomic<uint32_t> numInWindow;
+    atomic<uint32_t> numSuppressed;
+}logRateSite;
+
+class AsyncLogger{
+public:
+    static AsyncLogger& Instance();
+
+    ~AsyncLogger();
+
+    void SetLevel(int level) { mLevel.store(level, memory_order_relaxed); }
+    int GetLevel() const { return mLevel.load(memory_order_relaxed); }
+
+    // Formatted output is written to stdout (debug, info) or stderr (warn, error) and, if set, to this file.
+    // The messages logged before the call go to the previous file, the logger thread swaps the files.
+    bool SetLogFile(const string& filePath);
+
+    template<typename... Args>
+    void Log(int level, uint32_t numSuppressed, const char* format, const Args&... args);
+
+    // Blocks until the messages logged so far are written and flushed (not for the recognition loop)
+    void Flush();
+
+    uint64_t GetNumDropped() const { return mNumDropped.load(); }
+
+    // Rate limit : true if the call site may log now, numSuppressed gets the messages skipped since the last one
+    static bool AllowRate(logRateSite& site, uint32_t maxPerSecond, uint32_t& numSuppressed);
+
+    static int64_t NowUs();
+
+private:
+    AsyncLogger();
+
+    typedef struct {
+        const char* format;
+        int64_t timeUs;
+        uint32_t numSuppressed;
+        uint16_t payloadSize;
+        uint8_t level;
+        char payload[LOG_PAYLOAD_SIZE];
+    }logRecord;
+
+    // Bounded MPSC ring (per slot sequence, Vyukov style)
+    typedef struct {
+        atomic<uint64_t> seq;
+        logRecord record;
+    }logSlot;
+
+    // Arguments, each as a type tag + value
+    class ArgWriter{
+    public:
+        ArgWriter(char* payload) : mCur(payload), mEnd(payload + LOG_PAYLOAD_SIZE) {}
+
+        uint16_t GetSize(const char* payload) const { return mCur - payload; }
+
+        void Write() {}
+
+        template<typename T, typename... Rest>
+        void Write(const T& value, const Rest&... rest)
+        {
+            WriteOne(value);
+            Write(rest...);
+        }
+
+    private:
+        template<typename T>
+        typename enable_if<is_integral<T>::value || is_enum<T>::value>::type WriteOne(const T& value)
+        {
+            if(is_signed<T>::value || is_enum<T>::value)
+                WriteValue('i', (int64_t)value);
+            else
+                WriteValue('u', (uint64_t)value);
+        }
+
+        template<typename T>
+        typename enable_if<is_floating_point<T>::value>::type WriteOne(const T& value)
+        {
+            WriteValue('f', (double)value);
+        }
+
+        void WriteOne(const char* value) { WriteString(value ? value : "(null)", value ? strlen(value) : 6); }
+        void WriteOne(char* value) { WriteOne((const char*)value); }
+        void WriteOne(const string& value) { WriteString(value.c_str(), value.size()); }
+
+        template<typename T>
+        void WriteOne(T* value) { WriteValue('p', (const void*)value); }
+
+        template<typename T>
+        void WriteValue(char tag, const T& value)
+        {
+            if(mCur + 1 + sizeof(T) > mEnd)
+                return;
+            *mCur++ = tag;
+            memcpy(mCur, &value, sizeof(T));
+            mCur += sizeof(T);
+        }
+
+        // Truncated to the space left
+        void WriteString(const char* value, size_t length)
+        {
+            if(mCur + 3 > mEnd)
+                return;
+            length = min<size_t>(length, mEnd - mCur - 3);
+            *mCur++ = 's';
+            uint16_t length16 = length;
+            memcpy(mCur, &length16, 2);
+            memcpy(mCur + 2, value, length);
+            mCur += 2 + length;
+        }
+
+        char* mCur;
+        char* mEnd;
+    };
+
+    bool TryClaim(uint64_t& writeIdx);
+    void Publish(uint64_t writeIdx);
+
+    bool IsRecordReady();
+    void Run();
+    void WriteRecord(const logRecord& record);
+    static string FormatRecord(const logRecord& record);
+
+private:
+    static const uint32_t RING_SIZE = 4096;     // Power of 2
+
+    unique_ptr<logSlot[]> mRing;
+    atomic<uint64_t> mWriteIdx;
+    uint64_t mReadIdx = 0;
+
+    atomic<int> mLevel;
+    atomic<uint64_t> mNumDropped;
+    uint64_t mNumDroppedReported = 0;
+
+    atomic<bool> mStop;
+    atomic<bool> mSleeping;
+
+    // Logger thread wake-up, flush and file swap handshakes
+    mutex mMutex;
+    condition_variable mWake;
+    condition_variable mFlushed;
+    uint64_t mNumFlushed = 0;
+    bool mSwapLogFile = false;
+    FILE* mNextLogFile = nullptr;
+
+    FILE* mLogFile = nullptr;   // Logger thread only
+    thread mThread;
+};
+
+template<typename... Args>
+void AsyncLogger::Log(int level, uint32_t numSuppressed, const char* format, const Args&... args)
+{
+    uint64_t writeIdx;
+    if(!TryClaim(writeIdx))
+    {
+        mNumDropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    logRecord& record = mRing[writeIdx & (RING_SIZE - 1)].record;
+    record.format = format;
+    record.timeUs = NowUs();
+    record.numSuppressed = numSuppressed;
+    record.level = level;
+
+    ArgWriter writer(record.payload);
+    writer.Write(args...);
+    record.payloadSize = writer.GetSize(record.payload);
+
+    Publish(writeIdx);
+}
+
+#define PX2_LOG(level, ...) \
+    do { \
+        if(((level) >= PX2_LOG_COMPILE_LEVEL) && ((level) >= AsyncLogger::Instance().GetLevel())) \
+            AsyncLogger::Instance().Log((level), 0, __VA_ARGS__); \
+    } while(0)
+
+#define PX2_LOG_RATE(level, maxPerSecond, ...) \
+    do { \
+        if(((level) >= PX2_LOG_COMPILE_LEVEL) && ((level) >= AsyncLogger::Instance().GetLevel())) \
+        { \
+            static logRateSite px2LogSite_; \
+            uint32_t px2LogSuppressed_; \
+            if(AsyncLogger::AllowRate(px2LogSite_, (maxPerSecond), px2LogSuppressed_)) \
+                AsyncLogger::Instance().Log((level), px2LogSuppressed_, __VA_ARGS__); \
+        } \
+    } while(0)
+
+#define PX2_LOG_DEBUG(...) PX2_LOG(PX2_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define PX2_LOG_INFO(...)  PX2_LOG(PX2_LOG_LEVEL_INFO, __VA_ARGS__)
+#define PX2_LOG_WARN(...)  PX2_LOG(PX2_LOG_LEVEL_WARN, __VA_ARGS__)
+#define PX2_LOG_ERROR(...) PX2_LOG(PX2_LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#define PX2_LOG_DEBUG_RATE(maxPerSecond, ...) PX2_LOG_RATE(PX2_LOG_LEVEL_DEBUG, maxPerSecond, __VA_ARGS__)
+#define PX2_LOG_INFO_RATE(maxPerSecond, ...)  PX2_LOG_RATE(PX2_LOG_LEVEL_INFO, maxPerSecond, __VA_ARGS__)
+#define PX2_LOG_WARN_RATE(maxPerSecond, ...)  PX2_LOG_RATE(PX2_LOG_LEVEL_WARN, maxPerSecond, __VA_ARGS__)
+#define PX2_LOG_ERROR_RATE(maxPerSecond, ...) PX2_LOG_RATE(PX2_LOG_LEVEL_ERROR, maxPerSecond, __VA_ARGS__)
+
+#endif // PX2LOG_H
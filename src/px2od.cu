@@ -11,6 +11,13 @@ px2OD::~px2OD()
 }
 
 void px2OD::Init()
+{
+    InitObjectPool();
+    InitNetwork();
+    BindOutputs();
+}
+
+void px2OD::InitNetwork()
 {
     CHECK_DW_ERROR(dwDriveNet_initDefaultParams(&mDriveNetParams));
 
@@ -50,6 +57,8 @@ void px2OD::Init()
                                            0.0f, 1.0f, 0.0f,
                                            0.0f, 0.0f, 1.0f}};
 
+    mFullROI = driveNetROI;
+
     CHECK_DW_ERROR(dwObjectDetector_setROI(0, &driveNetROI, &driveNetROITrans, mDriveNetDetector));
 
     CHECK_DW_ERROR(dwObjectDetector_getROI(&mDetectorParams.ROIs[0], &mDetectorParams.transformations[0], 0, mDriveNetDetector));
@@ -61,7 +70,34 @@ void px2OD::Init()
 
     CHECK_DW_ERROR(dwObjectDetector_bindInput(&mODInputImg, 1, mDriveNetDetector));
 
-    for(uint32_t classIdx = 0; classIdx < mNumDriveNetClasses; ++classIdx)
+    // Initialize box list
+    mDnnBoxList.resize(mNumDriveNetClasses);
+    mDnnLabelList.resize(mNumDriveNetClasses);
+    mDnnLabelListPtr.resize(mNumDriveNetClasses);
+    mDnnConfidence.resize(mNumDriveNetClasses);
+    mDnnObjectID.resize(mNumDriveNetClasses);
+
+    // Get which label name for each class id
+    mClassLabels.resize(mNumDriveNetClasses);
+    for(uint32_t classIdx = 0U; classIdx < mNumDriveNetClasses; ++classIdx)
+    {
+        const char* classLabel;
+        CHECK_DW_ERROR(dwDriveNet_getClassLabel(&classLabel, classIdx, mDriveNet));
+        mClassLabels[classIdx] = classLabel;
+
+        // Reserve label and box lists
+        mDnnBoxList[classIdx].reserve(mMaxClustersPerClass);
+        mDnnLabelList[classIdx].reserve(mMaxClustersPerClass);
+        mDnnLabelListPtr[classIdx].reserve(mMaxClustersPerClass);
+        mDnnConfidence[classIdx].reserve(mMaxClustersPerClass);
+        mDnnObjectID[classIdx].reserve(mMaxClustersPerClass);
+    }
+}
+
+// Handles of every DriveNet class, mNumDriveNetClasses is not known yet
+void px2OD::InitObjectPool()
+{
+    for(uint32_t classIdx = 0; classIdx < DW_DRIVENET_NUM_CLASSES; ++classIdx)
     {
         mDetectorOutputObjects[classIdx].reset(new dwObjectHandle_t[MAX_OBJECT_OUTPUT_COUNT]);
         mClustererOutputObjects[classIdx].reset(new dwObjectHandle_t[MAX_OBJECT_OUTPUT_COUNT]);
@@ -74,7 +110,13 @@ void px2OD::Init()
             CHECK_DW_ERROR(dwObject_createCamera(&mDetectorOutputObjects[classIdx][objIdx], &objectData, &objectDataCamera));
             CHECK_DW_ERROR(dwObject_createCamera(&mClustererOutputObjects[classIdx][objIdx], &objectData, &objectDataCamera));
         }
+    }
+}
 
+void px2OD::BindOutputs()
+{
+    for(uint32_t classIdx = 0; classIdx < mNumDriveNetClasses; ++classIdx)
+    {
         mDetectorOutput[classIdx].count = 0;
         mDetectorOutput[classIdx].objects = mDetectorOutputObjects[classIdx].get();
         mDetectorOutput[classIdx].maxCount = MAX_OBJECT_OUTPUT_COUNT;
@@ -86,29 +128,31 @@ void px2OD::Init()
         CHECK_DW_ERROR(dwObjectClustering_bindInput(&mDetectorOutput[classIdx], mObjectClusteringHandles[classIdx]));
         CHECK_DW_ERROR(dwObjectClustering_bindOutput(&mClustererOutput[classIdx], mObjectClusteringHandles[classIdx]));
     }
+}
 
-    // Initialize box list
-    mDnnBoxList.resize(mNumDriveNetClasses);
-    mDnnLabelList.resize(mNumDriveNetClasses);
-    mDnnLabelListPtr.resize(mNumDriveNetClasses);
-    mDnnConfidence.resize(mNumDriveNetClasses);
-    mDnnObjectID.resize(mNumDriveNetClasses);
+void px2OD::SetROIScale(float32_t scale)
+{
+    if(scale == mROIScale)
+        return;
 
-    // Get which label name for each class id
-    mClassLabels.resize(mNumDriveNetClasses);
-    for(uint32_t classIdx = 0U; classIdx < mNumDriveNetClasses; ++classIdx)
-    {
-        const char* classLabel;
-        CHECK_DW_ERROR(dwDriveNet_getClassLabel(&classLabel, classIdx, mDriveNet));
-        mClassLabels[classIdx] = classLabel;
+    mROIScale = scale;
 
-        // Reserve label and box lists
-        mDnnBoxList[classIdx].reserve(mMaxClustersPerClass);
-        mDnnLabelList[classIdx].reserve(mMaxClustersPerClass);
-        mDnnLabelListPtr[classIdx].reserve(mMaxClustersPerClass);
-        mDnnConfidence[classIdx].reserve(mMaxClustersPerClass);
-        mDnnObjectID[classIdx].reserve(mMaxClustersPerClass);
-    }
+    dwRect roi;
+    roi.width = static_cast<int32_t>(mFullROI.width*scale);
+    roi.height = static_cast<int32_t>(mFullROI.height*scale);
+    roi.x = mFullROI.x + (mFullROI.width - roi.width)/2;
+    roi.y = mFullROI.y + (mFullROI.height - roi.height)/2;
+
+    dwTransformation2D roiTrans ={{1.0f, 0.0f, 0.0f,
+                                   0.0f, 1.0f, 0.0f,
+                                   0.0f, 0.0f, 1.0f}};
+
+    CHECK_DW_ERROR(dwObjectDetector_setROI(0, &roi, &roiTrans, mDriveNetDetector));
+
+    mDetectorROI.x = roi.x;
+    mDetectorROI.y = roi.y;
+    mDetectorROI.width = roi.width;
+    mDetectorROI.height = roi.height;
 }
 
 void px2OD::DetectObjects(dwImageCUDA* dwODInputImg,
@@ -118,10 +162,23 @@ void px2OD::DetectObjects(dwImageCUDA* dwODInputImg,
                    vector<vector<float32_t> >& outputODConfidencePerClass,
                    vector<vector<int> >& outputODIDPerClass)
 {
+    LatencyMonitor* latencyMonitor = mPx2Cam->GetLatencyMonitor();
+
     mODInputImg = dwODInputImg;
-    CHECK_DW_ERROR(dwObjectDetector_processDeviceAsync(mDriveNetDetector));
+    {
+        static const latencySectionId driveNetDeviceSection = LatencyMonitor::RegisterSection("driveNetDevice");
+        LatencyScope deviceScope(latencyMonitor, driveNetDeviceSection, mCudaStream);
+        CHECK_DW_ERROR(dwObjectDetector_processDeviceAsync(mDriveNetDetector));
+    }
+
+    {
+        static const latencySectionId driveNetHostSection = LatencyMonitor::RegisterSection("driveNetHost");
+        LatencyScope hostScope(latencyMonitor, driveNetHostSection, mCudaStream);
+        CHECK_DW_ERROR(dwObjectDetector_processHost(mDriveNetDetector));
+    }
 
-    CHECK_DW_ERROR(dwObjectDetector_processHost(mDriveNetDetector));
+    static const latencySectionId clusteringSection = LatencyMonitor::RegisterSection("clustering");
+    LatencyScope clusteringScope(latencyMonitor, clusteringSection);
 
     for (uint32_t classIdx = 0U; classIdx < mClassLabels.size(); ++classIdx)
     {
@@ -150,7 +207,8 @@ void px2OD::DetectObjects(dwImageCUDA* dwODInputImg,
 
             string boxAnnot = mClassLabels[classIdx];
             mDnnLabelList[classIdx].push_back(boxAnnot);
-            mDnnLabelListPtr[classIdx].push_back(mDnnLabelList[classIdx].back().c_str());
+            // Class label strings live as long as px2OD, so the output stays valid after the next DetectObjects()
+            mDnnLabelListPtr[classIdx].push_back(mClassLabels[classIdx].c_str());
         }
     }
 
@@ -13,6 +13,12 @@ public:
 
     void Init();
 
+    // Init() in parts, for the init graph. The object pool does not use the Driveworks context (any thread),
+    // BindOutputs() needs both others.
+    void InitNetwork();
+    void InitObjectPool();
+    void BindOutputs();
+
     void DetectObjects(dwImageCUDA* dwODInputImg,
                        vector<vector<dwRectf> >& outputODRectPerClass,
                        vector<const float32_t*>& outputODRectColorPerClass,
@@ -20,6 +26,9 @@ public:
                        vector<vector<float32_t> >& outputODConfidencePerClass,
                        vector<vector<int> >& outputODIDPerClass);
 
+    // Scales the detector ROI around its center (1 = full ROI of Init), used for load shedding.
+    // DriveNet input size is fixed, so a smaller ROI trades far / lateral coverage for resolution, not for time by itself.
+    void SetROIScale(float32_t scale);
 
 private:
     px2Cam *mPx2Cam;
@@ -36,6 +45,8 @@ private:
     dwObjectDetectorParams mDetectorParams{};
     dwObjectDetectorHandle_t mDriveNetDetector = DW_NULL_HANDLE;
     dwRectf mDetectorROI;
+    dwRect mFullROI;
+    float32_t mROIScale = 1.f;
 
     // Clustering
     dwObjectClusteringHandle_t* mObjectClusteringHandles = nullptr;
@@ -0,0 +1,112 @@
+#include "px2overlay.h"
+
+#include <cstring>
+
+OverlayBatch::OverlayBatch()
+{
+    Reserve(16, 256);
+}
+
+void OverlayBatch::Reserve(uint32_t numBatches, uint32_t numVerticesPerBatch)
+{
+    mNumVerticesPerBatch = numVerticesPerBatch;
+    mBatches.reserve(numBatches);
+    for(overlayBatch& batch : mBatches)
+    {
+        batch.boxes.reserve(numVerticesPerBatch);
+        batch.vertices.reserve(numVerticesPerBatch);
+    }
+    mTexts.reserve(numBatches);
+    mTextPool.reserve(numBatches*32);
+}
+
+void OverlayBatch::Clear()
+{
+    for(overlayBatch& batch : mBatches)
+    {
+        batch.boxes.clear();
+        batch.labelOffsets.clear();
+        batch.vertices.clear();
+    }
+    mTexts.clear();
+    mTextPool.clear();
+    mNumPrimitives = 0;
+}
+
+bool OverlayBatch::Empty() const
+{
+    return mNumPrimitives == 0;
+}
+
+// Few styles per frame : a linear search, starting from the last batch used
+overlayBatch& OverlayBatch::GetBatch(overlayPrimitive primitive, const dwVector4f& color, float32_t size)
+{
+    auto matches = [&](const overlayBatch& batch)
+    {
+        return (batch.primitive == primitive) && (batch.size == size) &&
+               (batch.color.x == color.x) && (batch.color.y == color.y) &&
+               (batch.color.z == color.z) && (batch.color.w == color.w);
+    };
+
+    if((mLastBatchIdx < mBatches.size()) && matches(mBatches[mLastBatchIdx]))
+        return mBatches[mLastBatchIdx];
+
+    for(uint32_t batchIdx = 0; batchIdx < mBatches.size(); batchIdx++)
+    {
+        if(matches(mBatches[batchIdx]))
+        {
+            mLastBatchIdx = batchIdx;
+            return mBatches[batchIdx];
+        }
+    }
+
+    overlayBatch batch;
+    batch.primitive = primitive;
+    batch.color = color;
+    batch.size = size;
+    mBatches.push_back(batch);
+    mBatches.back().boxes.reserve(mNumVerticesPerBatch);
+    mBatches.back().vertices.reserve(mNumVerticesPerBatch);
+
+    mLastBatchIdx = mBatches.size() - 1;
+    return mBatches.back();
+}
+
+uint32_t OverlayBatch::AddToPool(const char* text)
+{
+    uint32_t offset = mTextPool.size();
+    mTextPool.insert(mTextPool.end(), text, text + strlen(text) + 1);
+    return offset;
+}
+
+void OverlayBatch::AddBox(const dwRectf& box, const dwVector4f& color, float32_t lineWidth, const char* label)
+{
+    const char* labels[1] = {label};
+    AddBoxes(&box, label ? labels : nullptr, 1, color, lineWidth);
+}
+
+void OverlayBatch::AddBoxes(const dwRectf* boxes, const char* const* labels, uint32_t numBoxes, const dwVector4f& color,
+                            float32_t lineWidth)
+{
+    if(numBoxes == 0)
+        return;
+
+    overlayBatch& batch = GetBatch(labels ? OVERLAY_LABELED_BOXES : OVERLAY_BOXES, color, lineWidth);
+    batch.boxes.insert(batch.boxes.end(), boxes, boxes + numBoxes);
+    if(labels)
+    {
+        for(uint32_t boxIdx = 0; boxIdx < numBoxes; boxIdx++)
+            batch.labelOffsets.push_back(AddToPool(labels[boxIdx] ? labels[boxIdx] : ""));
+    }
+    mNumPrimitives += numBoxes;
+}
+
+void OverlayBatch::AddText(const char* text, const dwVector2f& position, const dwVector4f& color)
+{
+    overlayText entry;
+    entry.color = color;
+    entry.position = position;
+    entry.textOffset = AddToPool(text);
+    mTexts.push_back(entry);
+    mNumPrimitives++;
+}
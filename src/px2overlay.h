@@ -0,0 +1,113 @@
+#ifndef PX2OVERLAY_H
+#define PX2OVERLAY_H
+
+#include <dw/core/Types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Overlay command buffer : the primitives of a frame are appended to vertex batches, one per
+ * (primitive type, color, line width / point size), and px2Cam::FlushOverlay() renders each batch with
+ * a single render engine call. The draw cost depends on the number of distinct styles, not on the number of objects.
+ * Poly lines go to LINES batches as segments (2 vertices each), so all lanes of a color are one call.
+ * Batches keep their memory from frame to frame, Reserve() preallocates it.
+ */
+
+typedef enum {
+    OVERLAY_BOXES = 0,
+    OVERLAY_LABELED_BOXES = 1,
+    OVERLAY_LINES = 2,
+    OVERLAY_POINTS = 3
+}overlayPrimitive;
+
+typedef struct {
+    overlayPrimitive primitive;
+    dwVector4f color;
+    float32_t size;                 // Line width, point size
+    vector<dwRectf> boxes;          // OVERLAY_BOXES, OVERLAY_LABELED_BOXES
+    vector<uint32_t> labelOffsets;  // OVERLAY_LABELED_BOXES, in the text pool
+    vector<dwVector2f> vertices;    // OVERLAY_LINES (segment pairs), OVERLAY_POINTS
+}overlayBatch;
+
+typedef struct {
+    dwVector4f color;
+    dwVector2f position;
+    uint32_t textOffset;            // In the text pool
+}overlayText;
+
+class OverlayBatch{
+public:
+    OverlayBatch();
+
+    void Reserve(uint32_t numBatches, uint32_t numVerticesPerBatch);
+
+    // Empties the batches, keeps their memory (and their order) for the next frame
+    void Clear();
+
+    bool Empty() const;
+
+    // label : copied, null for an unlabeled box
+    void AddBox(const dwRectf& box, const dwVector4f& color, float32_t lineWidth, const char* label = nullptr);
+    void AddBoxes(const dwRectf* boxes, const char* const* labels, uint32_t numBoxes, const dwVector4f& color, float32_t lineWidth);
+
+    // PointT : anything with x, y (dwVector2f, cv::Point)
+    template<typename PointT>
+    void AddPolyLine(const PointT* pts, uint32_t numPts, const dwVector4f& color, float32_t lineWidth);
+
+    template<typename PointT>
+    void AddPoints(const PointT* pts, uint32_t numPts, const dwVector4f& color, float32_t pointSize);
+
+    void AddText(const char* text, const dwVector2f& position, const dwVector4f& color);
+
+    const vector<overlayBatch>& GetBatches() const { return mBatches; }
+    const vector<overlayText>& GetTexts() const { return mTexts; }
+    const char* GetText(uint32_t textOffset) const { return &mTextPool[textOffset]; }
+
+    // Boxes, poly lines, point sets and texts added since Clear()
+    uint32_t GetNumPrimitives() const { return mNumPrimitives; }
+
+private:
+    overlayBatch& GetBatch(overlayPrimitive primitive, const dwVector4f& color, float32_t size);
+    uint32_t AddToPool(const char* text);
+
+private:
+    vector<overlayBatch> mBatches;
+    uint32_t mLastBatchIdx = 0;
+    uint32_t mNumVerticesPerBatch = 0;  // Reserved for new batches
+    vector<overlayText> mTexts;
+    vector<char> mTextPool;
+    uint32_t mNumPrimitives = 0;
+};
+
+template<typename PointT>
+void OverlayBatch::AddPolyLine(const PointT* pts, uint32_t numPts, const dwVector4f& color, float32_t lineWidth)
+{
+    if(numPts < 2)
+        return;
+
+    vector<dwVector2f>& vertices = GetBatch(OVERLAY_LINES, color, lineWidth).vertices;
+    for(uint32_t ptIdx = 0; ptIdx + 1 < numPts; ptIdx++)
+    {
+        vertices.push_back({static_cast<float32_t>(pts[ptIdx].x), static_cast<float32_t>(pts[ptIdx].y)});
+        vertices.push_back({static_cast<float32_t>(pts[ptIdx + 1].x), static_cast<float32_t>(pts[ptIdx + 1].y)});
+    }
+    mNumPrimitives++;
+}
+
+template<typename PointT>
+void OverlayBatch::AddPoints(const PointT* pts, uint32_t numPts, const dwVector4f& color, float32_t pointSize)
+{
+    if(numPts == 0)
+        return;
+
+    vector<dwVector2f>& vertices = GetBatch(OVERLAY_POINTS, color, pointSize).vertices;
+    for(uint32_t ptIdx = 0; ptIdx < numPts; ptIdx++)
+        vertices.push_back({static_cast<float32_t>(pts[ptIdx].x), static_cast<float32_t>(pts[ptIdx].y)});
+    mNumPrimitives++;
+}
+
+#endif // PX2OVERLAY_H
@@ -0,0 +1,270 @@
+#include "px2pipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+static inline uint64_t NowUs()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+px2Pipeline::px2Pipeline(uint32_t numSlots, uint32_t queueCapacity)
+    : mNumSlots(numSlots), mQueueCapacity(queueCapacity), mFreeSlots(numSlots)
+{
+    mRunning = false;
+    mStopRequested = false;
+}
+
+px2Pipeline::~px2Pipeline()
+{
+    Stop();
+}
+
+bool px2Pipeline::AddStage(string name, pipelineStageFunc func, bool onMainThread)
+{
+    if(mRunning)
+    {
+        cout << "[PIPELINE] Cannot add stage " << name << " while running" << endl;
+        return false;
+    }
+
+    if(!mStages.empty() && mStages.back()->onMainThread)
+    {
+        cout << "[PIPELINE] Only the last stage can run on the main thread : " << name << endl;
+        return false;
+    }
+
+    unique_ptr<stageNode> stage(new stageNode);
+    stage->name = name;
+    stage->func = func;
+    stage->onMainThread = onMainThread;
+    stage->numFrames = 0;
+    stage->numDropped = 0;
+    stage->busyUs = 0;
+    stage->waitUs = 0;
+
+    if(!mStages.empty())
+        mQueues.push_back(unique_ptr<BoundedQueue<frameToken> >(new BoundedQueue<frameToken>(mQueueCapacity)));
+
+    mStages.push_back(move(stage));
+
+    return true;
+}
+
+void px2Pipeline::SetStageObserver(pipelineStageObserver observer)
+{
+    mObserver = observer;
+}
+
+bool px2Pipeline::Start()
+{
+    if(mStages.empty() || mStages[0]->onMainThread)
+    {
+        cout << "[PIPELINE] The source stage must run on its own thread" << endl;
+        return false;
+    }
+
+    for(uint32_t slotIdx = 0; slotIdx < mNumSlots; slotIdx++)
+        mFreeSlots.Push(slotIdx);
+
+    mStopRequested = false;
+    mRunning = true;
+
+    mThreads.push_back(thread(&px2Pipeline::RunSource, this));
+
+    for(uint32_t stageIdx = 1; stageIdx < mStages.size(); stageIdx++)
+    {
+        if(!mStages[stageIdx]->onMainThread)
+            mThreads.push_back(thread(&px2Pipeline::RunStage, this, stageIdx));
+    }
+
+    cout << "[PIPELINE] Started " << mStages.size() << " stages, " << mNumSlots << " frame slots" << endl;
+
+    return true;
+}
+
+bool px2Pipeline::RunMainThreadStage()
+{
+    if(!mRunning)
+        return false;
+
+    uint32_t stageIdx = mStages.size() - 1;
+    if(!mStages[stageIdx]->onMainThread)
+        return true;
+
+    frameToken token;
+    uint64_t waitBegin = NowUs();
+    if(!mQueues[stageIdx - 1]->Pop(token))
+        return false;
+    mStages[stageIdx]->waitUs += NowUs() - waitBegin;
+
+    ProcessFrame(stageIdx, token);
+
+    return mRunning;
+}
+
+void px2Pipeline::RequestStop()
+{
+    mStopRequested = true;
+}
+
+void px2Pipeline::Stop()
+{
+    if(!mRunning && mThreads.empty())
+        return;
+
+    mRunning = false;
+    CloseQueues();
+
+    for(uint32_t threadIdx = 0; threadIdx < mThreads.size(); threadIdx++)
+    {
+        if(mThreads[threadIdx].joinable())
+            mThreads[threadIdx].join();
+    }
+    mThreads.clear();
+
+    PrintStats();
+}
+
+vector<pipelineStageStats> px2Pipeline::GetStats()
+{
+    vector<pipelineStageStats> statsList;
+
+    for(uint32_t stageIdx = 0; stageIdx < mStages.size(); stageIdx++)
+    {
+        pipelineStageStats stats;
+        stats.name = mStages[stageIdx]->name;
+        stats.numFrames = mStages[stageIdx]->numFrames;
+        stats.numDropped = mStages[stageIdx]->numDropped;
+        stats.busyMs = mStages[stageIdx]->busyUs/1000.0;
+        stats.waitMs = mStages[stageIdx]->waitUs/1000.0;
+        statsList.push_back(stats);
+    }
+
+    return statsList;
+}
+
+void px2Pipeline::PrintStats()
+{
+    vector<pipelineStageStats> statsList = GetStats();
+
+    for(uint32_t stageIdx = 0; stageIdx < statsList.size(); stageIdx++)
+    {
+        const pipelineStageStats& stats = statsList[stageIdx];
+        double avgMs = (stats.numFrames > 0) ? stats.busyMs/stats.numFrames : 0.0;
+
+        printf("[PIPELINE] %-16s frames %8llu  dropped %6llu  avg %7.2fms  wait %10.1fms\n",
+               stats.name.c_str(), (unsigned long long)stats.numFrames, (unsigned long long)stats.numDropped,
+               avgMs, stats.waitMs);
+    }
+}
+
+void px2Pipeline::CloseQueues()
+{
+    mFreeSlots.Close();
+    for(uint32_t queueIdx = 0; queueIdx < mQueues.size(); queueIdx++)
+        mQueues[queueIdx]->Close();
+}
+
+void px2Pipeline::RunSource()
+{
+    while(mRunning && !mStopRequested)
+    {
+        frameToken token;
+
+        // No free slot : every frame is in flight, so the source waits for the slowest stage
+        uint64_t waitBegin = NowUs();
+        if(!mFreeSlots.Pop(token.slotIdx))
+            break;
+        mStages[0]->waitUs += NowUs() - waitBegin;
+
+        if(mStopRequested)
+        {
+            ReleaseSlot(token.slotIdx);
+            break;
+        }
+
+        token.seq = mNextSeq++;
+        token.timestamp_us = 0;
+
+        if(!ProcessFrame(0, token))
+            continue;
+
+        if(mStages.size() == 1)
+            continue;
+
+        waitBegin = NowUs();
+        if(!mQueues[0]->Push(token))
+            break;
+        mStages[0]->waitUs += NowUs() - waitBegin;
+    }
+
+    if(!mRunning)
+        return;
+
+    // Stop requested : every slot back means the frames in flight went through the last stage (or were dropped)
+    while(mRunning && (mFreeSlots.Size() < mNumSlots))
+        this_thread::sleep_for(chrono::milliseconds(1));
+
+    cout << "[PIPELINE] Stop requested, " << mNextSeq << " frames from the source" << endl;
+
+    mRunning = false;
+    CloseQueues();
+}
+
+void px2Pipeline::RunStage(uint32_t stageIdx)
+{
+    bool isLast = (stageIdx + 1 == mStages.size());
+
+    while(mRunning)
+    {
+        frameToken token;
+
+        uint64_t waitBegin = NowUs();
+        if(!mQueues[stageIdx - 1]->Pop(token))
+            break;
+        mStages[stageIdx]->waitUs += NowUs() - waitBegin;
+
+        if(!ProcessFrame(stageIdx, token) || isLast)
+            continue;
+
+        waitBegin = NowUs();
+        if(!mQueues[stageIdx]->Push(token))
+            break;
+        mStages[stageIdx]->waitUs += NowUs() - waitBegin;
+    }
+}
+
+// Runs one stage on one frame, releases the slot if the frame is dropped or done
+bool px2Pipeline::ProcessFrame(uint32_t stageIdx, frameToken& token)
+{
+    stageNode& stage = *mStages[stageIdx];
+
+    uint64_t begin = NowUs();
+    bool keep = stage.func(token);
+    uint64_t elapsed = NowUs() - begin;
+
+    stage.busyUs += elapsed;
+    stage.numFrames++;
+
+    if(!keep)
+        stage.numDropped++;
+
+    if(mObserver)
+        mObserver(stageIdx, token, elapsed/1000.0);
+
+    if(!keep || (stageIdx + 1 == mStages.size()))
+    {
+        ReleaseSlot(token.slotIdx);
+        return false;
+    }
+
+    return true;
+}
+
+void px2Pipeline::ReleaseSlot(uint32_t slotIdx)
+{
+    // Cannot block : there are never more slot indices than the queue capacity
+    mFreeSlots.Push(slotIdx);
+}
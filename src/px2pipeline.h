@@ -0,0 +1,227 @@
+#ifndef PX2PIPELINE_H
+#define PX2PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Small stage-graph runtime : stages are a chain of nodes with bounded queues in between,
+ * every stage runs on its own thread (the last one may run on the main thread, e.g. GL display),
+ * so consecutive frames overlap and the throughput is bounded by the slowest stage instead of the sum.
+ *
+ * Frames are identified by a frameToken (sequence number, capture timestamp, slot index).
+ * Slots are owned by the application (per-frame buffers and results), the pipeline only hands out free slot indices :
+ * a slot is taken by the first (source) stage and released after the last stage or when a stage drops the frame,
+ * so the number of slots bounds the number of frames in flight.
+ */
+
+typedef struct {
+    uint64_t seq = 0;               // Set by the pipeline, increases by one per source run
+    uint64_t timestamp_us = 0;      // Set by the source stage (camera timestamp)
+    uint32_t slotIdx = 0;
+}frameToken;
+
+// Returns false to drop the frame (it is not passed to the next stages)
+typedef function<bool(frameToken&)> pipelineStageFunc;
+
+// Called after every stage run, from the thread of the stage
+typedef function<void(uint32_t stageIdx, const frameToken& token, double costMs)> pipelineStageObserver;
+
+typedef struct {
+    string name;
+    uint64_t numFrames = 0;
+    uint64_t numDropped = 0;
+    double busyMs = 0.0;            // Time spent in the stage function
+    double waitMs = 0.0;            // Time spent waiting for input / output queue space
+}pipelineStageStats;
+
+template<typename T>
+class BoundedQueue{
+public:
+    BoundedQueue(size_t capacity) : mCapacity(capacity) {}
+
+    // Blocks while full, false if the queue was closed
+    bool Push(const T& item)
+    {
+        unique_lock<mutex> lock(mMutex);
+        mNotFull.wait(lock, [this]{ return mClosed || (mItems.size() < mCapacity); });
+        if(mClosed)
+            return false;
+
+        mItems.push_back(item);
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while empty, false if the queue was closed
+    bool Pop(T& item)
+    {
+        unique_lock<mutex> lock(mMutex);
+        mNotEmpty.wait(lock, [this]{ return mClosed || !mItems.empty(); });
+        if(mClosed)
+            return false;
+
+        item = mItems.front();
+        mItems.pop_front();
+        mNotFull.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        lock_guard<mutex> lock(mMutex);
+        mClosed = true;
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+    size_t Size()
+    {
+        lock_guard<mutex> lock(mMutex);
+        return mItems.size();
+    }
+
+private:
+    size_t mCapacity;
+    bool mClosed = false;
+    deque<T> mItems;
+    mutex mMutex;
+    condition_variable mNotEmpty;
+    condition_variable mNotFull;
+};
+
+/**
+ * Per-frame results that a stage may hand to several frames : a skipped stage shares the last result
+ * with its frame instead of copying it. Entries are reference counted, one producer stage acquires and publishes,
+ * any stage releases. With one entry per slot + one, Acquire() never waits.
+ */
+template<typename T>
+class SharedResultPool{
+public:
+    SharedResultPool(size_t capacity) : mEntries(capacity), mRefs(capacity)
+    {
+        for(size_t idx = 0; idx < capacity; idx++)
+            mRefs[idx].store(0);
+
+        // Entry 0 is the (empty) last result until the first Publish()
+        mRefs[0].store(1);
+    }
+
+    // Producer : free entry, one reference held by the caller
+    uint32_t Acquire()
+    {
+        while(true)
+        {
+            // Only the producer takes an entry out of 0 references
+            for(uint32_t idx = 0; idx < mRefs.size(); idx++)
+            {
+                if(mRefs[idx].load() == 0)
+                {
+                    mRefs[idx].store(1);
+                    return idx;
+                }
+            }
+            this_thread::yield();
+        }
+    }
+
+    // Producer : the acquired entry becomes the last result
+    void Publish(uint32_t idx)
+    {
+        mRefs[idx].fetch_add(1);
+        uint32_t prevLastIdx = mLastIdx;
+        mLastIdx = idx;
+        Release(prevLastIdx);
+    }
+
+    // Producer : one more reference on the last result
+    uint32_t ShareLast()
+    {
+        mRefs[mLastIdx].fetch_add(1);
+        return mLastIdx;
+    }
+
+    // Any thread, after the last read of the entry
+    void Release(uint32_t idx) { mRefs[idx].fetch_sub(1); }
+
+    T& Get(uint32_t idx) { return mEntries[idx]; }
+
+private:
+    vector<T> mEntries;
+    vector<atomic<int> > mRefs;
+    uint32_t mLastIdx = 0;
+};
+
+class px2Pipeline{
+public:
+    // queueCapacity : frames waiting between two stages
+    px2Pipeline(uint32_t numSlots, uint32_t queueCapacity = 1);
+    ~px2Pipeline();
+
+    // Stages run in declaration order, the first one is the source.
+    // Only the last stage can run on the main thread (see RunMainThreadStage).
+    bool AddStage(string name, pipelineStageFunc func, bool onMainThread = false);
+
+    void SetStageObserver(pipelineStageObserver observer);
+
+    bool Start();
+
+    // Runs the main thread stage for one frame, false once the pipeline is stopped
+    bool RunMainThreadStage();
+
+    // Any thread (end of stream from the source stage, SIGINT) : the source takes no new frame,
+    // the frames in flight go through the remaining stages, then the queues close and RunMainThreadStage() returns false
+    void RequestStop();
+
+    // Joins the stage threads
+    void Stop();
+
+    uint32_t GetNumSlots() const { return mNumSlots; }
+    vector<pipelineStageStats> GetStats();
+    void PrintStats();
+
+private:
+    typedef struct {
+        string name;
+        pipelineStageFunc func;
+        bool onMainThread = false;
+
+        atomic<uint64_t> numFrames;
+        atomic<uint64_t> numDropped;
+        atomic<uint64_t> busyUs;
+        atomic<uint64_t> waitUs;
+    }stageNode;
+
+    void RunSource();
+    void CloseQueues();
+    void RunStage(uint32_t stageIdx);
+    bool ProcessFrame(uint32_t stageIdx, frameToken& token);
+    void ReleaseSlot(uint32_t slotIdx);
+
+private:
+    uint32_t mNumSlots;
+    uint32_t mQueueCapacity;
+
+    vector<unique_ptr<stageNode> > mStages;
+    pipelineStageObserver mObserver;
+    // mQueues[i] is the input of stage i + 1
+    vector<unique_ptr<BoundedQueue<frameToken> > > mQueues;
+    BoundedQueue<uint32_t> mFreeSlots;
+
+    vector<thread> mThreads;
+    atomic<bool> mRunning;
+    atomic<bool> mStopRequested;
+    uint64_t mNextSeq = 0;
+};
+
+#endif // PX2PIPELINE_H
@@ -0,0 +1,623 @@
+#include "px2pngencoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static const uint32_t ADLER_BASE = 65521;
+
+// 0 : stored blocks ; 1-3 : small window, no lazy matching ; 4-6 : lodepng default ; 7-9 : full window
+void SetDeflateCompressionLevel(LodePNGCompressSettings& zlib, int level)
+{
+    level = min(max(level, 0), 9);
+
+    if(level == 0)
+    {
+        zlib.btype = 0;
+        zlib.use_lz77 = 0;
+        return;
+    }
+
+    static const unsigned windowSizes[10] = {0, 256, 512, 1024, 2048, 2048, 2048, 8192, 16384, 32768};
+    zlib.btype = 2;
+    zlib.use_lz77 = 1;
+    zlib.windowsize = windowSizes[level];
+    zlib.minmatch = 3;
+    zlib.nicematch = (level <= 3) ? 32 : ((level <= 6) ? 128 : 258);
+    zlib.lazymatching = (level >= 5) ? 1 : 0;
+}
+
+// Levels 0-1 : no filter, otherwise min-sum filter selection
+void SetPngCompressionLevel(LodePNGState& state, int level)
+{
+    state.encoder.filter_strategy = (level <= 1) ? LFS_ZERO : LFS_MINSUM;
+    SetDeflateCompressionLevel(state.encoder.zlibsettings, level);
+}
+
+static uint32_t Adler32(const uint8_t* data, size_t size)
+{
+    uint32_t s1 = 1, s2 = 0;
+    while(size > 0)
+    {
+        // 5552 : largest block without s2 overflow
+        size_t blockSize = min<size_t>(size, 5552);
+        size -= blockSize;
+        for(size_t i = 0; i < blockSize; i++)
+        {
+            s1 += data[i];
+            s2 += s1;
+        }
+        data += blockSize;
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+    }
+    return (s2 << 16) | s1;
+}
+
+// adler32 of A + B from adler32(A), adler32(B) and the size of B
+static uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    uint32_t rem = size2 % ADLER_BASE;
+    uint32_t s1 = adler1 & 0xffff;
+    uint32_t s2 = (uint32_t)(((uint64_t)rem*s1) % ADLER_BASE);
+    s1 += (adler2 & 0xffff) + ADLER_BASE - 1;
+    s2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+    if(s1 >= ADLER_BASE) s1 -= ADLER_BASE;
+    if(s1 >= ADLER_BASE) s1 -= ADLER_BASE;
+    if(s2 >= (ADLER_BASE << 1)) s2 -= (ADLER_BASE << 1);
+    if(s2 >= ADLER_BASE) s2 -= ADLER_BASE;
+    return (s2 << 16) | s1;
+}
+
+// Chunk crc32, slicing by 8 : ~8x lodepng_crc32 (one table lookup per byte) on stored / RLE bands
+static uint32_t Crc32(const uint8_t* data, size_t size)
+{
+    typedef struct {
+        uint32_t t[8][256];
+    }crcTables;
+
+    static const crcTables tables = []{
+        crcTables tb;
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+            tb.t[0][i] = c;
+        }
+        for(uint32_t i = 0; i < 256; i++)
+            for(int slice = 1; slice < 8; slice++)
+                tb.t[slice][i] = (tb.t[slice - 1][i] >> 8) ^ tb.t[0][tb.t[slice - 1][i] & 0xff];
+        return tb;
+    }();
+    const uint32_t (*t)[256] = tables.t;
+
+    uint32_t crc = 0xffffffffu;
+    for(; size >= 8; size -= 8, data += 8)
+    {
+        uint32_t low = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+        uint32_t high = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+              t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    }
+    for(; size > 0; size--, data++)
+        crc = t[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+
+    return crc ^ 0xffffffffu;
+}
+
+static void Put32(uint8_t* dst, uint32_t value)
+{
+    dst[0] = value >> 24;
+    dst[1] = value >> 16;
+    dst[2] = value >> 8;
+    dst[3] = value;
+}
+
+static void AppendChunk(vector<uint8_t>& png, const char* type, const uint8_t* data, uint32_t size)
+{
+    size_t start = png.size();
+    png.resize(start + 12 + size);
+    Put32(&png[start], size);
+    memcpy(&png[start + 4], type, 4);
+    if(size > 0)
+        memcpy(&png[start + 8], data, size);
+    Put32(&png[start + 8 + size], Crc32(&png[start + 4], 4 + size));
+}
+
+static inline uint8_t Paeth(int a, int b, int c)
+{
+    int pa = abs(b - c);
+    int pb = abs(a - c);
+    int pc = abs(a + b - 2*c);
+    if((pa <= pb) && (pa <= pc))
+        return a;
+    return (pb <= pc) ? b : c;
+}
+
+// PNG filter types 0-4, prev : nullptr on the first image row
+static void FilterRow(uint8_t* out, const uint8_t* row, const uint8_t* prev, size_t rowBytes, size_t bpp, int filterType)
+{
+    size_t i;
+    switch(filterType)
+    {
+    case 1:
+        memcpy(out, row, bpp);
+        for(i = bpp; i < rowBytes; i++)
+            out[i] = row[i] - row[i - bpp];
+        break;
+    case 2:
+        if(!prev)
+        {
+            memcpy(out, row, rowBytes);
+            break;
+        }
+        for(i = 0; i < rowBytes; i++)
+            out[i] = row[i] - prev[i];
+        break;
+    case 3:
+        if(!prev)
+        {
+            memcpy(out, row, bpp);
+            for(i = bpp; i < rowBytes; i++)
+                out[i] = row[i] - (row[i - bpp] >> 1);
+            break;
+        }
+        for(i = 0; i < bpp; i++)
+            out[i] = row[i] - (prev[i] >> 1);
+        for(i = bpp; i < rowBytes; i++)
+            out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+        break;
+    case 4:
+        if(!prev)
+        {
+            FilterRow(out, row, prev, rowBytes, bpp, 1);
+            break;
+        }
+        for(i = 0; i < bpp; i++)
+            out[i] = row[i] - prev[i];
+        for(i = bpp; i < rowBytes; i++)
+            out[i] = row[i] - Paeth(row[i - bpp], prev[i], prev[i - bpp]);
+        break;
+    default:
+        memcpy(out, row, rowBytes);
+        break;
+    }
+}
+
+// lodepng LFS_MINSUM : the filter with the smallest sum of absolute (signed) residuals
+static int FilterRowMinSum(uint8_t* out, uint8_t* candidates, const uint8_t* row, const uint8_t* prev, size_t rowBytes, size_t bpp)
+{
+    int bestType = 0;
+    size_t bestSum = 0;
+    for(int filterType = 0; filterType < 5; filterType++)
+    {
+        uint8_t* candidate = candidates + filterType*rowBytes;
+        FilterRow(candidate, row, prev, rowBytes, bpp, filterType);
+
+        size_t sum = 0;
+        if(filterType == 0)
+        {
+            for(size_t i = 0; i < rowBytes; i++)
+                sum += candidate[i];
+        }
+        else
+        {
+            for(size_t i = 0; i < rowBytes; i++)
+                sum += abs((int)(int8_t)candidate[i]);
+        }
+
+        if((filterType == 0) || (sum < bestSum))
+        {
+            bestType = filterType;
+            bestSum = sum;
+        }
+    }
+
+    memcpy(out, candidates + bestType*rowBytes, rowBytes);
+    return bestType;
+}
+
+// LSB first bit writer into a presized buffer
+typedef struct {
+    uint8_t* dst;
+    uint64_t bits;
+    uint32_t numBits;
+}bitWriter;
+
+static inline void PutBits(bitWriter& writer, uint32_t value, uint32_t numBits)
+{
+    writer.bits |= (uint64_t)value << writer.numBits;
+    writer.numBits += numBits;
+    while(writer.numBits >= 8)
+    {
+        *writer.dst++ = (uint8_t)writer.bits;
+        writer.bits >>= 8;
+        writer.numBits -= 8;
+    }
+}
+
+static inline void AlignBits(bitWriter& writer)
+{
+    if(writer.numBits > 0)
+        PutBits(writer, 0, 8 - writer.numBits);
+}
+
+static uint32_t ReverseBits(uint32_t code, uint32_t numBits)
+{
+    uint32_t reversed = 0;
+    for(uint32_t i = 0; i < numBits; i++)
+        reversed |= ((code >> i) & 1) << (numBits - 1 - i);
+    return reversed;
+}
+
+// Fixed Huffman codes (RFC 1951 3.2.6), bit reversed for the LSB first writer
+typedef struct {
+    uint32_t literalCodes[256];
+    uint8_t literalBits[256];
+    uint32_t matchCodes[259];       // Length code + extra bits + distance 1 (code 0, 5 bits), per length 3-258
+    uint8_t matchBits[259];
+}fixedHuffmanTables;
+
+static const fixedHuffmanTables& GetFixedHuffmanTables()
+{
+    static const fixedHuffmanTables tables = []{
+        fixedHuffmanTables t;
+        for(uint32_t symbol = 0; symbol < 256; symbol++)
+        {
+            uint32_t numBits = (symbol < 144) ? 8 : 9;
+            uint32_t code = (symbol < 144) ? (0x30 + symbol) : (0x190 + symbol - 144);
+            t.literalCodes[symbol] = ReverseBits(code, numBits);
+            t.literalBits[symbol] = numBits;
+        }
+
+        static const uint32_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint32_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        for(uint32_t length = 3; length <= 258; length++)
+        {
+            uint32_t lengthIdx = 0;
+            while((lengthIdx < 28) && (lengthBase[lengthIdx + 1] <= length))
+                lengthIdx++;
+
+            uint32_t symbol = 257 + lengthIdx;
+            uint32_t numBits = (symbol < 280) ? 7 : 8;
+            uint32_t code = (symbol < 280) ? (symbol - 256) : (0xc0 + symbol - 280);
+            t.matchCodes[length] = ReverseBits(code, numBits) | ((length - lengthBase[lengthIdx]) << numBits);
+            t.matchBits[length] = numBits + lengthExtra[lengthIdx] + 5;
+        }
+        return t;
+    }();
+    return tables;
+}
+
+// Sync flush after a non-final block : empty stored block, byte aligned
+static void PutSyncFlush(bitWriter& writer)
+{
+    PutBits(writer, 0, 3);
+    AlignBits(writer);
+    PutBits(writer, 0x0000, 16);
+    PutBits(writer, 0xffff, 16);
+}
+
+static void DeflateStored(vector<uint8_t>& out, const uint8_t* data, size_t size, bool final)
+{
+    size_t numBlocks = max<size_t>((size + 65534)/65535, 1);
+    size_t start = out.size();
+    out.resize(start + size + numBlocks*5);
+
+    uint8_t* dst = &out[start];
+    for(size_t blockIdx = 0; blockIdx < numBlocks; blockIdx++)
+    {
+        uint32_t blockSize = min<size_t>(size, 65535);
+        dst[0] = (final && (blockIdx == numBlocks - 1)) ? 1 : 0;
+        dst[1] = blockSize & 0xff;
+        dst[2] = blockSize >> 8;
+        dst[3] = ~blockSize & 0xff;
+        dst[4] = (~blockSize >> 8) & 0xff;
+        memcpy(dst + 5, data, blockSize);
+        dst += 5 + blockSize;
+        data += blockSize;
+        size -= blockSize;
+    }
+}
+
+// One fixed Huffman block : literals, and runs of the previous byte as distance 1 matches
+static void DeflateRle(vector<uint8_t>& out, const uint8_t* data, size_t size, bool final)
+{
+    const fixedHuffmanTables& tables = GetFixedHuffmanTables();
+
+    // Worst case : 9 bit literals
+    size_t start = out.size();
+    out.resize(start + size*9/8 + 16);
+
+    bitWriter writer = {&out[start], 0, 0};
+    PutBits(writer, final ? 1 : 0, 1);
+    PutBits(writer, 1, 2);
+
+    size_t i = 0;
+    while(i < size)
+    {
+        if(i > 0)
+        {
+            uint8_t value = data[i - 1];
+            size_t maxRun = min<size_t>(size - i, 258);
+            size_t run = 0;
+            while((run < maxRun) && (data[i + run] == value))
+                run++;
+
+            if(run >= 3)
+            {
+                PutBits(writer, tables.matchCodes[run], tables.matchBits[run]);
+                i += run;
+                continue;
+            }
+        }
+
+        PutBits(writer, tables.literalCodes[data[i]], tables.literalBits[data[i]]);
+        i++;
+    }
+
+    // End of block : symbol 256, 7 zero bits
+    PutBits(writer, 0, 7);
+    if(final)
+        AlignBits(writer);
+    else
+        PutSyncFlush(writer);
+
+    out.resize(writer.dst - out.data());
+}
+
+PngEncoder::PngEncoder()
+{
+    lodepng_compress_settings_init(&mZlib);
+    SetDeflateCompressionLevel(mZlib, mParams.compressionLevel);
+}
+
+PngEncoder::~PngEncoder()
+{
+    Release();
+}
+
+bool PngEncoder::Init(pngEncoderParameters params)
+{
+    Release();
+
+    mParams = params;
+    mParams.numThreads = max<uint32_t>(mParams.numThreads, 1);
+    mParams.bandRows = max<uint32_t>(mParams.bandRows, 1);
+    SetDeflateCompressionLevel(mZlib, mParams.compressionLevel);
+
+    mStop = false;
+    for(uint32_t workerIdx = 1; workerIdx < mParams.numThreads; workerIdx++)
+        mWorkers.push_back(thread(&PngEncoder::Worker, this));
+
+    return true;
+}
+
+void PngEncoder::Release()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStop = true;
+    }
+    mCond.notify_all();
+
+    for(thread& worker : mWorkers)
+        worker.join();
+    mWorkers.clear();
+
+    mFreeBands.clear();
+    mBandPool.clear();
+}
+
+uint32_t PngEncoder::NextBand(encodeTask& task)
+{
+    uint32_t bandIdx = task.nextBand++;
+    if(task.nextBand == task.numBands)
+        mTasks.erase(find(mTasks.begin(), mTasks.end(), &task));
+    return bandIdx;
+}
+
+void PngEncoder::BandDone(encodeTask& task)
+{
+    task.numDone++;
+    if(task.numDone == task.numBands)
+        mDoneCond.notify_all();
+}
+
+unsigned PngEncoder::Encode(vector<uint8_t>& png, const uint8_t* image, uint32_t width, uint32_t height, size_t pitch,
+                            LodePNGColorType colorType, uint32_t bitDepth)
+{
+    uint32_t numChannels;
+    switch(colorType)
+    {
+    case LCT_GREY:       numChannels = 1; break;
+    case LCT_GREY_ALPHA: numChannels = 2; break;
+    case LCT_RGB:        numChannels = 3; break;
+    case LCT_RGBA:       numChannels = 4; break;
+    default:             return 31;     // Illegal color type
+    }
+    if((bitDepth != 8) && (bitDepth != 16))
+        return 37;
+    if((width == 0) || (height == 0))
+        return 93;
+
+    encodeTask task;
+    task.image = image;
+    task.pitch = pitch;
+    task.bytesPerPixel = numChannels*bitDepth/8;
+    task.rowBytes = (size_t)width*task.bytesPerPixel;
+    task.height = height;
+    task.numBands = (height + mParams.bandRows - 1)/mParams.bandRows;
+    task.nextBand = 0;
+    task.numDone = 0;
+
+    {
+        lock_guard<mutex> lock(mMutex);
+        for(uint32_t bandIdx = 0; bandIdx < task.numBands; bandIdx++)
+        {
+            if(mFreeBands.empty())
+            {
+                mBandPool.push_back(bandBuffer());
+                mFreeBands.push_back(&mBandPool.back());
+            }
+            task.bands.push_back(mFreeBands.back());
+            mFreeBands.pop_back();
+        }
+        mTasks.push_back(&task);
+    }
+    mCond.notify_all();
+
+    // The calling thread encodes bands of its own image, then waits for the ones taken by the pool
+    {
+        unique_lock<mutex> lock(mMutex);
+        while(task.nextBand < task.numBands)
+        {
+            uint32_t bandIdx = NextBand(task);
+            lock.unlock();
+            EncodeBand(task, bandIdx);
+            lock.lock();
+            BandDone(task);
+        }
+        mDoneCond.wait(lock, [&task]{ return task.numDone == task.numBands; });
+    }
+
+    unsigned error = 0;
+    size_t pngBytes = 8 + 25 + 16 + 12;
+    uint32_t adler = 1;
+    for(uint32_t bandIdx = 0; bandIdx < task.numBands; bandIdx++)
+    {
+        const bandBuffer& band = *task.bands[bandIdx];
+        if(band.error && !error)
+            error = band.error;
+        pngBytes += band.chunk.size();
+        adler = (bandIdx == 0) ? band.adler : Adler32Combine(adler, band.adler, band.filtered.size());
+    }
+
+    if(!error)
+    {
+        static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        png.clear();
+        png.reserve(pngBytes);
+        png.insert(png.end(), signature, signature + 8);
+
+        uint8_t header[13];
+        Put32(header, width);
+        Put32(header + 4, height);
+        header[8] = bitDepth;
+        header[9] = colorType;
+        header[10] = 0;     // Deflate
+        header[11] = 0;     // Adaptive filtering
+        header[12] = 0;     // No interlace
+        AppendChunk(png, "IHDR", header, 13);
+
+        for(bandBuffer* band : task.bands)
+            png.insert(png.end(), band->chunk.begin(), band->chunk.end());
+
+        uint8_t trailer[4];
+        Put32(trailer, adler);
+        AppendChunk(png, "IDAT", trailer, 4);
+        AppendChunk(png, "IEND", nullptr, 0);
+    }
+
+    {
+        lock_guard<mutex> lock(mMutex);
+        mFreeBands.insert(mFreeBands.end(), task.bands.begin(), task.bands.end());
+    }
+
+    return error;
+}
+
+void PngEncoder::EncodeBand(const encodeTask& task, uint32_t bandIdx)
+{
+    bandBuffer& band = *task.bands[bandIdx];
+    uint32_t firstRow = bandIdx*mParams.bandRows;
+    uint32_t endRow = min(firstRow + mParams.bandRows, task.height);
+    size_t lineBytes = task.rowBytes + 1;
+
+    // Rows are filtered against the previous image row, also across bands
+    band.filtered.resize(lineBytes*(endRow - firstRow));
+    if((mParams.mode == PNG_ENCODE_DEFLATE) && (mParams.compressionLevel > 1))
+        band.candidates.resize(task.rowBytes*5);
+
+    for(uint32_t row = firstRow; row < endRow; row++)
+    {
+        uint8_t* line = &band.filtered[(row - firstRow)*lineBytes];
+        const uint8_t* src = task.image + row*task.pitch;
+        const uint8_t* prev = (row > 0) ? src - task.pitch : nullptr;
+
+        if(mParams.mode == PNG_ENCODE_RLE)
+        {
+            line[0] = 1;
+            FilterRow(line + 1, src, prev, task.rowBytes, task.bytesPerPixel, 1);
+        }
+        else if((mParams.mode == PNG_ENCODE_DEFLATE) && (mParams.compressionLevel > 1))
+        {
+            line[0] = FilterRowMinSum(line + 1, band.candidates.data(), src, prev, task.rowBytes, task.bytesPerPixel);
+        }
+        else
+        {
+            line[0] = 0;
+            memcpy(line + 1, src, task.rowBytes);
+        }
+    }
+    band.adler = Adler32(band.filtered.data(), band.filtered.size());
+
+    // IDAT chunk : length, type, (zlib header on the first band), deflate data, crc
+    band.chunk.clear();
+    band.chunk.resize(8);
+    memcpy(&band.chunk[4], "IDAT", 4);
+    if(bandIdx == 0)
+    {
+        // CMF : deflate, 32K window ; FLG : check bits, no dictionary, fastest
+        band.chunk.push_back(0x78);
+        band.chunk.push_back(0x01);
+    }
+
+    bool final = (bandIdx == task.numBands - 1);
+    band.error = 0;
+    switch(mParams.mode)
+    {
+    case PNG_ENCODE_STORE:
+        DeflateStored(band.chunk, band.filtered.data(), band.filtered.size(), final);
+        break;
+    case PNG_ENCODE_RLE:
+        DeflateRle(band.chunk, band.filtered.data(), band.filtered.size(), final);
+        break;
+    default:
+    {
+        unsigned char* deflated = nullptr;
+        size_t deflatedBytes = 0;
+        band.error = lodepng_deflate_part(&deflated, &deflatedBytes, band.filtered.data(), band.filtered.size(), &mZlib, final);
+        if(!band.error)
+            band.chunk.insert(band.chunk.end(), deflated, deflated + deflatedBytes);
+        free(deflated);
+        break;
+    }
+    }
+
+    size_t dataBytes = band.chunk.size() - 8;
+    Put32(&band.chunk[0], dataBytes);
+    band.chunk.resize(band.chunk.size() + 4);
+    Put32(&band.chunk[8 + dataBytes], Crc32(&band.chunk[4], 4 + dataBytes));
+}
+
+void PngEncoder::Worker()
+{
+    unique_lock<mutex> lock(mMutex);
+    while(true)
+    {
+        mCond.wait(lock, [this]{ return !mTasks.empty() || mStop; });
+        if(mTasks.empty())
+            return;
+
+        encodeTask& task = *mTasks.front();
+        uint32_t bandIdx = NextBand(task);
+        lock.unlock();
+        EncodeBand(task, bandIdx);
+        lock.lock();
+        BandDone(task);
+    }
+}
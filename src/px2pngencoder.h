@@ -0,0 +1,105 @@
+#ifndef PX2PNGENCODER_H
+#define PX2PNGENCODER_H
+
+#include <lodepng.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Parallel PNG encoder on top of the bundled lodepng.
+ *
+ * The image is split into bands of rows. Each band is filtered and deflated on its own by a thread pool (and the
+ * calling thread) and becomes one IDAT chunk : non-final bands end with a sync flush (empty stored block), so the
+ * concatenated bands are one valid zlib stream. The band adler32s are combined into the trailer, in a last IDAT chunk.
+ * Every band starts with an empty LZ77 window, files are slightly larger than a single-threaded lodepng encode.
+ *
+ *    PNG_ENCODE_STORE   : no filter, stored blocks. memcpy speed, raw size
+ *    PNG_ENCODE_RLE     : sub filter, runs of repeated bytes with fixed Huffman codes. Flat / synthetic images
+ *    PNG_ENCODE_DEFLATE : lodepng deflate at compressionLevel (SetPngCompressionLevel)
+ *
+ * Encode() can be called from several threads at once, the bands of all calls share the pool.
+ */
+
+typedef enum {
+    PNG_ENCODE_STORE = 0,
+    PNG_ENCODE_RLE = 1,
+    PNG_ENCODE_DEFLATE = 2
+}pngEncodeMode;
+
+typedef struct {
+    pngEncodeMode mode = PNG_ENCODE_DEFLATE;
+    int compressionLevel = 1;       // PNG_ENCODE_DEFLATE : 0 stored ... 9 smallest
+    uint32_t numThreads = 4;        // Including the calling thread
+    uint32_t bandRows = 64;
+}pngEncoderParameters;
+
+// lodepng encoder settings for a 0-9 compression level
+void SetDeflateCompressionLevel(LodePNGCompressSettings& zlib, int level);
+void SetPngCompressionLevel(LodePNGState& state, int level);
+
+class PngEncoder{
+public:
+    PngEncoder();
+    ~PngEncoder();
+
+    // Without Init() the bands are encoded on the calling thread only
+    bool Init(pngEncoderParameters params);
+    void Release();
+
+    // image : height rows of width pixels, pitch bytes apart, in PNG sample order (RGB(A), 16bit big endian)
+    // colorType : LCT_GREY / LCT_GREY_ALPHA / LCT_RGB / LCT_RGBA, bitDepth : 8 / 16
+    // Returns a lodepng error code, 0 : png holds the file
+    unsigned Encode(vector<uint8_t>& png, const uint8_t* image, uint32_t width, uint32_t height, size_t pitch,
+                    LodePNGColorType colorType, uint32_t bitDepth);
+
+private:
+    typedef struct {
+        vector<uint8_t> filtered;       // Filter type byte + row, per row
+        vector<uint8_t> candidates;     // Min-sum filter selection, one row per filter type
+        vector<uint8_t> chunk;          // IDAT chunk
+        uint32_t adler = 1;             // Of filtered
+        unsigned error = 0;
+    }bandBuffer;
+
+    typedef struct {
+        const uint8_t* image;
+        size_t pitch;
+        size_t rowBytes;
+        uint32_t height;
+        uint32_t bytesPerPixel;
+        uint32_t numBands;
+        uint32_t nextBand;
+        uint32_t numDone;
+        vector<bandBuffer*> bands;
+    }encodeTask;
+
+    // Called with mMutex held
+    uint32_t NextBand(encodeTask& task);
+    void BandDone(encodeTask& task);
+
+    void EncodeBand(const encodeTask& task, uint32_t bandIdx);
+    void Worker();
+
+private:
+    pngEncoderParameters mParams;
+    LodePNGCompressSettings mZlib;
+
+    deque<bandBuffer> mBandPool;
+    vector<bandBuffer*> mFreeBands;
+
+    deque<encodeTask*> mTasks;          // Tasks with bands left to start
+    mutex mMutex;
+    condition_variable mCond;
+    condition_variable mDoneCond;
+    vector<thread> mWorkers;
+    bool mStop = false;
+};
+
+#endif // PX2PNGENCODER_H
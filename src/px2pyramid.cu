@@ -0,0 +1,241 @@
+#include "px2pyramid.h"
+
+#include <cmath>
+
+// Shared by the kernel and the host reference
+
+// Reflect-101 border (cv::BORDER_DEFAULT), count >= 2
+__host__ __device__
+inline int PyramidReflect(int index, int count)
+{
+    if(index < 0)
+        index = -index;
+    if(index >= count)
+        index = 2*count - 2 - index;
+    return index;
+}
+
+// Level pixel (x, y) from the previous level (srcW x srcH)
+__host__ __device__
+inline void PyramidPixel(const uint8_t* src, size_t srcStep, int srcW, int srcH, pyramidFilter filter,
+                         int x, int y, uint8_t* dstPx)
+{
+    if(filter == PYRAMID_BOX)
+    {
+        int x0 = 2*x;
+        int y0 = 2*y;
+        int x1 = (x0 + 1 < srcW) ? x0 + 1 : x0;
+        int y1 = (y0 + 1 < srcH) ? y0 + 1 : y0;
+
+        const uint8_t* row0 = src + y0*srcStep;
+        const uint8_t* row1 = src + y1*srcStep;
+        for(int c = 0; c < 3; c++)
+            dstPx[c] = (uint8_t)((row0[x0*3 + c] + row0[x1*3 + c] + row1[x0*3 + c] + row1[x1*3 + c] + 2) >> 2);
+        return;
+    }
+
+    const int weights[5] = {1, 4, 6, 4, 1};
+
+    int cols[5];
+    for(int k = 0; k < 5; k++)
+        cols[k] = PyramidReflect(2*x + k - 2, srcW)*3;
+
+    // Integer sums, rounded once (total weight 256)
+    int sum[3] = {0, 0, 0};
+    for(int j = 0; j < 5; j++)
+    {
+        const uint8_t* row = src + PyramidReflect(2*y + j - 2, srcH)*srcStep;
+        for(int c = 0; c < 3; c++)
+        {
+            int rowSum = row[cols[0] + c] + 4*row[cols[1] + c] + 6*row[cols[2] + c] + 4*row[cols[3] + c] + row[cols[4] + c];
+            sum[c] += weights[j]*rowSum;
+        }
+    }
+
+    for(int c = 0; c < 3; c++)
+        dstPx[c] = (uint8_t)((sum[c] + 128) >> 8);
+}
+
+__global__
+void PyramidDown(const uint8_t* src, size_t srcStep, int srcW, int srcH, pyramidFilter filter,
+                 uint8_t* dst, size_t dstStep, int dstW, int dstH)
+{
+    int xIndex = blockIdx.x*blockDim.x + threadIdx.x;
+    int yIndex = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if((xIndex < dstW) && (yIndex < dstH))
+        PyramidPixel(src, srcStep, srcW, srcH, filter, xIndex, yIndex, dst + yIndex*dstStep + xIndex*3);
+}
+
+px2Pyramid::px2Pyramid(px2Cam* _px2Cam)
+{
+    mPx2Cam = _px2Cam;
+
+    // Reads GetOriGpuMatImgData()
+    mPx2Cam->RequestRGBAFrame();
+}
+
+bool px2Pyramid::Init(pyramidParameters pyrParams, uint32_t numSlots)
+{
+    if(!InitLevels(pyrParams))
+        return false;
+
+    return InitDevice(numSlots);
+}
+
+bool px2Pyramid::InitLevels(pyramidParameters pyrParams)
+{
+    mPyrParams = pyrParams;
+
+    if(mPyrParams.numLevels < 1)
+    {
+        cout << "[PYR_INIT] Invalid number of levels" << endl;
+        return false;
+    }
+
+    mLevelWidths.assign(1, CAM_IMG_WIDTH);
+    mLevelHeights.assign(1, CAM_IMG_HEIGHT);
+
+    // Stops before a level gets under 2 pixels (reflect-101 border)
+    for(int level = 1; level < mPyrParams.numLevels; level++)
+    {
+        if((mLevelWidths.back() < 4) || (mLevelHeights.back() < 4))
+        {
+            cout << "[PYR_INIT] Only " << level << " levels fit the frame" << endl;
+            mPyrParams.numLevels = level;
+            break;
+        }
+
+        mLevelWidths.push_back((mLevelWidths.back() + 1)/2);
+        mLevelHeights.push_back((mLevelHeights.back() + 1)/2);
+    }
+
+    return true;
+}
+
+bool px2Pyramid::InitDevice(uint32_t numSlots)
+{
+    mNumSlots = numSlots;
+
+    if(mNumSlots < 1)
+    {
+        cout << "[PYR_INIT] Invalid number of slots" << endl;
+        return false;
+    }
+
+    // Freed with the px2Cam device arena
+    DeviceArena* deviceArena = mPx2Cam->GetDeviceArena();
+
+    vector<vector<arenaBufferId> > levelIds(mNumSlots, vector<arenaBufferId>(mPyrParams.numLevels));
+    for(uint32_t slotIdx = 0; slotIdx < mNumSlots; slotIdx++)
+    {
+        for(int level = 0; level < mPyrParams.numLevels; level++)
+        {
+            levelIds[slotIdx][level] = deviceArena->Request("pyramid", "slot" + to_string(slotIdx) + "_level" + to_string(level),
+                                                            mLevelWidths[level]*mLevelHeights[level]*3*sizeof(uint8_t));
+        }
+    }
+
+    if(!deviceArena->Commit())
+    {
+        cout << "[PYR_INIT] Pyramid levels allocation fail" << endl;
+        return false;
+    }
+
+    mLevelGpuMats.assign(mNumSlots, vector<cv::cuda::GpuMat>(mPyrParams.numLevels));
+    for(uint32_t slotIdx = 0; slotIdx < mNumSlots; slotIdx++)
+    {
+        for(int level = 0; level < mPyrParams.numLevels; level++)
+        {
+            mLevelGpuMats[slotIdx][level] = cv::cuda::GpuMat(mLevelHeights[level], mLevelWidths[level], CV_8UC3,
+                                                             deviceArena->Get<uint8_t>(levelIds[slotIdx][level]));
+        }
+    }
+    mPyrTimestamps.assign(mNumSlots, 0);
+
+    return true;
+}
+
+void px2Pyramid::Build(uint32_t slotIdx, cudaStream_t stream)
+{
+    slotIdx = ClampSlot(slotIdx);
+    vector<cv::cuda::GpuMat>& levels = mLevelGpuMats[slotIdx];
+
+    gpuMatImgData camImg = mPx2Cam->GetOriGpuMatImgData();
+    mPyrTimestamps[slotIdx] = camImg.timestamp_us;
+
+    // Level 0 : the px2Cam frame is rewritten by the next frame
+    CHECK_CUDA_ERROR(cudaMemcpy2DAsync(levels[0].data, levels[0].step, camImg.gpuMatImg.data, camImg.gpuMatImg.step,
+                                       levels[0].cols*3, levels[0].rows, cudaMemcpyDeviceToDevice, stream));
+
+    const dim3 block(16,16);
+
+    for(int level = 1; level < mPyrParams.numLevels; level++)
+    {
+        const cv::cuda::GpuMat& src = (level == 1) ? camImg.gpuMatImg : levels[level - 1];
+        cv::cuda::GpuMat& dst = levels[level];
+
+        const dim3 grid((dst.cols + block.x - 1)/block.x, (dst.rows + block.y - 1)/block.y);
+
+        PyramidDown <<< grid, block, 0, stream >>> (src.data, src.step, src.cols, src.rows, mPyrParams.filter,
+                                                    dst.data, dst.step, dst.cols, dst.rows);
+    }
+}
+
+void px2Pyramid::BuildHost(const cv::Mat& camImg, vector<cv::Mat>& levels)
+{
+    levels.resize(mPyrParams.numLevels);
+    levels[0] = camImg;
+
+    for(int level = 1; level < mPyrParams.numLevels; level++)
+    {
+        const cv::Mat& src = levels[level - 1];
+        cv::Mat& dst = levels[level];
+        dst.create(mLevelHeights[level], mLevelWidths[level], CV_8UC3);
+
+        for(int y = 0; y < dst.rows; y++)
+        {
+            for(int x = 0; x < dst.cols; x++)
+            {
+                PyramidPixel(src.data, src.step, src.cols, src.rows, mPyrParams.filter,
+                             x, y, dst.ptr<uint8_t>(y) + x*3);
+            }
+        }
+    }
+}
+
+gpuMatImgData px2Pyramid::GetLevelGpuMatImgData(int level, uint32_t slotIdx)
+{
+    slotIdx = ClampSlot(slotIdx);
+
+    gpuMatImgData levelData;
+    levelData.timestamp_us = mPyrTimestamps[slotIdx];
+    levelData.gpuMatImg = mLevelGpuMats[slotIdx][ClampLevel(level)];
+    return levelData;
+}
+
+void px2Pyramid::Level2Level(float xIn, float yIn, int srcLevel, int dstLevel, float& xOut, float& yOut) const
+{
+    float scale = ldexpf(1.f, srcLevel - dstLevel);
+
+    // Gaussian : pixel centers on the even pixels of the previous level, box : pixel centers scale as the sizes
+    if(mPyrParams.filter == PYRAMID_GAUSSIAN)
+    {
+        xOut = xIn*scale;
+        yOut = yIn*scale;
+    }
+    else
+    {
+        xOut = (xIn + 0.5f)*scale - 0.5f;
+        yOut = (yIn + 0.5f)*scale - 0.5f;
+    }
+}
+
+int px2Pyramid::GetLevelForScale(float scale) const
+{
+    int level = 0;
+    while((level + 1 < mPyrParams.numLevels) && (ldexpf(1.f, -(level + 1)) >= scale*0.999f))
+        level++;
+
+    return level;
+}
@@ -0,0 +1,78 @@
+#ifndef PX2PYRAMID_H
+#define PX2PYRAMID_H
+
+#include "px2camlib.h"
+
+/**
+ * Image pyramid of the camera frame (BGR 8bit), built once per frame for the multi-scale consumers.
+ *
+ * One level set per frame slot : Build(slotIdx) in the capture stage writes only that slot, so the later stages
+ * read the levels of their own frame while the next frames are built. A slot is valid until its next Build().
+ *
+ * Level 0 is a copy of the px2Cam frame, level l + 1 halves level l ((size + 1)/2 as cv::pyrDown) :
+ *    PYRAMID_GAUSSIAN : 5x5 [1 4 6 4 1]/16 kernel, reflect-101 border (same result as cv::pyrDown),
+ *                       level pixel x is centered on level 0 pixel x*2^l
+ *    PYRAMID_BOX      : 2x2 mean, level pixel x covers level 0 pixels [x*2^l, (x + 1)*2^l)
+ * All the levels of all the slots are one px2Cam device arena block, allocated at Init().
+ * Level / slot indices out of range are clamped.
+ * BuildHost() is the host reference of Build() (same filter, same rounding).
+ */
+
+typedef enum {
+    PYRAMID_GAUSSIAN = 0,
+    PYRAMID_BOX
+}pyramidFilter;
+
+typedef struct {
+    int numLevels = 4;              // Including level 0, 1920x1208 -> 960x604 -> 480x302 -> 240x151
+    pyramidFilter filter = PYRAMID_GAUSSIAN;
+}pyramidParameters;
+
+class px2Pyramid{
+public:
+    px2Pyramid(px2Cam* _px2Cam);
+    ~px2Pyramid() {}
+
+    // After px2Cam::Init() (device arena), numSlots : frame slots of the pipeline
+    bool Init(pyramidParameters pyrParams, uint32_t numSlots = 1);
+
+    // Init() in two parts : the level sizes (enough for BuildHost()), then the levels of every slot in the device arena
+    bool InitLevels(pyramidParameters pyrParams);
+    bool InitDevice(uint32_t numSlots = 1);
+
+    // Pyramid of the current px2Cam frame into slot slotIdx
+    void Build(uint32_t slotIdx, cudaStream_t stream = 0);
+
+    // Host reference of Build() for a BGR camera image, levels[0] is camImg
+    void BuildHost(const cv::Mat& camImg, vector<cv::Mat>& levels);
+
+    int GetNumLevels() const { return mPyrParams.numLevels; }
+    uint32_t GetNumSlots() const { return mNumSlots; }
+    int GetLevelWidth(int level) const { return mLevelWidths[ClampLevel(level)]; }
+    int GetLevelHeight(int level) const { return mLevelHeights[ClampLevel(level)]; }
+
+    // Device, BGR, valid until the next Build() of the slot
+    gpuMatImgData GetLevelGpuMatImgData(int level, uint32_t slotIdx = 0);
+
+    // Pixel coordinate in level srcLevel -> same point in level dstLevel
+    void Level2Level(float xIn, float yIn, int srcLevel, int dstLevel, float& xOut, float& yOut) const;
+
+    // Coarsest level whose size is still >= the requested fraction of the frame (resizeRatio 0.5 -> level 1)
+    int GetLevelForScale(float scale) const;
+
+private:
+    int ClampLevel(int level) const { return min(max(level, 0), mPyrParams.numLevels - 1); }
+    uint32_t ClampSlot(uint32_t slotIdx) const { return min(slotIdx, mNumSlots - 1); }
+
+    px2Cam* mPx2Cam;
+
+    pyramidParameters mPyrParams;
+    uint32_t mNumSlots = 1;
+    vector<int> mLevelWidths;
+    vector<int> mLevelHeights;
+
+    vector<vector<cv::cuda::GpuMat> > mLevelGpuMats;    // [slot][level]
+    vector<uint64_t> mPyrTimestamps;                    // [slot]
+};
+
+#endif // PX2PYRAMID_H
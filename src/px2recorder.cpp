@@ -0,0 +1,238 @@
+#include "px2recorder.h"
+#include "px2log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include <sys/stat.h>
+
+static double NowS()
+{
+    return chrono::duration_cast<chrono::duration<double> >(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CameraRecorder::CameraRecorder()
+{
+}
+
+CameraRecorder::~CameraRecorder()
+{
+    Release();
+}
+
+bool CameraRecorder::Init(cameraRecorderParameters params, dwSensorHandle_t camera, const string& serializerParams)
+{
+    if(mSerializer)
+    {
+        cout << "[RECORDER] Already initialized" << endl;
+        return false;
+    }
+
+    mParams = params;
+    mParams.queueCapacity = max<uint32_t>(mParams.queueCapacity, 1);
+    mParams.decimateFactor = max<uint32_t>(mParams.decimateFactor, 1);
+    mCamera = camera;
+
+    dwSerializerParams seriParams;
+    seriParams.parameters = serializerParams.c_str();
+    seriParams.onData = nullptr;
+
+    dwStatus status = dwSensorSerializer_initialize(&mSerializer, &seriParams, mCamera);
+    if(status == DW_SUCCESS)
+        status = dwSensorSerializer_start(mSerializer);
+
+    if(status != DW_SUCCESS)
+    {
+        cout << "[RECORDER] Serializer init fail : " << dwGetStatusName(status) << endl;
+        if(mSerializer)
+            dwSensorSerializer_release(&mSerializer);
+        mSerializer = DW_NULL_HANDLE;
+        return false;
+    }
+
+    mStats = cameraRecorderStats();
+    mWriteMsSum = 0.0;
+    mStartS = NowS();
+    mLastStatsS = mStartS;
+    mStop = false;
+
+    mWriter = thread(&CameraRecorder::RunWriter, this);
+
+    static const char* policyNames[] = {"drop newest", "drop oldest", "decimate"};
+    cout << "[RECORDER] Queue of " << mParams.queueCapacity << " frames, " << policyNames[mParams.policy] << endl;
+
+    return true;
+}
+
+bool CameraRecorder::Submit(dwCameraFrameHandle_t frame)
+{
+    if(!mSerializer)
+        return false;
+
+    bool accepted = true;
+    bool printStats = false;
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStats.numSubmitted++;
+
+        uint32_t depth = mQueue.size();
+
+        if(mParams.policy == RECORD_DECIMATE)
+        {
+            if(depth >= mParams.decimateDepth)
+                mDecimating = true;
+            else if(depth == 0)
+                mDecimating = false;
+
+            if(mDecimating && ((mDecimateCount++ % mParams.decimateFactor) != 0))
+            {
+                mStats.numDecimated++;
+                accepted = false;
+            }
+        }
+
+        if(accepted && (depth >= mParams.queueCapacity))
+        {
+            mStats.numDropped++;
+
+            if(mParams.policy == RECORD_DROP_OLDEST)
+            {
+                mDoneFrames.push_back(mQueue.front());
+                mQueue.pop_front();
+            }
+            else
+            {
+                accepted = false;
+            }
+        }
+
+        if(accepted)
+        {
+            mQueue.push_back(frame);
+            mStats.maxQueueDepth = max<uint32_t>(mStats.maxQueueDepth, mQueue.size());
+        }
+
+        double nowS = NowS();
+        if((mParams.statsIntervalS > 0.f) && (nowS - mLastStatsS >= mParams.statsIntervalS))
+        {
+            mLastStatsS = nowS;
+            printStats = true;
+        }
+    }
+
+    if(accepted)
+        mQueueCond.notify_one();
+
+    if(printStats)
+        PrintStats(GetStats());
+
+    return accepted;
+}
+
+void CameraRecorder::ReturnFrames()
+{
+    vector<dwCameraFrameHandle_t> doneFrames;
+    {
+        lock_guard<mutex> lock(mMutex);
+        if(mDoneFrames.empty())
+            return;
+        doneFrames.swap(mDoneFrames);
+    }
+
+    for(dwCameraFrameHandle_t frame : doneFrames)
+        dwSensorCamera_returnFrame(&frame);
+}
+
+void CameraRecorder::Release()
+{
+    if(!mSerializer)
+        return;
+
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStop = true;
+    }
+    mQueueCond.notify_all();
+
+    if(mWriter.joinable())
+        mWriter.join();
+
+    ReturnFrames();
+
+    dwSensorSerializer_stop(mSerializer);
+    dwSensorSerializer_release(&mSerializer);
+    mSerializer = DW_NULL_HANDLE;
+
+    PrintStats(GetStats());
+}
+
+cameraRecorderStats CameraRecorder::GetStats()
+{
+    cameraRecorderStats stats;
+    {
+        lock_guard<mutex> lock(mMutex);
+        stats = mStats;
+        stats.queueDepth = mQueue.size();
+        uint64_t numWrites = stats.numWritten + stats.numWriteErrors;
+        stats.writeMsAvg = (numWrites > 0) ? mWriteMsSum/numWrites : 0.0;
+    }
+
+    double elapsedS = NowS() - mStartS;
+    if(elapsedS > 0.0)
+    {
+        stats.writeFps = stats.numWritten/elapsedS;
+
+        struct stat fileStat;
+        if(!mParams.filePath.empty() && (stat(mParams.filePath.c_str(), &fileStat) == 0))
+            stats.writeMBps = fileStat.st_size/elapsedS/(1 << 20);
+    }
+
+    return stats;
+}
+
+void CameraRecorder::PrintStats(const cameraRecorderStats& stats)
+{
+    PX2_LOG_INFO("[RECORDER] written %llu/%llu, dropped %llu, decimated %llu, errors %llu, queue %u (max %u), "
+                 "write %.1fms (max %.1fms), %.1ffps, %.1fMB/s",
+                 stats.numWritten, stats.numSubmitted, stats.numDropped, stats.numDecimated, stats.numWriteErrors,
+                 stats.queueDepth, stats.maxQueueDepth, stats.writeMsAvg, stats.writeMsMax, stats.writeFps, stats.writeMBps);
+}
+
+// The queue is written until empty, also after the stop request
+void CameraRecorder::RunWriter()
+{
+    unique_lock<mutex> lock(mMutex);
+
+    while(true)
+    {
+        mQueueCond.wait(lock, [this]{ return mStop || !mQueue.empty(); });
+
+        if(mQueue.empty())
+            break;
+
+        dwCameraFrameHandle_t frame = mQueue.front();
+        mQueue.pop_front();
+
+        lock.unlock();
+
+        double beginS = NowS();
+        dwStatus status = dwSensorSerializer_serializeCameraFrame(frame, mSerializer);
+        float writeMs = (NowS() - beginS)*1000.0;
+
+        if(status != DW_SUCCESS)
+            PX2_LOG_ERROR_RATE(1, "[RECORDER] Serializing fail : %s", dwGetStatusName(status));
+
+        lock.lock();
+
+        mDoneFrames.push_back(frame);
+
+        if(status == DW_SUCCESS)
+            mStats.numWritten++;
+        else
+            mStats.numWriteErrors++;
+
+        mWriteMsSum += writeMs;
+        mStats.writeMsMax = max(mStats.writeMsMax, writeMs);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef PX2RECORDER_H
+#define PX2RECORDER_H
+
+#include <dw/sensors/SensorSerializer.h>
+#include <dw/sensors/camera/Camera.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Camera recording off the capture path.
+ *
+ * The capture thread hands its camera frame over (Submit) instead of serializing it : the frame goes to a bounded
+ * queue, a writer thread serializes it (synchronous Driveworks serializer) and gives it back.
+ * Written or dropped frames are returned to the camera by the capture thread (ReturnFrames), so the
+ * camera is only used from one thread.
+ * The camera pool (fifo-size) must hold queueCapacity frames + the one being processed + the next one read.
+ *
+ * When the writer falls behind :
+ *    RECORD_DROP_NEWEST : a frame submitted to a full queue is not recorded
+ *    RECORD_DROP_OLDEST : the oldest queued frame is dropped for the new one
+ *    RECORD_DECIMATE    : from decimateDepth queued frames, only 1 frame out of decimateFactor is recorded
+ *                         (back to every frame once the queue is empty), drop newest when full
+ */
+
+typedef enum {
+    RECORD_DROP_NEWEST = 0,
+    RECORD_DROP_OLDEST = 1,
+    RECORD_DECIMATE = 2
+}recordPolicy;
+
+typedef struct {
+    uint32_t queueCapacity = 4;
+    recordPolicy policy = RECORD_DECIMATE;
+    uint32_t decimateDepth = 2;
+    uint32_t decimateFactor = 2;
+    string filePath = "";           // Recorded file, for the write throughput (bytes) only
+    float statsIntervalS = 10.f;    // Periodic metrics log, 0 : none
+}cameraRecorderParameters;
+
+typedef struct {
+    uint64_t numSubmitted = 0;
+    uint64_t numWritten = 0;
+    uint64_t numDropped = 0;        // Queue full (or oldest replaced)
+    uint64_t numDecimated = 0;      // Skipped by RECORD_DECIMATE
+    uint64_t numWriteErrors = 0;
+    uint32_t queueDepth = 0;
+    uint32_t maxQueueDepth = 0;
+    float writeMsAvg = 0.f;         // Serialization time per frame
+    float writeMsMax = 0.f;
+    float writeFps = 0.f;           // Since Init
+    float writeMBps = 0.f;          // File size / time since Init, 0 without filePath
+}cameraRecorderStats;
+
+class CameraRecorder{
+public:
+    CameraRecorder();
+    ~CameraRecorder();
+
+    // serializerParams : Driveworks serializer parameter string (format, type=disk,file=...)
+    bool Init(cameraRecorderParameters params, dwSensorHandle_t camera, const string& serializerParams);
+
+    // True : the recorder owns the frame until ReturnFrames gives it back, false : the caller returns it
+    bool Submit(dwCameraFrameHandle_t frame);
+
+    // Capture thread : returns the written and dropped frames to the camera
+    void ReturnFrames();
+
+    // Writes the queued frames, returns them and stops the serializer (before the camera is released)
+    void Release();
+
+    bool IsRecording() const { return mSerializer != DW_NULL_HANDLE; }
+
+    cameraRecorderStats GetStats();
+
+private:
+    void RunWriter();
+    void PrintStats(const cameraRecorderStats& stats);
+
+private:
+    cameraRecorderParameters mParams;
+    dwSensorHandle_t mCamera = DW_NULL_HANDLE;
+    dwSensorSerializerHandle_t mSerializer = DW_NULL_HANDLE;
+
+    mutex mMutex;
+    condition_variable mQueueCond;
+    deque<dwCameraFrameHandle_t> mQueue;
+    vector<dwCameraFrameHandle_t> mDoneFrames;
+    bool mStop = false;
+    thread mWriter;
+
+    // Submit side (capture thread)
+    bool mDecimating = false;
+    uint64_t mDecimateCount = 0;
+    double mLastStatsS = 0.0;
+
+    cameraRecorderStats mStats;
+    double mWriteMsSum = 0.0;
+    double mStartS = 0.0;
+};
+
+#endif // PX2RECORDER_H
@@ -0,0 +1,105 @@
+#include "px2rectify.h"
+
+px2Rectifier::px2Rectifier(px2Cam* _px2Cam)
+{
+    mPx2Cam = _px2Cam;
+
+    // Reads GetOriGpuMatImgData()
+    mPx2Cam->RequestRGBAFrame();
+}
+
+bool px2Rectifier::Init(rectifyParameters rectParams, string invRectMapFilePath)
+{
+    if(!LoadCalibration(rectParams, invRectMapFilePath))
+        return false;
+
+    return InitDevice();
+}
+
+bool px2Rectifier::LoadCalibration(rectifyParameters rectParams, string invRectMapFilePath)
+{
+    mRectParams = rectParams;
+
+    if((mRectParams.width <= 0) || (mRectParams.height <= 0))
+    {
+        cout << "[RECT_INIT] Invalid output size" << endl;
+        return false;
+    }
+
+    cv::Mat invMap1, invMap2;
+
+    cv::FileStorage fs(invRectMapFilePath, cv::FileStorage::READ);
+    fs["invMap1"] >> invMap1;
+    fs["invMap2"] >> invMap2;
+    fs.release();
+
+    cv::Mat rect2DistMap;
+    if(!BuildRect2DistMap(invMap1, invMap2, CAM_IMG_WIDTH, CAM_IMG_HEIGHT, rect2DistMap))
+        return false;
+
+    // Camera size output : the table is the map itself, otherwise it is resampled at the output pixel centers
+    if((mRectParams.width == CAM_IMG_WIDTH) && (mRectParams.height == CAM_IMG_HEIGHT))
+    {
+        mRemapTable = rect2DistMap;
+    }
+    else
+    {
+        mRemapTable.create(mRectParams.height, mRectParams.width, CV_32FC2);
+
+        for(int v = 0; v < mRectParams.height; v++)
+        {
+            for(int u = 0; u < mRectParams.width; u++)
+            {
+                float rectX, rectY;
+                Pixel2Rect(u, v, rectX, rectY);
+
+                float distX, distY;
+                cv::Vec2f& srcCoord = mRemapTable.at<cv::Vec2f>(v,u);
+                srcCoord = SampleRemapTable(rect2DistMap, rectX, rectY, distX, distY) ? cv::Vec2f(distX, distY)
+                                                                                      : cv::Vec2f(-1.f, -1.f);
+            }
+        }
+    }
+
+    int numValid = 0;
+    for(int v = 0; v < mRemapTable.rows; v++)
+        for(int u = 0; u < mRemapTable.cols; u++)
+            numValid += (mRemapTable.at<cv::Vec2f>(v,u)[0] >= 0.f) ? 1 : 0;
+
+    cout << "[RECT_INIT] " << mRectParams.width << "x" << mRectParams.height << " rectified image, "
+         << numValid*100/(mRectParams.width*mRectParams.height) << "% has a camera pixel" << endl;
+
+    return true;
+}
+
+bool px2Rectifier::InitDevice()
+{
+    return mRemap.Init(mRemapTable);
+}
+
+void px2Rectifier::Rectify(cv::cuda::GpuMat& rectImg, cudaStream_t stream)
+{
+    mRemap.Apply(mPx2Cam->GetOriGpuMatImgData().gpuMatImg, rectImg, stream);
+}
+
+void px2Rectifier::RectifyHost(const cv::Mat& camImg, cv::Mat& rectImg)
+{
+    RemapBGRHost(camImg, mRemapTable, rectImg);
+}
+
+void px2Rectifier::Rect2Pixel(float xIn, float yIn, float& xOut, float& yOut) const
+{
+    xOut = (xIn + 0.5f)*mRectParams.width/CAM_IMG_WIDTH - 0.5f;
+    yOut = (yIn + 0.5f)*mRectParams.height/CAM_IMG_HEIGHT - 0.5f;
+}
+
+void px2Rectifier::Pixel2Rect(float xIn, float yIn, float& xOut, float& yOut) const
+{
+    xOut = (xIn + 0.5f)*CAM_IMG_WIDTH/mRectParams.width - 0.5f;
+    yOut = (yIn + 0.5f)*CAM_IMG_HEIGHT/mRectParams.height - 0.5f;
+}
+
+bool px2Rectifier::Pixel2Dist(float xIn, float yIn, float& xOut, float& yOut) const
+{
+    return SampleRemapTable(mRemapTable, xIn, yIn, xOut, yOut);
+}
@@ -0,0 +1,59 @@
+#ifndef PX2RECTIFY_H
+#define PX2RECTIFY_H
+
+#include "px2camlib.h"
+#include "px2remap.h"
+
+/**
+ * Undistorted (rectified) image of the camera frame, paid once per frame for every consumer.
+ *
+ * The inverse rectification map (invRectMap.xml) is inverted at Init() into a forward remap table
+ * (output pixel -> distorted camera pixel), so Rectify() is a single bilinear GPU pass.
+ * The rectified plane has the camera resolution (same as px2LD::Dist2Rect), the output may be scaled down.
+ */
+
+typedef struct {
+    int width = CAM_IMG_WIDTH;      // Output size, the rectified plane is scaled to it
+    int height = CAM_IMG_HEIGHT;
+}rectifyParameters;
+
+class px2Rectifier{
+public:
+    px2Rectifier(px2Cam* _px2Cam);
+    ~px2Rectifier() {}
+
+    bool Init(rectifyParameters rectParams, string invRectMapFilePath);
+
+    // Init() in two parts : the remap table is built on the host (any thread), then uploaded
+    bool LoadCalibration(rectifyParameters rectParams, string invRectMapFilePath);
+    bool InitDevice();
+
+    // Rectified image of the current px2Cam frame (device, BGR), rectImg is allocated on the first call only
+    void Rectify(cv::cuda::GpuMat& rectImg, cudaStream_t stream = 0);
+
+    // Host reference of Rectify() for a BGR camera image
+    void RectifyHost(const cv::Mat& camImg, cv::Mat& rectImg);
+
+    int GetWidth() const { return mRectParams.width; }
+    int GetHeight() const { return mRectParams.height; }
+
+    // Forward table (output pixel -> distorted camera pixel, -1 : no camera pixel)
+    const cv::Mat& GetRemapTable() const { return mRemapTable; }
+
+    // Rectified camera pixel <-> output pixel (pixel centers)
+    void Rect2Pixel(float xIn, float yIn, float& xOut, float& yOut) const;
+    void Pixel2Rect(float xIn, float yIn, float& xOut, float& yOut) const;
+
+    // Output pixel -> distorted camera pixel, false outside the camera field of view
+    bool Pixel2Dist(float xIn, float yIn, float& xOut, float& yOut) const;
+
+private:
+    px2Cam* mPx2Cam;
+
+    rectifyParameters mRectParams;
+
+    cv::Mat mRemapTable;
+    px2Remap mRemap;
+};
+
+#endif // PX2RECTIFY_H
@@ -0,0 +1,219 @@
+#include "px2remap.h"
+
+#include <cmath>
+
+// Shared by the kernel and the host reference
+__host__ __device__
+inline void SampleBGRBilinear(const uint8_t* src, size_t srcStep, int srcW, int srcH,
+                              float sx, float sy, uint8_t* dstPx)
+{
+    int x0 = (int)floorf(sx);
+    int y0 = (int)floorf(sy);
+
+    if((sx < 0.f) || (x0 >= srcW) || (y0 < 0) || (y0 >= srcH))
+    {
+        dstPx[0] = dstPx[1] = dstPx[2] = 0;
+        return;
+    }
+
+    int x1 = (x0 + 1 < srcW) ? x0 + 1 : x0;
+    int y1 = (y0 + 1 < srcH) ? y0 + 1 : y0;
+    float fx = sx - (float)x0;
+    float fy = sy - (float)y0;
+
+    const uint8_t* row0 = src + y0*srcStep;
+    const uint8_t* row1 = src + y1*srcStep;
+
+    for(int c = 0; c < 3; c++)
+    {
+        float top = (1.f - fx)*row0[x0*3 + c] + fx*row0[x1*3 + c];
+        float bottom = (1.f - fx)*row1[x0*3 + c] + fx*row1[x1*3 + c];
+        dstPx[c] = (uint8_t)((1.f - fy)*top + fy*bottom + 0.5f);
+    }
+}
+
+__global__
+void RemapBGR(const uint8_t* src, size_t srcStep, int srcW, int srcH,
+              const float2* table, uint8_t* dst, size_t dstStep, int dstW, int dstH)
+{
+    int xIndex = blockIdx.x*blockDim.x + threadIdx.x;
+    int yIndex = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if((xIndex < dstW) && (yIndex < dstH))
+    {
+        float2 srcCoord = table[yIndex*dstW + xIndex];
+        SampleBGRBilinear(src, srcStep, srcW, srcH, srcCoord.x, srcCoord.y, dst + yIndex*dstStep + xIndex*3);
+    }
+}
+
+bool BuildRect2DistMap(const cv::Mat& invMap1, const cv::Mat& invMap2,
+                       int rectWidth, int rectHeight,
+                       cv::Mat& rect2DistMap)
+{
+    if(invMap1.empty() || (invMap1.size() != invMap2.size()) ||
+       (invMap1.type() != CV_32S) || (invMap2.type() != CV_32S))
+    {
+        cout << "[REMAP] Invalid inverse rectification map" << endl;
+        return false;
+    }
+
+    // Scatter every distorted pixel to its rectified position, averaging collisions
+    cv::Mat sum = cv::Mat::zeros(rectHeight, rectWidth, CV_32FC2);
+    cv::Mat cnt = cv::Mat::zeros(rectHeight, rectWidth, CV_32S);
+
+    for(int y = 0; y < invMap1.rows; y++)
+    {
+        for(int x = 0; x < invMap1.cols; x++)
+        {
+            int rectX = invMap1.at<int>(y,x);
+            int rectY = invMap2.at<int>(y,x);
+
+            // Same "no mapping" rule as px2LD::Dist2Rect
+            if((rectX <= 0) || (rectY <= 0) || (rectX >= rectWidth) || (rectY >= rectHeight))
+                continue;
+
+            sum.at<cv::Vec2f>(rectY, rectX) += cv::Vec2f((float)x, (float)y);
+            cnt.at<int>(rectY, rectX)++;
+        }
+    }
+
+    rect2DistMap.create(rectHeight, rectWidth, CV_32FC2);
+    for(int y = 0; y < rectHeight; y++)
+    {
+        for(int x = 0; x < rectWidth; x++)
+        {
+            int n = cnt.at<int>(y,x);
+            rect2DistMap.at<cv::Vec2f>(y,x) = (n > 0) ? sum.at<cv::Vec2f>(y,x)/(float)n : cv::Vec2f(-1.f, -1.f);
+        }
+    }
+
+    // Undistortion stretches the image borders, so fill the small holes left between scattered pixels
+    const int maxFillPasses = 4;
+    for(int pass = 0; pass < maxFillPasses; pass++)
+    {
+        cv::Mat prev = rect2DistMap.clone();
+        int numFilled = 0;
+
+        for(int y = 1; y < rectHeight - 1; y++)
+        {
+            for(int x = 1; x < rectWidth - 1; x++)
+            {
+                if(prev.at<cv::Vec2f>(y,x)[0] >= 0.f)
+                    continue;
+
+                cv::Vec2f acc(0.f, 0.f);
+                int n = 0;
+                const cv::Vec2f nb[4] = {prev.at<cv::Vec2f>(y, x-1), prev.at<cv::Vec2f>(y, x+1),
+                                         prev.at<cv::Vec2f>(y-1, x), prev.at<cv::Vec2f>(y+1, x)};
+                for(int k = 0; k < 4; k++)
+                {
+                    if(nb[k][0] >= 0.f)
+                    {
+                        acc += nb[k];
+                        n++;
+                    }
+                }
+
+                // At least two neighbours, so the outside of the valid area does not grow
+                if(n >= 2)
+                {
+                    rect2DistMap.at<cv::Vec2f>(y,x) = acc/(float)n;
+                    numFilled++;
+                }
+            }
+        }
+
+        if(numFilled == 0)
+            break;
+    }
+
+    return true;
+}
+
+bool SampleRemapTable(const cv::Mat& remapTable, float x, float y, float& outX, float& outY)
+{
+    int x0 = (int)floorf(x);
+    int y0 = (int)floorf(y);
+
+    if((x0 < 0) || (y0 < 0) || (x0 + 1 >= remapTable.cols) || (y0 + 1 >= remapTable.rows))
+        return false;
+
+    const cv::Vec2f& p00 = remapTable.at<cv::Vec2f>(y0, x0);
+    const cv::Vec2f& p01 = remapTable.at<cv::Vec2f>(y0, x0 + 1);
+    const cv::Vec2f& p10 = remapTable.at<cv::Vec2f>(y0 + 1, x0);
+    const cv::Vec2f& p11 = remapTable.at<cv::Vec2f>(y0 + 1, x0 + 1);
+
+    if((p00[0] < 0.f) || (p01[0] < 0.f) || (p10[0] < 0.f) || (p11[0] < 0.f))
+        return false;
+
+    float fx = x - (float)x0;
+    float fy = y - (float)y0;
+
+    cv::Vec2f p = (1.f - fy)*((1.f - fx)*p00 + fx*p01) + fy*((1.f - fx)*p10 + fx*p11);
+    outX = p[0];
+    outY = p[1];
+
+    return true;
+}
+
+void RemapBGRHost(const cv::Mat& srcImg, const cv::Mat& remapTable, cv::Mat& dstImg)
+{
+    dstImg.create(remapTable.rows, remapTable.cols, CV_8UC3);
+
+    for(int y = 0; y < remapTable.rows; y++)
+    {
+        for(int x = 0; x < remapTable.cols; x++)
+        {
+            const cv::Vec2f& srcCoord = remapTable.at<cv::Vec2f>(y,x);
+            SampleBGRBilinear(srcImg.data, srcImg.step, srcImg.cols, srcImg.rows,
+                              srcCoord[0], srcCoord[1], dstImg.ptr<uint8_t>(y) + x*3);
+        }
+    }
+}
+
+px2Remap::~px2Remap()
+{
+    if(mTableCuda)
+        cudaFree(mTableCuda);
+}
+
+bool px2Remap::Init(const cv::Mat& remapTable)
+{
+    if(remapTable.empty() || (remapTable.type() != CV_32FC2) || !remapTable.isContinuous())
+    {
+        cout << "[REMAP] Remap table must be a continuous CV_32FC2 matrix" << endl;
+        return false;
+    }
+
+    if(mTableCuda)
+    {
+        cudaFree(mTableCuda);
+        mTableCuda = nullptr;
+    }
+
+    mWidth = remapTable.cols;
+    mHeight = remapTable.rows;
+
+    cudaError_t status = cudaMalloc(&mTableCuda, mWidth*mHeight*sizeof(float2));
+    if(status == cudaSuccess)
+        status = cudaMemcpy(mTableCuda, remapTable.data, mWidth*mHeight*sizeof(float2), cudaMemcpyHostToDevice);
+
+    if(status != cudaSuccess)
+    {
+        cout << "[REMAP] Cannot upload remap table : " << cudaGetErrorString(status) << endl;
+        return false;
+    }
+
+    return true;
+}
+
+void px2Remap::Apply(const cv::cuda::GpuMat& srcImg, cv::cuda::GpuMat& dstImg, cudaStream_t stream)
+{
+    dstImg.create(mHeight, mWidth, CV_8UC3);
+
+    const dim3 block(16,16);
+    const dim3 grid((mWidth + block.x - 1)/block.x, (mHeight + block.y - 1)/block.y);
+
+    RemapBGR <<< grid, block, 0, stream >>> (srcImg.data, srcImg.step, srcImg.cols, srcImg.rows,
+                                             mTableCuda, dstImg.data, dstImg.step, mWidth, mHeight);
+}
@@ -0,0 +1,54 @@
+#ifndef PX2REMAP_H
+#define PX2REMAP_H
+
+#include "common_cv.h"
+
+#include <cuda_runtime.h>
+
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Precomputed remap (per output pixel source coordinate) applied on the GPU in one pass with bilinear sampling.
+ *
+ * Remap table : cv::Mat CV_32FC2, (x, y) source coordinate of every output pixel, x < 0 means "no source" (black).
+ * Images : 8bit BGR (CV_8UC3), same layout as px2Cam::GetOriGpuMatImgData().
+ * RemapBGRHost() is the host reference of px2Remap::Apply() (same sampling, same rounding).
+ */
+
+// Inverts the distorted -> rectified integer map (invRectMap.xml, invMap1/invMap2)
+// into a rectified -> distorted sub-pixel map of rectWidth x rectHeight.
+bool BuildRect2DistMap(const cv::Mat& invMap1, const cv::Mat& invMap2,
+                       int rectWidth, int rectHeight,
+                       cv::Mat& rect2DistMap);
+
+// Bilinear lookup in a remap table, false if outside or next to a "no source" entry
+bool SampleRemapTable(const cv::Mat& remapTable, float x, float y, float& outX, float& outY);
+
+void RemapBGRHost(const cv::Mat& srcImg, const cv::Mat& remapTable, cv::Mat& dstImg);
+
+class px2Remap{
+public:
+    px2Remap() {}
+    ~px2Remap();
+
+    // Owns the device table
+    px2Remap(const px2Remap&) = delete;
+    px2Remap& operator=(const px2Remap&) = delete;
+
+    bool Init(const cv::Mat& remapTable);
+
+    // dstImg is (re)allocated only if its size does not match the table
+    void Apply(const cv::cuda::GpuMat& srcImg, cv::cuda::GpuMat& dstImg, cudaStream_t stream = 0);
+
+    int GetWidth() const { return mWidth; }
+    int GetHeight() const { return mHeight; }
+
+private:
+    float2* mTableCuda = nullptr;
+    int mWidth = 0;
+    int mHeight = 0;
+};
+
+#endif // PX2REMAP_H
@@ -0,0 +1,273 @@
+#include "px2trace.h"
+
+#include <framework/ProfilerCUDA.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+atomic<uint64_t> gNextRecorderSerial(1);
+
+// Track of this thread in the last recorder it wrote to
+struct traceThreadCache
+{
+    uint64_t recorderSerial;
+    uint16_t tid;
+};
+thread_local traceThreadCache tTraceThread = {0, 0};
+
+// GPU intervals of a thread go to their own track
+const uint32_t TRACE_GPU_TID_OFFSET = 1000;
+
+string EscapeJSON(const string& text)
+{
+    string escaped;
+    for(char c : text)
+    {
+        if((c == '"') || (c == '\\'))
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+}
+
+TraceRecorder::TraceRecorder()
+    : mSerial(gNextRecorderSerial++), mHead(0)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    {
+        lock_guard<mutex> lock(mWriterMutex);
+        mStop = true;
+    }
+    mWriterCond.notify_all();
+
+    if(mWriter.joinable())
+        mWriter.join();
+}
+
+bool TraceRecorder::Init(traceRecorderParameters params)
+{
+    if(mRing)
+    {
+        cout << "[TRACE] Already initialized" << endl;
+        return false;
+    }
+
+    mParams = params;
+
+    uint64_t capacity = 1;
+    while(capacity < max<uint32_t>(mParams.capacity, 2))
+        capacity <<= 1;
+
+    mRing.reset(new traceSlot[capacity]);
+    for(uint64_t slotIdx = 0; slotIdx < capacity; slotIdx++)
+        mRing[slotIdx].seq.store(0, memory_order_relaxed);
+    mMask = capacity - 1;
+
+    mWriter = thread(&TraceRecorder::RunWriter, this);
+
+    cout << "[TRACE] " << capacity << " events ring, "
+         << ((capacity*sizeof(traceSlot)) >> 20) << "MB" << endl;
+
+    return true;
+}
+
+double TraceRecorder::NowUs()
+{
+    return chrono::duration_cast<chrono::duration<double, micro> >(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceRecorder::SetThreadName(const string& name)
+{
+    uint16_t tid = GetThreadId();
+
+    lock_guard<mutex> lock(mThreadMutex);
+    mThreadNames[tid] = name;
+}
+
+uint16_t TraceRecorder::GetThreadId()
+{
+    if(tTraceThread.recorderSerial == mSerial)
+        return tTraceThread.tid;
+
+    lock_guard<mutex> lock(mThreadMutex);
+
+    uint16_t tid = mThreadNames.size();
+    mThreadNames.push_back("thread " + to_string(tid));
+
+    tTraceThread.recorderSerial = mSerial;
+    tTraceThread.tid = tid;
+
+    return tid;
+}
+
+void TraceRecorder::Record(traceCategory category, uint32_t nameId, uint64_t frameSeq, double beginUs, double durationUs)
+{
+    if(!mRing)
+        return;
+
+    uint16_t tid = GetThreadId();
+
+    uint64_t writeIdx = mHead.fetch_add(1, memory_order_relaxed);
+    traceSlot& slot = mRing[writeIdx & mMask];
+
+    slot.seq.store(2*writeIdx + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot.event.nameId = nameId;
+    slot.event.category = category;
+    slot.event.tid = tid;
+    slot.event.frameSeq = frameSeq;
+    slot.event.beginUs = beginUs;
+    slot.event.durationUs = durationUs;
+
+    slot.seq.store(2*writeIdx + 2, memory_order_release);
+}
+
+// Consistent events only : a slot being rewritten during the copy is skipped
+void TraceRecorder::Snapshot(vector<traceEvent>& events)
+{
+    events.clear();
+    if(!mRing)
+        return;
+
+    uint64_t head = mHead.load(memory_order_acquire);
+    uint64_t capacity = mMask + 1;
+    uint64_t first = (head > capacity) ? head - capacity : 0;
+
+    events.reserve(head - first);
+    for(uint64_t readIdx = first; readIdx < head; readIdx++)
+    {
+        traceSlot& slot = mRing[readIdx & mMask];
+
+        uint64_t seqBefore = slot.seq.load(memory_order_acquire);
+        if(seqBefore != 2*readIdx + 2)
+            continue;
+
+        traceEvent event = slot.event;
+
+        atomic_thread_fence(memory_order_acquire);
+        if(slot.seq.load(memory_order_relaxed) != seqBefore)
+            continue;
+
+        events.push_back(event);
+    }
+}
+
+bool TraceRecorder::Dump(const string& filePath)
+{
+    vector<traceEvent> events;
+    Snapshot(events);
+
+    vector<string> threadNames;
+    {
+        lock_guard<mutex> lock(mThreadMutex);
+        threadNames = mThreadNames;
+    }
+
+    ofstream traceFile(filePath, ios::out | ios::trunc);
+    if(!traceFile.is_open())
+    {
+        cout << "[TRACE] Cannot open " << filePath << endl;
+        return false;
+    }
+
+    // Relative times keep the numbers short, the viewer only needs the order
+    double baseUs = events.empty() ? 0.0 : events[0].beginUs;
+    for(const traceEvent& event : events)
+        baseUs = min(baseUs, event.beginUs);
+
+    static const char* categoryNames[] = {"stage", "cpu", "gpu"};
+
+    traceFile << fixed << setprecision(3);
+    traceFile << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+    for(uint32_t tid = 0; tid < threadNames.size(); tid++)
+    {
+        string name = EscapeJSON(threadNames[tid]);
+
+        traceFile << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+                  << ", \"args\": {\"name\": \"" << name << "\"}},\n";
+        traceFile << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid + TRACE_GPU_TID_OFFSET
+                  << ", \"args\": {\"name\": \"" << name << " GPU\"}},\n";
+    }
+
+    // Section names are looked up once per id
+    vector<string> names;
+    for(size_t eventIdx = 0; eventIdx < events.size(); eventIdx++)
+    {
+        const traceEvent& event = events[eventIdx];
+
+        if(event.nameId >= names.size())
+            names.resize(event.nameId + 1);
+        if(names[event.nameId].empty())
+            names[event.nameId] = EscapeJSON(dw::common::ProfilerCUDA::getSectionName(event.nameId));
+
+        uint32_t tid = event.tid + ((event.category == TRACE_GPU) ? TRACE_GPU_TID_OFFSET : 0);
+
+        traceFile << "{\"name\": \"" << names[event.nameId] << "\", \"cat\": \"" << categoryNames[event.category]
+                  << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+                  << ", \"ts\": " << event.beginUs - baseUs << ", \"dur\": " << event.durationUs
+                  << ", \"args\": {\"frame\": " << event.frameSeq << "}}"
+                  << ((eventIdx + 1 < events.size()) ? ",\n" : "\n");
+    }
+
+    traceFile << "]}\n";
+
+    printf("[TRACE] %zu events -> %s\n", events.size(), filePath.c_str());
+
+    return true;
+}
+
+bool TraceRecorder::RequestDump(const string& reason)
+{
+    {
+        lock_guard<mutex> lock(mWriterMutex);
+
+        double nowUs = NowUs();
+        if(!mRing || !mPendingReason.empty() || (mNumDumps >= mParams.maxDumps))
+            return false;
+
+        if((mLastDumpUs >= 0.0) && (nowUs - mLastDumpUs < mParams.minDumpIntervalS*1e6))
+            return false;
+
+        mPendingReason = reason.empty() ? "request" : reason;
+        mLastDumpUs = nowUs;
+    }
+    mWriterCond.notify_one();
+
+    return true;
+}
+
+void TraceRecorder::RunWriter()
+{
+    unique_lock<mutex> lock(mWriterMutex);
+
+    while(true)
+    {
+        mWriterCond.wait(lock, [this]{ return mStop || !mPendingReason.empty(); });
+
+        if(mPendingReason.empty())
+            break;
+
+        string filePath = mParams.filePrefix + "_" + to_string(mNumDumps) + "_" + mPendingReason + ".json";
+        mNumDumps++;
+
+        mWriterCond.wait_for(lock, chrono::duration<float>(mParams.dumpDelayS), [this]{ return mStop; });
+
+        lock.unlock();
+        Dump(filePath);
+        lock.lock();
+
+        mPendingReason.clear();
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef PX2TRACE_H
+#define PX2TRACE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Timeline recorder, exported as Chrome trace-event JSON (chrome://tracing, Perfetto).
+ *
+ * Every stage run, profiled section (CPU) and GPU interval is one complete event (begin + duration)
+ * with its thread and frame id, written to a fixed size ring : recording never allocates nor locks,
+ * the oldest events are overwritten.
+ * A dump writes a snapshot of the ring from a background thread, on demand (RequestDump) or when
+ * LatencyMonitor sees a glass-to-result spike.
+ * Times are steady_clock us, as ProfilerCUDA.
+ */
+
+typedef enum {
+    TRACE_STAGE = 0,    // Pipeline stage run
+    TRACE_CPU = 1,      // Profiled section, CPU time
+    TRACE_GPU = 2       // Profiled section, GPU interval
+}traceCategory;
+
+typedef struct {
+    uint32_t capacity = 1 << 16;        // Events in the ring (rounded up to a power of 2), ~20 per frame : about 100s at 30fps
+    string filePrefix = "trace";        // <filePrefix>_<dumpIdx>_<reason>.json
+    float spikeThresholdMs = 0.f;       // Glass-to-result over it triggers a dump, 0 : disabled
+    float dumpDelayS = 0.5f;            // Snapshot taken this long after the trigger, so it shows what follows too
+    float minDumpIntervalS = 10.f;      // Triggers closer than this are ignored
+    uint32_t maxDumps = 20;
+}traceRecorderParameters;
+
+class TraceRecorder{
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+
+    bool Init(traceRecorderParameters params);
+    traceRecorderParameters GetParameters() const { return mParams; }
+
+    // Thread of the caller, shown as the track name
+    void SetThreadName(const string& name);
+
+    // nameId : ProfilerCUDA section id (registered name)
+    void Record(traceCategory category, uint32_t nameId, uint64_t frameSeq, double beginUs, double durationUs);
+
+    // Dump on the writer thread, false if skipped (interval, count, dump pending)
+    bool RequestDump(const string& reason);
+
+    // Synchronous dump of the current ring
+    bool Dump(const string& filePath);
+
+    uint64_t GetNumEvents() const { return mHead.load(); }
+
+    static double NowUs();
+
+private:
+    typedef struct {
+        uint32_t nameId;
+        uint16_t category;
+        uint16_t tid;
+        uint64_t frameSeq;
+        double beginUs;
+        double durationUs;
+    }traceEvent;
+
+    // Seqlock per slot : odd while written, 2*(write index + 1) when done
+    typedef struct {
+        atomic<uint64_t> seq;
+        traceEvent event;
+    }traceSlot;
+
+    uint16_t GetThreadId();
+    void Snapshot(vector<traceEvent>& events);
+    void RunWriter();
+
+private:
+    traceRecorderParameters mParams;
+    uint64_t mSerial;
+
+    unique_ptr<traceSlot[]> mRing;
+    uint64_t mMask = 0;
+    atomic<uint64_t> mHead;
+
+    mutex mThreadMutex;
+    vector<string> mThreadNames;
+
+    thread mWriter;
+    mutex mWriterMutex;
+    condition_variable mWriterCond;
+    string mPendingReason;
+    bool mStop = false;
+    uint32_t mNumDumps = 0;
+    double mLastDumpUs = -1.0;
+};
+
+#endif // PX2TRACE_H
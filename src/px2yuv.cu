@@ -0,0 +1,162 @@
+#include "px2yuv.h"
+
+#include <cmath>
+
+// Shared by the kernel and the host reference
+
+// Bilinear on a plane of numX x numY samples (channel of numChannels interleaved), (lx, ly) in samples
+__host__ __device__
+inline float SamplePlane(const uint8_t* plane, size_t pitch, int numX, int numY, int numChannels, int channel,
+                         float lx, float ly)
+{
+    lx = fminf(fmaxf(lx, 0.f), (float)(numX - 1));
+    ly = fminf(fmaxf(ly, 0.f), (float)(numY - 1));
+
+    int x0 = (int)lx;
+    int y0 = (int)ly;
+    int x1 = (x0 + 1 < numX) ? x0 + 1 : x0;
+    int y1 = (y0 + 1 < numY) ? y0 + 1 : y0;
+    float fx = lx - (float)x0;
+    float fy = ly - (float)y0;
+
+    const uint8_t* row0 = plane + y0*pitch;
+    const uint8_t* row1 = plane + y1*pitch;
+    float top = (1.f - fx)*row0[x0*numChannels + channel] + fx*row0[x1*numChannels + channel];
+    float bottom = (1.f - fx)*row1[x0*numChannels + channel] + fx*row1[x1*numChannels + channel];
+    return (1.f - fy)*top + fy*bottom;
+}
+
+// Luma mean of the 2x2 quad (qx, qy)
+__host__ __device__
+inline float QuadLuma(const uint8_t* luma, size_t lumaPitch, int qx, int qy)
+{
+    const uint8_t* row0 = luma + 2*qy*lumaPitch + 2*qx;
+    const uint8_t* row1 = row0 + lumaPitch;
+    return 0.25f*((float)row0[0] + (float)row0[1] + (float)row1[0] + (float)row1[1]);
+}
+
+__host__ __device__
+inline float SampleQuadLuma(const uint8_t* luma, size_t lumaPitch, int width, int height, float sx, float sy)
+{
+    // Quad (qx, qy) is centered on (2*qx + 0.5, 2*qy + 0.5)
+    int numX = width/2;
+    int numY = height/2;
+    float qx = fminf(fmaxf((sx - 0.5f)*0.5f, 0.f), (float)(numX - 1));
+    float qy = fminf(fmaxf((sy - 0.5f)*0.5f, 0.f), (float)(numY - 1));
+
+    int x0 = (int)qx;
+    int y0 = (int)qy;
+    int x1 = (x0 + 1 < numX) ? x0 + 1 : x0;
+    int y1 = (y0 + 1 < numY) ? y0 + 1 : y0;
+    float fx = qx - (float)x0;
+    float fy = qy - (float)y0;
+
+    float top = (1.f - fx)*QuadLuma(luma, lumaPitch, x0, y0) + fx*QuadLuma(luma, lumaPitch, x1, y0);
+    float bottom = (1.f - fx)*QuadLuma(luma, lumaPitch, x0, y1) + fx*QuadLuma(luma, lumaPitch, x1, y1);
+    return (1.f - fy)*top + fy*bottom;
+}
+
+// Tensor pixel (x, y) -> RGB 0-1
+__host__ __device__
+inline void NV12Pixel(const uint8_t* luma, size_t lumaPitch, const uint8_t* chroma, size_t chromaPitch, int width, int height,
+                      const yuvColorParameters& params, const tensorCropGeometry& geometry, int x, int y, float* rgb)
+{
+    float sx = ((float)(geometry.roiX + x) + 0.5f)/geometry.scaleX - 0.5f;
+    float sy = ((float)(geometry.roiY + y) + 0.5f)/geometry.scaleY - 0.5f;
+
+    float yValue = geometry.halfRes ? SampleQuadLuma(luma, lumaPitch, width, height, sx, sy)
+                                    : SamplePlane(luma, lumaPitch, width, height, 1, 0, sx, sy);
+
+    // Chroma sample (i, j) sits on luma (2*i, 2*j + 0.5)
+    float cx = sx*0.5f;
+    float cy = (sy - 0.5f)*0.5f;
+    float uValue = SamplePlane(chroma, chromaPitch, width/2, height/2, 2, 0, cx, cy);
+    float vValue = SamplePlane(chroma, chromaPitch, width/2, height/2, 2, 1, cx, cy);
+
+    float yn, un, vn;
+    if(params.fullRange)
+    {
+        yn = yValue/255.f;
+        un = (uValue - 128.f)/255.f;
+        vn = (vValue - 128.f)/255.f;
+    }
+    else
+    {
+        yn = (yValue - 16.f)/219.f;
+        un = (uValue - 128.f)/224.f;
+        vn = (vValue - 128.f)/224.f;
+    }
+
+    float r, g, b;
+    if(params.bt709)
+    {
+        r = yn + 1.5748f*vn;
+        g = yn - 0.187324f*un - 0.468124f*vn;
+        b = yn + 1.8556f*un;
+    }
+    else
+    {
+        r = yn + 1.402f*vn;
+        g = yn - 0.344136f*un - 0.714136f*vn;
+        b = yn + 1.772f*un;
+    }
+
+    rgb[0] = fminf(fmaxf(r, 0.f), 1.f);
+    rgb[1] = fminf(fmaxf(g, 0.f), 1.f);
+    rgb[2] = fminf(fmaxf(b, 0.f), 1.f);
+}
+
+__host__ __device__
+inline void StoreYuvTensorPixel(const float* rgb, int x, int y, int roiW, int roiH, float* tensor, uint8_t* bgr)
+{
+    int j = y*roiW + x;
+    for(int c = 0; c < 3; c++)
+    {
+        tensor[c*roiH*roiW + j] = rgb[c];
+        if(bgr)
+            bgr[j*3 + 2 - c] = (uint8_t)(rgb[c]*255.f + 0.5f);
+    }
+}
+
+__global__
+void NV12ToTensorKernel(const uint8_t* luma, size_t lumaPitch, const uint8_t* chroma, size_t chromaPitch, int width, int height,
+                        yuvColorParameters params, tensorCropGeometry geometry, float* tensor, uint8_t* bgr)
+{
+    int xIndex = blockIdx.x*blockDim.x + threadIdx.x;
+    int yIndex = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if((xIndex < geometry.roiW) && (yIndex < geometry.roiH))
+    {
+        float rgb[3];
+        NV12Pixel(luma, lumaPitch, chroma, chromaPitch, width, height, params, geometry, xIndex, yIndex, rgb);
+        StoreYuvTensorPixel(rgb, xIndex, yIndex, geometry.roiW, geometry.roiH, tensor, bgr);
+    }
+}
+
+void NV12ToTensor(const uint8_t* luma, size_t lumaPitch, const uint8_t* chroma, size_t chromaPitch, int width, int height,
+                  const yuvColorParameters& params, const tensorCropGeometry& geometry,
+                  float* tensor, uint8_t* bgr, cudaStream_t stream)
+{
+    const dim3 block(16,16);
+    const dim3 grid((geometry.roiW + block.x - 1)/block.x, (geometry.roiH + block.y - 1)/block.y);
+
+    NV12ToTensorKernel <<< grid, block, 0, stream >>> (luma, lumaPitch, chroma, chromaPitch, width, height,
+                                                       params, geometry, tensor, bgr);
+}
+
+void NV12ToTensorHost(const cv::Mat& luma, const cv::Mat& chroma, const yuvColorParameters& params,
+                      const tensorCropGeometry& geometry, vector<float>& tensor, cv::Mat& bgr)
+{
+    tensor.resize(3*geometry.roiH*geometry.roiW);
+    bgr.create(geometry.roiH, geometry.roiW, CV_8UC3);
+
+    for(int y = 0; y < geometry.roiH; y++)
+    {
+        for(int x = 0; x < geometry.roiW; x++)
+        {
+            float rgb[3];
+            NV12Pixel(luma.data, luma.step, chroma.data, chroma.step, luma.cols, luma.rows, params, geometry, x, y, rgb);
+            StoreYuvTensorPixel(rgb, x, y, geometry.roiW, geometry.roiH, tensor.data(), bgr.data);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef PX2YUV_H
+#define PX2YUV_H
+
+#include "common_cv.h"
+#include "px2demosaic.h"
+
+#include <cuda_runtime.h>
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Fused NV12 (YUV420 semi-planar) -> TensorRT input : colour conversion, resize, crop and normalization in one kernel,
+ * reading 1.5 bytes per camera pixel instead of the RGBA frame and the BGR / resized copies behind it.
+ *
+ * Every tensor pixel is sampled at its position in the frame (tensorCropGeometry, pixel centers as cv::cuda::resize) :
+ *    luma bilinear on the full grid, or on the 2x2 quad means (halfRes, resize ratio <= 0.5)
+ *    chroma bilinear on its half-res grid, MPEG-2 siting (co-sited with even columns, between row pairs)
+ * then BT.601 / BT.709, limited or full range.
+ *
+ * Outputs : CHW float RGB 0-1 (px2Cam::GetTrtImgData() layout) and optionally the cropped BGR 8bit image.
+ * NV12ToTensorHost() is the host reference of NV12ToTensor() (same sampling, same rounding).
+ */
+
+typedef struct {
+    bool bt709 = false;             // False : BT.601
+    bool fullRange = false;         // False : Y 16-235, UV 16-240
+}yuvColorParameters;
+
+// luma / chroma : Y plane, interleaved UV plane (half width / height), pitches in bytes
+// tensor : 3*roiH*roiW ; bgr : roiW*3 bytes per row, may be null
+void NV12ToTensor(const uint8_t* luma, size_t lumaPitch, const uint8_t* chroma, size_t chromaPitch, int width, int height,
+                  const yuvColorParameters& params, const tensorCropGeometry& geometry,
+                  float* tensor, uint8_t* bgr, cudaStream_t stream = 0);
+
+// luma : CV_8UC1 width x height ; chroma : CV_8UC2 width/2 x height/2 ; bgr : CV_8UC3 roiH x roiW
+void NV12ToTensorHost(const cv::Mat& luma, const cv::Mat& chroma, const yuvColorParameters& params,
+                      const tensorCropGeometry& geometry, vector<float>& tensor, cv::Mat& bgr);
+
+#endif // PX2YUV_H